@@ -0,0 +1,75 @@
+#ifndef __TBA_DISMOUNT_ADDRESSSET_H
+#define __TBA_DISMOUNT_ADDRESSSET_H
+
+/*
+ * AddressSet.h
+ *
+ * A set of addresses kept in a sorted array
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ProcessorAddress.h"
+
+/*
+ * The addresses are appended in any order, and sorted, without duplications,
+ * the first time the set is searched or enumerated after a change.
+ *
+ * NOTE: This class is not thread-safe. Several threads may search the set
+ *       after sort() was called, as long as no address is added.
+ */
+class AddressSet {
+public:
+    /*
+     * Constructor. Creates an empty set
+     */
+    AddressSet();
+
+    /*
+     * Adds 'address' to the set
+     */
+    void add(addressNumericValue address);
+
+    /*
+     * Return true if 'address' is in the set. Sorts the set if needed.
+     */
+    bool contains(addressNumericValue address);
+
+    /*
+     * Return true if 'address' is in the set. The set must be sorted.
+     */
+    bool containsSorted(addressNumericValue address) const;
+
+    /*
+     * Return the number of distinct addresses in the set, and address
+     * 'index', sorted
+     */
+    uint getCount();
+    addressNumericValue get(uint index);
+
+    /*
+     * Sorts the set and removes the duplicated addresses
+     */
+    void sort();
+
+private:
+    // Deny copy-constructor and operator =
+    AddressSet(const AddressSet& other);
+    AddressSet& operator = (const AddressSet& other);
+
+    // Sorting order
+    static bool isBefore(const addressNumericValue& a,
+                         const addressNumericValue& b);
+
+    // The addresses, and whether they are sorted and distinct
+    cSArray<addressNumericValue> m_addresses;
+    uint m_count;
+    bool m_isSorted;
+};
+
+// The reference countable object
+typedef cSmartPtr<AddressSet> AddressSetPtr;
+
+#endif // __TBA_DISMOUNT_ADDRESSSET_H
@@ -0,0 +1,121 @@
+#ifndef __TBA_DISMOUNT_ARRAYUTILS_H
+#define __TBA_DISMOUNT_ARRAYUTILS_H
+
+/*
+ * ArrayUtils.h
+ *
+ * Growing, sorting, merging and hashing the flat arrays of the analysis classes
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "dismount/ProcessorAddress.h"
+
+// The initial size of the growing arrays
+enum { INITIAL_ARRAY_SIZE = 256 };
+
+/*
+ * Appends 'item' to the first 'count' items of 'array', growing the array
+ * geometrically
+ */
+template <class T>
+void appendItem(cSArray<T>& array, uint& count, const T& item)
+{
+    if (count == array.getSize())
+        array.changeSize(t_max((uint)INITIAL_ARRAY_SIZE, count * 2));
+    array[count++] = item;
+}
+
+/*
+ * Sifts items[root] down the heap of the first 'count' items
+ */
+template <class T>
+void siftDown(T* items, uint root, uint count,
+              bool (*isBefore)(const T&, const T&))
+{
+    T value = items[root];
+    while (true)
+    {
+        uint child = root * 2 + 1;
+        if (child >= count)
+            break;
+        if (((child + 1) < count) && isBefore(items[child], items[child + 1]))
+            child++;
+        if (!isBefore(value, items[child]))
+            break;
+        items[root] = items[child];
+        root = child;
+    }
+    items[root] = value;
+}
+
+/*
+ * Sorts 'count' items with a heap sort. No recursion and no extra memory.
+ * The sort isn't stable.
+ */
+template <class T>
+void heapSort(T* items, uint count, bool (*isBefore)(const T&, const T&))
+{
+    if (count < 2)
+        return;
+
+    for (uint i = count / 2; i > 0; i--)
+        siftDown(items, i - 1, count, isBefore);
+
+    for (uint last = count - 1; last > 0; last--)
+    {
+        // Move the largest item to the end and restore the heap
+        T value = items[last];
+        items[last] = items[0];
+        items[0] = value;
+        siftDown(items, 0, last, isBefore);
+    }
+}
+
+/*
+ * Sorts items 'first' to 'count' of 'array', and merges them into the first
+ * 'first' items, which are already sorted. Only the new items are copied
+ * aside.
+ */
+template <class T>
+void mergeSorted(cSArray<T>& array, uint first, uint count,
+                 bool (*isBefore)(const T&, const T&))
+{
+    if (first >= count)
+        return;
+    heapSort(array.getBuffer() + first, count - first, isBefore);
+    if ((0 == first) || !isBefore(array[first], array[first - 1]))
+        return;
+
+    cSArray<T> added(count - first);
+    for (uint i = first; i < count; i++)
+        added[i - first] = array[i];
+
+    // Merge from the end, the new items are placed after equal old items
+    uint old = first;
+    uint next = count - first;
+    uint position = count;
+    while (next > 0)
+    {
+        if ((old > 0) && isBefore(added[next - 1], array[old - 1]))
+            array[--position] = array[--old];
+        else
+            array[--position] = added[--next];
+    }
+}
+
+/*
+ * Return the slot of 'address' in an open-addressing hash of 'mask' + 1
+ * slots
+ */
+inline uint hashAddress(ProcessorAddress::uintAddress address, uint mask)
+{
+    // Fold the address and mix the high bits into the low bits
+    uint32 hash = (uint32)(address ^ (address >> 32));
+    hash*= 0x9E3779B1;
+    hash^= hash >> 16;
+    return hash & mask;
+}
+
+#endif // __TBA_DISMOUNT_ARRAYUTILS_H
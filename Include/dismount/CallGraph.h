@@ -0,0 +1,209 @@
+#ifndef __TBA_DISMOUNT_CALLGRAPH_H
+#define __TBA_DISMOUNT_CALLGRAPH_H
+
+/*
+ * CallGraph.h
+ *
+ * The functions of the mapped code, the calls between them and their
+ * strongly connected components
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ProcessorAddress.h"
+#include "dismount/ControlFlowGraph.h"
+
+/*
+ * A call graph stored as flat arrays, built over a ControlFlowGraph:
+ *   - The functions start at the entry points and at the targets of the call
+ *     edges, and are sorted by their start address.
+ *   - The blocks of a function are the blocks reached from its start without
+ *     following calls or entering the start of another function. A block
+ *     which is reached from more than one function (shared code) belongs to
+ *     the function with the lowest start address.
+ *   - A function calls the functions which are targets of the call edges of
+ *     its blocks, or which its blocks jump or fall into (tail calls).
+ *   - The callees and the callers of each function are in compressed sparse
+ *     row form, like the edges of ControlFlowGraph.
+ *   - The strongly connected components (SCC) are found with Tarjan's
+ *     algorithm, and are numbered in bottom-up order: the callees of an SCC
+ *     are in the SCC itself or in an SCC with a lower number. The level of an
+ *     SCC is 0 if it calls no other SCC, or one more than the highest level
+ *     of the SCCs it calls, so the SCCs with the same level are independent.
+ *
+ * Usage:
+ *     CallGraph callGraph;
+ *     callGraph.build(flowMapper.getGraph(), entryPoints, entryPointsCount);
+ *     for (uint scc = 0; scc < callGraph.getSccsCount(); scc++)
+ *         for (uint i = 0; i < callGraph.getSccFunctionsCount(scc); i++)
+ *             analyze(callGraph.getSccFunction(scc, i));
+ *
+ * NOTE: This class is not thread-safe
+ */
+class CallGraph {
+public:
+    // Returned for blocks and addresses which aren't in any function
+    enum { NO_FUNCTION = 0xFFFFFFFF };
+
+    /*
+     * A function
+     */
+    struct Function {
+        // The start address
+        addressNumericValue m_start;
+        // The index of the entry block in the ControlFlowGraph
+        uint m_block;
+        // The strongly connected component of the function
+        uint m_scc;
+    };
+
+    /*
+     * Constructor. Creates an empty call graph
+     */
+    CallGraph();
+
+    /*
+     * Builds the call graph.
+     *
+     * graph            - The control flow graph of the mapped code
+     * entryPoints      - The addresses of the functions which are called from
+     *                    outside the code (exports for example). Addresses
+     *                    which aren't the start of a block are ignored.
+     * entryPointsCount - The number of entry points
+     */
+    void build(const ControlFlowGraph& graph,
+               const addressNumericValue* entryPoints,
+               uint entryPointsCount);
+
+    /*
+     * Return the number of functions
+     */
+    uint getFunctionsCount() const;
+
+    /*
+     * Return function 'index'. The functions are sorted by their start address.
+     */
+    const Function& getFunction(uint index) const;
+
+    /*
+     * Return the index of the function which starts at 'address', or
+     * NO_FUNCTION
+     */
+    uint findFunction(addressNumericValue address) const;
+
+    /*
+     * Return the function which block 'block' of the ControlFlowGraph belongs
+     * to, or NO_FUNCTION for unreachable blocks
+     */
+    uint getBlockFunction(uint block) const;
+
+    /*
+     * Return the number of blocks of function 'index', and block 'i' of it,
+     * sorted by the block index
+     */
+    uint getFunctionBlocksCount(uint index) const;
+    uint getFunctionBlock(uint index, uint i) const;
+
+    /*
+     * Return the number of distinct calls between the functions
+     */
+    uint getCallsCount() const;
+
+    /*
+     * Return the number of callees of function 'index', and callee 'i',
+     * sorted by the function index
+     */
+    uint getCalleesCount(uint index) const;
+    uint getCallee(uint index, uint i) const;
+
+    /*
+     * Return the number of callers of function 'index', and caller 'i',
+     * sorted by the function index
+     */
+    uint getCallersCount(uint index) const;
+    uint getCaller(uint index, uint i) const;
+
+    /*
+     * Return the number of strongly connected components
+     */
+    uint getSccsCount() const;
+
+    /*
+     * Return the number of functions of SCC 'scc', and function 'i' of it
+     */
+    uint getSccFunctionsCount(uint scc) const;
+    uint getSccFunction(uint scc, uint i) const;
+
+    /*
+     * Return the level of SCC 'scc'. See above.
+     */
+    uint getSccLevel(uint scc) const;
+
+    /*
+     * Return true if SCC 'scc' has a cycle: more than one function, or a
+     * function which calls itself
+     */
+    bool isSccRecursive(uint scc) const;
+
+private:
+    // Deny copy-constructor and operator =
+    CallGraph(const CallGraph& other);
+    CallGraph& operator = (const CallGraph& other);
+
+    /*
+     * A call between two functions, before it's stored in the CSR arrays
+     */
+    struct Call {
+        uint m_caller;
+        uint m_callee;
+    };
+
+    // Sorting orders
+    static bool isAddressBefore(const addressNumericValue& a,
+                                const addressNumericValue& b);
+    static bool isCallBefore(const Call& a, const Call& b);
+
+    /*
+     * Assigns the blocks to the functions
+     */
+    void assignBlocks(const ControlFlowGraph& graph);
+
+    /*
+     * Finds the calls between the functions and fills the CSR arrays
+     */
+    void buildCalls(const ControlFlowGraph& graph);
+
+    /*
+     * Finds the strongly connected components, in bottom-up order, and their
+     * levels
+     */
+    void buildSccs();
+
+    // The functions, sorted by the start address
+    cSArray<Function> m_functions;
+    uint m_functionsCount;
+    // The function of each block of the ControlFlowGraph
+    cSArray<uint> m_blockFunctions;
+    // The blocks of function 'i' are between offset 'i' and 'i + 1'
+    cSArray<uint> m_blockOffsets;
+    cSArray<uint> m_blocks;
+    // The callees and the callers of function 'i' are between offset 'i' and
+    // 'i + 1'
+    cSArray<uint> m_calleeOffsets;
+    cSArray<uint> m_callees;
+    cSArray<uint> m_callerOffsets;
+    cSArray<uint> m_callers;
+    uint m_callsCount;
+    // The functions of SCC 'i' are between offset 'i' and 'i + 1'
+    cSArray<uint> m_sccOffsets;
+    cSArray<uint> m_sccFunctions;
+    cSArray<uint> m_sccLevels;
+    uint m_sccsCount;
+};
+
+// The reference countable object
+typedef cSmartPtr<CallGraph> CallGraphPtr;
+
+#endif // __TBA_DISMOUNT_CALLGRAPH_H
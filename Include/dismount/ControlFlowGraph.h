@@ -0,0 +1,261 @@
+#ifndef __TBA_DISMOUNT_CONTROLFLOWGRAPH_H
+#define __TBA_DISMOUNT_CONTROLFLOWGRAPH_H
+
+/*
+ * ControlFlowGraph.h
+ *
+ * The basic blocks of the mapped code and the flow edges between them
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ProcessorAddress.h"
+#include "dismount/PagedBitset.h"
+
+/*
+ * A control flow graph stored as flat arrays:
+ *   - The basic blocks, sorted by their start address. The blocks don't
+ *     overlap, so the block of an address is found with a binary search.
+ *   - The successors and the predecessors of each block in compressed sparse
+ *     row form: the edges of block 'i' are the edges between offset 'i' and
+ *     offset 'i + 1'.
+ *
+ * The graph is built from records which are appended while the code is walked
+ * (See FlowMapper): the walked blocks, and the edges from the address of their
+ * flow altering instruction to the target address. A target in the middle of
+ * a block splits the block in two, joined by a fall-through edge. Edges whose
+ * target isn't the start of a block (unknown destinations, non-executable
+ * targets) aren't part of the graph.
+ *
+ * Usage:
+ *     const ControlFlowGraph& graph = flowMapper.getGraph();
+ *     uint block = graph.findBlock(address);
+ *     for (uint i = 0; i < graph.getSuccessorsCount(block); i++)
+ *         graph.getSuccessor(block, i).m_block;
+ *
+ * NOTE: This class is not thread-safe
+ */
+class ControlFlowGraph {
+public:
+    // The kinds of edges
+    enum EdgeKind {
+        // The flow into the next instruction
+        EDGE_FALLTHROUGH = 0,
+        // The taken side of a conditional jump
+        EDGE_CONDITIONAL,
+        // An unconditional jump
+        EDGE_UNCONDITIONAL,
+        // A call into the start of a function
+        EDGE_CALL,
+        // A jump through a switch table
+        EDGE_SWITCH
+    };
+
+    // Returned by findBlock() for addresses which aren't in any block
+    enum { NO_BLOCK = 0xFFFFFFFF };
+
+    /*
+     * A basic block
+     */
+    struct Block {
+        // The address of the first instruction
+        addressNumericValue m_start;
+        // The address after the last instruction
+        addressNumericValue m_end;
+    };
+
+    /*
+     * An edge of a block
+     */
+    struct Edge {
+        // The other block: the target for a successor, the source for a
+        // predecessor
+        uint m_block;
+        // See EdgeKind
+        uint m_kind;
+    };
+
+    /*
+     * A walked block
+     */
+    struct BlockRecord {
+        addressNumericValue m_start;
+        addressNumericValue m_end;
+    };
+
+    /*
+     * A walked edge
+     */
+    struct EdgeRecord {
+        // The address of the instruction which leaves the source block
+        addressNumericValue m_source;
+        addressNumericValue m_target;
+        uint m_kind;
+    };
+
+    /*
+     * The blocks and edges appended while walking the code, before the graph
+     * is built
+     */
+    class Records {
+    public:
+        /*
+         * Constructor. Creates an empty records set
+         */
+        Records();
+
+        /*
+         * Removes all the records. The allocated memory is kept.
+         */
+        void clear();
+
+        /*
+         * Appends a block of the instructions between 'start' and 'end'
+         * (exclusive). Empty blocks are ignored.
+         */
+        void addBlock(addressNumericValue start, addressNumericValue end);
+
+        /*
+         * Appends an edge from the instruction at 'source' into 'target'
+         */
+        void addEdge(addressNumericValue source,
+                     addressNumericValue target,
+                     uint kind);
+
+        /*
+         * Return the number of records
+         */
+        uint getBlocksCount() const;
+        uint getEdgesCount() const;
+
+        /*
+         * Return a record
+         */
+        const BlockRecord& getBlock(uint index) const;
+        const EdgeRecord& getEdge(uint index) const;
+
+        /*
+         * Removes the records after the first 'blocksCount' blocks and the
+         * first 'edgesCount' edges
+         */
+        void truncate(uint blocksCount, uint edgesCount);
+
+        /*
+         * Appends 'blocksCount' block records starting at 'firstBlock' and
+         * 'edgesCount' edge records starting at 'firstEdge' of 'other'
+         */
+        void append(const Records& other,
+                    uint firstBlock,
+                    uint blocksCount,
+                    uint firstEdge,
+                    uint edgesCount);
+
+        /*
+         * Copies 'blocksCount' block records starting at 'firstBlock' down to
+         * 'toBlock', and 'edgesCount' edge records starting at 'firstEdge'
+         * down to 'toEdge', keeping their order. See truncate.
+         */
+        void moveDown(uint firstBlock,
+                      uint blocksCount,
+                      uint toBlock,
+                      uint firstEdge,
+                      uint edgesCount,
+                      uint toEdge);
+
+    private:
+        cSArray<BlockRecord> m_blocks;
+        uint m_blocksCount;
+        cSArray<EdgeRecord> m_edges;
+        uint m_edgesCount;
+    };
+
+    /*
+     * Constructor. Creates an empty graph
+     */
+    ControlFlowGraph();
+
+    /*
+     * Builds the graph from the walked records.
+     *
+     * records      - The walked blocks and edges
+     * instructions - The addresses of the decoded instructions. A block is
+     *                split only at an instruction address.
+     */
+    void build(const Records& records, const PagedBitset& instructions);
+
+    /*
+     * Return the number of blocks
+     */
+    uint getBlocksCount() const;
+
+    /*
+     * Return block 'index'. The blocks are sorted by their start address.
+     */
+    const Block& getBlock(uint index) const;
+
+    /*
+     * Return the index of the block which contains 'address', or NO_BLOCK
+     */
+    uint findBlock(addressNumericValue address) const;
+
+    /*
+     * Return the number of edges in the graph
+     */
+    uint getEdgesCount() const;
+
+    /*
+     * Return the number of successors of block 'index', and successor 'i',
+     * sorted by the target block
+     */
+    uint getSuccessorsCount(uint index) const;
+    const Edge& getSuccessor(uint index, uint i) const;
+
+    /*
+     * Return the number of predecessors of block 'index', and predecessor
+     * 'i', sorted by the source block
+     */
+    uint getPredecessorsCount(uint index) const;
+    const Edge& getPredecessor(uint index, uint i) const;
+
+private:
+    // Deny copy-constructor and operator =
+    ControlFlowGraph(const ControlFlowGraph& other);
+    ControlFlowGraph& operator = (const ControlFlowGraph& other);
+
+    /*
+     * An edge between two blocks, before it's stored in the CSR arrays
+     */
+    struct BlockEdge {
+        uint m_from;
+        uint m_to;
+        uint m_kind;
+    };
+
+    // Sorting orders
+    static bool isBlockBefore(const Block& a, const Block& b);
+    static bool isAddressBefore(const addressNumericValue& a,
+                                const addressNumericValue& b);
+    static bool isEdgeBefore(const BlockEdge& a, const BlockEdge& b);
+
+    /*
+     * Return the index of the block which starts at 'address', or NO_BLOCK
+     */
+    uint findBlockStart(addressNumericValue address) const;
+
+    // The blocks, sorted by the start address
+    cSArray<Block> m_blocks;
+    uint m_blocksCount;
+    // The edges of block 'i' are between offset 'i' and 'i + 1'
+    cSArray<uint> m_successorOffsets;
+    cSArray<Edge> m_successors;
+    cSArray<uint> m_predecessorOffsets;
+    cSArray<Edge> m_predecessors;
+    uint m_edgesCount;
+};
+
+// The reference countable object
+typedef cSmartPtr<ControlFlowGraph> ControlFlowGraphPtr;
+
+#endif // __TBA_DISMOUNT_CONTROLFLOWGRAPH_H
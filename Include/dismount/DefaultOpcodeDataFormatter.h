@@ -19,12 +19,29 @@
  *     <opcode-name><spaces><operand>,<operand>...
  * The opcode-name filled has a length given in the constructor -
  * "opcodeNameAlignment".
- * All the number are displaied in hexadecimal form.
+ * All the number are displaied in hexadecimal form, either with the 'h' suffix
+ * (13h) or with the '0x' prefix (0x13). The numbers are rendered with
+ * pair-of-nibbles lookup tables directly into a characters buffer, without
+ * any intermediate string.
  * If IP-address is supplied then all relative address are translated to
  * absolute addresses, otherwise they are shown in the format $+-ADDR.
  */
 class DefaultOpcodeDataFormatter : public OpcodeDataFormatter {
 public:
+    /*
+     * The hexadecimal numbers styles
+     */
+    enum HexadecimalStyle {
+        // 0040100Ah
+        HEX_SUFFIX,
+        // 0x0040100A
+        HEX_PREFIX
+    };
+
+    // The number of characters needed for any number written by 'writeHex',
+    // including the null-terminator: "0x" + 16 digits + '\0'
+    enum { MAX_HEX_LENGTH = 20 };
+
     /*
      * Constructor.
      *
@@ -33,8 +50,35 @@ public:
      *                       characters then the 'opcodeNameAlignment' then the
      *                       opcode name will be cut, otherwise space character
      *                       will be appended to the opcode (Left alignment).
+     * hexadecimalStyle    - The style of the numbers
      */
-    DefaultOpcodeDataFormatter(uint opcodeNameAlignment);
+    DefaultOpcodeDataFormatter(uint opcodeNameAlignment,
+                               HexadecimalStyle hexadecimalStyle = HEX_SUFFIX);
+
+    /*
+     * Writes a number in hexadecimal form into 'buffer'.
+     *
+     * buffer - At least MAX_HEX_LENGTH characters. The number is
+     *          null-terminated.
+     * value  - The number to write
+     * digits - The number of digits, padded with zeros. Zero means the minimal
+     *          number of digits.
+     * style  - The decoration of the number. Set 'isDecorated' to false for a
+     *          plain number.
+     *
+     * Return the number of characters written, without the null-terminator.
+     */
+    static uint writeHex(character* buffer,
+                         uint64 value,
+                         uint digits,
+                         HexadecimalStyle style,
+                         bool isDecorated = true);
+
+    /*
+     * Return the two hexadecimal digits of 'value', not null-terminated. Used
+     * by the writers which encode bytes directly into their own buffers.
+     */
+    static const char* getHexPair(uint8 value);
 
     /*
      * See OpcodeDataFormatter::newInstruction
@@ -88,10 +132,15 @@ public:
 
 
 private:
+    /*
+     * Return the decorated hexadecimal form of 'value'. See 'writeHex'
+     */
+    cString translateHex(uint64 value, uint digits) const;
+
     // The number of character for the alignment
     uint m_opcodeNameAlignment;
-    // The suffix for hexadecimal number
-    static const character m_hexadecimalSuffix;
+    // The style of the hexadecimal numbers
+    HexadecimalStyle m_hexadecimalStyle;
 };
 
 // The reference countable object
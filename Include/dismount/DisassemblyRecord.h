@@ -0,0 +1,178 @@
+#ifndef __TBA_DISMOUNT_DISASSEMBLYRECORD_H
+#define __TBA_DISMOUNT_DISASSEMBLYRECORD_H
+
+/*
+ * DisassemblyRecord.h
+ *
+ * The binary structured disassembly format. A compact alternative to the
+ * textual OpcodeFormatter output for tools which consume the instructions
+ * programmatically.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+
+/*
+ * The file layout is:
+ *     Header                                    (32 bytes)
+ *     String table                              (Header::m_stringTableSize)
+ *     Padding up to Header::m_recordsOffset     (8 bytes alignment)
+ *     Record[]                                  (until the end of the file)
+ *
+ * The string table is a sequence of null-terminated mnemonics. A mnemonic id
+ * is the offset of the mnemonic inside the string table.
+ * The number of records is derived from the file size, so the file is
+ * written sequentially without seeking back.
+ *
+ * All the structures are naturally aligned and stored in the host byte-order
+ * (little-endian), so a reader can map the file into memory and use the
+ * records directly. See DisassemblyRecordReader.
+ */
+class DisassemblyRecord {
+public:
+    // Format constants
+    enum {
+        // "DMRS"
+        MAGIC = 0x53524D44,
+        // The current version of the format
+        VERSION = 1,
+        // The maximum number of operands in a record
+        MAX_OPERANDS = 3,
+        // The alignment of the records
+        RECORDS_ALIGNMENT = 8
+    };
+
+    /*
+     * The file header
+     */
+    struct Header {
+        // Must be MAGIC
+        uint32 m_magic;
+        // Must be VERSION
+        uint16 m_version;
+        // sizeof(Record)
+        uint16 m_recordSize;
+        // The string table position and length, in bytes
+        uint32 m_stringTableOffset;
+        uint32 m_stringTableSize;
+        // The position of the first record
+        uint32 m_recordsOffset;
+        // The OpcodeSubsystems::DisassemblerType of the instructions
+        uint32 m_processorType;
+        // Zero
+        uint32 m_reserved[2];
+    };
+
+    /*
+     * The register sets. A register id is:
+     *     (set << REGISTER_SET_SHIFT) | register-number
+     * where the number is the processor encoding (See ia32dis::IA32_GP32_EAX
+     * for example). Zero is reserved for "no register".
+     */
+    enum {
+        REGISTER_NONE = 0,
+        REGISTER_SET_SHIFT = 4,
+        REGISTER_NUMBER_MASK = 0xF,
+
+        REGISTER_SET_GP8 = 1,
+        REGISTER_SET_GP16 = 2,
+        REGISTER_SET_GP32 = 3,
+        REGISTER_SET_SEGMENT = 4,
+        REGISTER_SET_CONTROL = 5,
+        REGISTER_SET_DEBUG = 6,
+        REGISTER_SET_MMX = 7,
+        REGISTER_SET_SIMD = 8
+    };
+
+    /*
+     * The operand types
+     */
+    enum {
+        // The operand is not in use
+        OPERAND_NONE = 0,
+        // A register, stored in m_base
+        OPERAND_REGISTER = 1,
+        // A memory reference: m_segment:[m_base + m_index * m_scale + m_value]
+        // m_value is the sign-extended displacement, or the absolute address
+        // if there aren't any registers
+        OPERAND_MEMORY = 2,
+        // An immediate value, stored in m_value
+        OPERAND_IMMEDIATE = 3,
+        // A relative branch. m_value is the absolute target if the record has
+        // an address (FLAG_HAS_ADDRESS), otherwise the sign-extended distance
+        // from the next instruction
+        OPERAND_BRANCH = 4,
+        // A far pointer m_farSegment:m_value
+        OPERAND_FAR = 5
+    };
+
+    /*
+     * A single operand (16 bytes)
+     */
+    struct Operand {
+        // One of the OPERAND_* values
+        uint8 m_type;
+        // The size of the accessed data in bytes, or 0 if it's unknown
+        uint8 m_size;
+        // Register ids, see REGISTER_SET_*
+        uint8 m_base;
+        uint8 m_index;
+        // The index multiplier: 1, 2, 4 or 8
+        uint8 m_scale;
+        // The segment register override, or REGISTER_NONE
+        uint8 m_segment;
+        // The segment of an OPERAND_FAR
+        uint16 m_farSegment;
+        // The immediate, displacement or address. See OPERAND_*
+        uint64 m_value;
+    };
+
+    /*
+     * Records flags
+     */
+    enum {
+        // m_address is valid
+        FLAG_HAS_ADDRESS = 0x0001,
+        // The instruction may alter the program flow. See m_alterProperty
+        FLAG_BRANCH = 0x0002,
+        // m_branchTarget is valid
+        FLAG_HAS_BRANCH_TARGET = 0x0004,
+        // The instruction is a switch-table jump. m_branchTarget is the table
+        FLAG_SWITCH = 0x0008,
+        // The byte couldn't be decoded, the record length is 1
+        FLAG_INVALID = 0x0010,
+        // The instruction has the lock prefix
+        FLAG_LOCK = 0x0020,
+        // The instruction has the rep/repe prefix
+        FLAG_REP = 0x0040,
+        // The instruction has the repne prefix
+        FLAG_REPNE = 0x0080
+    };
+
+    /*
+     * A single instruction (80 bytes)
+     */
+    struct Record {
+        // The address of the instruction. See FLAG_HAS_ADDRESS
+        uint64 m_address;
+        // The target of a direct branch, or the address of a switch table.
+        // See FLAG_HAS_BRANCH_TARGET
+        uint64 m_branchTarget;
+        // The mnemonic id, the offset inside the string table
+        uint32 m_mnemonic;
+        // The Opcode::FlowAlter properties
+        uint32 m_alterProperty;
+        // FLAG_* values
+        uint16 m_flags;
+        // The number of bytes of the instruction
+        uint8 m_length;
+        // The number of used operands
+        uint8 m_operandsCount;
+        // Zero
+        uint32 m_reserved;
+        // The operands, in Intel order (destination first)
+        Operand m_operands[MAX_OPERANDS];
+    };
+};
+
+#endif // __TBA_DISMOUNT_DISASSEMBLYRECORD_H
@@ -0,0 +1,75 @@
+#ifndef __TBA_DISMOUNT_DISASSEMBLYRECORDREADER_H
+#define __TBA_DISMOUNT_DISASSEMBLYRECORDREADER_H
+
+/*
+ * DisassemblyRecordReader.h
+ *
+ * Gives access to a binary disassembly records file which is already in
+ * memory.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "dismount/DisassemblyRecord.h"
+
+/*
+ * Validates the header of a records file and returns pointers into it. The
+ * records are not copied or parsed, the file is usually mapped into memory by
+ * the caller.
+ *
+ * Usage:
+ *     DisassemblyRecordReader reader(mappedFile, mappedFileSize);
+ *     for (uint i = 0; i < reader.getRecordsCount(); i++)
+ *         printf("%s\n", reader.getMnemonic(reader.getRecord(i)));
+ */
+class DisassemblyRecordReader {
+public:
+    /*
+     * Constructor.
+     *
+     * data - The content of the file. Must be aligned to 8 bytes (any mapped
+     *        memory is) and kept alive while the reader is used.
+     * size - The number of bytes in 'data'
+     *
+     * Throw exception if the header is invalid or doesn't match 'size'
+     */
+    DisassemblyRecordReader(const void* data, uint size);
+
+    /*
+     * Return the header of the file
+     */
+    const DisassemblyRecord::Header& getHeader() const;
+
+    /*
+     * Return the number of records in the file
+     */
+    uint getRecordsCount() const;
+
+    /*
+     * Return all the records as an array of getRecordsCount() elements
+     */
+    const DisassemblyRecord::Record* getRecords() const;
+
+    /*
+     * Return a single record.
+     * Throw exception if 'index' is out of range.
+     */
+    const DisassemblyRecord::Record& getRecord(uint index) const;
+
+    /*
+     * Return the null-terminated mnemonic of a record.
+     * Throw exception if the mnemonic id is out of the string table.
+     */
+    const char* getMnemonic(const DisassemblyRecord::Record& record) const;
+
+private:
+    // The header, at the start of the data
+    const DisassemblyRecord::Header* m_header;
+    // The string table
+    const char* m_stringTable;
+    // The records and their count
+    const DisassemblyRecord::Record* m_records;
+    uint m_recordsCount;
+};
+
+#endif // __TBA_DISMOUNT_DISASSEMBLYRECORDREADER_H
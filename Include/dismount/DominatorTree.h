@@ -0,0 +1,208 @@
+#ifndef __TBA_DISMOUNT_DOMINATORTREE_H
+#define __TBA_DISMOUNT_DOMINATORTREE_H
+
+/*
+ * DominatorTree.h
+ *
+ * The dominators and the natural loops of the functions of the mapped code
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ControlFlowGraph.h"
+#include "dismount/CallGraph.h"
+
+/*
+ * The dominator tree and the loop nesting of every function of a CallGraph,
+ * stored as flat arrays indexed by the block index of the ControlFlowGraph.
+ *
+ * The flow inside a function is its blocks and the edges between them, except
+ * the call edges. The dominators are computed with the iterative algorithm of
+ * Cooper, Harvey and Kennedy ("A Simple, Fast Dominance Algorithm") over the
+ * reverse post-order of each function. The dominator tree is numbered in
+ * pre-order and post-order, so dominates() is two compares.
+ *
+ * A back edge is an edge into a block which dominates its source. The natural
+ * loop of a header is the header and the blocks which reach one of its back
+ * edges without passing through the header. Loops with the same header are
+ * one loop, and the loops are nested by their bodies. Retreating edges into a
+ * block which doesn't dominate the source (irreducible flow) don't form
+ * loops.
+ *
+ * All the memory is allocated once for each build, for all the functions.
+ *
+ * Usage:
+ *     DominatorTree dominators;
+ *     dominators.build(flowMapper.getGraph(), callGraph);
+ *     uint loop = dominators.getBlockLoop(block);
+ *     if (DominatorTree::NO_LOOP != loop)
+ *         dominators.getLoop(loop).m_depth;
+ *
+ * NOTE: This class is not thread-safe
+ */
+class DominatorTree {
+public:
+    // Returned for blocks and loops without a dominator or a loop
+    enum { NO_BLOCK = ControlFlowGraph::NO_BLOCK, NO_LOOP = 0xFFFFFFFF };
+
+    /*
+     * A natural loop
+     */
+    struct Loop {
+        // The header block
+        uint m_header;
+        // The innermost loop which contains this loop, or NO_LOOP
+        uint m_parent;
+        // The nesting depth. 1 for an outermost loop.
+        uint m_depth;
+        // The function of the loop
+        uint m_function;
+    };
+
+    /*
+     * A back edge
+     */
+    struct BackEdge {
+        // The block of the edge source
+        uint m_source;
+        // The loop header
+        uint m_header;
+    };
+
+    /*
+     * Constructor. Creates an empty tree
+     */
+    DominatorTree();
+
+    /*
+     * Computes the dominators and the loops of all the functions.
+     *
+     * graph     - The control flow graph of the mapped code
+     * callGraph - The call graph built over 'graph'
+     */
+    void build(const ControlFlowGraph& graph, const CallGraph& callGraph);
+
+    /*
+     * Return the immediate dominator of 'block', or NO_BLOCK for the entry
+     * block of a function and for the blocks without a function
+     */
+    uint getImmediateDominator(uint block) const;
+
+    /*
+     * Return true if 'dominator' dominates 'block'. A block dominates itself.
+     */
+    bool dominates(uint dominator, uint block) const;
+
+    /*
+     * Return the depth of 'block' in the dominator tree. 0 for the entry
+     * block of a function.
+     */
+    uint getDominatorDepth(uint block) const;
+
+    /*
+     * Return the number of loops of all the functions
+     */
+    uint getLoopsCount() const;
+
+    /*
+     * Return loop 'index'. Inner loops come before the loops which contain
+     * them.
+     */
+    const Loop& getLoop(uint index) const;
+
+    /*
+     * Return the innermost loop which contains 'block', or NO_LOOP
+     */
+    uint getBlockLoop(uint block) const;
+
+    /*
+     * Return the loop nesting depth of 'block'. 0 outside of loops.
+     */
+    uint getLoopDepth(uint block) const;
+
+    /*
+     * Return the number of back edges, and back edge 'index'
+     */
+    uint getBackEdgesCount() const;
+    const BackEdge& getBackEdge(uint index) const;
+
+private:
+    // Deny copy-constructor and operator =
+    DominatorTree(const DominatorTree& other);
+    DominatorTree& operator = (const DominatorTree& other);
+
+    /*
+     * Computes the immediate dominators of the blocks of 'function', and
+     * fills m_order with the post-order of its flow
+     */
+    void buildFunctionDominators(const ControlFlowGraph& graph,
+                                 const CallGraph& callGraph,
+                                 uint function);
+
+    /*
+     * Numbers the dominator tree of the function whose flow is in m_order in
+     * pre-order and post-order
+     */
+    void numberFunctionTree(uint entry);
+
+    /*
+     * Finds the back edges and the natural loops of the function whose flow
+     * is in m_order
+     */
+    void buildFunctionLoops(const ControlFlowGraph& graph,
+                            const CallGraph& callGraph,
+                            uint function);
+
+    /*
+     * Return the outermost loop found so far which contains 'loop'
+     */
+    uint getOutermostLoop(uint loop) const;
+
+    /*
+     * Return true if 'edge' is a flow edge inside 'function'
+     */
+    static bool isFunctionEdge(const CallGraph& callGraph,
+                               const ControlFlowGraph::Edge& edge,
+                               uint function);
+
+    // The immediate dominator of each block
+    cSArray<uint> m_idoms;
+    // The pre-order and post-order numbers of each block in the dominator
+    // tree, and its depth
+    cSArray<uint> m_preorder;
+    cSArray<uint> m_postorder;
+    cSArray<uint> m_depths;
+    // The loops, and the innermost loop of each block
+    cSArray<Loop> m_loops;
+    uint m_loopsCount;
+    cSArray<uint> m_blockLoops;
+    // The back edges
+    cSArray<BackEdge> m_backEdges;
+    uint m_backEdgesCount;
+
+    // Work arrays, reused by all the functions
+    // The blocks of the flow of the current function, in post-order
+    cSArray<uint> m_order;
+    uint m_orderCount;
+    // The post-order number of each block in its function flow
+    cSArray<uint> m_flowPostorder;
+    // A stack of blocks, and the next edge or child of each block in the
+    // stack
+    cSArray<uint> m_stack;
+    cSArray<uint> m_stackNext;
+    // The children of each block in the dominator tree, as linked lists
+    cSArray<uint> m_firstChild;
+    cSArray<uint> m_nextSibling;
+    // The blocks waiting to be added to a loop body
+    cSArray<uint> m_worklist;
+    // The next pre-order and post-order numbers
+    uint m_nextPreorder;
+    uint m_nextPostorder;
+};
+
+// The reference countable object
+typedef cSmartPtr<DominatorTree> DominatorTreePtr;
+
+#endif // __TBA_DISMOUNT_DOMINATORTREE_H
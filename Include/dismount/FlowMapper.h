@@ -11,8 +11,10 @@
  * - The algorithm does not reach blocks whose addresses
  *   are pushed to stack or MOV'd to a register:
  *      - Exception handlers and filters (address pushed into stack)
- *      - Switch statements (the call is to an offset plus an index
- *        stored in a register)
+ * - Switch statements (a jump to an offset plus an index stored in a
+ *   register) are walked through the entries of their jump table. The
+ *   number of entries is taken from the "cmp index, imm; ja default" bound
+ *   check before the jump, and is guessed when there isn't one.
  * - Code blocks that IDA gets using FLIRT
  * - Tries to treat non-functions that are exported as functions
  *   (FsRtlLegalAnsiCharacterArray in ntkrnlpa.exe, for instance)
@@ -27,8 +29,14 @@
 #include "dismount/StreamDisassemblerFactory.h"
 #include "dismount/DefaultOpcodeDataFormatter.h"
 #include "dismount/proc/ia32/IA32Opcode.h"
-#include "dismount/assembler/Stack.h"
+#include "dismount/assembler/ArrayStack.h"
 #include "dismount/SectionMemoryInterface.h"
+#include "dismount/PagedBitset.h"
+#include "dismount/AddressSet.h"
+#include "dismount/ControlFlowGraph.h"
+#include "dismount/XrefIndex.h"
+#include "dismount/MapListFile.h"
+#include "dismount/MapListReader.h"
 
 #define NUMBER_OF_OPCODE (7)
 #define OPCODE_MARGIN (10)
@@ -65,6 +73,134 @@ public:
         {}
     };
 
+    // A list of entry points stream addresses
+    typedef cList<addressNumericValue> addresses;
+
+    // Selects the breakpoint addresses of the map list, see
+    // buildBreakpointPlan. The end address of a subset is selected if
+    // (m_endAlterProperty & m_endMask) == m_endValue, and its caller address
+    // if (m_callerAlterProperty & m_callerMask) == m_callerValue.
+    struct BreakpointSelection {
+        int m_endMask;
+        int m_endValue;
+        int m_callerMask;
+        int m_callerValue;
+
+        // The default selection: the rets, and the callers which can be
+        // handled by OpcodeAction (FLOW_ACTION)
+        BreakpointSelection() : m_endMask(-1),
+                                m_endValue(Opcode::FLOW_RET | Opcode::FLOW_ACTION),
+                                m_callerMask(Opcode::FLOW_ACTION),
+                                m_callerValue(Opcode::FLOW_ACTION)
+        {}
+    };
+
+    // The breakpoint addresses of the map list
+    struct BreakpointPlan {
+        // The selected addresses, sorted and without duplicates
+        cSArray<addressNumericValue> m_addresses;
+        // The number of addresses of each class. An address which is selected
+        // more than once is counted by its first selection in the map list.
+        // The selected end addresses (the rets)
+        uint m_endsCount;
+        // The selected caller addresses: calls (FLOW_STACK_CHANGE), other
+        // unconditional jumps (FLOW_COND_ALWAYS) and the rest (conditional
+        // jumps)
+        uint m_callsCount;
+        uint m_jmpsCount;
+        uint m_othersCount;
+
+        BreakpointPlan() : m_endsCount(0),
+                           m_callsCount(0),
+                           m_jmpsCount(0),
+                           m_othersCount(0)
+        {}
+    };
+
+    /*
+     * Receives the results of the mapping as they are found, see setVisitor.
+     * The results of an entry point are delivered when its walk completes,
+     * so the subsets of a faulting entry point are never delivered.
+     */
+    class Visitor {
+    public:
+        // You can inherit from me
+        virtual ~Visitor() {};
+
+        /*
+         * A code subset was added to the results
+         */
+        virtual void onBlock(const CodeSubset& subset) {};
+
+        /*
+         * A flow edge of the results, from the instruction at 'source' into
+         * 'target'. See ControlFlowGraph::EdgeKind.
+         */
+        virtual void onEdge(addressNumericValue source,
+                            addressNumericValue target,
+                            uint kind) {};
+
+        /*
+         * Mapping 'entryPoint' failed at 'faultAddress' (fault tolerant
+         * mapping only), and its subsets were thrown out
+         */
+        virtual void onInvalid(const ProcessorAddress& entryPoint,
+                               const ProcessorAddress& faultAddress) {};
+
+        /*
+         * A potential subset was found. It's delivered to onBlock if a later
+         * walk reaches its start address.
+         */
+        virtual void onPotential(const CodeSubset& subset) {};
+    };
+
+    // The switch jump tables: the number of entries read from a table whose
+    // bound check wasn't found, and the value used for an unknown bound
+    enum { SWITCH_MAX_ENTRIES = 1024, SWITCH_NO_BOUND = 0 };
+
+    /*
+     * Tracks the bound check of a switch statement along a walk, one
+     * instruction at a time
+     */
+    class SwitchGuard {
+    public:
+        /*
+         * Constructor. Starts without a bound check
+         */
+        SwitchGuard();
+
+        /*
+         * Forgets the bound check, for the start of a new walk
+         */
+        void reset();
+
+        /*
+         * Tracks 'opcode', the next instruction of the walk.
+         *
+         * Returns the number of entries of the jump table if 'opcode' is a
+         * switch right after the bound check of its index register, or
+         * SWITCH_NO_BOUND
+         */
+        uint update(const OpcodePtr& opcode);
+
+    private:
+        // The bound check before the current instruction
+        enum State {
+            // The previous instruction isn't part of a bound check
+            STATE_NONE = 0,
+            // The previous instruction is "cmp reg, imm"
+            STATE_COMPARE,
+            // The previous instructions are "cmp reg, imm" and "ja default"
+            // (or "jae default")
+            STATE_JUMP
+        };
+
+        // The State, the compared register and the number of entries
+        uint m_state;
+        uint m_register;
+        uint m_bound;
+    };
+
     /*
      * Constructor.
      *
@@ -103,16 +239,78 @@ public:
              const addressNumericValue forcedEnd = 0,
              const bool isFaultTolerant = false);
 
+    /*
+     * Performs the mapping process for many entry points (for example all
+     * the exports of a module) in a single traversal.
+     *
+     * entryPoints - The stream addresses to start from. The list doesn't
+     *               have to be sorted and may contain duplicates.
+     * isFaultTolerant - See the map function. A faulting entry point throws
+     *                   out only its own subsets.
+     *
+     * The entry points are sorted and deduplicated, and each of them is
+     * forced to end at the next entry point (the last one isn't bounded).
+     * The result is the same as calling map for every entry point in address
+     * order with these bounds, without creating the calling objects for
+     * entry points that were already visited.
+     * Returns the number of subsets found.
+     */
+    uint mapAll(const addresses& entryPoints,
+                const bool isFaultTolerant = false);
+
+    /*
+     * Returns true if nothing was mapped by map() or mapAll(), and no map
+     * list was loaded, since the mapper was constructed
+     */
+    bool isEmpty() const;
+
+    /*
+     * Streams the results of the following mappings to 'visitor' instead of
+     * accumulating them. The map list, the control flow graph and the
+     * cross-references of these mappings stay empty, and the memory used is
+     * bounded by the walk of a single entry point and the potential subsets.
+     *
+     * visitor - The receiver of the results, or NULL to accumulate them
+     *           again. Not owned, must be kept alive while it's set.
+     */
+    void setVisitor(Visitor* visitor);
+
+    /*
+     * Declares a function which doesn't return. The walks of the following
+     * mappings stop after the calls to it, like after a JMP, instead of
+     * decoding the bytes after the call. The called function is still walked.
+     * See NoReturnAnalysis.
+     *
+     * address - The stream address of the function, or of the pointer which
+     *           the calls go through ("call dword ptr [address]", an import
+     *           for example)
+     */
+    void addNoReturn(addressNumericValue address);
+
+    /*
+     * Returns true if 'address' was declared by addNoReturn
+     */
+    bool isNoReturn(addressNumericValue address);
+
+    /*
+     * Returns the number of distinct addresses declared by addNoReturn, and
+     * address 'index' of them, sorted
+     */
+    uint getNoReturnsCount();
+    addressNumericValue getNoReturn(uint index);
+
+    /*
+     * Sorts an array of addresses in place, using a heap sort
+     *
+     * array - The addresses
+     * count - The number of addresses in the array
+     */
+    static void sortAddresses(addressNumericValue* array, uint count);
+
     /*
      * Writes the list built during the mapping process to an output
-     * object in a binary format:
-     *  - List size (DWORD)
-     *  - For each list member:
-     *      - Subset start address (DWORD)
-     *      - Subset end address (DWORD)
-     *      - Caller address (DWORD)
-     *      - End alter property (DWORD)
-     *      - Caller alter property (DWORD)
+     * object in the binary format of MapListFile: a header followed by a
+     * flat array of the subsets with 64 bit addresses, written in chunks.
      *
      * outputObject - The object to write to
      *
@@ -122,16 +320,31 @@ public:
     bool dumpMapList(BasicOutputPtr& outputObject);
 
     /*
-     * Loads from an input object (in the format specified in dumpMapList)
-     * to the map list object.
+     * Loads from an input object (in the format specified in dumpMapList,
+     * or in the first version of the format, see MapListFile) to the map
+     * list object. The control flow graph and the cross-references aren't
+     * stored in the file, so getGraph() and getXrefIndex() can't be used
+     * after a successful load.
      *
      * inputObject - The object to read from
      *
      * Returns true if the list was properly loaded.
-     * false if there was a problem reading from the object.
+     * false if there was a problem reading from the object, the list is
+     * left empty.
      */
     bool loadMapList(BasicInputPtr& inputObject);
 
+    /*
+     * Loads the map list object from a map list file which is already in
+     * memory (usually mapped by the caller). The subsets are used as is,
+     * without any reads. Tools which only scan the subsets can use the
+     * reader directly, without copying them into the map list. Like the
+     * stream loader, getGraph() and getXrefIndex() can't be used afterwards.
+     *
+     * reader - The validated file
+     */
+    void loadMapList(const MapListReader& reader);
+
     /*
      * Returns the code subset list built during the mapping process.
      *
@@ -139,6 +352,37 @@ public:
      */
     void getMapList(cList<CodeSubset>& listMap);
 
+    /*
+     * Returns the control flow graph of the code subsets in the map list.
+     * The blocks and edges are recorded during the walks, and the graph is
+     * built upon the first call after a mapping.
+     *
+     * Throws exception if the map list was loaded (See loadMapList)
+     */
+    const ControlFlowGraph& getGraph();
+
+    /*
+     * Returns the cross-references of the code subsets in the map list: the
+     * direct branches, the indirect branches through a pointer, the switch
+     * tables and the targets of their entries. The references are recorded
+     * during the walks, and the index is built upon the first call after a
+     * mapping.
+     *
+     * Throws exception if the map list was loaded (See loadMapList)
+     */
+    const XrefIndex& getXrefIndex();
+
+    /*
+     * Selects the addresses to place tracing breakpoints at from the map
+     * list: the end addresses and the caller addresses of the subsets.
+     *
+     * plan - Will be filled with the sorted addresses and their counts
+     * selection - The end and caller alter properties to select. The default
+     *             selects the rets and the handled callers.
+     */
+    void buildBreakpointPlan(BreakpointPlan& plan,
+                             const BreakpointSelection& selection = BreakpointSelection());
+
     /*
      * Returns the disassembler object for parsing the opcodes in the stream.
      */
@@ -169,6 +413,11 @@ private:
         OpcodePtr m_callingOpcode;
         ProcessorAddress m_forcedEndAddress;
 
+        JumpInstruction() : m_jmpAddress(gNullPointerProcessorAddress),
+                            m_returnAddress(gNullPointerProcessorAddress),
+                            m_forcedEndAddress(gNullPointerProcessorAddress)
+        {}
+
         JumpInstruction(ProcessorAddress jmpAddress,
                         ProcessorAddress returnAddress,
                         OpcodePtr callingOpcode,
@@ -179,10 +428,58 @@ private:
         {}
     };
 
-    // Typedefs for a stack of walk function parameters
-    typedef cList<JumpInstruction>::iterator WalkParamIter;
-    typedef StackInrastructor<JumpInstruction, WalkParamIter> WalkParametersStackObject;
-    typedef cSmartPtr<WalkParametersStackObject> WalkParametersStackObjectPtr;
+    // The number of walk parameters stored inside a stack object, before it
+    // allocates memory
+    enum { WALK_STACK_INLINE_COUNT = 16 };
+
+    // Typedef for a stack of walk function parameters
+    typedef ArrayStack<JumpInstruction, WALK_STACK_INLINE_COUNT> WalkParametersStackObject;
+
+    // A potential subset and the walk parameters saved while walking it
+    struct PotentialSubset {
+        CodeSubset m_subset;
+        // The saved walk parameters, in m_potentialJumps
+        uint m_firstJump;
+        uint m_jumpsCount;
+        // The graph records of the walk, in m_potentialRecords
+        uint m_firstBlockRecord;
+        uint m_blockRecordsCount;
+        uint m_firstEdgeRecord;
+        uint m_edgeRecordsCount;
+        // The references of the walk, in m_potentialXrefs
+        uint m_firstXrefRecord;
+        uint m_xrefRecordsCount;
+        // Whether it was taken out of the index. Its storage is reclaimed by
+        // compactPotentials.
+        bool m_isTaken;
+
+        PotentialSubset() : m_subset(gNullPointerProcessorAddress,
+                                     gNullPointerProcessorAddress,
+                                     gNullPointerProcessorAddress,
+                                     Opcode::FLOW_NO_ALTER,
+                                     Opcode::FLOW_NO_ALTER),
+                            m_firstJump(0),
+                            m_jumpsCount(0),
+                            m_firstBlockRecord(0),
+                            m_blockRecordsCount(0),
+                            m_firstEdgeRecord(0),
+                            m_edgeRecordsCount(0),
+                            m_firstXrefRecord(0),
+                            m_xrefRecordsCount(0),
+                            m_isTaken(false)
+        {}
+    };
+
+    // A slot of the potential subsets index
+    struct PotentialSlot {
+        // The start address of the subset
+        addressNumericValue m_startAddress;
+        // The index in m_potentials, or EMPTY_SLOT
+        uint m_index;
+    };
+
+    // The empty index slot
+    enum { EMPTY_SLOT = 0xFFFFFFFF };
 
     /*
      * Prevent copy constructor
@@ -190,7 +487,30 @@ private:
     FlowMapper(const FlowMapper& other);
 
     /*
-     * Initializes the array that will contain information about addresses
+     * Walks the code from a single entry point until the walk stack is empty,
+     * and adds the new subsets to the map list.
+     *
+     * start - The entry point address
+     * forcedEnd - The forced end address of the entry point, or 0
+     * callingOpcode - The opcode used as the caller of the entry point
+     * isFaultTolerant - See the map function
+     *
+     * Returns false if a fault occurred in fault tolerant mode (the subsets
+     * of this entry point are thrown out).
+     */
+    bool mapEntryPoint(const ProcessorAddress& start,
+                       const ProcessorAddress& forcedEnd,
+                       const OpcodePtr& callingOpcode,
+                       const bool isFaultTolerant);
+
+    /*
+     * Return true if address 'a' should be sorted before address 'b'
+     */
+    static bool isAddressBefore(const addressNumericValue& a,
+                                const addressNumericValue& b);
+
+    /*
+     * Clears the set that will contain information about addresses
      * that were visited during the mapping process.
      */
     void initHasVisited();
@@ -227,6 +547,8 @@ private:
      *  - Set address as visited
      *  - Check for a flow altering opcode. If it is:
      *      - Check for ret\int\invalid. Break walk if so.
+     *      - For a switch, push the targets of its jump table entries
+     *      - A call to a function which doesn't return is handled like a JMP
      *      - Get the jump address
      *      - Check for jump address validity. Continue walk if so. Break if JMP.
      *      - Check that we haven't yet visited the address. Continue walk if so. Break if JMP.
@@ -242,11 +564,90 @@ private:
      * Returns a MapAction enum that determines how to continue the walk.
      */
     MapAction handleSingleOpcode(OpcodePtr& opcode,
-                                 WalkParametersStackObjectPtr& saveStack,
+                                 WalkParametersStackObject& saveStack,
                                  const ProcessorAddress& startAddress,
                                  const ProcessorAddress& forcedEndAddress,
                                  const bool isFaultTolerant = false);
 
+    /*
+     * Appends a subset of a map list file to the map list
+     */
+    void appendMapListSubset(const MapListFile::Subset& subset);
+
+    /*
+     * Records the current graph block of the walk, which ends at
+     * m_graphBlockEnd, and starts a new block after it
+     */
+    void endGraphBlock();
+
+    /*
+     * Reads the entries of a switch jump table, and walks their targets like
+     * the targets of the other jumps. The reading stops at the first entry
+     * which can't be read or which isn't an executable address, and, when the
+     * bound is unknown, at an entry which was already visited (the code or
+     * the table after this table).
+     *
+     * opcode - The switch opcode
+     * switchAddress - The address of the switch opcode
+     * tableAddress - The address of the jump table
+     * entriesCount - The number of entries, or SWITCH_NO_BOUND to read up to
+     *                SWITCH_MAX_ENTRIES entries
+     * saveStack - The stack to push the walk parameters of the targets into
+     */
+    void resolveSwitchTable(const OpcodePtr& opcode,
+                            const ProcessorAddress& switchAddress,
+                            const ProcessorAddress& tableAddress,
+                            uint entriesCount,
+                            WalkParametersStackObject& saveStack);
+
+    /*
+     * Adds a potential subset to the potential subsets index, and copies its
+     * saved walk parameters into m_potentialJumps, its graph records into
+     * m_potentialRecords and its references into m_potentialXrefs
+     */
+    void addPotentialSubset(const CodeSubset& subset,
+                            const WalkParametersStackObject& saveStack,
+                            const ControlFlowGraph::Records& walkRecords,
+                            const XrefIndex::Records& walkXrefs);
+
+    /*
+     * Looks for the potential subset which starts at 'startAddress' and
+     * removes it from the index.
+     *
+     * startAddress - The address to look for
+     * potential - Will be filled with the subset and the position of its
+     *             saved walk parameters
+     *
+     * Returns true if the subset was found. false otherwise.
+     */
+    bool takePotentialSubset(addressNumericValue startAddress,
+                             PotentialSubset& potential);
+
+    /*
+     * Takes the potential subset which starts at 'startAddress', if there is
+     * one, and moves it into the subsets list, its records into the map
+     * records and its saved walk parameters into the walk stack.
+     */
+    void promotePotentialSubset(addressNumericValue startAddress);
+
+    /*
+     * Adds the potential subset 'index' of m_potentials to the potential
+     * subsets index
+     */
+    void indexPotentialSubset(uint index);
+
+    /*
+     * Doubles the size of the potential subsets index and rehash it
+     */
+    void growPotentialIndex();
+
+    /*
+     * Removes the taken potential subsets from m_potentials, and their walk
+     * parameters and records from m_potentialJumps, m_potentialRecords and
+     * m_potentialXrefs, keeping the order of the others. Rebuilds the index.
+     */
+    void compactPotentials();
+
     /*
      * Marks the given address as visited, so that we will know
      * not to re-parse it
@@ -292,14 +693,60 @@ private:
     cList<CodeSubset> m_listMap;
     // A temporary list containing subsets that are to be added to the final list
     cList<CodeSubset> m_tempListMap;
-    // A temporary list containing subsets that have been marked as potential
-    cList<CodeSubset> m_potentialSubsets;
-    // A list containing the call stacks corresponding with the potential subsets
-    cList<WalkParametersStackObjectPtr> m_potentialStacks;
+    // The subsets that have been marked as potential
+    cSArray<PotentialSubset> m_potentials;
+    uint m_potentialsCount;
+    // The call stacks corresponding with the potential subsets, one after the
+    // other
+    WalkParametersStackObject m_potentialJumps;
+    // An open-addressing hash from the start address of the potential subsets
+    // that weren't taken into their index in m_potentials. The size is always
+    // a power of 2.
+    cSArray<PotentialSlot> m_potentialIndex;
+    uint m_potentialIndexCount;
     // A stack responsible for managing walk function calls and their parameters
     WalkParametersStackObject m_walkStack;
-    // An array that contains information about addresses that were visited during the mapping process.
-    cBuffer m_hasVisited;
+    // The walk parameters found by the current walk. Reused by all the walks.
+    WalkParametersStackObject m_saveStack;
+    // The blocks and edges of the subsets in the map list, recorded during
+    // the walks
+    ControlFlowGraph::Records m_graphRecords;
+    // The graph records of the potential subsets, one after the other
+    ControlFlowGraph::Records m_potentialRecords;
+    // The graph records of the current walk. Reused by all the walks.
+    ControlFlowGraph::Records m_walkRecords;
+    // The graph built from m_graphRecords, and whether it's up to date
+    ControlFlowGraph m_graph;
+    bool m_isGraphBuilt;
+    // The current graph block of the walk: its start, the address after its
+    // last instruction and the address of its last instruction
+    addressNumericValue m_graphBlockStart;
+    addressNumericValue m_graphBlockEnd;
+    addressNumericValue m_graphLastInstruction;
+    // The bound check of a switch statement before the current instruction
+    SwitchGuard m_switchGuard;
+    // The references of the subsets in the map list, of the potential subsets
+    // and of the current walk, like the graph records
+    XrefIndex::Records m_xrefRecords;
+    XrefIndex::Records m_potentialXrefs;
+    XrefIndex::Records m_walkXrefs;
+    // The index built from m_xrefRecords, and whether it's up to date
+    XrefIndex m_xrefIndex;
+    bool m_isXrefIndexBuilt;
+    // Whether the map list was loaded from a file, without the graph and the
+    // cross-references records
+    bool m_isMapListLoaded;
+    // Whether an entry point was mapped. See isEmpty.
+    bool m_isMapped;
+    // The functions which don't return. See addNoReturn.
+    AddressSet m_noReturns;
+    // The receiver of the results, or NULL. See setVisitor.
+    Visitor* m_visitor;
+    // The number of subsets delivered to the visitor
+    uint m_streamedSubsetsCount;
+    // The addresses that were visited during the mapping process. Pages are
+    // allocated only for the touched code, so any virtual address can be used.
+    PagedBitset m_hasVisited;
     // Used as an interface between the flow mapper and the PE memory and section attributes
     SectionMemoryInterfacePtr m_memoryInterface;
     // The last opcode that was parsed correctly
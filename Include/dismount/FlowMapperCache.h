@@ -0,0 +1,216 @@
+#ifndef __TBA_DISMOUNT_FLOWMAPPERCACHE_H
+#define __TBA_DISMOUNT_FLOWMAPPERCACHE_H
+
+/*
+ * FlowMapperCache.h
+ *
+ * Stores the results of FlowMapper in a local directory, keyed by the content
+ * of the image, so an unchanged image is mapped only once.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/string.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/SectionMemoryInterface.h"
+#include "dismount/FlowMapper.h"
+
+/*
+ * A cache layer around FlowMapper::mapAll().
+ *
+ * The key of a result is a 128 bit digest of:
+ *   - The mapper version (See MAPPER_VERSION)
+ *   - The bytes of the image
+ *   - The section layout: the base addresses, the memory size and every
+ *     section bounds, raw address and flags
+ *   - The mapping options: the entry points (sorted, as mapAll handles
+ *     them), the fault tolerance and the functions which don't return
+ *
+ * The result is stored as "<directory>/<key>.map", a small header with the
+ * key followed by the map list (See FlowMapper::dumpMapList). On a hit, the
+ * map list is loaded into the mapper instead of disassembling.
+ *
+ * The control flow graph and the cross-references aren't stored, so after a
+ * hit the getGraph() and getXrefIndex() of the mapper throw, and neither
+ * CallGraph nor NoReturnAnalysis can run on the result. Map without the
+ * cache when they are needed.
+ *
+ * The cache is best-effort: a missing, truncated or foreign file is a miss,
+ * and a failure to store the result is ignored.
+ *
+ * Usage:
+ *     FlowMapper mapper(image, memoryInterface);
+ *     FlowMapperCache cache("/var/cache/dismount", mapper, image,
+ *                           memoryInterface);
+ *     cache.mapAll(exports);
+ *     mapper.getMapList(subsets);
+ *
+ * NOTE: A result depends on everything mapped before, so the mapper must be
+ *       empty: the cache is used for a single mapping of a new mapper,
+ *       without a visitor (See FlowMapper::setVisitor).
+ * NOTE: This class is not thread-safe
+ */
+class FlowMapperCache {
+public:
+    // The version of the results of FlowMapper. Must be increased by any
+    // change to FlowMapper which changes the map list it produces, so the
+    // stored results are invalidated.
+    enum { MAPPER_VERSION = 2 };
+
+    /*
+     * Constructor.
+     *
+     * directory       - The directory of the stored results. Must exist.
+     * mapper          - The mapper to map with, or to load the stored result
+     *                   into. Must be kept alive while this object is used.
+     * image           - The stream the mapper reads from
+     * memoryInterface - The sections of the image
+     * mapperVersion   - Overrides MAPPER_VERSION, for tools which wrap the
+     *                   mapper with their own processing
+     */
+    FlowMapperCache(const cString& directory,
+                    FlowMapper& mapper,
+                    const BasicInputPtr& image,
+                    const SectionMemoryInterfacePtr& memoryInterface,
+                    uint mapperVersion = MAPPER_VERSION);
+
+    /*
+     * Loads the stored result of FlowMapper::mapAll() with the same
+     * arguments, or calls it and stores the result.
+     *
+     * Throws if the mapper isn't empty (See FlowMapper::isEmpty).
+     * Returns the number of subsets found.
+     */
+    uint mapAll(const FlowMapper::addresses& entryPoints,
+                const bool isFaultTolerant = false);
+
+    /*
+     * Return true if the last mapping was loaded from the cache
+     */
+    bool isHit() const;
+
+private:
+    // Deny copy-constructor and operator =
+    FlowMapperCache(const FlowMapperCache& other);
+    FlowMapperCache& operator = (const FlowMapperCache& other);
+
+    // Constants of the stored results
+    enum {
+        // "DMMC"
+        MAGIC = 0x434D4D44,
+        // The size of each read of the image
+        IMAGE_CHUNK_SIZE = 64 * 1024
+    };
+
+    /*
+     * A 128 bit digest
+     */
+    struct Key {
+        uint64 m_low;
+        uint64 m_high;
+    };
+
+    /*
+     * The header of a stored result, followed by the map list
+     */
+    struct Header {
+        // Must be MAGIC
+        uint32 m_magic;
+        // The mapper version of the result
+        uint32 m_mapperVersion;
+        // The key of the result
+        Key m_key;
+        // The number of subsets in the map list
+        uint64 m_subsetsCount;
+    };
+
+    /*
+     * Computes a Key from a sequence of bytes and numbers. Not cryptographic,
+     * but all the bits of the input affect both halves of the key.
+     */
+    class Digest {
+    public:
+        /*
+         * Constructor. Starts an empty digest
+         */
+        Digest();
+
+        /*
+         * Adds 'size' bytes
+         */
+        void update(const uint8* data, uint size);
+
+        /*
+         * Adds a number
+         */
+        void updateUint64(uint64 value);
+
+        /*
+         * Return the key of all the added data
+         */
+        Key getKey() const;
+
+    private:
+        /*
+         * Mixes 8 bytes into the lanes
+         */
+        void mixWord(uint64 word);
+
+        // The two halves of the digest state
+        uint64 m_low;
+        uint64 m_high;
+        // The bytes which don't fill a word yet
+        uint8 m_tail[sizeof(uint64)];
+        uint m_tailLength;
+        // The total number of added bytes
+        uint64 m_length;
+    };
+
+    /*
+     * Digests the mapper version, the image and the section layout into
+     * m_imageDigest, upon the first mapping
+     */
+    void digestImage();
+
+    /*
+     * Digests the functions which don't return of the mapper (See
+     * FlowMapper::addNoReturn) into 'digest'
+     */
+    void digestNoReturns(Digest& digest);
+
+    /*
+     * Return the path of the stored result of 'key'
+     */
+    cString getPath(const Key& key) const;
+
+    /*
+     * Loads the stored result of 'key' into the mapper, and sets
+     * 'subsetsCount'. Returns false if it isn't stored or can't be loaded.
+     */
+    bool load(const Key& key, uint& subsetsCount);
+
+    /*
+     * Stores the map list of the mapper as the result of 'key'
+     */
+    void store(const Key& key, uint subsetsCount);
+
+    // The directory of the stored results
+    cString m_directory;
+    // The mapper
+    FlowMapper& m_mapper;
+    // The image and its sections
+    BasicInputPtr m_image;
+    SectionMemoryInterfacePtr m_memoryInterface;
+    uint m_mapperVersion;
+    // The digest of the image, see digestImage()
+    Digest m_imageDigest;
+    bool m_isImageDigested;
+    // See isHit()
+    bool m_isHit;
+};
+
+// The reference countable object
+typedef cSmartPtr<FlowMapperCache> FlowMapperCachePtr;
+
+#endif // __TBA_DISMOUNT_FLOWMAPPERCACHE_H
@@ -0,0 +1,172 @@
+#ifndef __TBA_DISMOUNT_FUNCTIONSEEDER_H
+#define __TBA_DISMOUNT_FUNCTIONSEEDER_H
+
+/*
+ * FunctionSeeder.h
+ *
+ * Finds function start candidates in the executable sections of an image, to
+ * map the code which isn't called from the mapped code
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/SectionMemoryInterface.h"
+#include "dismount/FlowMapper.h"
+
+/*
+ * Collects function start candidates, and maps them in a single batch with
+ * FlowMapper::mapAll.
+ *
+ * The sources of candidates (See SeedKind):
+ *   - Frame prologues: "push ebp; mov ebp, esp" (55 8B EC or 55 89 E5),
+ *     with the hot-patch "mov edi, edi" (8B FF) before it if present.
+ *   - Stack prologues: "sub esp, imm" (83 EC / 81 EC) or "enter" (C8) right
+ *     after a boundary: the start of a section, a ret or a padding byte.
+ *   - Padding: the first byte after a run of int3 (CC) or nop (90) bytes,
+ *     which ends at an aligned address.
+ *   - Relocations: the executable addresses stored at the relocated
+ *     locations of the image (See addRelocations).
+ *   - Any address given by the caller (exports for example).
+ *
+ * The sections are scanned a machine word at a time: a word is checked for
+ * the bytes which can start a pattern (55, CC, 90, C3) with bitwise
+ * arithmetic, and only the words which contain one are checked byte by byte.
+ *
+ * Usage:
+ *     FunctionSeeder seeder(image, memoryInterface);
+ *     seeder.scanSections();
+ *     seeder.addRelocations(relocations, relocationsCount);
+ *     seeder.seed(flowMapper);
+ *
+ * NOTE: The candidates are heuristic, so seed() maps them fault tolerant by
+ *       default.
+ * NOTE: This class is not thread-safe
+ */
+class FunctionSeeder {
+public:
+    // The sources of candidates, as bits
+    enum SeedKind {
+        SEED_FRAME_PROLOGUE = 1,
+        SEED_STACK_PROLOGUE = 2,
+        SEED_PADDING = 4,
+        SEED_RELOCATION = 8,
+        SEED_USER = 16,
+        SEED_ALL = 0x1F
+    };
+
+    /*
+     * A function start candidate
+     */
+    struct Candidate {
+        // The stream address
+        addressNumericValue m_address;
+        // The SeedKind bits of the sources which found it
+        uint m_kinds;
+    };
+
+    /*
+     * Constructor.
+     *
+     * image           - The stream the mapper reads from
+     * memoryInterface - The sections of the image
+     * kinds           - The SeedKind bits of the sources to use
+     */
+    FunctionSeeder(const BasicInputPtr& image,
+                   const SectionMemoryInterfacePtr& memoryInterface,
+                   uint kinds = SEED_ALL);
+
+    /*
+     * Scans the executable sections for prologues and padding
+     */
+    void scanSections();
+
+    /*
+     * Adds the executable addresses stored at relocated locations.
+     *
+     * locations - The stream addresses of the relocated DWORDs (from the base
+     *             relocations table of a PE for example)
+     * count     - The number of locations
+     */
+    void addRelocations(const addressNumericValue* locations, uint count);
+
+    /*
+     * Adds a candidate
+     *
+     * address - The stream address
+     * kind    - The source of the candidate
+     */
+    void addCandidate(addressNumericValue address, uint kind = SEED_USER);
+
+    /*
+     * Return the number of candidates
+     */
+    uint getCandidatesCount();
+
+    /*
+     * Return candidate 'index'. The candidates are sorted by their address,
+     * and each address appears once.
+     */
+    const Candidate& getCandidate(uint index);
+
+    /*
+     * Maps all the candidates with 'mapper' in a single batch.
+     *
+     * Returns the number of subsets of the mapper.
+     */
+    uint seed(FlowMapper& mapper, bool isFaultTolerant = true);
+
+private:
+    // Deny copy-constructor and operator =
+    FunctionSeeder(const FunctionSeeder& other);
+    FunctionSeeder& operator = (const FunctionSeeder& other);
+
+    // Scanning constants
+    enum {
+        // The alignment of the end of a padding run
+        PADDING_ALIGNMENT = 16,
+        // The shortest padding run
+        PADDING_MIN_LENGTH = 2
+    };
+
+    /*
+     * Scans the bytes of an executable section
+     *
+     * data  - The bytes
+     * size  - The number of bytes
+     * start - The stream address of the first byte
+     */
+    void scanSection(const uint8* data, uint size, addressNumericValue start);
+
+    /*
+     * Checks a single position of a section for the patterns
+     */
+    void scanPosition(const uint8* data,
+                      uint size,
+                      uint position,
+                      addressNumericValue start);
+
+    /*
+     * Sorts the candidates and merges the duplicated addresses
+     */
+    void sortCandidates();
+
+    // Sorting order
+    static bool isCandidateBefore(const Candidate& a, const Candidate& b);
+
+    // The image and its sections
+    BasicInputPtr m_image;
+    SectionMemoryInterfacePtr m_memoryInterface;
+    uint m_kinds;
+    // The candidates, and whether they are sorted and merged
+    cSArray<Candidate> m_candidates;
+    uint m_candidatesCount;
+    bool m_isSorted;
+};
+
+// The reference countable object
+typedef cSmartPtr<FunctionSeeder> FunctionSeederPtr;
+
+#endif // __TBA_DISMOUNT_FUNCTIONSEEDER_H
@@ -74,6 +74,16 @@ public:
      */
     virtual uint32 getSwitchTableOffset() const;
 
+    /*
+     * See Opcode::getSwitchIndexRegister
+     */
+    virtual uint getSwitchIndexRegister() const;
+
+    /*
+     * See Opcode::getRegisterCompare
+     */
+    virtual bool getRegisterCompare(uint& reg, uint32& value) const;
+
     /*
      * See Opcode::getAlterProperty.
      */
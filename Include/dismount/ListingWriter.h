@@ -0,0 +1,210 @@
+#ifndef __TBA_DISMOUNT_LISTINGWRITER_H
+#define __TBA_DISMOUNT_LISTINGWRITER_H
+
+/*
+ * ListingWriter.h
+ *
+ * Writes a complete disassembly listing of a range of bytes into a stream.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/StreamDisassembler.h"
+#include "dismount/OpcodeDataFormatter.h"
+#include "dismount/ProcessorAddress.h"
+
+/*
+ * Formats each instruction of a disassembler into a single listing line:
+ *     <address><margin><opcode-bytes><padding><margin><instruction>
+ *
+ * For example:
+ *     7C801D7Bh   8B FF                  mov       edi, edi
+ *
+ * The lines are collected into a large output buffer which is flushed into
+ * the output stream only when it is full, so writing the listing of a whole
+ * module costs a handful of stream writes. The opcode-bytes column is encoded
+ * directly into the buffer without any cString. The address column is
+ * rendered by the data formatter (translateAbsoluteAddress), so it follows
+ * the numbers style and the symbols of the instruction column.
+ *
+ * Usage:
+ *     DefaultOpcodeDataFormatter formatter(10);
+ *     ListingWriter writer(*disassembler, formatter);
+ *     writer.write(outputFile, start, end);
+ *
+ * NOTE: This class is not thread-safe
+ */
+class ListingWriter {
+public:
+    // Default values for the columns
+    enum {
+        // The number of opcode bytes shown in each line
+        DEFAULT_BYTES_COLUMN = 7,
+        // The spaces between the address and the opcode bytes
+        DEFAULT_ADDRESS_MARGIN = 3,
+        // The spaces between the opcode bytes and the instruction
+        DEFAULT_BYTES_MARGIN = 2,
+        // The size of the output buffer
+        DEFAULT_BUFFER_SIZE = 64 * 1024
+    };
+
+    /*
+     * The columns layout of the listing
+     */
+    class Options {
+    public:
+        /*
+         * Constructor. Fill the options with the default layout, the same
+         * layout as the test-application.
+         */
+        Options();
+
+        // Set to true in order to show the instruction address column
+        bool m_shouldShowAddress;
+        // Set to true in order to show the opcode bytes column
+        bool m_shouldShowBytes;
+        // The number of bytes in the opcode bytes column. Longer instructions
+        // are cut.
+        uint m_bytesColumn;
+        // The spaces after the address column
+        uint m_addressMargin;
+        // The spaces after the opcode bytes column
+        uint m_bytesMargin;
+    };
+
+    /*
+     * Constructor.
+     *
+     * disassembler  - The disassembler to read the instructions from
+     * dataFormatter - The formatter used for the address and the instruction
+     *                 columns
+     * options       - The columns layout
+     * bufferSize    - The number of bytes to collect before writing into
+     *                 the output stream
+     */
+    ListingWriter(StreamDisassembler& disassembler,
+                  OpcodeDataFormatter& dataFormatter,
+                  const Options& options = Options(),
+                  uint bufferSize = DEFAULT_BUFFER_SIZE);
+
+    /*
+     * Writes the listing of all the instructions from the current position
+     * of the disassembler until the end of the stream.
+     *
+     * output - The stream to write the listing to
+     *
+     * Return the number of instructions written
+     */
+    uint write(basicOutput& output);
+
+    /*
+     * Writes the listing of all the instructions which start inside the range
+     * [start, end).
+     *
+     * output - The stream to write the listing to
+     * start  - The address of the first instruction. The disassembler is
+     *          seeked into this address.
+     * end    - The address after the last byte of the range.
+     *
+     * Return the number of instructions written
+     *
+     * NOTE: The range is limited only if the disassembler provides the
+     *       instructions addresses, otherwise the listing stops at the end of
+     *       the stream.
+     */
+    uint write(basicOutput& output,
+               const ProcessorAddress& start,
+               ProcessorAddress::uintAddress end);
+
+    /*
+     * Writes all the pending lines into 'output'. Called automatically at the
+     * end of each 'write'. Should be called if 'write' throws an exception
+     * and the lines formatted so far are needed.
+     */
+    void flush(basicOutput& output);
+
+    /*
+     * Formats a single, already decoded, instruction into the buffer. The
+     * buffer is never flushed by this function, it grows as needed until
+     * 'clear' is called. Used to format instructions without a stream (See
+     * ParallelListingWriter).
+     *
+     * opcode - The instruction to format. Must be decoded by the disassembler
+     *          given in the constructor.
+     */
+    void format(const OpcodePtr& opcode);
+
+    /*
+     * Return the content of the buffer, the lines formatted since the last
+     * 'clear' or 'flush'.
+     */
+    const char* getBuffer() const;
+
+    /*
+     * Return the number of bytes in the buffer
+     */
+    uint getLength() const;
+
+    /*
+     * Empty the buffer without writing it
+     */
+    void clear();
+
+private:
+    // Deny copy-constructor and operator =
+    ListingWriter(const ListingWriter& other);
+    ListingWriter& operator = (const ListingWriter& other);
+
+    /*
+     * Disassembles the instructions up to 'end' (if 'shouldLimit' is set) and
+     * writes them
+     */
+    uint writeInstructions(basicOutput& output,
+                           bool shouldLimit,
+                           ProcessorAddress::uintAddress end);
+
+    /*
+     * Formats a single instruction into the output buffer. If 'output' is
+     * NULL the buffer grows instead of being flushed.
+     */
+    void writeInstruction(basicOutput* output, const OpcodePtr& opcode);
+
+    /*
+     * Makes sure that the output buffer has at least 'length' free bytes,
+     * either by flushing it into 'output' or, if 'output' is NULL, by growing
+     * it.
+     */
+    void reserve(basicOutput* output, uint length);
+
+    /*
+     * Encodes the opcode bytes column at the end of the output buffer
+     */
+    void appendBytes(const cBuffer& opcodeData);
+
+    /*
+     * Appends 'count' spaces at the end of the output buffer
+     */
+    void appendSpaces(uint count);
+
+    /*
+     * Appends a formatted string into the output buffer, flushing (or
+     * growing) the buffer as needed.
+     */
+    void appendString(basicOutput* output, const cString& string);
+
+    // The disassembler
+    StreamDisassembler& m_disassembler;
+    // The formatter for the instruction column
+    OpcodeDataFormatter& m_dataFormatter;
+    // The columns layout
+    Options m_options;
+    // The output buffer and the number of bytes used in it
+    cSArray<char> m_buffer;
+    uint m_used;
+};
+
+#endif // __TBA_DISMOUNT_LISTINGWRITER_H
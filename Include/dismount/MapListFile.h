@@ -0,0 +1,72 @@
+#ifndef __TBA_DISMOUNT_MAPLISTFILE_H
+#define __TBA_DISMOUNT_MAPLISTFILE_H
+
+/*
+ * MapListFile.h
+ *
+ * The binary format of the code subsets list of FlowMapper
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+
+/*
+ * The file layout is:
+ *     Header                                    (32 bytes)
+ *     Subset[Header::m_subsetsCount]            (at Header::m_subsetsOffset)
+ *
+ * The subsets are stored in the order of the map list. All the structures are
+ * naturally aligned and stored in the host byte-order (little-endian), so a
+ * reader can map the file into memory and use the subsets directly. See
+ * MapListReader.
+ *
+ * The first version of the format (written by older versions of
+ * FlowMapper::dumpMapList) has no header: a DWORD with the number of subsets,
+ * followed by five DWORDs for each subset. MAGIC is never a valid number of
+ * subsets in that format (it's over 25GB of subsets), so FlowMapper::
+ * loadMapList tells the versions apart by the first DWORD.
+ */
+class MapListFile {
+public:
+    // Format constants
+    enum {
+        // "DMML"
+        MAGIC = 0x4C4D4D44,
+        // The current version of the format. Version 1 is the format without
+        // a header.
+        VERSION = 2,
+        // The alignment of the subsets
+        SUBSETS_ALIGNMENT = 8
+    };
+
+    /*
+     * The file header
+     */
+    struct Header {
+        // Must be MAGIC
+        uint32 m_magic;
+        // Must be VERSION
+        uint16 m_version;
+        // sizeof(Subset)
+        uint16 m_subsetSize;
+        // The number of subsets
+        uint64 m_subsetsCount;
+        // The position of the first subset
+        uint32 m_subsetsOffset;
+        // Zero
+        uint32 m_reserved[3];
+    };
+
+    /*
+     * A code subset (32 bytes). See FlowMapper::CodeSubset
+     */
+    struct Subset {
+        uint64 m_startAddress;
+        uint64 m_endAddress;
+        uint64 m_callerAddress;
+        int32 m_endAlterProperty;
+        int32 m_callerAlterProperty;
+    };
+};
+
+#endif // __TBA_DISMOUNT_MAPLISTFILE_H
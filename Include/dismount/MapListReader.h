@@ -0,0 +1,68 @@
+#ifndef __TBA_DISMOUNT_MAPLISTREADER_H
+#define __TBA_DISMOUNT_MAPLISTREADER_H
+
+/*
+ * MapListReader.h
+ *
+ * Gives access to a map list file which is already in memory.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "dismount/MapListFile.h"
+
+/*
+ * Validates the header of a map list file (See MapListFile) and returns
+ * pointers into it. The subsets are not copied or parsed, the file is usually
+ * mapped into memory by the caller, so loading a huge cached analysis costs
+ * only the header validation.
+ *
+ * Usage:
+ *     MapListReader reader(mappedFile, mappedFileSize);
+ *     for (uint64 i = 0; i < reader.getSubsetsCount(); i++)
+ *         reader.getSubset(i).m_startAddress;
+ */
+class MapListReader {
+public:
+    /*
+     * Constructor.
+     *
+     * data - The content of the file. Must be aligned to 8 bytes (any mapped
+     *        memory is) and kept alive while the reader is used.
+     * size - The number of bytes in 'data'. 64 bit, so files above 4GB can
+     *        be read.
+     *
+     * Throw exception if the header is invalid or doesn't match 'size'
+     */
+    MapListReader(const void* data, uint64 size);
+
+    /*
+     * Return the header of the file
+     */
+    const MapListFile::Header& getHeader() const;
+
+    /*
+     * Return the number of subsets in the file
+     */
+    uint64 getSubsetsCount() const;
+
+    /*
+     * Return all the subsets as an array of getSubsetsCount() elements
+     */
+    const MapListFile::Subset* getSubsets() const;
+
+    /*
+     * Return a single subset.
+     * Throw exception if 'index' is out of range.
+     */
+    const MapListFile::Subset& getSubset(uint64 index) const;
+
+private:
+    // The header, at the start of the data
+    const MapListFile::Header* m_header;
+    // The subsets and their count
+    const MapListFile::Subset* m_subsets;
+    uint64 m_subsetsCount;
+};
+
+#endif // __TBA_DISMOUNT_MAPLISTREADER_H
@@ -0,0 +1,180 @@
+#ifndef __TBA_DISMOUNT_NORETURNANALYSIS_H
+#define __TBA_DISMOUNT_NORETURNANALYSIS_H
+
+/*
+ * NoReturnAnalysis.h
+ *
+ * Finds the functions which never return to their caller, so the walks of
+ * FlowMapper stop after the calls to them
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ProcessorAddress.h"
+#include "dismount/AddressSet.h"
+#include "dismount/SymbolTable.h"
+#include "dismount/ControlFlowGraph.h"
+#include "dismount/CallGraph.h"
+#include "dismount/FlowMapper.h"
+#include "dismount/ParallelFlowMapper.h"
+
+/*
+ * A set of functions which don't return, given as stream addresses: the
+ * start of a function, or the pointer which the calls go through (an import).
+ *
+ * The set starts with seeds:
+ *   - Addresses given by the caller.
+ *   - Symbols whose name is a well known function which doesn't return
+ *     (ExitProcess, KeBugCheckEx, abort, longjmp, ...). The decorations of
+ *     the names ("__imp__", a leading '_', an "@N" suffix, a "module!"
+ *     prefix) are ignored.
+ *
+ * and grows by inference over the mapped code (See analyze): a function
+ * returns if one of its paths reaches a ret, a jump to an unknown target, or
+ * a jump into a function which returns. The calls to the functions which
+ * don't return don't fall through. The functions are solved in the bottom-up
+ * order of the strongly connected components of the call graph, and each
+ * component is iterated until nothing changes, so mutually recursive
+ * functions without a ret are found as well.
+ *
+ * Usage:
+ *     NoReturnAnalysis noReturn;
+ *     noReturn.addKnownNames(symbols, imageBase);
+ *     noReturn.apply(flowMapper);
+ *     flowMapper.mapAll(exports);
+ *
+ *     callGraph.build(flowMapper.getGraph(), entryPoints, entryPointsCount);
+ *     if (noReturn.analyze(flowMapper, callGraph) > 0)
+ *         noReturn.apply(flowMapper);  // For the following mappings
+ *
+ * NOTE: The walks which were done before a function was found don't change.
+ *       Map again with a new mapper to drop the code after its calls.
+ * NOTE: This class is not thread-safe
+ */
+class NoReturnAnalysis {
+public:
+    /*
+     * Constructor. Creates an empty set
+     */
+    NoReturnAnalysis();
+
+    /*
+     * Adds a function which doesn't return.
+     *
+     * address - The stream address of the function, or of the pointer which
+     *           the calls go through
+     */
+    void addAddress(addressNumericValue address);
+
+    /*
+     * Adds the symbols whose name is a well known function which doesn't
+     * return.
+     *
+     * symbols - The symbols. Must be sorted.
+     * base    - Subtracted from the addresses of the symbols to get the
+     *           stream addresses (the image base when the symbols are
+     *           absolute addresses)
+     *
+     * Returns the number of symbols added.
+     */
+    uint addKnownNames(const SymbolTable& symbols,
+                       addressNumericValue base = 0);
+
+    /*
+     * Infers the functions of 'callGraph' which don't return, and adds their
+     * start to the set.
+     *
+     * mapper    - The mapper which mapped the code. Its map list, graph and
+     *             cross-references are used.
+     * callGraph - The call graph built over the graph of 'mapper'
+     *
+     * Returns the number of functions which don't return, seeds included.
+     */
+    uint analyze(FlowMapper& mapper, const CallGraph& callGraph);
+
+    /*
+     * Return true if function 'function' of the analyzed call graph doesn't
+     * return
+     */
+    bool isFunctionNoReturn(uint function) const;
+
+    /*
+     * Return true if 'address' is in the set
+     */
+    bool isNoReturn(addressNumericValue address);
+
+    /*
+     * Return the number of addresses in the set, and address 'index', sorted
+     */
+    uint getAddressesCount();
+    addressNumericValue getAddress(uint index);
+
+    /*
+     * Declares all the addresses in the set to 'mapper' (See
+     * FlowMapper::addNoReturn and ParallelFlowMapper::addNoReturn)
+     */
+    void apply(FlowMapper& mapper);
+    void apply(ParallelFlowMapper& mapper);
+
+    /*
+     * Return true if 'name' is a well known function which doesn't return,
+     * ignoring its decorations
+     */
+    static bool isKnownName(const char* name);
+
+private:
+    // Deny copy-constructor and operator =
+    NoReturnAnalysis(const NoReturnAnalysis& other);
+    NoReturnAnalysis& operator = (const NoReturnAnalysis& other);
+
+    // The way a block leaves its function, besides its edges
+    enum BlockExit {
+        // Through its edges only
+        EXIT_NONE = 0,
+        // Ends with a ret, or with a jump to an unknown target
+        EXIT_RETURN,
+        // Ends with a call or a jump to a function which doesn't return
+        EXIT_DEAD
+    };
+
+    /*
+     * Fills m_blockExits and m_blockCallees from the cross-references and the
+     * map list of 'mapper'
+     */
+    void classifyBlocks(FlowMapper& mapper,
+                        const ControlFlowGraph& graph,
+                        const CallGraph& callGraph);
+
+    /*
+     * Return true if a path of 'function' returns, with the functions
+     * currently known to return
+     */
+    bool isReturning(const ControlFlowGraph& graph,
+                     const CallGraph& callGraph,
+                     uint function);
+
+    // The set
+    AddressSet m_addresses;
+
+    // The result of analyze: whether each function returns
+    cSArray<uint8> m_isReturning;
+    uint m_functionsCount;
+
+    // Work arrays of analyze
+    // The BlockExit of each block, and the function called at its end or
+    // CallGraph::NO_FUNCTION
+    cSArray<uint8> m_blockExits;
+    cSArray<uint> m_blockCallees;
+    // The number of the last search which visited each block, the number of
+    // the current search, and a stack of blocks
+    cSArray<uint> m_blockMarks;
+    uint m_mark;
+    cSArray<uint> m_stack;
+};
+
+// The reference countable object
+typedef cSmartPtr<NoReturnAnalysis> NoReturnAnalysisPtr;
+
+#endif // __TBA_DISMOUNT_NORETURNANALYSIS_H
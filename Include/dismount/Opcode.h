@@ -117,6 +117,22 @@ public:
      */
     virtual uint32 getSwitchTableOffset() const = 0;
 
+    /*
+     * For 'switch' opcodes, returns the register used as the index inside
+     * the switch jump table
+     */
+    virtual uint getSwitchIndexRegister() const = 0;
+
+    /*
+     * Returns true if the opcode compares a register with a constant
+     * ("cmp reg, imm"), which bounds the index of a switch statement when it
+     * is followed by a conditional jump to the default case.
+     *
+     * reg   - Will be filled with the compared register
+     * value - Will be filled with the constant
+     */
+    virtual bool getRegisterCompare(uint& reg, uint32& value) const = 0;
+
     /*
      * Returns the flow altering properties of the opcode
      */
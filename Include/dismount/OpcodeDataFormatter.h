@@ -133,4 +133,7 @@ public:
     virtual cString reparseThirdOperand(const cString& opcodeName) = 0;
 };
 
+// The reference countable object
+typedef cSmartPtr<OpcodeDataFormatter> OpcodeDataFormatterPtr;
+
 #endif // __TBA_DISMOUNT_OPCODEDATAFORMATTER_H
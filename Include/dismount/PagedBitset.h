@@ -0,0 +1,147 @@
+#ifndef __TBA_DISMOUNT_PAGEDBITSET_H
+#define __TBA_DISMOUNT_PAGEDBITSET_H
+
+/*
+ * PagedBitset.h
+ *
+ * A sparse set of addresses over the whole address space, stored as bitmap
+ * pages which are allocated upon the first touch.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ProcessorAddress.h"
+
+/*
+ * The bitset is two-level:
+ *   - A directory, an open-addressing hash from the page number (the address
+ *     without its low PAGE_SHIFT bits) into the page index.
+ *   - The pages, PAGE_SIZE bits each, stored one after the other in a single
+ *     array of words.
+ *
+ * The memory usage tracks the touched addresses, not the size of the image,
+ * and any 64 bit address can be used. The last accessed page is cached, so
+ * the sequential accesses of a code walk don't touch the directory.
+ *
+ * Usage:
+ *     PagedBitset visited;
+ *     visited.setRange(0x401000, 5);
+ *     visited.isSet(0x401002);     // true
+ *
+ * NOTE: This class is not thread-safe
+ */
+class PagedBitset {
+public:
+    // Page constants
+    enum {
+        // The number of addresses covered by each page is 1 << PAGE_SHIFT
+        PAGE_SHIFT = 12,
+        PAGE_SIZE = 1 << PAGE_SHIFT,
+        // The words of a page
+        WORD_BITS = 32,
+        WORD_SHIFT = 5,
+        PAGE_WORDS = PAGE_SIZE / WORD_BITS
+    };
+
+    /*
+     * Constructor. Creates an empty set
+     */
+    PagedBitset();
+
+    /*
+     * Removes all the addresses and frees the pages
+     */
+    void clear();
+
+    /*
+     * Return true if 'address' is in the set
+     */
+    bool isSet(ProcessorAddress::uintAddress address) const;
+
+    /*
+     * Return true if 'address' is in the set. Unlike isSet, the last accessed
+     * page isn't updated, so several threads may call it at once while the
+     * set isn't changed.
+     */
+    bool isSetConcurrent(ProcessorAddress::uintAddress address) const;
+
+    /*
+     * Adds 'address' to the set
+     */
+    void set(ProcessorAddress::uintAddress address);
+
+    /*
+     * Adds 'length' addresses starting at 'start' (for example all the bytes
+     * of an instruction). Whole words are filled at once.
+     */
+    void setRange(ProcessorAddress::uintAddress start,
+                  ProcessorAddress::uintAddress length);
+
+    /*
+     * Return true if any of the 'length' addresses starting at 'start' is in
+     * the set. Whole words are tested at once.
+     */
+    bool isAnySet(ProcessorAddress::uintAddress start,
+                  ProcessorAddress::uintAddress length) const;
+
+    /*
+     * Return the number of allocated pages
+     */
+    uint getPagesCount() const;
+
+private:
+    // The empty directory slot
+    enum { EMPTY_SLOT = 0xFFFFFFFF };
+
+    /*
+     * A directory slot
+     */
+    struct Slot {
+        // The page number
+        ProcessorAddress::uintAddress m_page;
+        // The index of the page, or EMPTY_SLOT
+        uint m_index;
+    };
+
+    /*
+     * Return the words of page 'page', or NULL if the page wasn't allocated
+     */
+    const uint32* findPage(ProcessorAddress::uintAddress page) const;
+
+    /*
+     * Like findPage, without the last accessed page
+     */
+    const uint32* lookupPage(ProcessorAddress::uintAddress page) const;
+
+    /*
+     * Return the words of page 'page'. Allocates a new zeroed page if needed.
+     */
+    uint32* getPage(ProcessorAddress::uintAddress page);
+
+    /*
+     * Doubles the directory size and rehash all the pages
+     */
+    void growDirectory();
+
+    /*
+     * Return a mask of the bits 'first' to 'last' (inclusive) of a word
+     */
+    static uint32 getWordMask(uint first, uint last);
+
+    // The directory. The size is always a power of 2.
+    cSArray<Slot> m_directory;
+    // The pages words, PAGE_WORDS words for each page, and the number of
+    // allocated pages
+    cSArray<uint32> m_words;
+    uint m_pagesCount;
+    // The last accessed page and its index, or EMPTY_SLOT
+    mutable ProcessorAddress::uintAddress m_lastPage;
+    mutable uint m_lastIndex;
+};
+
+// The reference countable object
+typedef cSmartPtr<PagedBitset> PagedBitsetPtr;
+
+#endif // __TBA_DISMOUNT_PAGEDBITSET_H
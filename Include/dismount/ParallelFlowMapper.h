@@ -0,0 +1,426 @@
+#ifndef __TBA_DISMOUNT_PARALLELFLOWMAPPER_H
+#define __TBA_DISMOUNT_PARALLELFLOWMAPPER_H
+
+/*
+ * ParallelFlowMapper.h
+ *
+ * Maps the flow of a program from many entry points at once, spreading the
+ * code walks over several threads.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/list.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/os/mutex.h"
+#include "xStl/os/event.h"
+#include "dismount/OpcodeSubsystems.h"
+#include "dismount/StreamDisassembler.h"
+#include "dismount/DefaultOpcodeDataFormatter.h"
+#include "dismount/SectionMemoryInterface.h"
+#include "dismount/PagedBitset.h"
+#include "dismount/AddressSet.h"
+#include "dismount/FlowMapper.h"
+
+/*
+ * The parallel counterpart of calling FlowMapper::map() for every export and
+ * every relocated offset.
+ *
+ * The mapping is done in rounds. The worker threads are started once for each
+ * call to map(), and each round walks a sorted array of code addresses (the
+ * "frontier"):
+ *   1. The frontier is split between the workers. Each worker walks the
+ *      addresses of its own range with its own disassembler, and steals half
+ *      of the remaining range of another worker when its range is exhausted.
+ *   2. A walk decodes a single code subset, from its start address until the
+ *      first ret, unconditional jump, invalid instruction, non-executable
+ *      address, or code which was claimed or walked before the round, and
+ *      collects the branch targets it finds. The claimed and walked sets are
+ *      changed only between the rounds, so the walk depends only on its
+ *      start address and on the sets as they were when the round started,
+ *      and the workers read them without locks.
+ *   3. The calling thread merges the branches in (target, caller) order. The
+ *      first branch to an unclaimed target claims it in the visited set and
+ *      adds it to the next frontier, unless the target was walked already.
+ *      (As with FlowMapper, a branch into walked code starts no subset,
+ *      except for the start of a potential subset. See below)
+ *
+ * Since every step is ordered by address, the result is the same for any
+ * number of threads and any scheduling.
+ *
+ * Each round walks the targets found by the previous one, so the number of
+ * rounds is the branch depth of the code: the longest chain of branches
+ * from an entry point to a subset. The workers wait for each other at the
+ * end of every round.
+ *
+ * The differences from the sequential FlowMapper:
+ *   - Every branch target which wasn't walked before its round starts a
+ *     subset. A subset which falls through into the start of another subset
+ *     ends at that start, as a sequential walk that reaches visited code.
+ *   - A subset which ends with an invalid instruction, or reaches the forced
+ *     end of its entry point, is "potential" and its branches are ignored,
+ *     until another branch targets its start.
+ *   - A walk which reaches code walked in an earlier round falls through
+ *     into it, and ends there. If that's inside another subset, the other
+ *     subset is split there, as by a branch target, without decoding it
+ *     again.
+ *   - Potential walks of the same round which reach the same code share a
+ *     single potential block, the one with the lowest start address. The
+ *     others end where they reach the shared code. (The sequential mapper
+ *     keeps the first walk, which depends on the walk order.)
+ *   - Invalid instructions end the subset instead of failing the whole map.
+ *   - The switch jump tables are read when the switch is claimed, after
+ *     the round, so a table without a bound check stops at the code and the
+ *     tables of the previous rounds.
+ *
+ * Usage:
+ *     ParallelFlowMapper mapper(BasicInputPtr(new cFileStream(filename)),
+ *                               memoryInterface,
+ *                               numberOfCores);
+ *     for (each export)
+ *         mapper.addEntryPoint(address, nextExportAddress);
+ *     mapper.map();
+ *     mapper.getMapList(subsets);
+ *
+ * NOTE: This class is not thread-safe
+ */
+class ParallelFlowMapper {
+public:
+    /*
+     * Constructor.
+     *
+     * image           - The image. It's read once into a buffer, and each
+     *                   worker decodes the buffer with its own disassembler.
+     * memoryInterface - The sections of the image. Only read by the workers.
+     * workersCount    - The number of worker threads
+     * type            - The disassembler of the code
+     */
+    ParallelFlowMapper(const BasicInputPtr& image,
+                       const SectionMemoryInterfacePtr& memoryInterface,
+                       uint workersCount,
+                       OpcodeSubsystems::DisassemblerType type =
+                           OpcodeSubsystems::DISASSEMBLER_INTEL_32);
+
+    /*
+     * Destructor. Stops the workers of a map() which failed.
+     */
+    ~ParallelFlowMapper();
+
+    /*
+     * Adds an address to start mapping from.
+     *
+     * address   - The stream address of the code
+     * forcedEnd - If not zero, the walk from 'address' stops when it reaches
+     *             'forcedEnd' (See FlowMapper::map)
+     */
+    void addEntryPoint(addressNumericValue address,
+                       addressNumericValue forcedEnd = 0);
+
+    /*
+     * Declares a function which doesn't return. The walks of the following
+     * mappings stop after the calls to it, like after a JMP (See
+     * FlowMapper::addNoReturn).
+     *
+     * address - The stream address of the function, or of the pointer which
+     *           the calls go through
+     */
+    void addNoReturn(addressNumericValue address);
+
+    /*
+     * Maps all the code reachable from the entry points which were added
+     * since the last call.
+     *
+     * Returns the total number of subsets.
+     * Throw exception if any of the workers failed.
+     */
+    uint map();
+
+    /*
+     * Returns the code subsets, sorted by their start address. Subsets for
+     * branches without a known destination (start address 0) are at the end,
+     * sorted by the caller address. The subsets which start at a fall-through
+     * target follow the subset they were split from.
+     *
+     * listMap - Will be filled with the list
+     */
+    void getMapList(cList<FlowMapper::CodeSubset>& listMap);
+
+private:
+    // Deny copy-constructor and operator =
+    ParallelFlowMapper(const ParallelFlowMapper& other);
+    ParallelFlowMapper& operator = (const ParallelFlowMapper& other);
+
+    // The workers and their context
+    class Worker;
+    struct WorkerContext;
+    typedef cSmartPtr<WorkerContext> WorkerContextPtr;
+
+    /*
+     * An address to walk
+     */
+    struct WorkItem {
+        addressNumericValue m_address;
+        addressNumericValue m_forcedEnd;
+        addressNumericValue m_callerAddress;
+        int m_callerAlterProperty;
+    };
+
+    // Branch types
+    enum {
+        // A flow into m_target
+        BRANCH_TARGET = 0,
+        // m_target is the jump table of the switch at m_callerAddress, and
+        // shouldn't be walked. The entries are read when the branch is
+        // claimed.
+        BRANCH_SWITCH_TABLE = 1
+    };
+
+    /*
+     * A branch found by a walk
+     */
+    struct Branch {
+        addressNumericValue m_target;
+        addressNumericValue m_callerAddress;
+        int m_callerAlterProperty;
+        uint m_type;
+        // BRANCH_SWITCH_TABLE: the number of entries of the table, or
+        // FlowMapper::SWITCH_NO_BOUND
+        uint m_entriesCount;
+    };
+
+    /*
+     * A decoded instruction of a block
+     */
+    struct Instruction {
+        // The offset from the block start
+        uint32 m_offset;
+        uint16 m_alterProperty;
+    };
+
+    /*
+     * A walked code subset
+     */
+    struct Block {
+        addressNumericValue m_start;
+        addressNumericValue m_end;
+        addressNumericValue m_callerAddress;
+        int m_endAlterProperty;
+        int m_callerAlterProperty;
+        // The alter property of the first instruction
+        int m_firstAlterProperty;
+        // See the class documentation
+        bool m_isPotential;
+        // Set for a potential block which was ended at the code of another
+        // block
+        bool m_isCut;
+        // Set for a block which ends where it falls through into code which
+        // was claimed or walked in an earlier round
+        bool m_isFallThrough;
+        // The last address of the walk, before the block was cut
+        addressNumericValue m_walkEnd;
+        // The instructions of the block, in m_instructions
+        uint m_firstInstruction;
+        uint m_instructionsCount;
+        // The branches of a potential subset, in m_heldBranches
+        uint m_firstBranch;
+        uint m_branchesCount;
+    };
+
+    /*
+     * A block index, sorted by the block start address
+     */
+    struct BlockOrder {
+        addressNumericValue m_start;
+        uint m_index;
+    };
+
+    /*
+     * A potential block index, sorted by the walk end and the start address
+     */
+    struct TailOrder {
+        addressNumericValue m_walkEnd;
+        addressNumericValue m_start;
+        uint m_index;
+    };
+
+    // Sorting orders
+    static bool isEntryBefore(const WorkItem& a, const WorkItem& b);
+    static bool isItemBefore(const WorkItem& a, const WorkItem& b);
+    static bool isBranchBefore(const Branch& a, const Branch& b);
+    static bool isCallerBefore(const Branch& a, const Branch& b);
+    static bool isOrderBefore(const BlockOrder& a, const BlockOrder& b);
+    static bool isTailBefore(const TailOrder& a, const TailOrder& b);
+
+    /*
+     * Walks a single work item, and adds the block and its branches to the
+     * worker context. Called from the worker threads.
+     */
+    void walk(WorkerContext& context, const WorkItem& item);
+
+    /*
+     * Return the index of the next frontier item for worker 'index', stealing
+     * from the other workers if needed. Return false if there aren't any items
+     * left in this round.
+     */
+    bool takeItem(uint index, uint& item);
+
+    /*
+     * Starts a thread for each worker, and stops them. The threads wait for
+     * the rounds between the calls.
+     */
+    void startWorkers();
+    void stopWorkers();
+
+    /*
+     * Walks the frontier with all the workers.
+     * Return false if any of the workers failed.
+     */
+    bool runRound();
+
+    /*
+     * Called by the worker threads. Waits until a round other than 'round'
+     * starts and updates 'round'. Return false if the workers are stopped.
+     */
+    bool waitRound(WorkerContext& context, uint& round);
+
+    /*
+     * Called by a worker thread when it's done with the current round
+     */
+    void endRound();
+
+    /*
+     * Collects the blocks and branches of the round, and builds the next
+     * frontier
+     */
+    void mergeRound();
+
+    /*
+     * Claims the targets of 'branches' (sorted) and appends the new targets
+     * to the next frontier. Promoted potential blocks append their held
+     * branches into 'promoted'.
+     */
+    void claimBranches(const cSArray<Branch>& branches,
+                       uint count,
+                       cSArray<Branch>& promoted,
+                       uint& promotedCount);
+
+    /*
+     * Reads the entries of the jump table of 'table', as
+     * FlowMapper::resolveSwitchTable, and appends a branch into each target
+     * to 'branches'. The entries are claimed as data.
+     */
+    void readSwitchTable(const Branch& table,
+                         cSArray<Branch>& branches,
+                         uint& branchesCount);
+
+    /*
+     * Keeps a single potential block for each code which is shared by several
+     * walks. The other blocks are cut where they reach the shared code, and
+     * their branches before it are appended into 'branches'. m_tails must be
+     * sorted.
+     */
+    void cutPotentials(cSArray<Branch>& branches, uint& branchesCount);
+
+    /*
+     * Ends a potential block at its first instruction which is shared with
+     * another block, and makes it a normal block
+     */
+    void cutBlock(Block& block, cSArray<Branch>& branches, uint& branchesCount);
+
+    /*
+     * Return the index of the potential block which starts at 'address', or
+     * m_blocksCount
+     */
+    uint findPotential(addressNumericValue address) const;
+
+    /*
+     * Appends the subsets of the non-potential 'block' to 'listMap'. The
+     * block ends at the first start of another block or fall-through target
+     * inside it. Each fall-through target inside it which wasn't split by
+     * another block (See 'splits') starts a subset of the rest of the block,
+     * which ends in the same way.
+     *
+     * starts - The start addresses of all the blocks
+     * splits - The fall-through targets which were split already
+     */
+    void appendSubsets(const Block& block,
+                       const PagedBitset& starts,
+                       PagedBitset& splits,
+                       cList<FlowMapper::CodeSubset>& listMap);
+
+    /*
+     * Return the first fall-through into 'address', by caller. m_fallThroughs
+     * must be sorted.
+     */
+    const Branch& findFallThrough(addressNumericValue address) const;
+
+    // The memory interface
+    SectionMemoryInterfacePtr m_memoryInterface;
+    // The bytes of the image, shared by the workers
+    cSArray<uint8> m_image;
+    // The workers
+    cSArray<WorkerContextPtr> m_workers;
+    // The threads of the workers during map()
+    cList<cSmartPtr<Worker> > m_threads;
+
+    // Guards the rounds state below
+    cMutex m_poolLock;
+    // The number of the current round
+    uint m_round;
+    // The number of workers which didn't finish the current round
+    uint m_activeWorkers;
+    // Set when the threads should exit
+    bool m_isStopping;
+    // Signaled when the last worker finishes a round
+    cEvent m_roundEnd;
+
+    // The functions which don't return. See addNoReturn.
+    AddressSet m_noReturns;
+
+    // The entry points added since the last map
+    cSArray<WorkItem> m_entries;
+    uint m_entriesCount;
+
+    // The addresses to walk in the current round
+    cSArray<WorkItem> m_frontier;
+    uint m_frontierCount;
+
+    // The claimed start addresses
+    PagedBitset m_claimed;
+
+    // The instructions addresses of all the blocks, and the addresses which
+    // are instructions of more than one block. m_claimed and
+    // m_walkedInstructions are read by the workers during the rounds (See
+    // PagedBitset::isSetConcurrent), and changed only between them.
+    PagedBitset m_walkedInstructions;
+    PagedBitset m_sharedInstructions;
+
+    // All the walked blocks
+    cSArray<Block> m_blocks;
+    uint m_blocksCount;
+    // The instructions of all the blocks
+    cSArray<Instruction> m_instructions;
+    uint m_instructionsCount;
+    // The branches of the potential blocks
+    cSArray<Branch> m_heldBranches;
+    uint m_heldBranchesCount;
+    // All the blocks which were ever potential, sorted by the start address,
+    // and sorted by the walk end
+    cSArray<BlockOrder> m_potentials;
+    cSArray<TailOrder> m_tails;
+    uint m_potentialsCount;
+    // The branches without a known destination
+    cSArray<Branch> m_unknownBranches;
+    uint m_unknownBranchesCount;
+    // The fall-through of the blocks into code of an earlier round, from the
+    // last instruction of the block, and their targets
+    cSArray<Branch> m_fallThroughs;
+    uint m_fallThroughsCount;
+    PagedBitset m_fallThroughTargets;
+};
+
+// The reference countable object
+typedef cSmartPtr<ParallelFlowMapper> ParallelFlowMapperPtr;
+
+#endif // __TBA_DISMOUNT_PARALLELFLOWMAPPER_H
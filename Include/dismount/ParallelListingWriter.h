@@ -0,0 +1,194 @@
+#ifndef __TBA_DISMOUNT_PARALLELLISTINGWRITER_H
+#define __TBA_DISMOUNT_PARALLELLISTINGWRITER_H
+
+/*
+ * ParallelListingWriter.h
+ *
+ * Writes a disassembly listing, formatting the instructions on several
+ * threads.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/list.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/stream/basicIO.h"
+#include "xStl/os/mutex.h"
+#include "xStl/os/event.h"
+#include "dismount/Opcode.h"
+#include "dismount/StreamDisassembler.h"
+#include "dismount/OpcodeDataFormatter.h"
+#include "dismount/ProcessorAddress.h"
+#include "dismount/ListingWriter.h"
+
+/*
+ * Produces exactly the same listing as ListingWriter, but formatting the
+ * instructions is spread over a pool of worker threads:
+ *   1. The calling thread decodes the instructions into batches of
+ *      'batchSize' instructions. Each instruction is decoded only once.
+ *   2. The workers format whole batches into per-batch text buffers, each
+ *      worker with its own OpcodeDataFormatter.
+ *   3. The calling thread writes the buffers in address order.
+ * The steps are repeated for a window of batches at a time, so the memory
+ * usage doesn't depend on the size of the module. The workers are started
+ * once for each write() and wait for the next window between the windows.
+ *
+ * Usage:
+ *     cList<OpcodeDataFormatterPtr> formatters;
+ *     for (uint i = 0; i < numberOfCores; i++)
+ *         formatters.append(OpcodeDataFormatterPtr(
+ *                                 new DefaultOpcodeDataFormatter(10)));
+ *     ParallelListingWriter writer(*disassembler, formatters);
+ *     writer.write(outputFile, start, end);
+ *
+ * NOTE: The disassembler's getOpcodeFormat() is called concurrently from all
+ *       workers and must not change the disassembler state (as with
+ *       IA32StreamDisassembler).
+ * NOTE: This class is not thread-safe
+ */
+class ParallelListingWriter {
+public:
+    // Default values
+    enum {
+        // The number of instructions in a batch
+        DEFAULT_BATCH_SIZE = 4096,
+        // The number of batches decoded for each worker before formatting
+        BATCHES_PER_WORKER = 4
+    };
+
+    /*
+     * Constructor.
+     *
+     * disassembler - The disassembler to read the instructions from
+     * formatters   - The formatters for the instruction column. A worker
+     *                thread is created for each formatter.
+     * options      - The columns layout. See ListingWriter::Options
+     * batchSize    - The number of instructions formatted by a worker at once
+     */
+    ParallelListingWriter(StreamDisassembler& disassembler,
+                          const cList<OpcodeDataFormatterPtr>& formatters,
+                          const ListingWriter::Options& options =
+                                ListingWriter::Options(),
+                          uint batchSize = DEFAULT_BATCH_SIZE);
+
+    /*
+     * Destructor. Stops the workers.
+     */
+    ~ParallelListingWriter();
+
+    /*
+     * See ListingWriter::write
+     */
+    uint write(basicOutput& output);
+
+    /*
+     * See ListingWriter::write
+     */
+    uint write(basicOutput& output,
+               const ProcessorAddress& start,
+               ProcessorAddress::uintAddress end);
+
+private:
+    // Deny copy-constructor and operator =
+    ParallelListingWriter(const ParallelListingWriter& other);
+    ParallelListingWriter& operator = (const ParallelListingWriter& other);
+
+    // Forward declaration of the worker thread
+    class Worker;
+    friend class Worker;
+
+    /*
+     * A batch of decoded instructions and their formatted text
+     */
+    class Batch {
+    public:
+        // Constructor. Empty batch
+        Batch();
+
+        // The decoded instructions
+        cList<OpcodePtr> m_opcodes;
+        // The formatted listing of the instructions
+        cSArray<char> m_text;
+        uint m_textLength;
+    };
+    typedef cSmartPtr<Batch> BatchPtr;
+
+    /*
+     * Decodes, formats and writes windows of batches until the end of the
+     * stream, or until 'end' if 'shouldLimit' is set.
+     */
+    uint writeInstructions(basicOutput& output,
+                           bool shouldLimit,
+                           ProcessorAddress::uintAddress end);
+
+    /*
+     * Decodes up to 'batchSize' instructions into 'batch'.
+     *
+     * Return false if the last instruction was decoded.
+     */
+    bool decodeBatch(Batch& batch,
+                     bool shouldLimit,
+                     ProcessorAddress::uintAddress end);
+
+    /*
+     * Starts a thread for each formatter, and stops them. The threads wait
+     * for the windows between the calls.
+     */
+    void startWorkers();
+    void stopWorkers();
+
+    /*
+     * Formats all the batches in m_window using the workers
+     */
+    void formatWindow();
+
+    /*
+     * Called by the workers. Waits on 'windowStart' until a window other than
+     * 'window' is ready and updates 'window'. Return false if the workers are
+     * stopped.
+     */
+    bool waitWindow(cEvent& windowStart, uint& window);
+
+    /*
+     * Called by a worker when it's done with the current window
+     */
+    void endWindow();
+
+    /*
+     * Called by the workers. Takes the next batch to format.
+     *
+     * Return NULL if all the batches were taken
+     */
+    Batch* takeBatch();
+
+    // The disassembler
+    StreamDisassembler& m_disassembler;
+    // The formatters, one for each worker
+    cList<OpcodeDataFormatterPtr> m_formatters;
+    // The columns layout
+    ListingWriter::Options m_options;
+    // The number of instructions in a batch
+    uint m_batchSize;
+
+    // The batches of the current window, in address order
+    cList<BatchPtr> m_window;
+    // The next batch to be taken by a worker and its lock
+    cList<BatchPtr>::iterator m_nextBatch;
+    cMutex m_nextBatchLock;
+
+    // The workers threads during write(), one for each formatter
+    cList<cSmartPtr<Worker> > m_workers;
+    // Guards the windows state below
+    cMutex m_poolLock;
+    // The number of the current window
+    uint m_windowNumber;
+    // The number of workers which didn't finish the current window
+    uint m_activeWorkers;
+    // Set when the threads should exit
+    bool m_isStopping;
+    // Signaled when the last worker finishes a window
+    cEvent m_windowEnd;
+};
+
+#endif // __TBA_DISMOUNT_PARALLELLISTINGWRITER_H
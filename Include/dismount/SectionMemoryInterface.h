@@ -13,6 +13,9 @@
  */
 
 #include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/list.h"
+#include "xStl/data/smartptr.h"
 
 class SectionMemoryInterface {
 public:
@@ -74,6 +77,9 @@ public:
      *
      * Returns true if the address attributes contains the wanted flags.
      * false otherwise.
+     *
+     * The check is a single lookup in the pages permission table, and a
+     * second lookup for pages which are only partially covered by a section.
      */
     bool checkAddress(addressNumericValue address, uint flags);
 
@@ -86,6 +92,8 @@ public:
      * Returns the translated address, if found inside the PE sections.
      * 0 otherwise.
      *
+     * The sections are looked up with a binary search over the sorted
+     * section intervals (See initIntervals).
      */
     uint virtualToRawAddress(addressNumericValue virtualAddress);
 
@@ -116,11 +124,59 @@ private:
     SectionMemoryInterface(const SectionMemoryInterface& other);
 
     /*
-     * Initializes the memory attribute maps, used to check addresses
+     * A section bounds and attributes, stored in a contiguous array
+     * sorted by the start address. See "GeneralSection".
+     */
+    struct SectionInterval {
+        addressNumericValue m_start;
+        addressNumericValue m_end;
+        addressNumericValue m_rawDataAddress;
+        uint m_flags;
+    };
+
+    // The permission table constants
+    enum {
+        // The permissions are stored per 4 KB page
+        PERMISSION_PAGE_SHIFT = 12,
+        PERMISSION_PAGE_SIZE = 1 << PERMISSION_PAGE_SHIFT,
+        // All the flags managed by the table
+        PERMISSION_FLAGS_MASK = SECTION_FLAG_READ | SECTION_FLAG_WRITE | SECTION_FLAG_EXECUTABLE,
+        // Set in a page entry whose addresses have different flags. The rest
+        // of the entry is the index of the page in m_mixedPagesFlags.
+        PERMISSION_PAGE_MIXED = 0x8000,
+        PERMISSION_MAX_MIXED_PAGES = 0x8000
+    };
+
+    /*
+     * Initializes the pages permission table, used to check addresses
      * against certain flags (see "checkAddress").
+     * Pages which are entirely covered by a section take the section flags.
+     * Pages which are partially covered (unaligned section edges) fall back
+     * to a byte of flags for each address.
      */
     void initMaps();
 
+    /*
+     * Copies the section list into the sorted intervals array.
+     * Empty sections are omitted. The sections are expected not to overlap.
+     */
+    void initIntervals();
+
+    /*
+     * Adds flags to the addresses 'start' until 'end' (not including) of a
+     * single page.
+     *
+     * page - The page number
+     * start - The first address, inside the page
+     * end - The address after the last address, inside the page or the
+     *       start of the next page
+     * flags - The flags to add
+     */
+    void addPageFlags(uint page,
+                      addressNumericValue start,
+                      addressNumericValue end,
+                      uint flags);
+
     // The module base address
     addressNumericValue m_moduleBaseAddress;
     // The image base
@@ -129,13 +185,17 @@ private:
     uint m_memorySize;
     // The section list
     cList<GeneralSection> m_sectionList;
-
-    /* Arrays containing information about which addresses are
-       defined as read, write and executable */
-    // TODO: Create a dedicated data structure for this
-    //cBuffer m_readMap;
-    cBuffer m_writeMap;
-    cBuffer m_execMap;
+    // The sections sorted by their start address
+    cSArray<SectionInterval> m_intervals;
+
+    /* The read, write and executable flags of each page, or
+       PERMISSION_PAGE_MIXED and the index of the page flags in
+       m_mixedPagesFlags */
+    cSArray<uint16> m_pagesFlags;
+    // The flags of each address of the mixed pages, PERMISSION_PAGE_SIZE bytes per page
+    cBuffer m_mixedPagesFlags;
+    // The number of mixed pages
+    uint m_mixedPagesCount;
 };
 
 typedef cSmartPtr<SectionMemoryInterface> SectionMemoryInterfacePtr;
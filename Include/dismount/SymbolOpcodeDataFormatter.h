@@ -0,0 +1,60 @@
+#ifndef __TBA_DISMOUNT_SYMBOLOPCODEDATAFORMATTER_H
+#define __TBA_DISMOUNT_SYMBOLOPCODEDATAFORMATTER_H
+
+/*
+ * SymbolOpcodeDataFormatter.h
+ *
+ * Formatter which shows addresses as symbol names
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/string.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ProcessorAddress.h"
+#include "dismount/SymbolTable.h"
+#include "dismount/DefaultOpcodeDataFormatter.h"
+
+/*
+ * Same as DefaultOpcodeDataFormatter, but absolute addresses (and relative
+ * addresses when the IP is known) are translated using a SymbolTable:
+ *     call  _main               ; Exact match
+ *     jmp   _main+1Ah           ; Inside a symbol
+ *     call  00402000h           ; No symbol before the address, or too far
+ */
+class SymbolOpcodeDataFormatter : public DefaultOpcodeDataFormatter {
+public:
+    // The default for 'maxOffset'
+    enum { DEFAULT_MAX_OFFSET = 0x10000 };
+
+    /*
+     * Constructor.
+     *
+     * opcodeNameAlignment - See DefaultOpcodeDataFormatter
+     * symbols             - The symbols to use. Must be sorted, and kept
+     *                       alive and unchanged while the formatter is used.
+     * maxOffset           - The largest distance from the nearest preceding
+     *                       symbol which is rendered as "name+offset".
+     *                       Farther addresses are rendered as numbers.
+     */
+    SymbolOpcodeDataFormatter(uint opcodeNameAlignment,
+                              const SymbolTable& symbols,
+                              ProcessorAddress::uintAddress maxOffset =
+                                    DEFAULT_MAX_OFFSET);
+
+    /*
+     * See OpcodeDataFormatter::translateAbsoluteAddress
+     */
+    virtual cString translateAbsoluteAddress(const ProcessorAddress& absoulte);
+
+private:
+    // The symbols
+    const SymbolTable& m_symbols;
+    // The largest offset rendered as "name+offset"
+    ProcessorAddress::uintAddress m_maxOffset;
+};
+
+// The reference countable object
+typedef cSmartPtr<SymbolOpcodeDataFormatter> SymbolOpcodeDataFormatterPtr;
+
+#endif // __TBA_DISMOUNT_SYMBOLOPCODEDATAFORMATTER_H
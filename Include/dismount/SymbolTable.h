@@ -0,0 +1,164 @@
+#ifndef __TBA_DISMOUNT_SYMBOLTABLE_H
+#define __TBA_DISMOUNT_SYMBOLTABLE_H
+
+/*
+ * SymbolTable.h
+ *
+ * A store of symbols names and their addresses, used to translate addresses
+ * into names.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/ProcessorAddress.h"
+
+/*
+ * The symbols are stored in a single contiguous array sorted by address, and
+ * all the names are stored in a single characters pool. Two lookups are
+ * provided:
+ *   - Exact match, using an open-addressing hash over the sorted array.
+ *   - Nearest preceding symbol, using a binary search over the sorted array.
+ *
+ * Usage:
+ *     SymbolTable symbols;
+ *     symbols.addSymbol(0x401000, "_main");
+ *     symbols.addSymbol(0x401100, "_foo");
+ *     symbols.sort();
+ *
+ *     symbols.findNearest(0x401010, address);  // "_main", address = 0x401000
+ *
+ * When several symbols share the same address, the first added symbol is
+ * used.
+ *
+ * NOTE: Lookups are allowed only after 'sort' and are thread-safe as long as
+ *       the table is not modified.
+ */
+class SymbolTable {
+public:
+    /*
+     * Constructor. Creates an empty table
+     */
+    SymbolTable();
+
+    /*
+     * Adds a new symbol to the table. 'sort' must be called before the next
+     * lookup.
+     *
+     * address - The address of the symbol
+     * name    - The symbol name
+     */
+    void addSymbol(ProcessorAddress::uintAddress address, const cString& name);
+    void addSymbol(ProcessorAddress::uintAddress address, const char* name);
+
+    /*
+     * Reads symbols from a flat text file. Each line is:
+     *     <hex-address> <name>
+     * The address may have a '0x' prefix or a 'h' suffix. Empty lines and lines
+     * starting with '#' or ';' are ignored. The table is sorted at the end.
+     *
+     * input - The stream to read the file from. Read until the end.
+     *
+     * Return the number of symbols read.
+     * Throw exception if a line is malformed. The symbols of the file are not
+     * added in this case, and the table is sorted.
+     */
+    uint load(basicInput& input);
+
+    /*
+     * Sorts the symbols and builds the exact-match index. Must be called after
+     * adding symbols.
+     */
+    void sort();
+
+    /*
+     * Return the number of symbols in the table (after removing duplicated
+     * addresses by 'sort')
+     */
+    uint getCount() const;
+
+    /*
+     * Return the address and the name of symbol 'index'. The symbols are
+     * sorted by their address.
+     */
+    ProcessorAddress::uintAddress getAddress(uint index) const;
+    const char* getName(uint index) const;
+
+    /*
+     * Return the name of the symbol at 'address'.
+     * Return NULL if there isn't any symbol at 'address'.
+     */
+    const char* find(ProcessorAddress::uintAddress address) const;
+
+    /*
+     * Return the name of the symbol with the highest address which is lower or
+     * equal to 'address'.
+     *
+     * address       - The address to look for
+     * symbolAddress - Will be filled with the address of the symbol
+     *
+     * Return NULL if all symbols are above 'address'.
+     */
+    const char* findNearest(ProcessorAddress::uintAddress address,
+                            ProcessorAddress::uintAddress& symbolAddress) const;
+
+    /*
+     * Renders 'address' as "name" or "name+offset". The offset is written in
+     * hexadecimal form with the 'h' suffix.
+     *
+     * address   - The address to render
+     * maxOffset - The largest offset from the nearest symbol to render
+     * output    - Will be filled with the rendered name
+     *
+     * Return false if there isn't a symbol at or up to 'maxOffset' bytes
+     * before 'address', 'output' is not changed in this case.
+     */
+    bool render(ProcessorAddress::uintAddress address,
+                ProcessorAddress::uintAddress maxOffset,
+                cString& output) const;
+
+private:
+    /*
+     * A single symbol
+     */
+    struct Symbol {
+        // The symbol address
+        ProcessorAddress::uintAddress m_address;
+        // The offset of the null-terminated name inside m_names. Also serves
+        // as the insertion order.
+        uint m_nameOffset;
+    };
+
+    // The empty hash slot
+    enum { EMPTY_SLOT = 0xFFFFFFFF };
+
+    /*
+     * Return true if 'a' should be sorted before 'b'
+     */
+    static bool isBefore(const Symbol& a, const Symbol& b);
+
+    /*
+     * Fills m_hash with the index of each symbol
+     */
+    void buildHash();
+
+    // The symbols and the number of used entries
+    cSArray<Symbol> m_symbols;
+    uint m_count;
+    // All the symbols names, null-terminated, and the number of used bytes
+    cSArray<char> m_names;
+    uint m_namesLength;
+    // Open-addressing hash: the indexes of the symbols in m_symbols, or
+    // EMPTY_SLOT. The size is always a power of 2.
+    cSArray<uint> m_hash;
+    // Set to true when the symbols are sorted and indexed
+    bool m_isSorted;
+};
+
+// The reference countable object
+typedef cSmartPtr<SymbolTable> SymbolTablePtr;
+
+#endif // __TBA_DISMOUNT_SYMBOLTABLE_H
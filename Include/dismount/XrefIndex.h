@@ -0,0 +1,206 @@
+#ifndef __TBA_DISMOUNT_XREFINDEX_H
+#define __TBA_DISMOUNT_XREFINDEX_H
+
+/*
+ * XrefIndex.h
+ *
+ * The code and data cross-references of the mapped code
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/ProcessorAddress.h"
+
+/*
+ * The references from instructions to addresses, stored as flat arrays:
+ *   - The references sorted by their source instruction (and target).
+ *   - A view grouped by the target: the distinct targets, sorted, and for
+ *     each target the positions of its references, sorted by the source.
+ * Both "what does X reference" and "who references X" are binary searches.
+ *
+ * The index is built from records which are appended while the code is
+ * walked (See FlowMapper::getXrefIndex).
+ *
+ * Usage:
+ *     const XrefIndex& xrefs = flowMapper.getXrefIndex();
+ *     uint count;
+ *     uint first = xrefs.findTo(address, count);
+ *     for (uint i = 0; i < count; i++)
+ *         xrefs.getXrefTo(first + i).m_source;
+ *
+ * NOTE: This class is not thread-safe
+ */
+class XrefIndex {
+public:
+    // The kinds of references
+    enum XrefKind {
+        // A direct call
+        XREF_CALL = 0,
+        // A direct jump, conditional or not
+        XREF_JUMP,
+        // An indirect branch through a pointer, "dword ptr [address]" (an
+        // import thunk for example). The target is the address of the pointer.
+        XREF_THUNK,
+        // A switch jump. The target is the address of the switch table.
+        XREF_SWITCH_TABLE
+    };
+
+    // Returned by the find functions when nothing is found
+    enum { NOT_FOUND = 0xFFFFFFFF };
+
+    /*
+     * A single reference
+     */
+    struct Xref {
+        // The address of the referencing instruction
+        addressNumericValue m_source;
+        // The referenced address
+        addressNumericValue m_target;
+        // See XrefKind
+        uint m_kind;
+    };
+
+    /*
+     * The references appended while walking the code, before the index is
+     * built
+     */
+    class Records {
+    public:
+        /*
+         * Constructor. Creates an empty records set
+         */
+        Records();
+
+        /*
+         * Removes all the records. The allocated memory is kept.
+         */
+        void clear();
+
+        /*
+         * Appends a reference from the instruction at 'source' to 'target'
+         */
+        void add(addressNumericValue source,
+                 addressNumericValue target,
+                 uint kind);
+
+        /*
+         * Return the number of records
+         */
+        uint getCount() const;
+
+        /*
+         * Return a record
+         */
+        const Xref& get(uint index) const;
+
+        /*
+         * Removes the records after the first 'count' records
+         */
+        void truncate(uint count);
+
+        /*
+         * Appends 'count' records starting at 'first' of 'other'
+         */
+        void append(const Records& other, uint first, uint count);
+
+        /*
+         * Copies 'count' records starting at 'first' down to 'to', keeping
+         * their order. See truncate.
+         */
+        void moveDown(uint first, uint count, uint to);
+
+    private:
+        cSArray<Xref> m_xrefs;
+        uint m_count;
+    };
+
+    /*
+     * Constructor. Creates an empty index
+     */
+    XrefIndex();
+
+    /*
+     * Builds the index from the walked records. Duplicated references are
+     * stored once.
+     */
+    void build(const Records& records);
+
+    /*
+     * Return the number of references
+     */
+    uint getXrefsCount() const;
+
+    /*
+     * Return reference 'index'. The references are sorted by the source, the
+     * target and the kind.
+     */
+    const Xref& getXref(uint index) const;
+
+    /*
+     * Finds the references from the instruction at 'source'.
+     *
+     * count - Will be filled with the number of references
+     *
+     * Return the index of the first reference (See getXref), or NOT_FOUND
+     */
+    uint findFrom(addressNumericValue source, uint& count) const;
+
+    /*
+     * Finds the references to 'target'.
+     *
+     * count - Will be filled with the number of references
+     *
+     * Return the position of the first reference in the grouped-by-target
+     * view (See getXrefTo), or NOT_FOUND
+     */
+    uint findTo(addressNumericValue target, uint& count) const;
+
+    /*
+     * Return the number of distinct targets
+     */
+    uint getTargetsCount() const;
+
+    /*
+     * Return the address of target 'index'. The targets are sorted.
+     */
+    addressNumericValue getTarget(uint index) const;
+
+    /*
+     * Return the number of references to target 'index', and the position of
+     * the first one in the grouped-by-target view
+     */
+    uint getTargetXrefsCount(uint index) const;
+    uint getTargetFirstXref(uint index) const;
+
+    /*
+     * Return the reference at 'position' of the grouped-by-target view
+     */
+    const Xref& getXrefTo(uint position) const;
+
+private:
+    // Deny copy-constructor and operator =
+    XrefIndex(const XrefIndex& other);
+    XrefIndex& operator = (const XrefIndex& other);
+
+    // Sorting orders
+    static bool isSourceBefore(const Xref& a, const Xref& b);
+    static bool isTargetBefore(const Xref& a, const Xref& b);
+
+    // The references sorted by the source
+    cSArray<Xref> m_xrefs;
+    uint m_xrefsCount;
+    // The same references sorted by the target and then by the source
+    cSArray<Xref> m_byTarget;
+    // The distinct targets. The references to target 'i' are in m_byTarget
+    // between offset 'i' and 'i + 1'.
+    cSArray<addressNumericValue> m_targets;
+    uint m_targetsCount;
+    cSArray<uint> m_targetOffsets;
+};
+
+// The reference countable object
+typedef cSmartPtr<XrefIndex> XrefIndexPtr;
+
+#endif // __TBA_DISMOUNT_XREFINDEX_H
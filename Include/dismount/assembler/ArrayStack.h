@@ -0,0 +1,163 @@
+#ifndef __TBA_DISMOUNT_ASSEMBLER_ARRAYSTACK_H
+#define __TBA_DISMOUNT_ASSEMBLER_ARRAYSTACK_H
+
+/*
+ * ArrayStack.h
+ *
+ * Stack stored in a contiguous array
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+
+/*
+ * Stack implementation using an array, for stacks which are pushed and popped
+ * in a tight loop.
+ *
+ * The first INLINE_COUNT variables are stored inside the object, so a shallow
+ * stack never allocates. Deeper stacks move into a heap array which grows
+ * geometrically and is kept by clear(), so a reused stack allocates only when
+ * it reaches a new depth.
+ *
+ * 'T' must have a default constructor and operator =. Popped and cleared
+ * variables are reset to T() to release their references.
+ *
+ * Usage:
+ *     ArrayStack<JumpInstruction, 16> stack;
+ *     stack.push(jump);
+ *     stack.pop(jump);
+ *
+ * NOTE: This class is not thread-safe
+ */
+template <class T, uint INLINE_COUNT>
+class ArrayStack {
+public:
+    /*
+     * Constructor. Creates an empty stack
+     */
+    ArrayStack();
+
+    /*
+     * Pop a value from the stack
+     *
+     * output - Will be filled with the top-of-the stack variable
+     *
+     * Throw exception if the stack is empty
+     */
+    void pop(T& output);
+
+    /*
+     * Clear the top-of-stack element
+     *
+     * Throw exception if the stack is empty
+     */
+    void pop2null();
+
+    /*
+     * Peek into the last element in the stack
+     *
+     * Throw exception if the stack is empty
+     */
+    const T& peek() const;
+
+    /*
+     * Get the top-of-stack element
+     *
+     * Throw exception if the stack is empty
+     */
+    T& tos();
+
+    /*
+     * Return true if the stack is empty
+     */
+    bool isEmpty() const;
+
+    /*
+     * Return the number of variables in the stack
+     */
+    uint getSize() const;
+
+    /*
+     * Return variable 'index', counted from the bottom of the stack
+     */
+    const T& operator[](uint index) const;
+
+    /*
+     * Push a variable into the stack
+     *
+     * var - The new variable to be pushed.
+     */
+    void push(const T& var);
+
+    /*
+     * Pushes all the variables of 'other', from its bottom to its top, so
+     * 'other' is copied as is on top of this stack. 'other' isn't changed.
+     */
+    void append(const ArrayStack& other);
+
+    /*
+     * Moves all the variables of 'other' into this stack, leaving 'other'
+     * empty. The variables are pushed from the top of 'other' to its bottom,
+     * as popping 'other' and pushing each variable, so the bottom of 'other'
+     * becomes the top-of-stack.
+     */
+    void splice(ArrayStack& other);
+
+    /*
+     * Pushes the variables 'first' to 'first + count - 1' (counted from the
+     * bottom) of 'other' in the same order as splice(), without removing them
+     * from 'other'.
+     *
+     * Throw exception if the range is out of 'other'
+     */
+    void spliceCopy(const ArrayStack& other, uint first, uint count);
+
+    /*
+     * Copies the variables 'first' to 'first + count - 1' (counted from the
+     * bottom) down to 'to', keeping their order. See truncate().
+     *
+     * Throw exception if the range is out of the stack or 'to' is above
+     * 'first'
+     */
+    void moveDown(uint first, uint count, uint to);
+
+    /*
+     * Removes the variables above the first 'count'. The allocated memory is
+     * kept for the next pushes.
+     *
+     * Throw exception if there are less than 'count' variables
+     */
+    void truncate(uint count);
+
+    /*
+     * Delete the stack. The allocated memory is kept for the next pushes.
+     */
+    void clear();
+
+private:
+    // Deny copy-constructor and operator =
+    ArrayStack(const ArrayStack& other);
+    ArrayStack& operator = (const ArrayStack& other);
+
+    /*
+     * Makes room for at least 'count' variables. Grows geometrically.
+     */
+    void reserve(uint count);
+
+    // The first variables, stored inside the object
+    T m_inline[INLINE_COUNT];
+    // The variables, once there are more than INLINE_COUNT
+    cSArray<T> m_heap;
+    // Either m_inline or the buffer of m_heap
+    T* m_items;
+    // The number of variables and the size of m_items
+    uint m_count;
+    uint m_capacity;
+};
+
+// And include template implementation
+#include "ArrayStack.inl"
+
+#endif // __TBA_DISMOUNT_ASSEMBLER_ARRAYSTACK_H
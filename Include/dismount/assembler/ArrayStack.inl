@@ -0,0 +1,152 @@
+/*
+ * ArrayStack.inl
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "dismount/assembler/ArrayStack.h"
+
+template <class T, uint INLINE_COUNT>
+ArrayStack<T, INLINE_COUNT>::ArrayStack() :
+    m_items(m_inline),
+    m_count(0),
+    m_capacity(INLINE_COUNT)
+{
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::pop(T& output)
+{
+    CHECK(m_count > 0);
+    m_count--;
+    output = m_items[m_count];
+    m_items[m_count] = T();
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::pop2null()
+{
+    CHECK(m_count > 0);
+    m_count--;
+    m_items[m_count] = T();
+}
+
+template <class T, uint INLINE_COUNT>
+const T& ArrayStack<T, INLINE_COUNT>::peek() const
+{
+    CHECK(m_count > 0);
+    return m_items[m_count - 1];
+}
+
+template <class T, uint INLINE_COUNT>
+T& ArrayStack<T, INLINE_COUNT>::tos()
+{
+    CHECK(m_count > 0);
+    return m_items[m_count - 1];
+}
+
+template <class T, uint INLINE_COUNT>
+bool ArrayStack<T, INLINE_COUNT>::isEmpty() const
+{
+    return m_count == 0;
+}
+
+template <class T, uint INLINE_COUNT>
+uint ArrayStack<T, INLINE_COUNT>::getSize() const
+{
+    return m_count;
+}
+
+template <class T, uint INLINE_COUNT>
+const T& ArrayStack<T, INLINE_COUNT>::operator[](uint index) const
+{
+    ASSERT(index < m_count);
+    return m_items[index];
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::push(const T& var)
+{
+    if (m_count == m_capacity)
+        reserve(m_count + 1);
+    m_items[m_count++] = var;
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::append(const ArrayStack<T, INLINE_COUNT>& other)
+{
+    reserve(m_count + other.m_count);
+    for (uint i = 0; i < other.m_count; i++)
+        m_items[m_count++] = other.m_items[i];
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::splice(ArrayStack<T, INLINE_COUNT>& other)
+{
+    spliceCopy(other, 0, other.m_count);
+    other.clear();
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::spliceCopy(const ArrayStack<T, INLINE_COUNT>& other,
+                                             uint first,
+                                             uint count)
+{
+    CHECK((first <= other.m_count) && (count <= (other.m_count - first)));
+    reserve(m_count + count);
+    for (uint i = first + count; i > first; i--)
+        m_items[m_count++] = other.m_items[i - 1];
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::moveDown(uint first, uint count, uint to)
+{
+    CHECK((first <= m_count) && (count <= (m_count - first)) && (to <= first));
+    for (uint i = 0; i < count; i++)
+        m_items[to + i] = m_items[first + i];
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::truncate(uint count)
+{
+    CHECK(count <= m_count);
+    for (uint i = count; i < m_count; i++)
+        m_items[i] = T();
+    m_count = count;
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::clear()
+{
+    for (uint i = 0; i < m_count; i++)
+        m_items[i] = T();
+    m_count = 0;
+}
+
+template <class T, uint INLINE_COUNT>
+void ArrayStack<T, INLINE_COUNT>::reserve(uint count)
+{
+    if (count <= m_capacity)
+        return;
+
+    uint capacity = m_capacity * 2;
+    if (capacity < count)
+        capacity = count;
+
+    if (m_items == m_inline)
+    {
+        // Move out of the inline variables
+        m_heap.changeSize(capacity);
+        for (uint i = 0; i < m_count; i++)
+        {
+            m_heap[i] = m_inline[i];
+            m_inline[i] = T();
+        }
+    } else
+        m_heap.changeSize(capacity);
+
+    m_items = m_heap.getBuffer();
+    m_capacity = capacity;
+}
@@ -70,6 +70,15 @@ public:
      */
     void push(const T& var);
 
+    /*
+     * Moves all the variables of 'other' into this stack, leaving 'other'
+     * empty. The variables are popped from 'other' and pushed one by one, so
+     * the bottom of 'other' becomes the top-of-stack.
+     *
+     * other - The stack to move the variables from
+     */
+    void splice(StackInrastructor& other);
+
     /*
      * TODO! Protect these methods
      *
@@ -42,6 +42,16 @@ void StackInrastructor<T, Itr>::push(const T& var)
     m_stack.insert(var);
 }
 
+template <class T, class Itr>
+void StackInrastructor<T, Itr>::splice(StackInrastructor<T, Itr>& other)
+{
+    while (!other.isEmpty())
+    {
+        m_stack.insert(*other.m_stack.begin());
+        other.m_stack.remove(other.m_stack.begin());
+    }
+}
+
 template <class T, class Itr>
 const T& StackInrastructor<T, Itr>::peek() const
 {
@@ -0,0 +1,176 @@
+#ifndef __TBA_DISMOUNT_PROC_IA32_IA32FORMATTINGCACHE_H
+#define __TBA_DISMOUNT_PROC_IA32_IA32FORMATTINGCACHE_H
+
+/*
+ * IA32FormattingCache.h
+ *
+ * Memorize the formatted text of repeated ia32 encodings.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/data/smartptr.h"
+#include "dismount/Opcode.h"
+#include "dismount/OpcodeFormatter.h"
+#include "dismount/OpcodeDataFormatter.h"
+#include "dismount/proc/ia32/IA32Opcode.h"
+
+/*
+ * Real code repeats the same encodings over and over again ("push ebp",
+ * "mov ebp, esp", "call dword ptr [...]"). This cache keeps the text which
+ * IA32IntelNotation generated for an encoding, keyed by the instruction bytes
+ * and the processor mode, and returns it without formatting the operands
+ * again.
+ *
+ * Relative branches (jmp/jcc/call with a relative operand) are rendered
+ * differently for each address. For these instructions only the prefix and the
+ * instruction name are cached, and the operand is translated again by the
+ * data-formatter upon each call.
+ *
+ * The cache is a fixed number of direct-mapped slots, a colliding encoding
+ * replaces the older one, so the memory usage is bounded.
+ *
+ * Usage:
+ *     disassembler.setFormattingCache(IA32FormattingCachePtr(
+ *                          new IA32FormattingCache(dataFormatter)));
+ *     ...
+ *     disassembler.getOpcodeFormat(opcode, dataFormatter)->string();
+ *
+ * NOTE: The cache belongs to a single data-formatter. The data-formatter
+ *       output must depend only on its arguments (beside the instruction
+ *       address of relative operands), and its 'endInstruction' must not
+ *       change the text of the prefix and the instruction name. Call 'clear'
+ *       whenever the data-formatter settings are changed.
+ * NOTE: This class is not thread-safe. Each thread should use its own
+ *       data-formatter and its own cache.
+ */
+class IA32FormattingCache {
+public:
+    // The default number of slots
+    enum { DEFAULT_SLOTS = 4096 };
+
+    /*
+     * Constructor.
+     *
+     * dataFormatter - The data-formatter which formats the instructions. Must
+     *                 be kept alive while this object is used.
+     * slots         - The number of cached encodings. Rounded up to a power
+     *                 of 2.
+     */
+    IA32FormattingCache(OpcodeDataFormatter& dataFormatter,
+                        uint slots = DEFAULT_SLOTS);
+
+    /*
+     * See OpcodeFormatter::string(). Return the same text as
+     * IA32IntelNotation.
+     *
+     * instruction   - An IA32Opcode instruction
+     * formatStruct  - Will be filled with the position of the instruction
+     *                 parts
+     */
+    cString string(const OpcodePtr& instruction,
+                   OpcodeFormatter::OpcodeFormatStruct* formatStruct = NULL);
+
+    /*
+     * Return an OpcodeFormatter for 'instruction' which uses this cache. The
+     * formatter must not outlive the cache.
+     *
+     * Throw exception if instruction is not in the IA32Opcode.
+     */
+    OpcodeFormatterPtr getOpcodeFormat(const OpcodePtr& instruction);
+
+    /*
+     * Return the data-formatter of the cache
+     */
+    OpcodeDataFormatter& getDataFormatter();
+
+    /*
+     * Drops all the cached encodings
+     */
+    void clear();
+
+    /*
+     * Return the number of instructions which were found/not found in the
+     * cache
+     */
+    uint getHits() const;
+    uint getMisses() const;
+
+private:
+    // Deny copy-constructor and operator =
+    IA32FormattingCache(const IA32FormattingCache& other);
+    IA32FormattingCache& operator = (const IA32FormattingCache& other);
+
+    // Cache constants
+    enum {
+        // The longest ia32 instruction
+        MAX_CACHED_BYTES = 15,
+        // The longest cached text, longer texts are not cached
+        MAX_CACHED_TEXT = 96
+    };
+
+    /*
+     * A single slot
+     */
+    struct Entry {
+        // The instruction encoding and processor mode
+        uint8 m_bytes[MAX_CACHED_BYTES];
+        uint8 m_length;
+        uint8 m_type;
+        // Set to true if the slot is in use
+        bool m_isValid;
+        // Set to true if only the text before the operands is cached
+        bool m_isRelative;
+        // See OpcodeFormatter::OpcodeFormatStruct
+        uint8 m_opcodeNameStart;
+        uint8 m_opcodeOperandsStart;
+        // The null-terminated text
+        character m_text[MAX_CACHED_TEXT + 1];
+    };
+
+    /*
+     * The OpcodeFormatter returned by 'getOpcodeFormat'
+     */
+    class CachedFormatter : public OpcodeFormatter {
+    public:
+        // Constructor
+        CachedFormatter(IA32FormattingCache& cache,
+                        const OpcodePtr& instruction);
+        // See OpcodeFormatter::string()
+        virtual cString string(OpcodeFormatStruct* formatStruct = NULL) const;
+        // See OpcodeFormatter::parseOperandAddress()
+        virtual uint parseOperandAddress(ProcessorAddress& address);
+    private:
+        IA32FormattingCache& m_cache;
+        OpcodePtr m_instruction;
+    };
+
+    /*
+     * Return true if the only operand of 'opcode' is relative to the
+     * instruction address, and fills 'relative' with the distance from the
+     * instruction start.
+     * Return false for all other instructions, including far pointers.
+     */
+    static bool getRelativeOperand(const IA32Opcode& opcode,
+                                   ProcessorAddress::intAddress& relative);
+
+    /*
+     * Return the slot of an encoding
+     */
+    uint hashEncoding(const uint8* bytes, uint length, uint type) const;
+
+    // The data-formatter
+    OpcodeDataFormatter& m_dataFormatter;
+    // The slots. The size is always a power of 2.
+    cSArray<Entry> m_entries;
+    // Statistics
+    uint m_hits;
+    uint m_misses;
+};
+
+// The reference countable object
+typedef cSmartPtr<IA32FormattingCache> IA32FormattingCachePtr;
+
+#endif // __TBA_DISMOUNT_PROC_IA32_IA32FORMATTINGCACHE_H
@@ -71,6 +71,16 @@ public:
      */
     virtual uint32 getSwitchTableOffset() const;
 
+    /*
+     * See Opcode::getSwitchIndexRegister
+     */
+    virtual uint getSwitchIndexRegister() const;
+
+    /*
+     * See Opcode::getRegisterCompare
+     */
+    virtual bool getRegisterCompare(uint& reg, uint32& value) const;
+
     /*
      * See Opcode::getAlterProperty
      */
@@ -143,9 +153,11 @@ public:
     virtual OpcodeSubsystems::DisassemblerType getType() const;
 
 private:
-    // The OpcodeFormatter is the only class for now which can get access to
-    // opcode's data.
+    // The OpcodeFormatter, its cache and the binary records writer are the
+    // only classes for now which can get access to opcode's data.
     friend class IA32IntelNotation;
+    friend class IA32RecordWriter;
+    friend class IA32FormattingCache;
 
     // The assembler type
     IA32eInstructionSet::DisassemblerTypes m_type;
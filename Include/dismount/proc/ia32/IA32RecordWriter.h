@@ -0,0 +1,153 @@
+#ifndef __TBA_DISMOUNT_PROC_IA32_IA32RECORDWRITER_H
+#define __TBA_DISMOUNT_PROC_IA32_IA32RECORDWRITER_H
+
+/*
+ * IA32RecordWriter.h
+ *
+ * Writes decoded ia32 instructions as binary disassembly records.
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/Opcode.h"
+#include "dismount/OpcodeSubsystems.h"
+#include "dismount/DisassemblyRecord.h"
+#include "dismount/proc/ia32/opcodeTable.h"
+#include "dismount/proc/ia32/IA32Opcode.h"
+
+/*
+ * Translates IA32Opcode objects into DisassemblyRecord::Record directly from
+ * the decoded fields, without OpcodeFormatter and without any string
+ * handling.
+ *
+ * The header and the string table (all the mnemonics of the opcode tables)
+ * are written in the constructor. The records are collected into a buffer
+ * and written when it is full, or upon 'flush'.
+ *
+ * Usage:
+ *     IA32RecordWriter writer(outputFile,
+ *                             OpcodeSubsystems::DISASSEMBLER_INTEL_32);
+ *     while (!disassembler->isEndOfStream())
+ *         writer.write(disassembler->next());
+ *     writer.flush();
+ *
+ * NOTE: This class is not thread-safe
+ */
+class IA32RecordWriter {
+public:
+    // The default number of records collected before writing
+    enum { DEFAULT_BUFFERED_RECORDS = 1024 };
+
+    /*
+     * Constructor. Writes the header and the string table.
+     *
+     * output          - The stream to write into. Must be kept alive while
+     *                   this object is used.
+     * processorType   - Either DISASSEMBLER_INTEL_16 or
+     *                   DISASSEMBLER_INTEL_32
+     * bufferedRecords - The number of records collected before writing
+     */
+    IA32RecordWriter(basicOutput& output,
+                     OpcodeSubsystems::DisassemblerType processorType,
+                     uint bufferedRecords = DEFAULT_BUFFERED_RECORDS);
+
+    /*
+     * Adds a single instruction.
+     *
+     * opcode - Either an IA32Opcode or an InvalidOpcodeByte
+     *
+     * Throw exception for other opcode types.
+     */
+    void write(const OpcodePtr& opcode);
+
+    /*
+     * Writes all the collected records into the stream. Must be called after
+     * the last instruction.
+     */
+    void flush();
+
+    /*
+     * Return the number of records written so far
+     */
+    uint getRecordsCount() const;
+
+    /*
+     * Translates a single instruction into 'record'.
+     *
+     * opcode - The decoded instruction
+     * record - Will be filled with the instruction information
+     */
+    void translate(const IA32Opcode& opcode,
+                   DisassemblyRecord::Record& record) const;
+
+private:
+    // Deny copy-constructor and operator =
+    IA32RecordWriter(const IA32RecordWriter& other);
+    IA32RecordWriter& operator = (const IA32RecordWriter& other);
+
+    /*
+     * Builds the string table and the mnemonics ids, and writes the header
+     */
+    void writeHeader(OpcodeSubsystems::DisassemblerType processorType);
+
+    /*
+     * Fills a single operand of 'opcode'
+     */
+    void translateOperand(const IA32Opcode& opcode,
+                          ia32dis::OperandType type,
+                          DisassemblyRecord::Operand& operand,
+                          DisassemblyRecord::Record& record) const;
+
+    /*
+     * Fills a ModR/M operand, either memory or register
+     */
+    void translateModrm(const IA32Opcode& opcode,
+                        ia32dis::OperandType type,
+                        DisassemblyRecord::Operand& operand) const;
+
+    /*
+     * Fills a relative branch operand and the record branch target
+     *
+     * relative - The distance from the end of the instruction
+     */
+    void translateBranch(const IA32Opcode& opcode,
+                         int64 relative,
+                         DisassemblyRecord::Operand& operand,
+                         DisassemblyRecord::Record& record) const;
+
+    /*
+     * Return the register id of a register in a set.
+     * See DisassemblyRecord::REGISTER_SET_*
+     */
+    static uint8 getRegister(uint set, uint number);
+
+    /*
+     * Return the register set of the general purpose registers of 'size'
+     */
+    static uint getGPSet(IntegerEncoding::IntegerEncodingType size);
+
+    /*
+     * Return the segment register id of the segment override prefix, or
+     * REGISTER_NONE
+     */
+    static uint8 getSegmentOverride(const IA32Opcode& opcode);
+
+    // The stream
+    basicOutput& m_output;
+    // The mnemonic id of each opcode entry and spelling:
+    //     [entry-index * MNEMONIC_VARIANTS_COUNT + variant]
+    // See ia32dis::getOpcodeEntryIndex
+    cSArray<uint32> m_mnemonics;
+    // The mnemonic id of invalid bytes
+    uint32 m_invalidMnemonic;
+    // The collected records and thier count
+    cSArray<DisassemblyRecord::Record> m_records;
+    uint m_used;
+    // The number of records written
+    uint m_count;
+};
+
+#endif // __TBA_DISMOUNT_PROC_IA32_IA32RECORDWRITER_H
@@ -20,6 +20,7 @@
 #include "dismount/proc/ia32/opcodeTable.h"
 #include "dismount/proc/ia32/IA32eInstructionSet.h"
 #include "dismount/proc/ia32/IA32OpcodeDatastruct.h"
+#include "dismount/proc/ia32/IA32FormattingCache.h"
 
 /*
  * The disassembler implementation to x86 processors.
@@ -97,6 +98,9 @@ public:
 
     /*
      * See StreamDisassembler::getOpcodeFormat
+     *
+     * If a formatting cache was set and 'dataFormatter' is the data-formatter
+     * of the cache, the returned formatter uses the cache.
      */
     virtual OpcodeFormatterPtr getOpcodeFormat(
         const OpcodePtr& instruction,
@@ -111,6 +115,12 @@ public:
      */
     virtual OpcodeSubsystems::DisassemblerType getType() const;
 
+    /*
+     * Sets the formatting cache used by 'getOpcodeFormat'. An empty pointer
+     * disables the cache. See IA32FormattingCache.
+     */
+    void setFormattingCache(const IA32FormattingCachePtr& formattingCache);
+
 private:
     // The type of the instruction set
     IA32eInstructionSet::DisassemblerTypes m_type;
@@ -123,6 +133,8 @@ private:
     bool m_shouldUseAddress;
     // The address of the stream
     ProcessorAddress m_streamAddress;
+    // The formatting cache, or empty pointer
+    IA32FormattingCachePtr m_formattingCache;
 
     /*
      * Called each time the stream is about to be read bytes from, test that
@@ -339,6 +339,60 @@ extern const uint8 gIa32TwoByteEscapeCharacter;
 extern const uint8 gIa32FPUStartEscapeCharacter;
 extern const uint8 gIa32FPUEndEscapeCharacter;
 
+/*
+ * The different spellings of a single opcode name. See the symbols in
+ * OpcodeEntry::m_opcodeName
+ */
+typedef enum {
+    // The 16bit spelling (pusha, jcxz, movsw, cbw)
+    MNEMONIC_16BIT = 0,
+    // The 32bit spelling (pushad, jecxz, movsd, cwde)
+    MNEMONIC_32BIT = 1,
+    // The number of spellings stored for each entry
+    MNEMONIC_VARIANTS_COUNT = 2
+} MnemonicVariant;
+
+// The maximum length of a resolved opcode name, including the null-terminator
+enum { MAX_MNEMONIC_LENGTH = 16 };
+
+/*
+ * Returns the final name of an opcode, with all the '#d', '#e', '##' and '/'
+ * symbols already substituted according to 'variant'.
+ * The names are resolved once, together with the opcode tables, so the
+ * returned pointer is static and the call doesn't allocate.
+ *
+ * opcode  - An entry from one of the opcode tables above
+ * variant - The spelling to return
+ *
+ * Throw exception if 'opcode' doesn't belong to any of the opcode tables.
+ */
+const char* getResolvedOpcodeName(const OpcodeEntry* opcode,
+                                  MnemonicVariant variant);
+
+/*
+ * The opcode tables above viewed as a single sequence of entries: the one
+ * byte table, the two-bytes table and the FPU table, including thier
+ * OPCODEEOT markers. Used to attach information to opcode entries in flat
+ * arrays.
+ */
+
+/*
+ * Return the number of entries in all the opcode tables
+ */
+uint getOpcodeEntriesCount();
+
+/*
+ * Return the index of 'opcode' in the sequence.
+ * Throw exception if 'opcode' doesn't belong to any of the opcode tables.
+ */
+uint getOpcodeEntryIndex(const OpcodeEntry* opcode);
+
+/*
+ * Return the entry at 'index' in the sequence.
+ * Throw exception if 'index' is out of range.
+ */
+const OpcodeEntry* getOpcodeEntry(uint index);
+
 /*
  * A legacy prefix descriptor. Provide the name of the prefix (If there is one),
  * and the opcode number.
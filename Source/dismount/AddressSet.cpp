@@ -0,0 +1,84 @@
+#include "dismount/dismount.h"
+/*
+ * AddressSet.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/AddressSet.h"
+
+AddressSet::AddressSet() :
+    m_count(0),
+    m_isSorted(true)
+{
+}
+
+void AddressSet::add(addressNumericValue address)
+{
+    appendItem(m_addresses, m_count, address);
+    m_isSorted = false;
+}
+
+bool AddressSet::contains(addressNumericValue address)
+{
+    sort();
+    return containsSorted(address);
+}
+
+bool AddressSet::containsSorted(addressNumericValue address) const
+{
+    CHECK(m_isSorted);
+
+    // Binary search
+    uint low = 0;
+    uint high = m_count;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        if (m_addresses[middle] < address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return (low < m_count) && (m_addresses[low] == address);
+}
+
+uint AddressSet::getCount()
+{
+    sort();
+    return m_count;
+}
+
+addressNumericValue AddressSet::get(uint index)
+{
+    CHECK(index < getCount());
+    return m_addresses[index];
+}
+
+bool AddressSet::isBefore(const addressNumericValue& a,
+                          const addressNumericValue& b)
+{
+    return a < b;
+}
+
+void AddressSet::sort()
+{
+    if (m_isSorted)
+        return;
+
+    heapSort(m_addresses.getBuffer(), m_count, isBefore);
+    uint uniqueCount = 0;
+    for (uint i = 0; i < m_count; i++)
+    {
+        if ((uniqueCount > 0) && (m_addresses[uniqueCount - 1] == m_addresses[i]))
+            continue;
+        m_addresses[uniqueCount++] = m_addresses[i];
+    }
+    m_count = uniqueCount;
+    m_isSorted = true;
+}
@@ -0,0 +1,441 @@
+#include "dismount/dismount.h"
+/*
+ * CallGraph.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/CallGraph.h"
+
+CallGraph::CallGraph() :
+    m_functionsCount(0),
+    m_blockOffsets(1),
+    m_calleeOffsets(1),
+    m_callerOffsets(1),
+    m_callsCount(0),
+    m_sccOffsets(1),
+    m_sccsCount(0)
+{
+    m_blockOffsets[0] = 0;
+    m_calleeOffsets[0] = 0;
+    m_callerOffsets[0] = 0;
+    m_sccOffsets[0] = 0;
+}
+
+bool CallGraph::isAddressBefore(const addressNumericValue& a,
+                                const addressNumericValue& b)
+{
+    return a < b;
+}
+
+bool CallGraph::isCallBefore(const Call& a, const Call& b)
+{
+    if (a.m_caller != b.m_caller)
+        return a.m_caller < b.m_caller;
+    return a.m_callee < b.m_callee;
+}
+
+void CallGraph::build(const ControlFlowGraph& graph,
+                      const addressNumericValue* entryPoints,
+                      uint entryPointsCount)
+{
+    // Collect the function starts: the entry points and the call targets
+    cSArray<addressNumericValue> starts;
+    uint startsCount = 0;
+    for (uint i = 0; i < entryPointsCount; i++)
+        appendItem(starts, startsCount, entryPoints[i]);
+    for (uint block = 0; block < graph.getBlocksCount(); block++)
+    {
+        for (uint i = 0; i < graph.getSuccessorsCount(block); i++)
+        {
+            const ControlFlowGraph::Edge& edge = graph.getSuccessor(block, i);
+            if (ControlFlowGraph::EDGE_CALL == edge.m_kind)
+                appendItem(starts, startsCount,
+                           graph.getBlock(edge.m_block).m_start);
+        }
+    }
+    heapSort(starts.getBuffer(), startsCount, isAddressBefore);
+
+    // Keep the starts of blocks, once
+    m_functions.changeSize(startsCount);
+    m_functionsCount = 0;
+    for (uint i = 0; i < startsCount; i++)
+    {
+        if ((m_functionsCount > 0) &&
+            (m_functions[m_functionsCount - 1].m_start == starts[i]))
+            continue;
+        uint block = graph.findBlock(starts[i]);
+        if ((ControlFlowGraph::NO_BLOCK == block) ||
+            (graph.getBlock(block).m_start != starts[i]))
+            continue;
+
+        Function& function = m_functions[m_functionsCount++];
+        function.m_start = starts[i];
+        function.m_block = block;
+        function.m_scc = 0;
+    }
+
+    assignBlocks(graph);
+    buildCalls(graph);
+    buildSccs();
+}
+
+void CallGraph::assignBlocks(const ControlFlowGraph& graph)
+{
+    uint blocksCount = graph.getBlocksCount();
+    m_blockFunctions.changeSize(blocksCount);
+    for (uint block = 0; block < blocksCount; block++)
+        m_blockFunctions[block] = NO_FUNCTION;
+
+    // The start of a function always belongs to it
+    for (uint function = 0; function < m_functionsCount; function++)
+        m_blockFunctions[m_functions[function].m_block] = function;
+
+    // Walk the blocks reached from each function start, in the order of the
+    // start addresses. A block which is already owned stops the walk.
+    cSArray<uint> stack;
+    uint stackCount = 0;
+    for (uint function = 0; function < m_functionsCount; function++)
+    {
+        appendItem(stack, stackCount, m_functions[function].m_block);
+        while (stackCount > 0)
+        {
+            uint block = stack[--stackCount];
+            for (uint i = 0; i < graph.getSuccessorsCount(block); i++)
+            {
+                const ControlFlowGraph::Edge& edge = graph.getSuccessor(block, i);
+                if ((ControlFlowGraph::EDGE_CALL == edge.m_kind) ||
+                    (NO_FUNCTION != m_blockFunctions[edge.m_block]))
+                    continue;
+                m_blockFunctions[edge.m_block] = function;
+                appendItem(stack, stackCount, edge.m_block);
+            }
+        }
+    }
+
+    // Group the blocks by their function
+    m_blockOffsets.changeSize(m_functionsCount + 1);
+    for (uint function = 0; function <= m_functionsCount; function++)
+        m_blockOffsets[function] = 0;
+    uint ownedCount = 0;
+    for (uint block = 0; block < blocksCount; block++)
+    {
+        if (NO_FUNCTION == m_blockFunctions[block])
+            continue;
+        m_blockOffsets[m_blockFunctions[block] + 1]++;
+        ownedCount++;
+    }
+    for (uint function = 0; function < m_functionsCount; function++)
+        m_blockOffsets[function + 1] += m_blockOffsets[function];
+
+    m_blocks.changeSize(ownedCount);
+    cSArray<uint> positions(m_functionsCount);
+    for (uint function = 0; function < m_functionsCount; function++)
+        positions[function] = m_blockOffsets[function];
+    for (uint block = 0; block < blocksCount; block++)
+    {
+        if (NO_FUNCTION == m_blockFunctions[block])
+            continue;
+        m_blocks[positions[m_blockFunctions[block]]++] = block;
+    }
+}
+
+void CallGraph::buildCalls(const ControlFlowGraph& graph)
+{
+    // Collect the calls of the owned blocks: the call edges, and the jumps
+    // and fall-throughs into the start of another function
+    cSArray<Call> calls;
+    uint callsCount = 0;
+    for (uint i = 0; i < m_blocks.getSize(); i++)
+    {
+        uint block = m_blocks[i];
+        uint caller = m_blockFunctions[block];
+        for (uint j = 0; j < graph.getSuccessorsCount(block); j++)
+        {
+            const ControlFlowGraph::Edge& edge = graph.getSuccessor(block, j);
+            uint callee = m_blockFunctions[edge.m_block];
+            if ((NO_FUNCTION == callee) ||
+                (m_functions[callee].m_block != edge.m_block))
+                continue;
+            if ((ControlFlowGraph::EDGE_CALL != edge.m_kind) &&
+                (callee == caller))
+                // A loop back into the start of the function
+                continue;
+
+            Call call;
+            call.m_caller = caller;
+            call.m_callee = callee;
+            appendItem(calls, callsCount, call);
+        }
+    }
+
+    // Sort and remove the duplicated calls
+    heapSort(calls.getBuffer(), callsCount, isCallBefore);
+    m_callsCount = 0;
+    for (uint i = 0; i < callsCount; i++)
+    {
+        if ((m_callsCount > 0) &&
+            (calls[m_callsCount - 1].m_caller == calls[i].m_caller) &&
+            (calls[m_callsCount - 1].m_callee == calls[i].m_callee))
+            continue;
+        calls[m_callsCount++] = calls[i];
+    }
+
+    // Fill the CSR arrays. The calls are sorted by the caller, so the callees
+    // are in order, and the callers are appended in order.
+    m_calleeOffsets.changeSize(m_functionsCount + 1);
+    m_callerOffsets.changeSize(m_functionsCount + 1);
+    for (uint function = 0; function <= m_functionsCount; function++)
+    {
+        m_calleeOffsets[function] = 0;
+        m_callerOffsets[function] = 0;
+    }
+    for (uint i = 0; i < m_callsCount; i++)
+    {
+        m_calleeOffsets[calls[i].m_caller + 1]++;
+        m_callerOffsets[calls[i].m_callee + 1]++;
+    }
+    for (uint function = 0; function < m_functionsCount; function++)
+    {
+        m_calleeOffsets[function + 1] += m_calleeOffsets[function];
+        m_callerOffsets[function + 1] += m_callerOffsets[function];
+    }
+
+    m_callees.changeSize(m_callsCount);
+    m_callers.changeSize(m_callsCount);
+    cSArray<uint> positions(m_functionsCount);
+    for (uint function = 0; function < m_functionsCount; function++)
+        positions[function] = m_callerOffsets[function];
+    for (uint i = 0; i < m_callsCount; i++)
+    {
+        m_callees[i] = calls[i].m_callee;
+        m_callers[positions[calls[i].m_callee]++] = calls[i].m_caller;
+    }
+}
+
+void CallGraph::buildSccs()
+{
+    // Tarjan's algorithm, with an explicit stack instead of recursion. An SCC
+    // is completed only after all the SCCs it calls, so the SCCs are numbered
+    // in bottom-up order.
+    enum { NOT_VISITED = 0xFFFFFFFF };
+    cSArray<uint> indexes(m_functionsCount);
+    cSArray<uint> lowLinks(m_functionsCount);
+    cSArray<uint8> isOnStack(m_functionsCount);
+    for (uint function = 0; function < m_functionsCount; function++)
+    {
+        indexes[function] = NOT_VISITED;
+        isOnStack[function] = 0;
+    }
+
+    // The functions of the SCCs which aren't completed yet
+    cSArray<uint> stack(m_functionsCount);
+    uint stackCount = 0;
+    // The functions being visited, and the next callee of each
+    cSArray<uint> visitFunctions(m_functionsCount);
+    cSArray<uint> visitCallees(m_functionsCount);
+    uint visitCount = 0;
+
+    m_sccFunctions.changeSize(m_functionsCount);
+    m_sccOffsets.changeSize(m_functionsCount + 1);
+    m_sccOffsets[0] = 0;
+    m_sccsCount = 0;
+    uint sccFunctionsCount = 0;
+    uint nextIndex = 0;
+
+    for (uint root = 0; root < m_functionsCount; root++)
+    {
+        if (NOT_VISITED != indexes[root])
+            continue;
+
+        indexes[root] = lowLinks[root] = nextIndex++;
+        stack[stackCount++] = root;
+        isOnStack[root] = 1;
+        visitFunctions[visitCount] = root;
+        visitCallees[visitCount] = m_calleeOffsets[root];
+        visitCount++;
+
+        while (visitCount > 0)
+        {
+            uint function = visitFunctions[visitCount - 1];
+            uint& callee = visitCallees[visitCount - 1];
+            if (callee < m_calleeOffsets[function + 1])
+            {
+                uint next = m_callees[callee++];
+                if (NOT_VISITED == indexes[next])
+                {
+                    // Visit the callee
+                    indexes[next] = lowLinks[next] = nextIndex++;
+                    stack[stackCount++] = next;
+                    isOnStack[next] = 1;
+                    visitFunctions[visitCount] = next;
+                    visitCallees[visitCount] = m_calleeOffsets[next];
+                    visitCount++;
+                }
+                else if (0 != isOnStack[next])
+                    lowLinks[function] = t_min(lowLinks[function], indexes[next]);
+                continue;
+            }
+
+            // All the callees were visited
+            visitCount--;
+            if (lowLinks[function] == indexes[function])
+            {
+                // 'function' is the root of an SCC, pop it
+                uint member;
+                do
+                {
+                    member = stack[--stackCount];
+                    isOnStack[member] = 0;
+                    m_functions[member].m_scc = m_sccsCount;
+                    m_sccFunctions[sccFunctionsCount++] = member;
+                } while (member != function);
+                m_sccsCount++;
+                m_sccOffsets[m_sccsCount] = sccFunctionsCount;
+            }
+            if (visitCount > 0)
+            {
+                uint caller = visitFunctions[visitCount - 1];
+                lowLinks[caller] = t_min(lowLinks[caller], lowLinks[function]);
+            }
+        }
+    }
+
+    // The levels. The callees of an SCC are in lower SCCs, which already have
+    // their levels.
+    m_sccLevels.changeSize(m_sccsCount);
+    for (uint scc = 0; scc < m_sccsCount; scc++)
+    {
+        uint level = 0;
+        for (uint i = m_sccOffsets[scc]; i < m_sccOffsets[scc + 1]; i++)
+        {
+            uint function = m_sccFunctions[i];
+            for (uint j = m_calleeOffsets[function];
+                 j < m_calleeOffsets[function + 1];
+                 j++)
+            {
+                uint calleeScc = m_functions[m_callees[j]].m_scc;
+                if (calleeScc != scc)
+                    level = t_max(level, m_sccLevels[calleeScc] + 1);
+            }
+        }
+        m_sccLevels[scc] = level;
+    }
+}
+
+uint CallGraph::getFunctionsCount() const
+{
+    return m_functionsCount;
+}
+
+const CallGraph::Function& CallGraph::getFunction(uint index) const
+{
+    CHECK(index < m_functionsCount);
+    return m_functions[index];
+}
+
+uint CallGraph::findFunction(addressNumericValue address) const
+{
+    uint low = 0;
+    uint high = m_functionsCount;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        if (m_functions[middle].m_start < address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if ((low == m_functionsCount) || (m_functions[low].m_start != address))
+        return NO_FUNCTION;
+    return low;
+}
+
+uint CallGraph::getBlockFunction(uint block) const
+{
+    CHECK(block < m_blockFunctions.getSize());
+    return m_blockFunctions[block];
+}
+
+uint CallGraph::getFunctionBlocksCount(uint index) const
+{
+    CHECK(index < m_functionsCount);
+    return m_blockOffsets[index + 1] - m_blockOffsets[index];
+}
+
+uint CallGraph::getFunctionBlock(uint index, uint i) const
+{
+    CHECK(i < getFunctionBlocksCount(index));
+    return m_blocks[m_blockOffsets[index] + i];
+}
+
+uint CallGraph::getCallsCount() const
+{
+    return m_callsCount;
+}
+
+uint CallGraph::getCalleesCount(uint index) const
+{
+    CHECK(index < m_functionsCount);
+    return m_calleeOffsets[index + 1] - m_calleeOffsets[index];
+}
+
+uint CallGraph::getCallee(uint index, uint i) const
+{
+    CHECK(i < getCalleesCount(index));
+    return m_callees[m_calleeOffsets[index] + i];
+}
+
+uint CallGraph::getCallersCount(uint index) const
+{
+    CHECK(index < m_functionsCount);
+    return m_callerOffsets[index + 1] - m_callerOffsets[index];
+}
+
+uint CallGraph::getCaller(uint index, uint i) const
+{
+    CHECK(i < getCallersCount(index));
+    return m_callers[m_callerOffsets[index] + i];
+}
+
+uint CallGraph::getSccsCount() const
+{
+    return m_sccsCount;
+}
+
+uint CallGraph::getSccFunctionsCount(uint scc) const
+{
+    CHECK(scc < m_sccsCount);
+    return m_sccOffsets[scc + 1] - m_sccOffsets[scc];
+}
+
+uint CallGraph::getSccFunction(uint scc, uint i) const
+{
+    CHECK(i < getSccFunctionsCount(scc));
+    return m_sccFunctions[m_sccOffsets[scc] + i];
+}
+
+uint CallGraph::getSccLevel(uint scc) const
+{
+    CHECK(scc < m_sccsCount);
+    return m_sccLevels[scc];
+}
+
+bool CallGraph::isSccRecursive(uint scc) const
+{
+    if (getSccFunctionsCount(scc) > 1)
+        return true;
+
+    uint function = getSccFunction(scc, 0);
+    for (uint i = 0; i < getCalleesCount(function); i++)
+    {
+        if (getCallee(function, i) == function)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,354 @@
+#include "dismount/dismount.h"
+/*
+ * ControlFlowGraph.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/ControlFlowGraph.h"
+
+ControlFlowGraph::Records::Records() :
+    m_blocksCount(0),
+    m_edgesCount(0)
+{
+}
+
+void ControlFlowGraph::Records::clear()
+{
+    m_blocksCount = 0;
+    m_edgesCount = 0;
+}
+
+void ControlFlowGraph::Records::addBlock(addressNumericValue start,
+                                         addressNumericValue end)
+{
+    if (end <= start)
+        return;
+
+    BlockRecord block;
+    block.m_start = start;
+    block.m_end = end;
+    appendItem(m_blocks, m_blocksCount, block);
+}
+
+void ControlFlowGraph::Records::addEdge(addressNumericValue source,
+                                        addressNumericValue target,
+                                        uint kind)
+{
+    EdgeRecord edge;
+    edge.m_source = source;
+    edge.m_target = target;
+    edge.m_kind = kind;
+    appendItem(m_edges, m_edgesCount, edge);
+}
+
+uint ControlFlowGraph::Records::getBlocksCount() const
+{
+    return m_blocksCount;
+}
+
+uint ControlFlowGraph::Records::getEdgesCount() const
+{
+    return m_edgesCount;
+}
+
+const ControlFlowGraph::BlockRecord& ControlFlowGraph::Records::getBlock(uint index) const
+{
+    CHECK(index < m_blocksCount);
+    return m_blocks[index];
+}
+
+const ControlFlowGraph::EdgeRecord& ControlFlowGraph::Records::getEdge(uint index) const
+{
+    CHECK(index < m_edgesCount);
+    return m_edges[index];
+}
+
+void ControlFlowGraph::Records::truncate(uint blocksCount, uint edgesCount)
+{
+    CHECK((blocksCount <= m_blocksCount) && (edgesCount <= m_edgesCount));
+    m_blocksCount = blocksCount;
+    m_edgesCount = edgesCount;
+}
+
+void ControlFlowGraph::Records::append(const Records& other,
+                                       uint firstBlock,
+                                       uint blocksCount,
+                                       uint firstEdge,
+                                       uint edgesCount)
+{
+    CHECK((firstBlock <= other.m_blocksCount) &&
+          (blocksCount <= (other.m_blocksCount - firstBlock)));
+    CHECK((firstEdge <= other.m_edgesCount) &&
+          (edgesCount <= (other.m_edgesCount - firstEdge)));
+
+    for (uint i = 0; i < blocksCount; i++)
+        appendItem(m_blocks, m_blocksCount, other.m_blocks[firstBlock + i]);
+    for (uint i = 0; i < edgesCount; i++)
+        appendItem(m_edges, m_edgesCount, other.m_edges[firstEdge + i]);
+}
+
+void ControlFlowGraph::Records::moveDown(uint firstBlock,
+                                         uint blocksCount,
+                                         uint toBlock,
+                                         uint firstEdge,
+                                         uint edgesCount,
+                                         uint toEdge)
+{
+    CHECK((firstBlock <= m_blocksCount) &&
+          (blocksCount <= (m_blocksCount - firstBlock)) &&
+          (toBlock <= firstBlock));
+    CHECK((firstEdge <= m_edgesCount) &&
+          (edgesCount <= (m_edgesCount - firstEdge)) &&
+          (toEdge <= firstEdge));
+
+    for (uint i = 0; i < blocksCount; i++)
+        m_blocks[toBlock + i] = m_blocks[firstBlock + i];
+    for (uint i = 0; i < edgesCount; i++)
+        m_edges[toEdge + i] = m_edges[firstEdge + i];
+}
+
+ControlFlowGraph::ControlFlowGraph() :
+    m_blocksCount(0),
+    m_successorOffsets(1),
+    m_predecessorOffsets(1),
+    m_edgesCount(0)
+{
+    m_successorOffsets[0] = 0;
+    m_predecessorOffsets[0] = 0;
+}
+
+bool ControlFlowGraph::isBlockBefore(const Block& a, const Block& b)
+{
+    if (a.m_start != b.m_start)
+        return a.m_start < b.m_start;
+    // The longest block first
+    return a.m_end > b.m_end;
+}
+
+bool ControlFlowGraph::isAddressBefore(const addressNumericValue& a,
+                                       const addressNumericValue& b)
+{
+    return a < b;
+}
+
+bool ControlFlowGraph::isEdgeBefore(const BlockEdge& a, const BlockEdge& b)
+{
+    if (a.m_from != b.m_from)
+        return a.m_from < b.m_from;
+    if (a.m_to != b.m_to)
+        return a.m_to < b.m_to;
+    return a.m_kind < b.m_kind;
+}
+
+void ControlFlowGraph::build(const Records& records,
+                             const PagedBitset& instructions)
+{
+    // Sort the walked blocks. A block inside another block (a walk which
+    // started in the middle of walked code) splits it, and the overlapping
+    // blocks (code which was decoded from two different offsets) are trimmed.
+    cSArray<Block> walked(t_max(records.getBlocksCount(), 1U));
+    uint walkedCount = 0;
+    cSArray<addressNumericValue> splits;
+    uint splitsCount = 0;
+    for (uint i = 0; i < records.getBlocksCount(); i++)
+    {
+        walked[i].m_start = records.getBlock(i).m_start;
+        walked[i].m_end = records.getBlock(i).m_end;
+    }
+    heapSort(walked.getBuffer(), records.getBlocksCount(), isBlockBefore);
+    for (uint i = 0; i < records.getBlocksCount(); i++)
+    {
+        if (walkedCount > 0)
+        {
+            Block& last = walked[walkedCount - 1];
+            if (walked[i].m_end <= last.m_end)
+            {
+                if (walked[i].m_start != last.m_start)
+                    appendItem(splits, splitsCount, walked[i].m_start);
+                continue;
+            }
+            if (walked[i].m_start < last.m_end)
+                last.m_end = walked[i].m_start;
+        }
+        walked[walkedCount++] = walked[i];
+    }
+    m_blocks = walked;
+    m_blocksCount = walkedCount;
+
+    // Find the targets in the middle of a block
+    for (uint i = 0; i < records.getEdgesCount(); i++)
+    {
+        addressNumericValue target = records.getEdge(i).m_target;
+        uint index = findBlock(target);
+        if ((NO_BLOCK != index) &&
+            (m_blocks[index].m_start != target) &&
+            instructions.isSet(target))
+            appendItem(splits, splitsCount, target);
+    }
+    heapSort(splits.getBuffer(), splitsCount, isAddressBefore);
+
+    // Split the blocks, and join the parts with fall-through edges
+    cSArray<BlockEdge> edges;
+    uint edgesCount = 0;
+    cSArray<Block> blocks(t_max(walkedCount + splitsCount, 1U));
+    uint blocksCount = 0;
+    uint split = 0;
+    for (uint i = 0; i < walkedCount; i++)
+    {
+        Block block = walked[i];
+        while ((split < splitsCount) && (splits[split] < block.m_end))
+        {
+            if (splits[split] > block.m_start)
+            {
+                BlockEdge edge;
+                edge.m_from = blocksCount;
+                edge.m_to = blocksCount + 1;
+                edge.m_kind = EDGE_FALLTHROUGH;
+                appendItem(edges, edgesCount, edge);
+
+                blocks[blocksCount].m_start = block.m_start;
+                blocks[blocksCount].m_end = splits[split];
+                blocksCount++;
+                block.m_start = splits[split];
+            }
+            split++;
+        }
+        blocks[blocksCount++] = block;
+    }
+    m_blocks = blocks;
+    m_blocksCount = blocksCount;
+
+    // Resolve the walked edges into blocks
+    for (uint i = 0; i < records.getEdgesCount(); i++)
+    {
+        const EdgeRecord& record = records.getEdge(i);
+        BlockEdge edge;
+        edge.m_from = findBlock(record.m_source);
+        edge.m_to = findBlockStart(record.m_target);
+        edge.m_kind = record.m_kind;
+        if ((NO_BLOCK == edge.m_from) || (NO_BLOCK == edge.m_to))
+            continue;
+        appendItem(edges, edgesCount, edge);
+    }
+
+    // Sort the edges by their source block and remove the duplicates
+    heapSort(edges.getBuffer(), edgesCount, isEdgeBefore);
+    uint uniqueCount = 0;
+    for (uint i = 0; i < edgesCount; i++)
+    {
+        if ((uniqueCount > 0) &&
+            (edges[uniqueCount - 1].m_from == edges[i].m_from) &&
+            (edges[uniqueCount - 1].m_to == edges[i].m_to) &&
+            (edges[uniqueCount - 1].m_kind == edges[i].m_kind))
+            continue;
+        edges[uniqueCount++] = edges[i];
+    }
+    m_edgesCount = uniqueCount;
+
+    // Count the edges of each block
+    m_successorOffsets.changeSize(m_blocksCount + 1);
+    m_predecessorOffsets.changeSize(m_blocksCount + 1);
+    for (uint i = 0; i <= m_blocksCount; i++)
+    {
+        m_successorOffsets[i] = 0;
+        m_predecessorOffsets[i] = 0;
+    }
+    for (uint i = 0; i < m_edgesCount; i++)
+    {
+        m_successorOffsets[edges[i].m_from + 1]++;
+        m_predecessorOffsets[edges[i].m_to + 1]++;
+    }
+    for (uint i = 0; i < m_blocksCount; i++)
+    {
+        m_successorOffsets[i + 1]+= m_successorOffsets[i];
+        m_predecessorOffsets[i + 1]+= m_predecessorOffsets[i];
+    }
+
+    // Fill the rows. The edges are sorted by the source block, so the
+    // predecessors of each block are sorted as well.
+    m_successors.changeSize(t_max(m_edgesCount, 1U));
+    m_predecessors.changeSize(t_max(m_edgesCount, 1U));
+    cSArray<uint> next(m_predecessorOffsets);
+    for (uint i = 0; i < m_edgesCount; i++)
+    {
+        m_successors[i].m_block = edges[i].m_to;
+        m_successors[i].m_kind = edges[i].m_kind;
+
+        uint position = next[edges[i].m_to]++;
+        m_predecessors[position].m_block = edges[i].m_from;
+        m_predecessors[position].m_kind = edges[i].m_kind;
+    }
+}
+
+uint ControlFlowGraph::getBlocksCount() const
+{
+    return m_blocksCount;
+}
+
+const ControlFlowGraph::Block& ControlFlowGraph::getBlock(uint index) const
+{
+    CHECK(index < m_blocksCount);
+    return m_blocks[index];
+}
+
+uint ControlFlowGraph::findBlock(addressNumericValue address) const
+{
+    // Find the last block which starts at or before 'address'
+    uint low = 0;
+    uint high = m_blocksCount;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        if (m_blocks[middle].m_start <= address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if ((0 == low) || (address >= m_blocks[low - 1].m_end))
+        return NO_BLOCK;
+    return low - 1;
+}
+
+uint ControlFlowGraph::findBlockStart(addressNumericValue address) const
+{
+    uint index = findBlock(address);
+    if ((NO_BLOCK == index) || (m_blocks[index].m_start != address))
+        return NO_BLOCK;
+    return index;
+}
+
+uint ControlFlowGraph::getEdgesCount() const
+{
+    return m_edgesCount;
+}
+
+uint ControlFlowGraph::getSuccessorsCount(uint index) const
+{
+    CHECK(index < m_blocksCount);
+    return m_successorOffsets[index + 1] - m_successorOffsets[index];
+}
+
+const ControlFlowGraph::Edge& ControlFlowGraph::getSuccessor(uint index, uint i) const
+{
+    CHECK(i < getSuccessorsCount(index));
+    return m_successors[m_successorOffsets[index] + i];
+}
+
+uint ControlFlowGraph::getPredecessorsCount(uint index) const
+{
+    CHECK(index < m_blocksCount);
+    return m_predecessorOffsets[index + 1] - m_predecessorOffsets[index];
+}
+
+const ControlFlowGraph::Edge& ControlFlowGraph::getPredecessor(uint index, uint i) const
+{
+    CHECK(i < getPredecessorsCount(index));
+    return m_predecessors[m_predecessorOffsets[index] + i];
+}
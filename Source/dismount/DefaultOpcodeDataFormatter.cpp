@@ -10,14 +10,95 @@
 #include "xStl/data/char.h"
 #include "xStl/data/string.h"
 #include "xStl/data/datastream.h"
+#include "xStl/except/assert.h"
 #include "dismount/DefaultOpcodeDataFormatter.h"
 
-const character DefaultOpcodeDataFormatter::m_hexadecimalSuffix =
-    XSTL_CHAR('h');
+// The two hexadecimal digits of each byte: gHexPairs[byte * 2]
+static const char gHexPairs[] =
+    "000102030405060708090A0B0C0D0E0F"
+    "101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F"
+    "303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F"
+    "505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F"
+    "707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F"
+    "909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+    "B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+    "D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+    "F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// Return the number of hexadecimal digits of a value, without leading zeros
+static uint getHexDigits(uint64 value)
+{
+    uint digits = 1;
+    while ((digits < 16) && ((value >> (digits * 4)) != 0))
+        digits++;
+    return digits;
+}
+
+DefaultOpcodeDataFormatter::DefaultOpcodeDataFormatter(
+        uint opcodeNameAlignment,
+        HexadecimalStyle hexadecimalStyle) :
+    m_opcodeNameAlignment(opcodeNameAlignment),
+    m_hexadecimalStyle(hexadecimalStyle)
+{
+}
+
+uint DefaultOpcodeDataFormatter::writeHex(character* buffer,
+                                          uint64 value,
+                                          uint digits,
+                                          HexadecimalStyle style,
+                                          bool isDecorated)
+{
+    ASSERT(digits <= 16);
+    if (digits == 0)
+        digits = getHexDigits(value);
+
+    character* position = buffer;
+    if (isDecorated && (style == HEX_PREFIX))
+    {
+        *(position++) = XSTL_CHAR('0');
+        *(position++) = XSTL_CHAR('x');
+    }
+
+    // Write the digits from the end, a byte at a time
+    character* digit = position + digits;
+    uint left = digits;
+    while (left >= 2)
+    {
+        const char* pair = gHexPairs + ((uint)(value & 0xFF) * 2);
+        *(--digit) = pair[1];
+        *(--digit) = pair[0];
+        value>>= 8;
+        left-= 2;
+    }
+    if (left > 0)
+        *(--digit) = gHexPairs[(uint)(value & 0xF) * 2 + 1];
+    position+= digits;
+
+    if (isDecorated && (style == HEX_SUFFIX))
+        *(position++) = XSTL_CHAR('h');
+    *position = XSTL_CHAR('\0');
+
+    return (uint)(position - buffer);
+}
+
+const char* DefaultOpcodeDataFormatter::getHexPair(uint8 value)
+{
+    return gHexPairs + ((uint)value * 2);
+}
 
-DefaultOpcodeDataFormatter::DefaultOpcodeDataFormatter(uint opcodeNameAlignment) :
-    m_opcodeNameAlignment(opcodeNameAlignment)
+cString DefaultOpcodeDataFormatter::translateHex(uint64 value,
+                                                 uint digits) const
 {
+    character buffer[MAX_HEX_LENGTH];
+    writeHex(buffer, value, digits, m_hexadecimalStyle);
+    return cString(buffer);
 }
 
 void DefaultOpcodeDataFormatter::newInstruction(bool,
@@ -32,33 +113,40 @@ cString DefaultOpcodeDataFormatter::endInstruction(const cString& instruction)
 
 cString DefaultOpcodeDataFormatter::translateUint8(uint8 data)
 {
-    return HEXBYTE(data) + m_hexadecimalSuffix;
+    return translateHex(data, 2);
 }
 
 cString DefaultOpcodeDataFormatter::translateUint16(uint16 data)
 {
-    return HEXWORD(data) + m_hexadecimalSuffix;
+    return translateHex(data, 4);
 }
 
 cString DefaultOpcodeDataFormatter::translateUint32(uint32 data)
 {
-    return HEXDWORD(data) + m_hexadecimalSuffix;
+    return translateHex(data, 8);
 }
 
 cString DefaultOpcodeDataFormatter::translateUint64(uint64 data)
 {
-    return HEXQWORD(data) + m_hexadecimalSuffix;
+    return translateHex(data, 16);
 }
 
 cString DefaultOpcodeDataFormatter::translateRelativeDisplacement(int64 displacement)
 {
+    // " - " or " + " followed by the number
+    character buffer[3 + MAX_HEX_LENGTH];
+    buffer[0] = XSTL_CHAR(' ');
+    buffer[2] = XSTL_CHAR(' ');
     if (displacement < 0)
     {
-        return cString(" - ") + HEXNUMBER((uint)(-displacement))  + m_hexadecimalSuffix;
+        buffer[1] = XSTL_CHAR('-');
+        writeHex(buffer + 3, (uint)(-displacement), 0, m_hexadecimalStyle);
     } else
     {
-        return cString(" + ") + HEXNUMBER((uint)displacement) + m_hexadecimalSuffix;
+        buffer[1] = XSTL_CHAR('+');
+        writeHex(buffer + 3, (uint)displacement, 0, m_hexadecimalStyle);
     }
+    return cString(buffer);
 }
 
 cString DefaultOpcodeDataFormatter::translateAbsoluteAddress(
@@ -67,15 +155,24 @@ cString DefaultOpcodeDataFormatter::translateAbsoluteAddress(
     switch (absoulte.getAddressType())
     {
     case ProcessorAddress::PROCESSOR_16:
-        return HEXWORD((uint16)absoulte.getAddress()) + m_hexadecimalSuffix;
+        return translateHex((uint16)absoulte.getAddress(), 4);
     case ProcessorAddress::PROCESSOR_20:
-        return HEXWORD((uint16)(absoulte.getAddress() >> 16)) +
-               ":" +
-               HEXWORD((uint16)(absoulte.getAddress() & 0xFFFF));
+        {
+            // SSSS:OOOO
+            character buffer[2 * MAX_HEX_LENGTH];
+            uint length = writeHex(buffer,
+                                   (uint16)(absoulte.getAddress() >> 16),
+                                   4, m_hexadecimalStyle, false);
+            buffer[length] = XSTL_CHAR(':');
+            writeHex(buffer + length + 1,
+                     (uint16)(absoulte.getAddress() & 0xFFFF),
+                     4, m_hexadecimalStyle, false);
+            return cString(buffer);
+        }
     case ProcessorAddress::PROCESSOR_32:
-        return HEXDWORD((uint32)absoulte.getAddress()) + m_hexadecimalSuffix;
+        return translateHex((uint32)absoulte.getAddress(), 8);
     case ProcessorAddress::PROCESSOR_64:
-        return HEXQWORD(absoulte.getAddress()) + m_hexadecimalSuffix;
+        return translateHex(absoulte.getAddress(), 16);
     default:
         CHECK_FAIL();
     }
@@ -90,13 +187,19 @@ cString DefaultOpcodeDataFormatter::translateRelativeAddress(
     if (isIpValid)
         return translateAbsoluteAddress(ip + relative);
 
-    // Show the relative address
-    cString ret;
-
+    // Show the relative address: $+XX or $-XX
+    character buffer[2 + MAX_HEX_LENGTH];
+    buffer[0] = XSTL_CHAR('$');
     if (relative >= 0)
-        return cString("$+") + HEXNUMBER((uint32)relative);
-    else
-        return cString("$-") + HEXNUMBER((uint32)(-relative));
+    {
+        buffer[1] = XSTL_CHAR('+');
+        writeHex(buffer + 2, (uint32)relative, 0, m_hexadecimalStyle, false);
+    } else
+    {
+        buffer[1] = XSTL_CHAR('-');
+        writeHex(buffer + 2, (uint32)(-relative), 0, m_hexadecimalStyle, false);
+    }
+    return cString(buffer);
 }
 
 cString DefaultOpcodeDataFormatter::getOpcodesSeparator(const cString&)
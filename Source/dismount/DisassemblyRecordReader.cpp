@@ -0,0 +1,72 @@
+#include "dismount/dismount.h"
+/*
+ * DisassemblyRecordReader.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/except/trace.h"
+#include "dismount/DisassemblyRecord.h"
+#include "dismount/DisassemblyRecordReader.h"
+
+DisassemblyRecordReader::DisassemblyRecordReader(const void* data, uint size)
+{
+    const uint8* start = (const uint8*)data;
+
+    CHECK(size >= sizeof(DisassemblyRecord::Header));
+    m_header = (const DisassemblyRecord::Header*)start;
+    CHECK(m_header->m_magic == DisassemblyRecord::MAGIC);
+    CHECK(m_header->m_version == DisassemblyRecord::VERSION);
+    CHECK(m_header->m_recordSize == sizeof(DisassemblyRecord::Record));
+
+    // The string table must be null-terminated and before the records. The
+    // offsets are checked one by one, so their sum can't wrap around.
+    CHECK(m_header->m_recordsOffset <= size);
+    CHECK(m_header->m_stringTableOffset >= sizeof(DisassemblyRecord::Header));
+    CHECK(m_header->m_stringTableOffset <= m_header->m_recordsOffset);
+    CHECK(m_header->m_stringTableSize > 0);
+    CHECK(m_header->m_stringTableSize <=
+          (m_header->m_recordsOffset - m_header->m_stringTableOffset));
+    m_stringTable = (const char*)(start + m_header->m_stringTableOffset);
+    CHECK(m_stringTable[m_header->m_stringTableSize - 1] == '\0');
+
+    // The records fill the rest of the file
+    CHECK((m_header->m_recordsOffset % DisassemblyRecord::RECORDS_ALIGNMENT) == 0);
+    CHECK(((size - m_header->m_recordsOffset) %
+           sizeof(DisassemblyRecord::Record)) == 0);
+    m_records = (const DisassemblyRecord::Record*)(start +
+                                                   m_header->m_recordsOffset);
+    m_recordsCount = (size - m_header->m_recordsOffset) /
+                     sizeof(DisassemblyRecord::Record);
+}
+
+const DisassemblyRecord::Header& DisassemblyRecordReader::getHeader() const
+{
+    return *m_header;
+}
+
+uint DisassemblyRecordReader::getRecordsCount() const
+{
+    return m_recordsCount;
+}
+
+const DisassemblyRecord::Record* DisassemblyRecordReader::getRecords() const
+{
+    return m_records;
+}
+
+const DisassemblyRecord::Record& DisassemblyRecordReader::getRecord(
+        uint index) const
+{
+    CHECK(index < m_recordsCount);
+    return m_records[index];
+}
+
+const char* DisassemblyRecordReader::getMnemonic(
+        const DisassemblyRecord::Record& record) const
+{
+    CHECK(record.m_mnemonic < m_header->m_stringTableSize);
+    return m_stringTable + record.m_mnemonic;
+}
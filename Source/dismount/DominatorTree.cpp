@@ -0,0 +1,347 @@
+#include "dismount/dismount.h"
+/*
+ * DominatorTree.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/DominatorTree.h"
+
+// Marks the blocks which weren't reached by the walk of their function flow
+enum { NOT_VISITED = 0xFFFFFFFF, IN_PROGRESS = 0xFFFFFFFE };
+
+DominatorTree::DominatorTree() :
+    m_loopsCount(0),
+    m_backEdgesCount(0),
+    m_orderCount(0),
+    m_nextPreorder(0),
+    m_nextPostorder(0)
+{
+}
+
+bool DominatorTree::isFunctionEdge(const CallGraph& callGraph,
+                                   const ControlFlowGraph::Edge& edge,
+                                   uint function)
+{
+    return (ControlFlowGraph::EDGE_CALL != edge.m_kind) &&
+           (callGraph.getBlockFunction(edge.m_block) == function);
+}
+
+void DominatorTree::build(const ControlFlowGraph& graph,
+                          const CallGraph& callGraph)
+{
+    uint blocksCount = graph.getBlocksCount();
+    m_idoms.changeSize(blocksCount);
+    m_preorder.changeSize(blocksCount);
+    m_postorder.changeSize(blocksCount);
+    m_depths.changeSize(blocksCount);
+    m_blockLoops.changeSize(blocksCount);
+    m_order.changeSize(blocksCount);
+    m_flowPostorder.changeSize(blocksCount);
+    m_stack.changeSize(blocksCount);
+    m_stackNext.changeSize(blocksCount);
+    m_firstChild.changeSize(blocksCount);
+    m_nextSibling.changeSize(blocksCount);
+    for (uint block = 0; block < blocksCount; block++)
+    {
+        m_idoms[block] = NO_BLOCK;
+        m_depths[block] = 0;
+        m_blockLoops[block] = NO_LOOP;
+        m_flowPostorder[block] = NOT_VISITED;
+        m_firstChild[block] = NO_BLOCK;
+        m_nextSibling[block] = NO_BLOCK;
+    }
+    m_loopsCount = 0;
+    m_backEdgesCount = 0;
+    m_nextPreorder = 0;
+    m_nextPostorder = 0;
+
+    for (uint function = 0; function < callGraph.getFunctionsCount(); function++)
+    {
+        buildFunctionDominators(graph, callGraph, function);
+        numberFunctionTree(callGraph.getFunction(function).m_block);
+        buildFunctionLoops(graph, callGraph, function);
+    }
+
+    // The blocks outside of the function flows dominate only themselves
+    for (uint block = 0; block < blocksCount; block++)
+    {
+        if (NOT_VISITED != m_flowPostorder[block])
+            continue;
+        m_preorder[block] = m_nextPreorder++;
+        m_postorder[block] = m_nextPostorder++;
+    }
+
+    // The inner loops come first, so the parent of a loop has its depth when
+    // the loops are scanned backward
+    for (uint i = m_loopsCount; i > 0; i--)
+    {
+        Loop& loop = m_loops[i - 1];
+        if (NO_LOOP == loop.m_parent)
+            loop.m_depth = 1;
+        else
+            loop.m_depth = m_loops[loop.m_parent].m_depth + 1;
+    }
+}
+
+void DominatorTree::buildFunctionDominators(const ControlFlowGraph& graph,
+                                            const CallGraph& callGraph,
+                                            uint function)
+{
+    uint entry = callGraph.getFunction(function).m_block;
+
+    // Walk the function flow from the entry block, and list the blocks in
+    // post-order
+    m_orderCount = 0;
+    uint nextPostorder = 0;
+    uint stackCount = 0;
+    m_stack[stackCount] = entry;
+    m_stackNext[stackCount] = 0;
+    stackCount++;
+    m_flowPostorder[entry] = IN_PROGRESS;
+    while (stackCount > 0)
+    {
+        uint block = m_stack[stackCount - 1];
+        uint& next = m_stackNext[stackCount - 1];
+        if (next < graph.getSuccessorsCount(block))
+        {
+            const ControlFlowGraph::Edge& edge = graph.getSuccessor(block, next++);
+            if (isFunctionEdge(callGraph, edge, function) &&
+                (NOT_VISITED == m_flowPostorder[edge.m_block]))
+            {
+                m_flowPostorder[edge.m_block] = IN_PROGRESS;
+                m_stack[stackCount] = edge.m_block;
+                m_stackNext[stackCount] = 0;
+                stackCount++;
+            }
+            continue;
+        }
+
+        stackCount--;
+        m_flowPostorder[block] = nextPostorder++;
+        m_order[m_orderCount++] = block;
+    }
+
+    // Cooper, Harvey and Kennedy: intersect the dominators of the processed
+    // predecessors, in reverse post-order, until nothing changes. The entry
+    // block is its own dominator while iterating.
+    m_idoms[entry] = entry;
+    bool isChanged = true;
+    while (isChanged)
+    {
+        isChanged = false;
+        for (uint i = m_orderCount; i > 0; i--)
+        {
+            uint block = m_order[i - 1];
+            if (block == entry)
+                continue;
+
+            uint newIdom = NO_BLOCK;
+            for (uint j = 0; j < graph.getPredecessorsCount(block); j++)
+            {
+                const ControlFlowGraph::Edge& edge = graph.getPredecessor(block, j);
+                if (!isFunctionEdge(callGraph, edge, function) ||
+                    (NO_BLOCK == m_idoms[edge.m_block]))
+                    continue;
+                if (NO_BLOCK == newIdom)
+                {
+                    newIdom = edge.m_block;
+                    continue;
+                }
+
+                // Walk up the tree from both blocks until they meet
+                uint finger1 = edge.m_block;
+                uint finger2 = newIdom;
+                while (finger1 != finger2)
+                {
+                    while (m_flowPostorder[finger1] < m_flowPostorder[finger2])
+                        finger1 = m_idoms[finger1];
+                    while (m_flowPostorder[finger2] < m_flowPostorder[finger1])
+                        finger2 = m_idoms[finger2];
+                }
+                newIdom = finger1;
+            }
+
+            if (m_idoms[block] != newIdom)
+            {
+                m_idoms[block] = newIdom;
+                isChanged = true;
+            }
+        }
+    }
+    m_idoms[entry] = NO_BLOCK;
+}
+
+void DominatorTree::numberFunctionTree(uint entry)
+{
+    // Link the children of each block, in post-order of the flow
+    for (uint i = m_orderCount; i > 0; i--)
+    {
+        uint block = m_order[i - 1];
+        uint idom = m_idoms[block];
+        if (NO_BLOCK == idom)
+            continue;
+        m_nextSibling[block] = m_firstChild[idom];
+        m_firstChild[idom] = block;
+    }
+
+    // Walk the tree
+    uint stackCount = 0;
+    m_stack[stackCount] = entry;
+    m_stackNext[stackCount] = m_firstChild[entry];
+    stackCount++;
+    m_preorder[entry] = m_nextPreorder++;
+    m_depths[entry] = 0;
+    while (stackCount > 0)
+    {
+        uint block = m_stack[stackCount - 1];
+        uint& child = m_stackNext[stackCount - 1];
+        if (NO_BLOCK != child)
+        {
+            uint next = child;
+            child = m_nextSibling[next];
+            m_preorder[next] = m_nextPreorder++;
+            m_depths[next] = m_depths[block] + 1;
+            m_stack[stackCount] = next;
+            m_stackNext[stackCount] = m_firstChild[next];
+            stackCount++;
+            continue;
+        }
+
+        stackCount--;
+        m_postorder[block] = m_nextPostorder++;
+    }
+}
+
+uint DominatorTree::getOutermostLoop(uint loop) const
+{
+    while (NO_LOOP != m_loops[loop].m_parent)
+        loop = m_loops[loop].m_parent;
+    return loop;
+}
+
+void DominatorTree::buildFunctionLoops(const ControlFlowGraph& graph,
+                                       const CallGraph& callGraph,
+                                       uint function)
+{
+    // A header dominates the headers of the loops inside its loop, so in
+    // post-order the inner loops are found first
+    for (uint i = 0; i < m_orderCount; i++)
+    {
+        uint header = m_order[i];
+
+        // Collect the back edges into the header
+        uint worklistCount = 0;
+        for (uint j = 0; j < graph.getPredecessorsCount(header); j++)
+        {
+            const ControlFlowGraph::Edge& edge = graph.getPredecessor(header, j);
+            if (!isFunctionEdge(callGraph, edge, function) ||
+                (NOT_VISITED == m_flowPostorder[edge.m_block]) ||
+                !dominates(header, edge.m_block))
+                continue;
+
+            BackEdge backEdge;
+            backEdge.m_source = edge.m_block;
+            backEdge.m_header = header;
+            appendItem(m_backEdges, m_backEdgesCount, backEdge);
+            appendItem(m_worklist, worklistCount, edge.m_block);
+        }
+        if (0 == worklistCount)
+            continue;
+
+        Loop newLoop;
+        newLoop.m_header = header;
+        newLoop.m_parent = NO_LOOP;
+        newLoop.m_depth = 0;
+        newLoop.m_function = function;
+        uint loop = m_loopsCount;
+        appendItem(m_loops, m_loopsCount, newLoop);
+        m_blockLoops[header] = loop;
+
+        // Walk backward from the back edges to the header. A block of an
+        // inner loop makes the inner loop a child, and the walk continues
+        // from the inner loop header.
+        while (worklistCount > 0)
+        {
+            uint block = m_worklist[--worklistCount];
+            if (NO_LOOP == m_blockLoops[block])
+                m_blockLoops[block] = loop;
+            else
+            {
+                uint inner = getOutermostLoop(m_blockLoops[block]);
+                if (inner == loop)
+                    continue;
+                m_loops[inner].m_parent = loop;
+                block = m_loops[inner].m_header;
+            }
+
+            for (uint j = 0; j < graph.getPredecessorsCount(block); j++)
+            {
+                const ControlFlowGraph::Edge& edge = graph.getPredecessor(block, j);
+                if (isFunctionEdge(callGraph, edge, function) &&
+                    (NOT_VISITED != m_flowPostorder[edge.m_block]))
+                    appendItem(m_worklist, worklistCount, edge.m_block);
+            }
+        }
+    }
+}
+
+uint DominatorTree::getImmediateDominator(uint block) const
+{
+    CHECK(block < m_idoms.getSize());
+    return m_idoms[block];
+}
+
+bool DominatorTree::dominates(uint dominator, uint block) const
+{
+    CHECK((dominator < m_preorder.getSize()) && (block < m_preorder.getSize()));
+    return (m_preorder[dominator] <= m_preorder[block]) &&
+           (m_postorder[block] <= m_postorder[dominator]);
+}
+
+uint DominatorTree::getDominatorDepth(uint block) const
+{
+    CHECK(block < m_depths.getSize());
+    return m_depths[block];
+}
+
+uint DominatorTree::getLoopsCount() const
+{
+    return m_loopsCount;
+}
+
+const DominatorTree::Loop& DominatorTree::getLoop(uint index) const
+{
+    CHECK(index < m_loopsCount);
+    return m_loops[index];
+}
+
+uint DominatorTree::getBlockLoop(uint block) const
+{
+    CHECK(block < m_blockLoops.getSize());
+    return m_blockLoops[block];
+}
+
+uint DominatorTree::getLoopDepth(uint block) const
+{
+    uint loop = getBlockLoop(block);
+    if (NO_LOOP == loop)
+        return 0;
+    return m_loops[loop].m_depth;
+}
+
+uint DominatorTree::getBackEdgesCount() const
+{
+    return m_backEdgesCount;
+}
+
+const DominatorTree::BackEdge& DominatorTree::getBackEdge(uint index) const
+{
+    CHECK(index < m_backEdgesCount);
+    return m_backEdges[index];
+}
@@ -9,12 +9,24 @@
 #include "xStl/stream/ioStream.h"
 #include "xStl/stream/fileStream.h"
 #include "xStl/data/datastream.h"
+#include "xStl/data/endian.h"
+#include "xStl/os/os.h"
 #include "xStl/../../tests/tests.h"
+#include "dismount/ArrayUtils.h"
 #include "dismount/FlowMapper.h"
 #include "dismount/FlowMapperException.h"
+#include "dismount/MapListFile.h"
+#include "dismount/MapListReader.h"
+#include "dismount/proc/ia32/IA32IntelNotation.h"
+
+// The initial size of the potential subsets array and index
+enum { POTENTIAL_INITIAL_SIZE = 64 };
+
+// The number of subsets in each read and write of a map list file
+enum { MAP_LIST_CHUNK_SUBSETS = 4096 };
 
 FlowMapper::MapAction FlowMapper::handleSingleOpcode(OpcodePtr& opcode,
-                                                     WalkParametersStackObjectPtr& saveStack,
+                                                     WalkParametersStackObject& saveStack,
                                                      const ProcessorAddress& startAddress,
                                                      const ProcessorAddress& forcedEndAddress,
                                                      const bool isFaultTolerant /* = false */)
@@ -77,6 +89,13 @@ FlowMapper::MapAction FlowMapper::handleSingleOpcode(OpcodePtr& opcode,
     if(!isExecutable(currAddress))
         return FlowMapper::MAP_BREAK;
 
+    // Add the instruction to the current graph block
+    m_graphLastInstruction = currAddress.getAddress();
+    m_graphBlockEnd = m_graphLastInstruction + opcode->getOpcodeSize();
+
+    // Track the bound check of a switch statement
+    uint switchEntriesCount = m_switchGuard.update(opcode);
+
     // Check if this is a flow altering opcode
     if (opcode->isBranch())
     {
@@ -106,22 +125,64 @@ FlowMapper::MapAction FlowMapper::handleSingleOpcode(OpcodePtr& opcode,
             ((Opcode::FLOW_COND_ALWAYS | Opcode::FLOW_ACTION) == opcode->getAlterProperty()))
             jmpAlways = true;
 
+        // The kind of the graph edge into the jump address
+        uint edgeKind = ControlFlowGraph::EDGE_CONDITIONAL;
+        if (opcode->isSwitch())
+            edgeKind = ControlFlowGraph::EDGE_SWITCH;
+        else if (Opcode::FLOW_STACK_CHANGE & opcode->getAlterProperty())
+            edgeKind = ControlFlowGraph::EDGE_CALL;
+        else if (jmpAlways)
+            edgeKind = ControlFlowGraph::EDGE_UNCONDITIONAL;
+
         // For JMPs belonging to a switch statement: Make sure we don't analyze the jump table
         if (opcode->isSwitch())
-            markVisited(ProcessorAddress(ProcessorAddress::PROCESSOR_32,
-                                         opcode->getSwitchTableOffset() - m_memoryInterface->getImageBase()));
+        {
+            ProcessorAddress tableAddress(ProcessorAddress::PROCESSOR_32,
+                                          opcode->getSwitchTableOffset() - m_memoryInterface->getImageBase());
+            markVisited(tableAddress);
+            m_walkXrefs.add(currAddress.getAddress(),
+                            tableAddress.getAddress(),
+                            XrefIndex::XREF_SWITCH_TABLE);
+
+            // Walk the targets of the table entries
+            XSTL_TRY
+            {
+                resolveSwitchTable(opcode,
+                                   currAddress,
+                                   tableAddress,
+                                   switchEntriesCount,
+                                   saveStack);
+            }
+            XSTL_CATCH(cException& e)
+            {
+                if (isFaultTolerant)
+                    return FlowMapper::MAP_QUIT_INVALID;
+                throw(e);
+            }
+        }
 
         // Get the address to jump to from the opcode operand
-        OpcodeFormatterPtr opcodeFormatter = m_disassembler->getOpcodeFormat(opcode, *m_formatter);
+        // (The notation is on the stack, to avoid an allocation for each branch)
         ProcessorAddress jmpAddress(gNullPointerProcessorAddress);
-        uint operandType = opcodeFormatter->parseOperandAddress(jmpAddress);
+        uint operandType = IA32IntelNotation(opcode, *m_formatter).parseOperandAddress(jmpAddress);
+
+        // Calls to functions which don't return end the block like a JMP
+        bool isCall = (0 != (Opcode::FLOW_STACK_CHANGE & opcode->getAlterProperty()));
 
         // Check if the 'relocated' address is in a writable section
         if (ia32dis::OPND_MODRM_dWORDPTR == operandType)
         {
+            ProcessorAddress pointerAddress(ProcessorAddress::PROCESSOR_32,
+                                            jmpAddress.getAddress() - m_memoryInterface->getImageBase());
+            if (!opcode->isSwitch())
+                m_walkXrefs.add(currAddress.getAddress(),
+                                pointerAddress.getAddress(),
+                                XrefIndex::XREF_THUNK);
+            if (isCall && isNoReturn(pointerAddress.getAddress()))
+                jmpAlways = true;
+
             // If it is, omit the destination address (We only use the caller address)
-            if (isWritable(ProcessorAddress(ProcessorAddress::PROCESSOR_32,
-                                            jmpAddress.getAddress() - m_memoryInterface->getImageBase())))
+            if (isWritable(pointerAddress))
                 jmpAddress.setAddress(0);
             else
             {
@@ -137,6 +198,15 @@ FlowMapper::MapAction FlowMapper::handleSingleOpcode(OpcodePtr& opcode,
            visited the address before - we treat it
            like a normal opcode and continue on.
            (Break if this is an unconditional JMP) */
+        if (0 != jmpAddress.getAddress())
+        {
+            m_walkXrefs.add(currAddress.getAddress(),
+                            jmpAddress.getAddress(),
+                            isCall ? XrefIndex::XREF_CALL : XrefIndex::XREF_JUMP);
+            if (isCall && isNoReturn(jmpAddress.getAddress()))
+                jmpAlways = true;
+        }
+
         XSTL_TRY
         {
             if ((0 != jmpAddress.getAddress()) &&
@@ -155,43 +225,19 @@ FlowMapper::MapAction FlowMapper::handleSingleOpcode(OpcodePtr& opcode,
             throw(e);
         }
 
+        // Record the graph edge, whether the address was visited or not
+        if (0 != jmpAddress.getAddress())
+            m_walkRecords.addEdge(currAddress.getAddress(),
+                                  jmpAddress.getAddress(),
+                                  edgeKind);
+
         // Check if we visited the address before
         XSTL_TRY
         {
             if ((0 != jmpAddress.getAddress()) && isVisited(jmpAddress))
             {
-                // If we have potential subsets
-                if (0 != m_potentialSubsets.length())
-                {
-                    // Search the jump address in the potential list
-                    cList<CodeSubset>::iterator subsetIter = m_potentialSubsets.begin();
-                    cList<WalkParametersStackObjectPtr>::iterator stackIter = m_potentialStacks.begin();
-                    for (; subsetIter != m_potentialSubsets.end(); subsetIter++, stackIter++)
-                    {
-                        if (jmpAddress == (*subsetIter).m_startAddress)
-                        {
-                            // We found the address, append it to the subset list
-                            m_tempListMap.append(*subsetIter);
-                            m_potentialSubsets.remove(subsetIter);
-
-                            while(!(*stackIter)->isEmpty())
-                            {
-                                // Get the current walk parameters from the top of the stack
-                                ProcessorAddress dummyAddress(gNullPointerProcessorAddress);
-                                JumpInstruction currWalkParameters(dummyAddress,
-                                                                   dummyAddress,
-                                                                   OpcodePtr(),
-                                                                   dummyAddress);
-                                (*stackIter)->pop(currWalkParameters);
-
-                                // Push the walk parameters to the actual global stack
-                                m_walkStack.push(currWalkParameters);
-                            }
-                            m_potentialStacks.remove(stackIter);
-                            break;
-                        }
-                    }
-                }
+                // Search the jump address in the potential subsets
+                promotePotentialSubset(jmpAddress.getAddress());
 
                 // Finally, continue on (Break if this is an unconditional JMP)
                 if (jmpAlways)
@@ -213,10 +259,10 @@ FlowMapper::MapAction FlowMapper::handleSingleOpcode(OpcodePtr& opcode,
             XSTL_THROW(FlowMapperException);
 
         // Mark a jump to the operand address
-        saveStack->push(JumpInstruction(jmpAddress,
-                                        nextOpcode,
-                                        opcode,
-                                        ProcessorAddress(gNullPointerProcessorAddress)));
+        saveStack.push(JumpInstruction(jmpAddress,
+                                       nextOpcode,
+                                       opcode,
+                                       ProcessorAddress(gNullPointerProcessorAddress)));
 
         // Finally, if this is an uncoditional JMP, end this block
         if (jmpAlways)
@@ -250,7 +296,14 @@ bool FlowMapper::walk(const ProcessorAddress& startAddress,
 
     OpcodePtr endOpcode;
     bool isPotential = false;
-    WalkParametersStackObjectPtr saveStack(new WalkParametersStackObject());
+    m_saveStack.clear();
+
+    // Start an empty graph block
+    m_walkRecords.clear();
+    m_walkXrefs.clear();
+    m_switchGuard.reset();
+    m_graphBlockStart = startAddress.getAddress();
+    m_graphBlockEnd = m_graphBlockStart;
 
     XSTL_TRY
     {
@@ -260,11 +313,23 @@ bool FlowMapper::walk(const ProcessorAddress& startAddress,
             // Read and parse the next opcode
             OpcodePtr opcode;
             FlowMapper::MapAction action = handleSingleOpcode(opcode,
-                                                              saveStack,
+                                                              m_saveStack,
                                                               startAddress,
                                                               forcedEndAddress,
                                                               isFaultTolerant);
 
+            // A flow altering instruction which doesn't end the walk ends the
+            // graph block, and falls through into the next one
+            if (((FlowMapper::MAP_NORMAL == action) ||
+                 (FlowMapper::MAP_CONTINUE == action)) &&
+                opcode->isBranch())
+            {
+                m_walkRecords.addEdge(m_graphLastInstruction,
+                                      m_graphBlockEnd,
+                                      ControlFlowGraph::EDGE_FALLTHROUGH);
+                endGraphBlock();
+            }
+
             // Decide what to do based on the returned action
             if (FlowMapper::MAP_BREAK == action)
             {
@@ -297,15 +362,26 @@ bool FlowMapper::walk(const ProcessorAddress& startAddress,
     if (!endOpcode->getOpcodeAddress(endAddress))
         XSTL_THROW(FlowMapperException);
 
+    // If the walk stopped at an instruction which isn't part of the block
+    // (visited code, the forced end), the block falls through into it
+    if ((m_graphBlockEnd != m_graphBlockStart) &&
+        (endAddress.getAddress() == m_graphBlockEnd))
+        m_walkRecords.addEdge(m_graphLastInstruction,
+                              m_graphBlockEnd,
+                              ControlFlowGraph::EDGE_FALLTHROUGH);
+    endGraphBlock();
+
     // Create new subset with the given bounds
     if (isPotential)
     {
-        m_potentialSubsets.append(CodeSubset(startAddress,
-                                             endAddress,
-                                             callerAddress,
-                                             endOpcode->getAlterProperty(),
-                                             callingOpcode->getAlterProperty()));
-        m_potentialStacks.append(saveStack);
+        addPotentialSubset(CodeSubset(startAddress,
+                                      endAddress,
+                                      callerAddress,
+                                      endOpcode->getAlterProperty(),
+                                      callingOpcode->getAlterProperty()),
+                           m_saveStack,
+                           m_walkRecords,
+                           m_walkXrefs);
     }
     else
     {
@@ -314,19 +390,12 @@ bool FlowMapper::walk(const ProcessorAddress& startAddress,
                                         callerAddress,
                                         endOpcode->getAlterProperty(),
                                         callingOpcode->getAlterProperty()));
-        while(!saveStack->isEmpty())
-        {
-            // Get the current walk parameters from the top of the stack
-            ProcessorAddress dummyAddress(gNullPointerProcessorAddress);
-            JumpInstruction currWalkParameters(dummyAddress,
-                                               dummyAddress,
-                                               OpcodePtr(),
-                                               dummyAddress);
-            saveStack->pop(currWalkParameters);
-
-            // Push the walk parameters to the actual global stack
-            m_walkStack.push(currWalkParameters);
-        }
+        // Push the walk parameters to the actual global stack
+        m_walkStack.splice(m_saveStack);
+        m_graphRecords.append(m_walkRecords,
+                              0, m_walkRecords.getBlocksCount(),
+                              0, m_walkRecords.getEdgesCount());
+        m_xrefRecords.append(m_walkXrefs, 0, m_walkXrefs.getCount());
     }
 
     return true;
@@ -340,18 +409,97 @@ uint FlowMapper::map(const addressNumericValue start,
     ProcessorAddress startProcessorAddress(ProcessorAddress::PROCESSOR_32, start);
     ProcessorAddress forcedEndAddress(ProcessorAddress::PROCESSOR_32, forcedEnd);
 
+    if (!mapEntryPoint(startProcessorAddress,
+                       forcedEndAddress,
+                       OpcodePtr(new InvalidOpcodeByte(
+                                     0,
+                                     true,
+                                     ProcessorAddress(gNullPointerProcessorAddress))),
+                       isFaultTolerant))
+        return 0;
+
+    return m_listMap.length() + m_streamedSubsetsCount;
+}
+
+uint FlowMapper::mapAll(const addresses& entryPoints,
+                        const bool isFaultTolerant /* = false */)
+{
+    // Copy the entry points into an array and sort them
+    cSArray<addressNumericValue> sortedEntryPoints(entryPoints.length());
+    uint count = 0;
+    for (addresses::iterator iter = entryPoints.begin();
+         iter != entryPoints.end();
+         iter++)
+        sortedEntryPoints[count++] = *iter;
+    sortAddresses(sortedEntryPoints.getBuffer(), count);
+
+    // Remove duplicated entry points
+    uint uniqueCount = 0;
+    for (uint i = 0; i < count; i++)
+    {
+        if ((uniqueCount > 0) &&
+            (sortedEntryPoints[uniqueCount - 1] == sortedEntryPoints[i]))
+            continue;
+        sortedEntryPoints[uniqueCount++] = sortedEntryPoints[i];
+    }
+
+    // All the entry points share the same (invalid) calling opcode
+    OpcodePtr callingOpcode(new InvalidOpcodeByte(
+                                0,
+                                true,
+                                ProcessorAddress(gNullPointerProcessorAddress)));
+
+    for (uint i = 0; i < uniqueCount; i++)
+    {
+        ProcessorAddress startAddress(ProcessorAddress::PROCESSOR_32,
+                                      sortedEntryPoints[i]);
+
+        // A walk from a visited address quits right away
+        if (isVisited(startAddress))
+            continue;
+
+        // Each entry point ends at the next one
+        addressNumericValue forcedEnd = 0;
+        if ((i + 1) < uniqueCount)
+            forcedEnd = sortedEntryPoints[i + 1];
+
+        mapEntryPoint(startAddress,
+                      ProcessorAddress(ProcessorAddress::PROCESSOR_32, forcedEnd),
+                      callingOpcode,
+                      isFaultTolerant);
+    }
+
+    return m_listMap.length() + m_streamedSubsetsCount;
+}
+
+bool FlowMapper::isEmpty() const
+{
+    return !m_isMapped && !m_isMapListLoaded;
+}
+
+bool FlowMapper::mapEntryPoint(const ProcessorAddress& start,
+                               const ProcessorAddress& forcedEnd,
+                               const OpcodePtr& callingOpcode,
+                               const bool isFaultTolerant)
+{
+    m_isMapped = true;
+
     // Clear data structures
     m_tempListMap.removeAll();
     m_walkStack.clear();
 
+    // The graph records of this entry point are thrown out on a fault
+    uint graphBlocksCount = m_graphRecords.getBlocksCount();
+    uint graphEdgesCount = m_graphRecords.getEdgesCount();
+    uint xrefsCount = m_xrefRecords.getCount();
+    m_isGraphBuilt = false;
+    m_isXrefIndexBuilt = false;
+
     // Push the initial walk parameters to the stack
-    m_walkStack.push(JumpInstruction(startProcessorAddress,
+    m_walkStack.push(JumpInstruction(start,
                                      ProcessorAddress(gNullPointerProcessorAddress),
-                                     OpcodePtr(new InvalidOpcodeByte(
-                                                   0,
-                                                   true,
-                                                   ProcessorAddress(gNullPointerProcessorAddress))),
-                                     forcedEndAddress));
+                                     callingOpcode,
+                                     forcedEnd));
 
     // Loop until the stack is empty
     while(!m_walkStack.isEmpty())
@@ -379,7 +527,34 @@ uint FlowMapper::map(const addressNumericValue start,
                  currWalkParameters.m_callingOpcode,
                  currWalkParameters.m_forcedEndAddress,
                  isFaultTolerant))
-            return 0;
+        {
+            m_graphRecords.truncate(graphBlocksCount, graphEdgesCount);
+            m_xrefRecords.truncate(xrefsCount);
+            if (NULL != m_visitor)
+                m_visitor->onInvalid(start, m_lastOpcode);
+            return false;
+        }
+    }
+
+    if (NULL != m_visitor)
+    {
+        // Stream the results of this address, and drop them
+        for (cList<CodeSubset>::iterator iter = m_tempListMap.begin();
+             iter != m_tempListMap.end();
+             iter++)
+        {
+            m_visitor->onBlock(*iter);
+            m_streamedSubsetsCount++;
+        }
+        for (uint i = graphEdgesCount; i < m_graphRecords.getEdgesCount(); i++)
+        {
+            const ControlFlowGraph::EdgeRecord& edge = m_graphRecords.getEdge(i);
+            m_visitor->onEdge(edge.m_source, edge.m_target, edge.m_kind);
+        }
+        m_graphRecords.truncate(graphBlocksCount, graphEdgesCount);
+        m_xrefRecords.truncate(xrefsCount);
+        m_tempListMap.removeAll();
+        return true;
     }
 
     // Add all the subsets created under this address to the actual list map
@@ -389,7 +564,44 @@ uint FlowMapper::map(const addressNumericValue start,
              iter++)
             m_listMap.append(*iter);
 
-    return m_listMap.length();
+    return true;
+}
+
+void FlowMapper::setVisitor(Visitor* visitor)
+{
+    m_visitor = visitor;
+}
+
+void FlowMapper::addNoReturn(addressNumericValue address)
+{
+    m_noReturns.add(address);
+}
+
+bool FlowMapper::isNoReturn(addressNumericValue address)
+{
+    return m_noReturns.contains(address);
+}
+
+uint FlowMapper::getNoReturnsCount()
+{
+    return m_noReturns.getCount();
+}
+
+addressNumericValue FlowMapper::getNoReturn(uint index)
+{
+    return m_noReturns.get(index);
+}
+
+void FlowMapper::sortAddresses(addressNumericValue* array, uint count)
+{
+    // Heap sort, no recursion and no extra memory for huge export tables
+    heapSort(array, count, isAddressBefore);
+}
+
+bool FlowMapper::isAddressBefore(const addressNumericValue& a,
+                                 const addressNumericValue& b)
+{
+    return a < b;
 }
 
 bool FlowMapper::dumpMapList(BasicOutputPtr& outputObject)
@@ -399,33 +611,39 @@ bool FlowMapper::dumpMapList(BasicOutputPtr& outputObject)
 
     XSTL_TRY
     {
-        // Write the length of the list
-        uint8 sizeBuffer[sizeof(DWORD)];
-        outputObject->writeUint32(sizeBuffer, m_listMap.length());
-        outputObject->write(sizeBuffer, sizeof(DWORD));
+        // Write the header, the subsets follow it
+        MapListFile::Header header;
+        cOS::memset(&header, 0, sizeof(header));
+        header.m_magic = MapListFile::MAGIC;
+        header.m_version = MapListFile::VERSION;
+        header.m_subsetSize = sizeof(MapListFile::Subset);
+        header.m_subsetsCount = m_listMap.length();
+        header.m_subsetsOffset = sizeof(MapListFile::Header);
+        outputObject->pipeWrite(&header, sizeof(header));
 
-        // Enumerate the subsets and write them to the file
+        // Write the subsets in chunks
+        cSArray<MapListFile::Subset> subsets(t_min((uint)MAP_LIST_CHUNK_SUBSETS,
+                                                   m_listMap.length()));
+        uint used = 0;
         for (cList<CodeSubset>::iterator iter = m_listMap.begin(); iter != m_listMap.end(); iter++)
         {
-            // Write the address DWORDs to buffers
-            uint8 startAddressBuffer[sizeof(DWORD)],
-                  endAddressBuffer[sizeof(DWORD)],
-                  callerAddressBuffer[sizeof(DWORD)],
-                  endAlterPropertyBuffer[sizeof(DWORD)],
-                  callerAlterPropertyBuffer[sizeof(DWORD)];
-            outputObject->writeUint32(startAddressBuffer, (uint32)(*iter).m_startAddress.getAddress());
-            outputObject->writeUint32(endAddressBuffer, (uint32)(*iter).m_endAddress.getAddress());
-            outputObject->writeUint32(callerAddressBuffer, (uint32)(*iter).m_callerAddress.getAddress());
-            outputObject->writeUint32(endAlterPropertyBuffer, (uint32)(*iter).m_endAlterProperty);
-            outputObject->writeUint32(callerAlterPropertyBuffer, (uint32)(*iter).m_callerAlterProperty);
-
-            // Write the addresses to the file
-            outputObject->write(startAddressBuffer, sizeof(DWORD));
-            outputObject->write(endAddressBuffer, sizeof(DWORD));
-            outputObject->write(callerAddressBuffer, sizeof(DWORD));
-            outputObject->write(endAlterPropertyBuffer, sizeof(DWORD));
-            outputObject->write(callerAlterPropertyBuffer, sizeof(DWORD));
+            MapListFile::Subset& subset = subsets[used++];
+            subset.m_startAddress = (*iter).m_startAddress.getAddress();
+            subset.m_endAddress = (*iter).m_endAddress.getAddress();
+            subset.m_callerAddress = (*iter).m_callerAddress.getAddress();
+            subset.m_endAlterProperty = (*iter).m_endAlterProperty;
+            subset.m_callerAlterProperty = (*iter).m_callerAlterProperty;
+
+            if (used == subsets.getSize())
+            {
+                outputObject->pipeWrite(subsets.getBuffer(),
+                                        used * sizeof(MapListFile::Subset));
+                used = 0;
+            }
         }
+        if (used > 0)
+            outputObject->pipeWrite(subsets.getBuffer(),
+                                    used * sizeof(MapListFile::Subset));
     }
     XSTL_CATCH_ALL
     {
@@ -439,12 +657,57 @@ bool FlowMapper::loadMapList(BasicInputPtr& inputObject)
 {
     // Start with a clean list
     m_listMap.removeAll();
+    m_graphRecords.clear();
+    m_xrefRecords.clear();
+    m_isGraphBuilt = false;
+    m_isXrefIndexBuilt = false;
+    m_isMapListLoaded = false;
 
     XSTL_TRY
     {
-        // Read the length of the list
+        // Read the magic of the header, or the length of the list in the
+        // first version of the format
         uint8 sizeBuffer[sizeof(DWORD)];
         inputObject->read(sizeBuffer, sizeof(DWORD));
+
+        if (MapListFile::MAGIC == cLittleEndian::readUint32(sizeBuffer))
+        {
+            // Read the rest of the header
+            MapListFile::Header header;
+            cOS::memcpy(&header, sizeBuffer, sizeof(DWORD));
+            inputObject->pipeRead(((uint8*)&header) + sizeof(DWORD),
+                                  sizeof(header) - sizeof(DWORD));
+            CHECK(header.m_version == MapListFile::VERSION);
+            CHECK(header.m_subsetSize == sizeof(MapListFile::Subset));
+            CHECK(header.m_subsetsOffset >= sizeof(MapListFile::Header));
+
+            // Skip to the subsets
+            uint skip = header.m_subsetsOffset - sizeof(MapListFile::Header);
+            if (skip > 0)
+            {
+                cSArray<uint8> padding(skip);
+                inputObject->pipeRead(padding.getBuffer(), skip);
+            }
+
+            // Read the subsets in chunks
+            uint64 left = header.m_subsetsCount;
+            cSArray<MapListFile::Subset> subsets((uint)t_min((uint64)MAP_LIST_CHUNK_SUBSETS,
+                                                             t_max(left, (uint64)1)));
+            while (left > 0)
+            {
+                uint count = (uint)t_min((uint64)subsets.getSize(), left);
+                inputObject->pipeRead(subsets.getBuffer(),
+                                      count * sizeof(MapListFile::Subset));
+                for (uint i = 0; i < count; i++)
+                    appendMapListSubset(subsets[i]);
+                left-= count;
+            }
+
+            m_isMapListLoaded = true;
+            return true;
+        }
+
+        // The first version of the format
         uint32 listLength = inputObject->readUint32(sizeBuffer);
 
         for (uint i = 0; i < listLength; i++)
@@ -478,31 +741,381 @@ bool FlowMapper::loadMapList(BasicInputPtr& inputObject)
     }
     XSTL_CATCH_ALL
     {
+        // Don't leave a partial list
+        m_listMap.removeAll();
+        return false;
+    }
+
+    m_isMapListLoaded = true;
+    return true;
+}
+
+void FlowMapper::loadMapList(const MapListReader& reader)
+{
+    // Start with a clean list
+    m_listMap.removeAll();
+    m_graphRecords.clear();
+    m_xrefRecords.clear();
+    m_isGraphBuilt = false;
+    m_isXrefIndexBuilt = false;
+    m_isMapListLoaded = false;
+
+    const MapListFile::Subset* subsets = reader.getSubsets();
+    for (uint64 i = 0; i < reader.getSubsetsCount(); i++)
+        appendMapListSubset(subsets[i]);
+    m_isMapListLoaded = true;
+}
+
+/*
+ * Return the ProcessorAddress of a map list file address. Addresses above
+ * 4GB are kept as 64 bit addresses.
+ */
+static ProcessorAddress getMapListAddress(uint64 address)
+{
+    if (address > 0xFFFFFFFF)
+        return ProcessorAddress(ProcessorAddress::PROCESSOR_64, address);
+    return ProcessorAddress(ProcessorAddress::PROCESSOR_32, address);
+}
+
+void FlowMapper::appendMapListSubset(const MapListFile::Subset& subset)
+{
+    m_listMap.append(CodeSubset(getMapListAddress(subset.m_startAddress),
+                                getMapListAddress(subset.m_endAddress),
+                                getMapListAddress(subset.m_callerAddress),
+                                subset.m_endAlterProperty,
+                                subset.m_callerAlterProperty));
+}
+
+void FlowMapper::addPotentialSubset(const CodeSubset& subset,
+                                    const WalkParametersStackObject& saveStack,
+                                    const ControlFlowGraph::Records& walkRecords,
+                                    const XrefIndex::Records& walkXrefs)
+{
+    // Reclaim the storage of the taken potential subsets once they are more
+    // than half of the stored ones, so it's bounded by the untaken ones
+    if ((m_potentialsCount >= POTENTIAL_INITIAL_SIZE) &&
+        ((m_potentialsCount - m_potentialIndexCount) * 2 > m_potentialsCount))
+        compactPotentials();
+
+    // Keep the index load factor at most 50%
+    if ((m_potentialIndexCount + 1) * 2 > m_potentialIndex.getSize())
+        growPotentialIndex();
+
+    // Store the subset, grow the array geometrically
+    if (m_potentialsCount == m_potentials.getSize())
+        m_potentials.changeSize(t_max((uint)POTENTIAL_INITIAL_SIZE,
+                                      m_potentialsCount * 2));
+    uint index = m_potentialsCount++;
+    m_potentials[index].m_subset = subset;
+    m_potentials[index].m_isTaken = false;
+    m_potentials[index].m_firstJump = m_potentialJumps.getSize();
+    m_potentials[index].m_jumpsCount = saveStack.getSize();
+    m_potentialJumps.append(saveStack);
+    m_potentials[index].m_firstBlockRecord = m_potentialRecords.getBlocksCount();
+    m_potentials[index].m_blockRecordsCount = walkRecords.getBlocksCount();
+    m_potentials[index].m_firstEdgeRecord = m_potentialRecords.getEdgesCount();
+    m_potentials[index].m_edgeRecordsCount = walkRecords.getEdgesCount();
+    m_potentialRecords.append(walkRecords,
+                              0, walkRecords.getBlocksCount(),
+                              0, walkRecords.getEdgesCount());
+    m_potentials[index].m_firstXrefRecord = m_potentialXrefs.getCount();
+    m_potentials[index].m_xrefRecordsCount = walkXrefs.getCount();
+    m_potentialXrefs.append(walkXrefs, 0, walkXrefs.getCount());
+
+    if (NULL != m_visitor)
+        m_visitor->onPotential(subset);
+
+    indexPotentialSubset(index);
+}
+
+void FlowMapper::indexPotentialSubset(uint index)
+{
+    // Index it by its start address
+    uint mask = m_potentialIndex.getSize() - 1;
+    addressNumericValue startAddress =
+        m_potentials[index].m_subset.m_startAddress.getAddress();
+    uint slot = hashAddress(startAddress, mask);
+    while (m_potentialIndex[slot].m_index != EMPTY_SLOT)
+        slot = (slot + 1) & mask;
+    m_potentialIndex[slot].m_startAddress = startAddress;
+    m_potentialIndex[slot].m_index = index;
+    m_potentialIndexCount++;
+}
+
+bool FlowMapper::takePotentialSubset(addressNumericValue startAddress,
+                                     PotentialSubset& potential)
+{
+    if (0 == m_potentialIndexCount)
         return false;
+
+    uint mask = m_potentialIndex.getSize() - 1;
+    uint slot = hashAddress(startAddress, mask);
+    while (true)
+    {
+        if (m_potentialIndex[slot].m_index == EMPTY_SLOT)
+            return false;
+        if (m_potentialIndex[slot].m_startAddress == startAddress)
+            break;
+        slot = (slot + 1) & mask;
+    }
+
+    m_potentials[m_potentialIndex[slot].m_index].m_isTaken = true;
+    potential = m_potentials[m_potentialIndex[slot].m_index];
+    m_potentialIndexCount--;
+
+    // Remove the slot, and shift back the following slots of the cluster
+    // which can't be found without it
+    uint empty = slot;
+    m_potentialIndex[empty].m_index = EMPTY_SLOT;
+    slot = (slot + 1) & mask;
+    while (m_potentialIndex[slot].m_index != EMPTY_SLOT)
+    {
+        uint home = hashAddress(m_potentialIndex[slot].m_startAddress, mask);
+        // Move the slot if its home isn't cyclically in (empty, slot]
+        if (((slot - home) & mask) >= ((slot - empty) & mask))
+        {
+            m_potentialIndex[empty] = m_potentialIndex[slot];
+            m_potentialIndex[slot].m_index = EMPTY_SLOT;
+            empty = slot;
+        }
+        slot = (slot + 1) & mask;
     }
 
     return true;
 }
 
+void FlowMapper::promotePotentialSubset(addressNumericValue startAddress)
+{
+    PotentialSubset potential;
+    if (!takePotentialSubset(startAddress, potential))
+        return;
+
+    // We found the address, append it to the subset list
+    m_tempListMap.append(potential.m_subset);
+    m_graphRecords.append(m_potentialRecords,
+                          potential.m_firstBlockRecord,
+                          potential.m_blockRecordsCount,
+                          potential.m_firstEdgeRecord,
+                          potential.m_edgeRecordsCount);
+    m_xrefRecords.append(m_potentialXrefs,
+                         potential.m_firstXrefRecord,
+                         potential.m_xrefRecordsCount);
+
+    // Push the walk parameters to the actual global stack
+    m_walkStack.spliceCopy(m_potentialJumps,
+                           potential.m_firstJump,
+                           potential.m_jumpsCount);
+}
+
+void FlowMapper::growPotentialIndex()
+{
+    cSArray<PotentialSlot> old(m_potentialIndex);
+    uint size = t_max((uint)POTENTIAL_INITIAL_SIZE, old.getSize() * 2);
+    m_potentialIndex.changeSize(size);
+    for (uint i = 0; i < size; i++)
+        m_potentialIndex[i].m_index = EMPTY_SLOT;
+
+    uint mask = size - 1;
+    for (uint i = 0; i < old.getSize(); i++)
+    {
+        if (old[i].m_index == EMPTY_SLOT)
+            continue;
+        uint slot = hashAddress(old[i].m_startAddress, mask);
+        while (m_potentialIndex[slot].m_index != EMPTY_SLOT)
+            slot = (slot + 1) & mask;
+        m_potentialIndex[slot] = old[i];
+    }
+}
+
+void FlowMapper::compactPotentials()
+{
+    uint count = 0;
+    uint jumpsCount = 0;
+    uint blockRecordsCount = 0;
+    uint edgeRecordsCount = 0;
+    uint xrefRecordsCount = 0;
+    for (uint i = 0; i < m_potentialsCount; i++)
+    {
+        PotentialSubset& potential = m_potentials[i];
+        if (potential.m_isTaken)
+            continue;
+
+        // The ranges of the untaken subsets are in order, so they only move
+        // down
+        m_potentialJumps.moveDown(potential.m_firstJump,
+                                  potential.m_jumpsCount,
+                                  jumpsCount);
+        potential.m_firstJump = jumpsCount;
+        jumpsCount+= potential.m_jumpsCount;
+        m_potentialRecords.moveDown(potential.m_firstBlockRecord,
+                                    potential.m_blockRecordsCount,
+                                    blockRecordsCount,
+                                    potential.m_firstEdgeRecord,
+                                    potential.m_edgeRecordsCount,
+                                    edgeRecordsCount);
+        potential.m_firstBlockRecord = blockRecordsCount;
+        blockRecordsCount+= potential.m_blockRecordsCount;
+        potential.m_firstEdgeRecord = edgeRecordsCount;
+        edgeRecordsCount+= potential.m_edgeRecordsCount;
+        m_potentialXrefs.moveDown(potential.m_firstXrefRecord,
+                                  potential.m_xrefRecordsCount,
+                                  xrefRecordsCount);
+        potential.m_firstXrefRecord = xrefRecordsCount;
+        xrefRecordsCount+= potential.m_xrefRecordsCount;
+
+        if (count != i)
+            m_potentials[count] = potential;
+        count++;
+    }
+
+    // Release the references of the removed subsets
+    for (uint i = count; i < m_potentialsCount; i++)
+        m_potentials[i] = PotentialSubset();
+    m_potentialsCount = count;
+    m_potentialJumps.truncate(jumpsCount);
+    m_potentialRecords.truncate(blockRecordsCount, edgeRecordsCount);
+    m_potentialXrefs.truncate(xrefRecordsCount);
+
+    // The indices of the subsets have changed
+    for (uint i = 0; i < m_potentialIndex.getSize(); i++)
+        m_potentialIndex[i].m_index = EMPTY_SLOT;
+    m_potentialIndexCount = 0;
+    for (uint i = 0; i < m_potentialsCount; i++)
+        indexPotentialSubset(i);
+}
+
+void FlowMapper::endGraphBlock()
+{
+    m_walkRecords.addBlock(m_graphBlockStart, m_graphBlockEnd);
+    m_graphBlockStart = m_graphBlockEnd;
+}
+
+FlowMapper::SwitchGuard::SwitchGuard() :
+    m_state(STATE_NONE),
+    m_register(0),
+    m_bound(SWITCH_NO_BOUND)
+{
+}
+
+void FlowMapper::SwitchGuard::reset()
+{
+    m_state = STATE_NONE;
+}
+
+uint FlowMapper::SwitchGuard::update(const OpcodePtr& opcode)
+{
+    uint state = m_state;
+    m_state = STATE_NONE;
+
+    // "cmp reg, imm" starts a bound check
+    uint reg;
+    uint32 value;
+    if (opcode->getRegisterCompare(reg, value))
+    {
+        m_state = STATE_COMPARE;
+        m_register = reg;
+        m_bound = value;
+        return SWITCH_NO_BOUND;
+    }
+
+    if (STATE_COMPARE == state)
+    {
+        // "ja default" leaves the indices up to the constant, "jae default"
+        // the indices below it
+        if (Opcode::FLOW_COND_BIGGER == opcode->getAlterProperty())
+        {
+            m_bound++;
+            m_state = STATE_JUMP;
+        }
+        else if ((Opcode::FLOW_COND_LOWER | Opcode::FLOW_COND_NOT) == opcode->getAlterProperty())
+            m_state = STATE_JUMP;
+        return SWITCH_NO_BOUND;
+    }
+
+    if ((STATE_JUMP == state) &&
+        opcode->isSwitch() &&
+        (opcode->getSwitchIndexRegister() == m_register))
+        return m_bound;
+
+    return SWITCH_NO_BOUND;
+}
+
+void FlowMapper::resolveSwitchTable(const OpcodePtr& opcode,
+                                    const ProcessorAddress& switchAddress,
+                                    const ProcessorAddress& tableAddress,
+                                    uint entriesCount,
+                                    WalkParametersStackObject& saveStack)
+{
+    bool isBounded = (SWITCH_NO_BOUND != entriesCount);
+    if (!isBounded)
+        entriesCount = SWITCH_MAX_ENTRIES;
+
+    // The targets are walked like the targets of the other jumps
+    ProcessorAddress nextOpcode(gNullPointerProcessorAddress);
+    if (!m_disassembler->getNextOpcodeLocation(nextOpcode))
+        XSTL_THROW(FlowMapperException);
+
+    // The disassembler reads from the same stream
+    uint position = m_inputStream->getPointer();
+    uint length = m_inputStream->length();
+    addressNumericValue imageBase = m_memoryInterface->getImageBase();
+
+    for (uint i = 0; i < entriesCount; i++)
+    {
+        ProcessorAddress entryAddress(ProcessorAddress::PROCESSOR_32,
+                                      tableAddress.getAddress() + i * sizeof(uint32));
+        if (!isBounded && (0 != i) && isVisited(entryAddress))
+            break;
+
+        uint rawAddress = m_memoryInterface->virtualToRawAddress(entryAddress.getAddress());
+        if ((0 == rawAddress) || ((rawAddress + sizeof(uint32)) > length))
+            break;
+
+        uint8 buffer[sizeof(uint32)];
+        m_inputStream->seek(rawAddress, basicInput::IO_SEEK_SET);
+        m_inputStream->pipeRead(buffer, sizeof(buffer));
+        addressNumericValue value = cLittleEndian::readUint32(buffer);
+        if (value < imageBase)
+            break;
+
+        ProcessorAddress target(ProcessorAddress::PROCESSOR_32, value - imageBase);
+        if (!isExecutable(target))
+            break;
+
+        markVisited(entryAddress);
+        m_walkRecords.addEdge(switchAddress.getAddress(),
+                              target.getAddress(),
+                              ControlFlowGraph::EDGE_SWITCH);
+        m_walkXrefs.add(switchAddress.getAddress(),
+                        target.getAddress(),
+                        XrefIndex::XREF_JUMP);
+
+        if (isVisited(target))
+            promotePotentialSubset(target.getAddress());
+        else
+            saveStack.push(JumpInstruction(target,
+                                           nextOpcode,
+                                           opcode,
+                                           ProcessorAddress(gNullPointerProcessorAddress)));
+    }
+
+    m_inputStream->seek(position, basicInput::IO_SEEK_SET);
+}
+
 void FlowMapper::initHasVisited()
 {
-    // Create the array, initialized to zero
-    uint visitedLength = 8 * ((m_inputStream->length() / 8) + 1);
-    m_hasVisited = cBuffer(visitedLength);
-    for (uint i = 0; i < visitedLength; i++)
-        m_hasVisited[i] = 0;
+    // Start with an empty set, pages are allocated upon the first visit
+    m_hasVisited.clear();
 }
 
 void FlowMapper::markVisited(const ProcessorAddress& address)
 {
-    m_hasVisited[(uint)address.getAddress() / 8] |=
-        (1 << ((uint)address.getAddress() % 8));
+    m_hasVisited.set(address.getAddress());
 }
 
 bool FlowMapper::isVisited(const ProcessorAddress& address)
 {
-    return (0 != (m_hasVisited[(uint)address.getAddress() / 8] &
-                  (1 << ((uint)address.getAddress() % 8))));
+    return m_hasVisited.isSet(address.getAddress());
 }
 
 bool FlowMapper::isExecutable(const ProcessorAddress& address)
@@ -520,6 +1133,17 @@ bool FlowMapper::isWritable(const ProcessorAddress& address)
 FlowMapper::FlowMapper(const BasicInputPtr& inputStream,
                        const SectionMemoryInterfacePtr& memoryInterface) :
     m_inputStream(inputStream),
+    m_potentialsCount(0),
+    m_potentialIndexCount(0),
+    m_isGraphBuilt(false),
+    m_graphBlockStart(0),
+    m_graphBlockEnd(0),
+    m_graphLastInstruction(0),
+    m_isXrefIndexBuilt(false),
+    m_isMapListLoaded(false),
+    m_isMapped(false),
+    m_visitor(NULL),
+    m_streamedSubsetsCount(0),
     m_memoryInterface(memoryInterface),
     m_lastOpcode(gNullPointerProcessorAddress)
 {
@@ -542,6 +1166,110 @@ void FlowMapper::getMapList(cList<CodeSubset>& listMap)
 {
     listMap = m_listMap;
 }
+
+const ControlFlowGraph& FlowMapper::getGraph()
+{
+    // The records of a loaded map list aren't known
+    CHECK(!m_isMapListLoaded);
+    if (!m_isGraphBuilt)
+    {
+        m_graph.build(m_graphRecords, m_hasVisited);
+        m_isGraphBuilt = true;
+    }
+    return m_graph;
+}
+
+/*
+ * Adds 'address' to a hash set of 'mask' + 1 slots. Returns false if it's
+ * already in the set.
+ */
+static bool insertBreakpoint(cSArray<addressNumericValue>& slots,
+                             cSArray<uint8>& isUsed,
+                             uint mask,
+                             uint slot,
+                             addressNumericValue address)
+{
+    while (0 != isUsed[slot])
+    {
+        if (slots[slot] == address)
+            return false;
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = address;
+    isUsed[slot] = 1;
+    return true;
+}
+
+void FlowMapper::buildBreakpointPlan(BreakpointPlan& plan,
+                                     const BreakpointSelection& selection)
+{
+    plan.m_endsCount = 0;
+    plan.m_callsCount = 0;
+    plan.m_jmpsCount = 0;
+    plan.m_othersCount = 0;
+
+    // Each subset selects at most two addresses. Size the set for a load
+    // factor of at most 50%, so it never grows.
+    uint maxCount = m_listMap.length() * 2;
+    uint size = POTENTIAL_INITIAL_SIZE;
+    while (size < maxCount * 2)
+        size*= 2;
+    uint mask = size - 1;
+    cSArray<addressNumericValue> slots(size);
+    cSArray<uint8> isUsed(size);
+    for (uint i = 0; i < size; i++)
+        isUsed[i] = 0;
+
+    plan.m_addresses.changeSize(maxCount);
+    uint count = 0;
+    for (cList<CodeSubset>::iterator iter = m_listMap.begin();
+         iter != m_listMap.end();
+         ++iter)
+    {
+        const CodeSubset& subset = *iter;
+
+        if ((subset.m_endAlterProperty & selection.m_endMask) == selection.m_endValue)
+        {
+            addressNumericValue address = subset.m_endAddress.getAddress();
+            if (insertBreakpoint(slots, isUsed, mask, hashAddress(address, mask), address))
+            {
+                plan.m_addresses[count++] = address;
+                plan.m_endsCount++;
+            }
+        }
+
+        int callerAlterProperty = subset.m_callerAlterProperty;
+        if ((callerAlterProperty & selection.m_callerMask) == selection.m_callerValue)
+        {
+            addressNumericValue address = subset.m_callerAddress.getAddress();
+            if (insertBreakpoint(slots, isUsed, mask, hashAddress(address, mask), address))
+            {
+                plan.m_addresses[count++] = address;
+                if (Opcode::FLOW_STACK_CHANGE & callerAlterProperty)
+                    plan.m_callsCount++;
+                else if (Opcode::FLOW_COND_ALWAYS & callerAlterProperty)
+                    plan.m_jmpsCount++;
+                else
+                    plan.m_othersCount++;
+            }
+        }
+    }
+
+    plan.m_addresses.changeSize(count);
+    sortAddresses(plan.m_addresses.getBuffer(), count);
+}
+
+const XrefIndex& FlowMapper::getXrefIndex()
+{
+    CHECK(!m_isMapListLoaded);
+    if (!m_isXrefIndexBuilt)
+    {
+        m_xrefIndex.build(m_xrefRecords);
+        m_isXrefIndexBuilt = true;
+    }
+    return m_xrefIndex;
+}
+
 OpcodeFormatterPtr FlowMapper::getFormatter(OpcodePtr& opcode)
 {
   return m_disassembler->getOpcodeFormat(opcode, *m_formatter);
@@ -0,0 +1,290 @@
+#include "dismount/dismount.h"
+/*
+ * FlowMapperCache.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/os.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/except/trace.h"
+#include "xStl/stream/basicIO.h"
+#include "xStl/stream/fileStream.h"
+#include "dismount/DefaultOpcodeDataFormatter.h"
+#include "dismount/MapListFile.h"
+#include "dismount/FlowMapperCache.h"
+
+// The multipliers of the digest (64 bit odd constants, written as two halves
+// for old compilers)
+static const uint64 gPrime1 = ((uint64)0x9E3779B1 << 32) | 0x85EBCA87;
+static const uint64 gPrime2 = ((uint64)0xC2B2AE3D << 32) | 0x27D4EB4F;
+static const uint64 gFinal1 = ((uint64)0xFF51AFD7 << 32) | 0xED558CCD;
+static const uint64 gFinal2 = ((uint64)0xC4CEB9FE << 32) | 0x1A85EC53;
+
+// Rotates a 64 bit value left
+static uint64 rotateLeft(uint64 value, uint bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Spreads every bit of 'value' over all the bits of the result
+static uint64 finalizeWord(uint64 value)
+{
+    value^= value >> 33;
+    value*= gFinal1;
+    value^= value >> 33;
+    value*= gFinal2;
+    value^= value >> 33;
+    return value;
+}
+
+FlowMapperCache::Digest::Digest() :
+    m_low(gPrime1),
+    m_high(gPrime2),
+    m_tailLength(0),
+    m_length(0)
+{
+}
+
+void FlowMapperCache::Digest::mixWord(uint64 word)
+{
+    m_low = rotateLeft(m_low + word * gPrime2, 31) * gPrime1;
+    m_high = rotateLeft(m_high ^ (word * gPrime1), 27) * gPrime2 + m_low;
+}
+
+void FlowMapperCache::Digest::update(const uint8* data, uint size)
+{
+    m_length+= size;
+
+    // Complete the tail into a word
+    while ((size > 0) && (m_tailLength > 0))
+    {
+        m_tail[m_tailLength++] = *(data++);
+        size--;
+        if (m_tailLength == sizeof(uint64))
+        {
+            uint64 word;
+            cOS::memcpy(&word, m_tail, sizeof(word));
+            mixWord(word);
+            m_tailLength = 0;
+        }
+    }
+
+    // Whole words
+    while (size >= sizeof(uint64))
+    {
+        uint64 word;
+        cOS::memcpy(&word, data, sizeof(word));
+        mixWord(word);
+        data+= sizeof(uint64);
+        size-= sizeof(uint64);
+    }
+
+    // Keep the rest for the next update
+    while (size > 0)
+    {
+        m_tail[m_tailLength++] = *(data++);
+        size--;
+    }
+}
+
+void FlowMapperCache::Digest::updateUint64(uint64 value)
+{
+    update((const uint8*)&value, sizeof(value));
+}
+
+FlowMapperCache::Key FlowMapperCache::Digest::getKey() const
+{
+    // Mix the tail and the length
+    Digest final(*this);
+    uint64 word = 0;
+    cOS::memcpy(&word, m_tail, m_tailLength);
+    final.mixWord(word);
+    final.mixWord(m_length);
+
+    Key key;
+    key.m_low = finalizeWord(final.m_low + final.m_high);
+    key.m_high = finalizeWord(final.m_high ^ rotateLeft(final.m_low, 32));
+    return key;
+}
+
+FlowMapperCache::FlowMapperCache(const cString& directory,
+                                 FlowMapper& mapper,
+                                 const BasicInputPtr& image,
+                                 const SectionMemoryInterfacePtr& memoryInterface,
+                                 uint mapperVersion) :
+    m_directory(directory),
+    m_mapper(mapper),
+    m_image(image),
+    m_memoryInterface(memoryInterface),
+    m_mapperVersion(mapperVersion),
+    m_isImageDigested(false),
+    m_isHit(false)
+{
+}
+
+uint FlowMapperCache::mapAll(const FlowMapper::addresses& entryPoints,
+                             const bool isFaultTolerant /* = false */)
+{
+    // The stored result is the whole map list of the mapper
+    CHECK(m_mapper.isEmpty());
+
+    // The result depends only on the sorted distinct entry points
+    cSArray<addressNumericValue> sortedEntryPoints(t_max(entryPoints.length(), 1U));
+    uint count = 0;
+    for (FlowMapper::addresses::iterator iter = entryPoints.begin();
+         iter != entryPoints.end();
+         iter++)
+        sortedEntryPoints[count++] = *iter;
+    FlowMapper::sortAddresses(sortedEntryPoints.getBuffer(), count);
+
+    digestImage();
+    Digest digest(m_imageDigest);
+    digest.updateUint64(isFaultTolerant ? 1 : 0);
+    for (uint i = 0; i < count; i++)
+    {
+        if ((i > 0) && (sortedEntryPoints[i - 1] == sortedEntryPoints[i]))
+            continue;
+        digest.updateUint64(sortedEntryPoints[i]);
+    }
+    digestNoReturns(digest);
+    Key key = digest.getKey();
+
+    uint subsetsCount = 0;
+    m_isHit = load(key, subsetsCount);
+    if (m_isHit)
+        return subsetsCount;
+
+    subsetsCount = m_mapper.mapAll(entryPoints, isFaultTolerant);
+    store(key, subsetsCount);
+    return subsetsCount;
+}
+
+bool FlowMapperCache::isHit() const
+{
+    return m_isHit;
+}
+
+void FlowMapperCache::digestImage()
+{
+    if (m_isImageDigested)
+        return;
+
+    m_imageDigest.updateUint64(m_mapperVersion);
+
+    // The bytes of the image. The stream position is kept for the mapper.
+    uint position = m_image->getPointer();
+    uint left = m_image->length();
+    m_imageDigest.updateUint64(left);
+    m_image->seek(0, basicInput::IO_SEEK_SET);
+    cSArray<uint8> buffer(IMAGE_CHUNK_SIZE);
+    while (left > 0)
+    {
+        uint size = t_min(left, buffer.getSize());
+        m_image->pipeRead(buffer.getBuffer(), size);
+        m_imageDigest.update(buffer.getBuffer(), size);
+        left-= size;
+    }
+    m_image->seek(position, basicInput::IO_SEEK_SET);
+
+    // The section layout
+    m_imageDigest.updateUint64(m_memoryInterface->getModuleBaseAddress());
+    m_imageDigest.updateUint64(m_memoryInterface->getImageBase());
+    m_imageDigest.updateUint64(m_memoryInterface->getMemorySize());
+    cList<SectionMemoryInterface::GeneralSection>& sections =
+        m_memoryInterface->getSectionList();
+    m_imageDigest.updateUint64(sections.length());
+    for (cList<SectionMemoryInterface::GeneralSection>::iterator iter = sections.begin();
+         iter != sections.end();
+         iter++)
+    {
+        m_imageDigest.updateUint64((*iter).m_start);
+        m_imageDigest.updateUint64((*iter).m_end);
+        m_imageDigest.updateUint64((*iter).m_rawDataAddress);
+        m_imageDigest.updateUint64((*iter).m_flags);
+    }
+
+    m_isImageDigested = true;
+}
+
+void FlowMapperCache::digestNoReturns(Digest& digest)
+{
+    uint count = m_mapper.getNoReturnsCount();
+    digest.updateUint64(count);
+    for (uint i = 0; i < count; i++)
+        digest.updateUint64(m_mapper.getNoReturn(i));
+}
+
+cString FlowMapperCache::getPath(const Key& key) const
+{
+    character name[DefaultOpcodeDataFormatter::MAX_HEX_LENGTH * 2];
+    uint length = DefaultOpcodeDataFormatter::writeHex(
+        name, key.m_high, 16, DefaultOpcodeDataFormatter::HEX_PREFIX, false);
+    DefaultOpcodeDataFormatter::writeHex(
+        name + length, key.m_low, 16, DefaultOpcodeDataFormatter::HEX_PREFIX, false);
+    return m_directory + cString("/") + cString(name) + cString(".map");
+}
+
+bool FlowMapperCache::load(const Key& key, uint& subsetsCount)
+{
+    XSTL_TRY
+    {
+        BasicInputPtr input(new cFileStream(getPath(key), cFile::READ));
+
+        Header header;
+        input->pipeRead(&header, sizeof(header));
+        if ((header.m_magic != MAGIC) ||
+            (header.m_mapperVersion != m_mapperVersion) ||
+            (header.m_key.m_low != key.m_low) ||
+            (header.m_key.m_high != key.m_high))
+            return false;
+
+        // The map list must have the subsets counted in the header. The
+        // mapper reads exactly the subsets of the map list header, or fails.
+        MapListFile::Header listHeader;
+        input->pipeRead(&listHeader, sizeof(listHeader));
+        if ((listHeader.m_magic != MapListFile::MAGIC) ||
+            (listHeader.m_subsetsCount != header.m_subsetsCount))
+            return false;
+        input->seek(-(int)sizeof(listHeader), basicInput::IO_SEEK_CUR);
+
+        if (!m_mapper.loadMapList(input))
+            return false;
+        subsetsCount = (uint)header.m_subsetsCount;
+        return true;
+    }
+    XSTL_CATCH_ALL
+    {
+        // Not stored, or can't be read
+        return false;
+    }
+}
+
+void FlowMapperCache::store(const Key& key, uint subsetsCount)
+{
+    // An empty map list isn't written by the mapper
+    if (0 == subsetsCount)
+        return;
+
+    XSTL_TRY
+    {
+        BasicOutputPtr output(new cFileStream(getPath(key),
+                                              cFile::CREATE | cFile::WRITE));
+
+        Header header;
+        cOS::memset(&header, 0, sizeof(header));
+        header.m_magic = MAGIC;
+        header.m_mapperVersion = m_mapperVersion;
+        header.m_key = key;
+        header.m_subsetsCount = subsetsCount;
+        output->pipeWrite(&header, sizeof(header));
+        m_mapper.dumpMapList(output);
+    }
+    XSTL_CATCH_ALL
+    {
+        // The cache is best-effort, the result is stored next time
+    }
+}
@@ -0,0 +1,264 @@
+#include "dismount/dismount.h"
+/*
+ * FunctionSeeder.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/os.h"
+#include "xStl/data/array.h"
+#include "xStl/data/endian.h"
+#include "xStl/except/trace.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/FunctionSeeder.h"
+
+// Repeats a byte in all the bytes of a 64 bit word (written as two halves for
+// old compilers)
+static const uint64 gLowBytes = ((uint64)0x01010101 << 32) | 0x01010101;
+static const uint64 gHighBits = ((uint64)0x80808080 << 32) | 0x80808080;
+
+/*
+ * Return true if any of the bytes of 'word' equals 'value'
+ */
+static bool hasByte(uint64 word, uint8 value)
+{
+    uint64 difference = word ^ (gLowBytes * value);
+    return ((difference - gLowBytes) & ~difference & gHighBits) != 0;
+}
+
+/*
+ * Return true if 'value' is a padding byte (int3 or nop)
+ */
+static bool isPadding(uint8 value)
+{
+    return (0xCC == value) || (0x90 == value);
+}
+
+/*
+ * Return true if the bytes at 'position' are a stack prologue: sub esp, imm8;
+ * sub esp, imm32 or enter imm16, 0
+ */
+static bool isStackPrologue(const uint8* data, uint size, uint position)
+{
+    uint8 opcode = data[position];
+    uint left = size - position;
+    return ((0x83 == opcode) && (left >= 3) && (0xEC == data[position + 1])) ||
+           ((0x81 == opcode) && (left >= 6) && (0xEC == data[position + 1])) ||
+           ((0xC8 == opcode) && (left >= 4) && (0 == data[position + 3]));
+}
+
+FunctionSeeder::FunctionSeeder(const BasicInputPtr& image,
+                               const SectionMemoryInterfacePtr& memoryInterface,
+                               uint kinds /* = SEED_ALL */) :
+    m_image(image),
+    m_memoryInterface(memoryInterface),
+    m_kinds(kinds),
+    m_candidatesCount(0),
+    m_isSorted(true)
+{
+}
+
+void FunctionSeeder::scanSections()
+{
+    if (0 == (m_kinds & (SEED_FRAME_PROLOGUE | SEED_STACK_PROLOGUE | SEED_PADDING)))
+        return;
+
+    // The stream position is kept for the mapper
+    uint position = m_image->getPointer();
+    uint length = m_image->length();
+    cSArray<uint8> buffer;
+
+    cList<SectionMemoryInterface::GeneralSection>& sections =
+        m_memoryInterface->getSectionList();
+    for (cList<SectionMemoryInterface::GeneralSection>::iterator iter = sections.begin();
+         iter != sections.end();
+         iter++)
+    {
+        const SectionMemoryInterface::GeneralSection& section = *iter;
+        if ((0 == (section.m_flags & SectionMemoryInterface::SECTION_FLAG_EXECUTABLE)) ||
+            (section.m_end <= section.m_start) ||
+            (section.m_rawDataAddress >= length))
+            continue;
+
+        // Read the bytes of the section which are in the image
+        uint size = (uint)t_min(section.m_end - section.m_start,
+                                (addressNumericValue)(length - section.m_rawDataAddress));
+        if (buffer.getSize() < size)
+            buffer.changeSize(size);
+        m_image->seek((uint)section.m_rawDataAddress, basicInput::IO_SEEK_SET);
+        m_image->pipeRead(buffer.getBuffer(), size);
+
+        scanSection(buffer.getBuffer(), size, section.m_start);
+    }
+
+    m_image->seek(position, basicInput::IO_SEEK_SET);
+}
+
+void FunctionSeeder::scanSection(const uint8* data,
+                                 uint size,
+                                 addressNumericValue start)
+{
+    // The start of the section is a boundary
+    if ((m_kinds & SEED_STACK_PROLOGUE) && (size > 0) &&
+        isStackPrologue(data, size, 0))
+        addCandidate(start, SEED_STACK_PROLOGUE);
+
+    // Skip the words without any byte which starts a pattern
+    uint position = 0;
+    while ((position + sizeof(uint64)) <= size)
+    {
+        uint64 word;
+        cOS::memcpy(&word, data + position, sizeof(word));
+        if (hasByte(word, 0x55) || hasByte(word, 0xCC) ||
+            hasByte(word, 0x90) || hasByte(word, 0xC3))
+        {
+            for (uint i = 0; i < sizeof(uint64); i++)
+                scanPosition(data, size, position + i, start);
+        }
+        position+= sizeof(uint64);
+    }
+    for (; position < size; position++)
+        scanPosition(data, size, position, start);
+}
+
+void FunctionSeeder::scanPosition(const uint8* data,
+                                  uint size,
+                                  uint position,
+                                  addressNumericValue start)
+{
+    uint8 value = data[position];
+    uint left = size - position;
+
+    // push ebp; mov ebp, esp (and mov edi, edi before it)
+    if ((0x55 == value) && (left >= 3) &&
+        (((0x8B == data[position + 1]) && (0xEC == data[position + 2])) ||
+         ((0x89 == data[position + 1]) && (0xE5 == data[position + 2]))))
+    {
+        uint prologue = position;
+        if ((position >= 2) &&
+            (0x8B == data[position - 2]) && (0xFF == data[position - 1]))
+            prologue = position - 2;
+        addCandidate(start + prologue, SEED_FRAME_PROLOGUE);
+        return;
+    }
+
+    // The position after a ret or a padding byte is a boundary
+    uint next = position + 1;
+    if ((next >= size) || ((0xC3 != value) && !isPadding(value)) ||
+        isPadding(data[next]))
+        return;
+
+    // The end of a padding run, at an aligned address
+    if (isPadding(value) && (0 == ((start + next) % PADDING_ALIGNMENT)))
+    {
+        uint runLength = 0;
+        while ((runLength < position + 1) &&
+               (runLength < PADDING_MIN_LENGTH) &&
+               isPadding(data[position - runLength]))
+            runLength++;
+        if (runLength >= PADDING_MIN_LENGTH)
+            addCandidate(start + next, SEED_PADDING);
+    }
+
+    if (isStackPrologue(data, size, next))
+        addCandidate(start + next, SEED_STACK_PROLOGUE);
+}
+
+void FunctionSeeder::addRelocations(const addressNumericValue* locations,
+                                    uint count)
+{
+    if (0 == (m_kinds & SEED_RELOCATION))
+        return;
+
+    uint position = m_image->getPointer();
+    uint length = m_image->length();
+    addressNumericValue imageBase = m_memoryInterface->getImageBase();
+
+    for (uint i = 0; i < count; i++)
+    {
+        uint rawAddress = m_memoryInterface->virtualToRawAddress(locations[i]);
+        if ((0 == rawAddress) || ((rawAddress + sizeof(uint32)) > length))
+            continue;
+
+        uint8 buffer[sizeof(uint32)];
+        m_image->seek(rawAddress, basicInput::IO_SEEK_SET);
+        m_image->pipeRead(buffer, sizeof(buffer));
+        addressNumericValue value = cLittleEndian::readUint32(buffer);
+        if (value < imageBase)
+            continue;
+
+        addressNumericValue target = value - imageBase;
+        if (m_memoryInterface->checkAddress(target,
+                                            SectionMemoryInterface::SECTION_FLAG_EXECUTABLE))
+            addCandidate(target, SEED_RELOCATION);
+    }
+
+    m_image->seek(position, basicInput::IO_SEEK_SET);
+}
+
+void FunctionSeeder::addCandidate(addressNumericValue address,
+                                  uint kind /* = SEED_USER */)
+{
+    if (0 == (kind & m_kinds))
+        return;
+
+    Candidate candidate;
+    candidate.m_address = address;
+    candidate.m_kinds = kind;
+    appendItem(m_candidates, m_candidatesCount, candidate);
+    m_isSorted = false;
+}
+
+bool FunctionSeeder::isCandidateBefore(const Candidate& a, const Candidate& b)
+{
+    return a.m_address < b.m_address;
+}
+
+void FunctionSeeder::sortCandidates()
+{
+    if (m_isSorted)
+        return;
+
+    heapSort(m_candidates.getBuffer(), m_candidatesCount, isCandidateBefore);
+
+    // Merge the kinds of the duplicated addresses
+    uint count = 0;
+    for (uint i = 0; i < m_candidatesCount; i++)
+    {
+        if ((count > 0) &&
+            (m_candidates[count - 1].m_address == m_candidates[i].m_address))
+        {
+            m_candidates[count - 1].m_kinds|= m_candidates[i].m_kinds;
+            continue;
+        }
+        m_candidates[count++] = m_candidates[i];
+    }
+    m_candidatesCount = count;
+    m_isSorted = true;
+}
+
+uint FunctionSeeder::getCandidatesCount()
+{
+    sortCandidates();
+    return m_candidatesCount;
+}
+
+const FunctionSeeder::Candidate& FunctionSeeder::getCandidate(uint index)
+{
+    sortCandidates();
+    CHECK(index < m_candidatesCount);
+    return m_candidates[index];
+}
+
+uint FunctionSeeder::seed(FlowMapper& mapper, bool isFaultTolerant /* = true */)
+{
+    sortCandidates();
+
+    FlowMapper::addresses entryPoints;
+    for (uint i = 0; i < m_candidatesCount; i++)
+        entryPoints.append(m_candidates[i].m_address);
+    return mapper.mapAll(entryPoints, isFaultTolerant);
+}
@@ -58,6 +58,16 @@ uint32 InvalidOpcodeByte::getSwitchTableOffset() const
     return 0;
 }
 
+uint InvalidOpcodeByte::getSwitchIndexRegister() const
+{
+    return 0;
+}
+
+bool InvalidOpcodeByte::getRegisterCompare(uint& reg, uint32& value) const
+{
+    return false;
+}
+
 int InvalidOpcodeByte::getAlterProperty() const
 {
     return Opcode::FLOW_NO_ALTER;
@@ -0,0 +1,226 @@
+#include "dismount/dismount.h"
+/*
+ * ListingWriter.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/os.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/except/trace.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/StreamDisassembler.h"
+#include "dismount/OpcodeFormatter.h"
+#include "dismount/OpcodeDataFormatter.h"
+#include "dismount/DefaultOpcodeDataFormatter.h"
+#include "dismount/DisassemblerEndOfStreamException.h"
+#include "dismount/ListingWriter.h"
+
+ListingWriter::Options::Options() :
+    m_shouldShowAddress(true),
+    m_shouldShowBytes(true),
+    m_bytesColumn(DEFAULT_BYTES_COLUMN),
+    m_addressMargin(DEFAULT_ADDRESS_MARGIN),
+    m_bytesMargin(DEFAULT_BYTES_MARGIN)
+{
+}
+
+ListingWriter::ListingWriter(StreamDisassembler& disassembler,
+                             OpcodeDataFormatter& dataFormatter,
+                             const Options& options,
+                             uint bufferSize) :
+    m_disassembler(disassembler),
+    m_dataFormatter(dataFormatter),
+    m_options(options),
+    m_buffer(bufferSize),
+    m_used(0)
+{
+    // The buffer must be able to hold the fixed columns of a single line
+    CHECK(bufferSize >= (m_options.m_addressMargin +
+                         m_options.m_bytesColumn * 3 +
+                         m_options.m_bytesMargin + 1));
+}
+
+uint ListingWriter::write(basicOutput& output)
+{
+    return writeInstructions(output, false, 0);
+}
+
+uint ListingWriter::write(basicOutput& output,
+                          const ProcessorAddress& start,
+                          ProcessorAddress::uintAddress end)
+{
+    m_disassembler.jumpToAddress(start);
+    return writeInstructions(output, true, end);
+}
+
+void ListingWriter::flush(basicOutput& output)
+{
+    if (m_used == 0)
+        return;
+
+    output.pipeWrite(m_buffer.getBuffer(), m_used);
+    m_used = 0;
+}
+
+uint ListingWriter::writeInstructions(basicOutput& output,
+                                      bool shouldLimit,
+                                      ProcessorAddress::uintAddress end)
+{
+    uint count = 0;
+    ProcessorAddress next(gNullPointerProcessorAddress);
+
+    XSTL_TRY
+    {
+        while (!m_disassembler.isEndOfStream())
+        {
+            if (shouldLimit && m_disassembler.getNextOpcodeLocation(next) &&
+                (next.getAddress() >= end))
+                break;
+
+            writeInstruction(&output, m_disassembler.next());
+            count++;
+        }
+    }
+    XSTL_CATCH (DisassemblerEndOfStreamException&)
+    {
+        // End of stream. Nothing to do.
+    }
+
+    flush(output);
+    return count;
+}
+
+void ListingWriter::format(const OpcodePtr& opcode)
+{
+    writeInstruction(NULL, opcode);
+}
+
+const char* ListingWriter::getBuffer() const
+{
+    return m_buffer.getBuffer();
+}
+
+uint ListingWriter::getLength() const
+{
+    return m_used;
+}
+
+void ListingWriter::clear()
+{
+    m_used = 0;
+}
+
+void ListingWriter::writeInstruction(basicOutput* output,
+                                     const OpcodePtr& opcode)
+{
+    // Format the instruction first, the formatter might need the IP
+    OpcodeFormatterPtr formatter = m_disassembler.getOpcodeFormat(opcode,
+        m_dataFormatter);
+
+    // The address is rendered by the data formatter, like the addresses of
+    // the instruction column
+    bool hasAddress = false;
+    if (m_options.m_shouldShowAddress)
+    {
+        ProcessorAddress address(gNullPointerProcessorAddress);
+        if (opcode->getOpcodeAddress(address))
+        {
+            appendString(output,
+                         m_dataFormatter.translateAbsoluteAddress(address));
+            hasAddress = true;
+        }
+    }
+
+    // Make room for the fixed columns
+    reserve(output, m_options.m_addressMargin +
+                    m_options.m_bytesColumn * 3 + m_options.m_bytesMargin);
+    if (hasAddress)
+        appendSpaces(m_options.m_addressMargin);
+
+    if (m_options.m_shouldShowBytes)
+    {
+        appendBytes(opcode->getOpcode());
+        appendSpaces(m_options.m_bytesMargin);
+    }
+
+    appendString(output, formatter->string());
+
+    reserve(output, 1);
+    m_buffer[m_used++] = '\n';
+}
+
+void ListingWriter::reserve(basicOutput* output, uint length)
+{
+    if ((m_used + length) <= m_buffer.getSize())
+        return;
+
+    if (output != NULL)
+    {
+        flush(*output);
+        return;
+    }
+
+    // No output, grow the buffer geometrically
+    uint newSize = m_buffer.getSize() * 2;
+    if (newSize < (m_used + length))
+        newSize = m_used + length;
+    m_buffer.changeSize(newSize);
+}
+
+void ListingWriter::appendBytes(const cBuffer& opcodeData)
+{
+    char* position = m_buffer.getBuffer() + m_used;
+    const uint8* data = opcodeData.getBuffer();
+    uint count = t_min(opcodeData.getSize(), m_options.m_bytesColumn);
+
+    uint i = 0;
+    for (; i < count; i++)
+    {
+        const char* pair = DefaultOpcodeDataFormatter::getHexPair(data[i]);
+        position[0] = pair[0];
+        position[1] = pair[1];
+        position[2] = ' ';
+        position+= 3;
+    }
+    // Pad the missing bytes
+    for (; i < m_options.m_bytesColumn; i++)
+    {
+        position[0] = ' ';
+        position[1] = ' ';
+        position[2] = ' ';
+        position+= 3;
+    }
+    m_used+= m_options.m_bytesColumn * 3;
+}
+
+void ListingWriter::appendSpaces(uint count)
+{
+    memset(m_buffer.getBuffer() + m_used, ' ', count);
+    m_used+= count;
+}
+
+void ListingWriter::appendString(basicOutput* output, const cString& string)
+{
+    const character* source = string.getBuffer();
+    uint length = string.length();
+
+    while (length > 0)
+    {
+        if (m_used == m_buffer.getSize())
+            reserve(output, length);
+
+        uint chunk = t_min(length, m_buffer.getSize() - m_used);
+        char* destination = m_buffer.getBuffer() + m_used;
+        // The formatter output is plain ASCII, narrow each character
+        for (uint i = 0; i < chunk; i++)
+            destination[i] = (char)source[i];
+
+        source+= chunk;
+        length-= chunk;
+        m_used+= chunk;
+    }
+}
@@ -0,0 +1,53 @@
+#include "dismount/dismount.h"
+/*
+ * MapListReader.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/except/trace.h"
+#include "dismount/MapListFile.h"
+#include "dismount/MapListReader.h"
+
+MapListReader::MapListReader(const void* data, uint64 size)
+{
+    const uint8* start = (const uint8*)data;
+
+    CHECK(size >= sizeof(MapListFile::Header));
+    m_header = (const MapListFile::Header*)start;
+    CHECK(m_header->m_magic == MapListFile::MAGIC);
+    CHECK(m_header->m_version == MapListFile::VERSION);
+    CHECK(m_header->m_subsetSize == sizeof(MapListFile::Subset));
+
+    // The subsets must be inside the file
+    CHECK(m_header->m_subsetsOffset >= sizeof(MapListFile::Header));
+    CHECK((m_header->m_subsetsOffset % MapListFile::SUBSETS_ALIGNMENT) == 0);
+    CHECK(m_header->m_subsetsOffset <= size);
+    CHECK(m_header->m_subsetsCount <=
+          ((size - m_header->m_subsetsOffset) / sizeof(MapListFile::Subset)));
+    m_subsets = (const MapListFile::Subset*)(start + m_header->m_subsetsOffset);
+    m_subsetsCount = m_header->m_subsetsCount;
+}
+
+const MapListFile::Header& MapListReader::getHeader() const
+{
+    return *m_header;
+}
+
+uint64 MapListReader::getSubsetsCount() const
+{
+    return m_subsetsCount;
+}
+
+const MapListFile::Subset* MapListReader::getSubsets() const
+{
+    return m_subsets;
+}
+
+const MapListFile::Subset& MapListReader::getSubset(uint64 index) const
+{
+    CHECK(index < m_subsetsCount);
+    return m_subsets[index];
+}
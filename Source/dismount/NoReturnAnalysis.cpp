@@ -0,0 +1,335 @@
+#include "dismount/dismount.h"
+/*
+ * NoReturnAnalysis.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/list.h"
+#include "xStl/except/trace.h"
+#include "dismount/Opcode.h"
+#include "dismount/XrefIndex.h"
+#include "dismount/NoReturnAnalysis.h"
+
+/*
+ * The well known functions which don't return, without their decorations
+ * (See isKnownName)
+ */
+static const char* gKnownNames[] = {
+    // Windows
+    "ExitProcess",
+    "ExitThread",
+    "FreeLibraryAndExitThread",
+    "RtlExitUserProcess",
+    "RtlExitUserThread",
+    "RaiseFailFastException",
+    // Windows kernel
+    "KeBugCheck",
+    "KeBugCheckEx",
+    "ExRaiseStatus",
+    "RtlRaiseStatus",
+    "ExRaiseAccessViolation",
+    "ExRaiseDatatypeMisalignment",
+    "PsTerminateSystemThread",
+    // C runtime
+    "exit",
+    "Exit",
+    "abort",
+    "quick_exit",
+    "amsg_exit",
+    "longjmp",
+    "longjmp_chk",
+    "siglongjmp",
+    "pthread_exit",
+    "assert_fail",
+    "stack_chk_fail",
+    "chk_fail",
+    "fortify_fail",
+    "report_gsfailure",
+    "report_rangecheckfailure",
+    "invalid_parameter_noinfo_noreturn",
+    "invoke_watson",
+    // C++ runtime
+    "CxxThrowException",
+    "cxa_throw",
+    "cxa_rethrow",
+    "cxa_bad_cast",
+    "cxa_bad_typeid",
+    "cxa_pure_virtual",
+    NULL
+};
+
+/*
+ * Return true if the first 'length' characters of 'name' are 'known'
+ */
+static bool isNameEqual(const char* name, uint length, const char* known)
+{
+    for (uint i = 0; i < length; i++)
+    {
+        if ((known[i] == '\0') || (known[i] != name[i]))
+            return false;
+    }
+    return known[length] == '\0';
+}
+
+NoReturnAnalysis::NoReturnAnalysis() :
+    m_functionsCount(0),
+    m_mark(0)
+{
+}
+
+void NoReturnAnalysis::addAddress(addressNumericValue address)
+{
+    m_addresses.add(address);
+}
+
+uint NoReturnAnalysis::addKnownNames(const SymbolTable& symbols,
+                                     addressNumericValue base /* = 0 */)
+{
+    uint count = 0;
+    for (uint i = 0; i < symbols.getCount(); i++)
+    {
+        addressNumericValue address = symbols.getAddress(i);
+        if ((address < base) || !isKnownName(symbols.getName(i)))
+            continue;
+        addAddress(address - base);
+        count++;
+    }
+    return count;
+}
+
+bool NoReturnAnalysis::isKnownName(const char* name)
+{
+    // Skip a "module!" prefix
+    for (const char* position = name; *position != '\0'; position++)
+    {
+        if (*position == '!')
+            name = position + 1;
+    }
+
+    // Skip the leading '_' and an import prefix ("__imp__")
+    while (*name == '_')
+        name++;
+    if ((name[0] == 'i') && (name[1] == 'm') && (name[2] == 'p') &&
+        (name[3] == '_'))
+    {
+        name+= 4;
+        while (*name == '_')
+            name++;
+    }
+
+    // Stop at the "@N" suffix of stdcall names
+    uint length = 0;
+    while ((name[length] != '\0') && (name[length] != '@'))
+        length++;
+
+    for (uint i = 0; NULL != gKnownNames[i]; i++)
+    {
+        if (isNameEqual(name, length, gKnownNames[i]))
+            return true;
+    }
+    return false;
+}
+
+uint NoReturnAnalysis::analyze(FlowMapper& mapper, const CallGraph& callGraph)
+{
+    const ControlFlowGraph& graph = mapper.getGraph();
+
+    uint blocksCount = graph.getBlocksCount();
+    m_functionsCount = callGraph.getFunctionsCount();
+    m_isReturning.changeSize(t_max(m_functionsCount, 1U));
+    for (uint i = 0; i < m_functionsCount; i++)
+        m_isReturning[i] = 0;
+    classifyBlocks(mapper, graph, callGraph);
+
+    m_blockMarks.changeSize(t_max(blocksCount, 1U));
+    m_stack.changeSize(t_max(blocksCount, 1U));
+    for (uint i = 0; i < blocksCount; i++)
+        m_blockMarks[i] = 0;
+    m_mark = 0;
+
+    // Solve the components bottom-up, so the functions called from outside
+    // a component are already solved. A component is solved again until
+    // none of its functions changes.
+    for (uint scc = 0; scc < callGraph.getSccsCount(); scc++)
+    {
+        bool isChanged = true;
+        while (isChanged)
+        {
+            isChanged = false;
+            for (uint i = 0; i < callGraph.getSccFunctionsCount(scc); i++)
+            {
+                uint function = callGraph.getSccFunction(scc, i);
+                if ((0 != m_isReturning[function]) ||
+                    isNoReturn(callGraph.getFunction(function).m_start))
+                    continue;
+                if (isReturning(graph, callGraph, function))
+                {
+                    m_isReturning[function] = 1;
+                    isChanged = true;
+                }
+            }
+        }
+    }
+
+    // Add the functions which don't return to the set
+    uint count = 0;
+    for (uint i = 0; i < m_functionsCount; i++)
+    {
+        if (0 != m_isReturning[i])
+            continue;
+        addAddress(callGraph.getFunction(i).m_start);
+        count++;
+    }
+    return count;
+}
+
+bool NoReturnAnalysis::isFunctionNoReturn(uint function) const
+{
+    CHECK(function < m_functionsCount);
+    return 0 == m_isReturning[function];
+}
+
+bool NoReturnAnalysis::isNoReturn(addressNumericValue address)
+{
+    return m_addresses.contains(address);
+}
+
+uint NoReturnAnalysis::getAddressesCount()
+{
+    return m_addresses.getCount();
+}
+
+addressNumericValue NoReturnAnalysis::getAddress(uint index)
+{
+    return m_addresses.get(index);
+}
+
+void NoReturnAnalysis::apply(FlowMapper& mapper)
+{
+    for (uint i = 0; i < getAddressesCount(); i++)
+        mapper.addNoReturn(m_addresses.get(i));
+}
+
+void NoReturnAnalysis::apply(ParallelFlowMapper& mapper)
+{
+    for (uint i = 0; i < getAddressesCount(); i++)
+        mapper.addNoReturn(m_addresses.get(i));
+}
+
+void NoReturnAnalysis::classifyBlocks(FlowMapper& mapper,
+                                      const ControlFlowGraph& graph,
+                                      const CallGraph& callGraph)
+{
+    uint blocksCount = graph.getBlocksCount();
+    m_blockExits.changeSize(t_max(blocksCount, 1U));
+    m_blockCallees.changeSize(t_max(blocksCount, 1U));
+    for (uint i = 0; i < blocksCount; i++)
+    {
+        m_blockExits[i] = EXIT_NONE;
+        m_blockCallees[i] = CallGraph::NO_FUNCTION;
+    }
+
+    // The calls end their block. A call or a jump through the pointer of a
+    // function which doesn't return is a dead end.
+    const XrefIndex& xrefs = mapper.getXrefIndex();
+    for (uint i = 0; i < xrefs.getXrefsCount(); i++)
+    {
+        const XrefIndex::Xref& xref = xrefs.getXref(i);
+        if ((XrefIndex::XREF_CALL != xref.m_kind) &&
+            (XrefIndex::XREF_THUNK != xref.m_kind))
+            continue;
+        uint block = graph.findBlock(xref.m_source);
+        if (ControlFlowGraph::NO_BLOCK == block)
+            continue;
+
+        if (isNoReturn(xref.m_target))
+            m_blockExits[block] = EXIT_DEAD;
+        else if (XrefIndex::XREF_CALL == xref.m_kind)
+            m_blockCallees[block] = callGraph.findFunction(xref.m_target);
+    }
+
+    // The walks end at the rets, and at the jumps whose target isn't known
+    // (indirect jumps, jumps out of the code), which may be tail calls to any
+    // function
+    cList<FlowMapper::CodeSubset> subsets;
+    mapper.getMapList(subsets);
+    for (cList<FlowMapper::CodeSubset>::iterator iter = subsets.begin();
+         iter != subsets.end();
+         iter++)
+    {
+        if (0 == (*iter).m_startAddress.getAddress())
+            continue;
+        uint block = graph.findBlock((*iter).m_endAddress.getAddress());
+        if ((ControlFlowGraph::NO_BLOCK == block) ||
+            (EXIT_DEAD == m_blockExits[block]))
+            continue;
+
+        int property = (*iter).m_endAlterProperty;
+        if (0 != (property & (Opcode::FLOW_RET | Opcode::FLOW_RETF)))
+            m_blockExits[block] = EXIT_RETURN;
+        else if ((0 != (property & Opcode::FLOW_COND_ALWAYS)) &&
+                 (0 == (property & Opcode::FLOW_STACK_CHANGE)) &&
+                 (0 == graph.getSuccessorsCount(block)))
+            m_blockExits[block] = EXIT_RETURN;
+    }
+}
+
+bool NoReturnAnalysis::isReturning(const ControlFlowGraph& graph,
+                                   const CallGraph& callGraph,
+                                   uint function)
+{
+    // Depth first search over the flow of the function, from its entry
+    m_mark++;
+    uint entry = callGraph.getFunction(function).m_block;
+    uint stackCount = 0;
+    m_blockMarks[entry] = m_mark;
+    m_stack[stackCount++] = entry;
+
+    while (stackCount > 0)
+    {
+        uint block = m_stack[--stackCount];
+        if (EXIT_DEAD == m_blockExits[block])
+            continue;
+        if (EXIT_RETURN == m_blockExits[block])
+            return true;
+
+        // The flow after a call continues only if the called function returns
+        uint callee = m_blockCallees[block];
+        bool isFallingThrough = (CallGraph::NO_FUNCTION == callee) ||
+                                (0 != m_isReturning[callee]);
+
+        for (uint i = 0; i < graph.getSuccessorsCount(block); i++)
+        {
+            const ControlFlowGraph::Edge& edge = graph.getSuccessor(block, i);
+            if (ControlFlowGraph::EDGE_CALL == edge.m_kind)
+                continue;
+            if ((ControlFlowGraph::EDGE_FALLTHROUGH == edge.m_kind) &&
+                !isFallingThrough)
+                continue;
+
+            uint target = edge.m_block;
+            uint targetFunction = callGraph.getBlockFunction(target);
+            if (targetFunction != function)
+            {
+                // A tail call returns if the function returns. Code which is
+                // shared with another function is assumed to return.
+                if ((CallGraph::NO_FUNCTION == targetFunction) ||
+                    (callGraph.getFunction(targetFunction).m_block != target) ||
+                    (0 != m_isReturning[targetFunction]))
+                    return true;
+                continue;
+            }
+
+            if (m_blockMarks[target] == m_mark)
+                continue;
+            m_blockMarks[target] = m_mark;
+            m_stack[stackCount++] = target;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,228 @@
+#include "dismount/dismount.h"
+/*
+ * PagedBitset.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/PagedBitset.h"
+
+// The initial number of directory slots and allocated pages
+enum {
+    DIRECTORY_INITIAL_SIZE = 64,
+    PAGES_INITIAL_COUNT = 16
+};
+
+PagedBitset::PagedBitset() :
+    m_pagesCount(0),
+    m_lastPage(0),
+    m_lastIndex(EMPTY_SLOT)
+{
+    clear();
+}
+
+void PagedBitset::clear()
+{
+    m_directory.changeSize(DIRECTORY_INITIAL_SIZE);
+    for (uint i = 0; i < DIRECTORY_INITIAL_SIZE; i++)
+        m_directory[i].m_index = EMPTY_SLOT;
+    m_words.changeSize(PAGES_INITIAL_COUNT * PAGE_WORDS);
+    m_pagesCount = 0;
+    m_lastPage = 0;
+    m_lastIndex = EMPTY_SLOT;
+}
+
+uint PagedBitset::getPagesCount() const
+{
+    return m_pagesCount;
+}
+
+const uint32* PagedBitset::findPage(ProcessorAddress::uintAddress page) const
+{
+    if ((m_lastIndex != EMPTY_SLOT) && (m_lastPage == page))
+        return m_words.getBuffer() + m_lastIndex * PAGE_WORDS;
+
+    const uint32* words = lookupPage(page);
+    if (words != NULL)
+    {
+        m_lastPage = page;
+        m_lastIndex = (uint)((words - m_words.getBuffer()) / PAGE_WORDS);
+    }
+    return words;
+}
+
+const uint32* PagedBitset::lookupPage(ProcessorAddress::uintAddress page) const
+{
+    uint mask = m_directory.getSize() - 1;
+    uint slot = hashAddress(page, mask);
+    while (m_directory[slot].m_index != EMPTY_SLOT)
+    {
+        if (m_directory[slot].m_page == page)
+            return m_words.getBuffer() + m_directory[slot].m_index * PAGE_WORDS;
+        slot = (slot + 1) & mask;
+    }
+
+    return NULL;
+}
+
+uint32* PagedBitset::getPage(ProcessorAddress::uintAddress page)
+{
+    const uint32* words = findPage(page);
+    if (words != NULL)
+        return (uint32*)words;
+
+    // Keep the directory load factor at most 50%
+    if ((m_pagesCount + 1) * 2 > m_directory.getSize())
+        growDirectory();
+
+    // Allocate a new page, grow the pages geometrically
+    if ((m_pagesCount + 1) * PAGE_WORDS > m_words.getSize())
+        m_words.changeSize(m_words.getSize() * 2);
+    uint index = m_pagesCount++;
+    uint32* newPage = m_words.getBuffer() + index * PAGE_WORDS;
+    memset(newPage, 0, PAGE_WORDS * sizeof(uint32));
+
+    uint mask = m_directory.getSize() - 1;
+    uint slot = hashAddress(page, mask);
+    while (m_directory[slot].m_index != EMPTY_SLOT)
+        slot = (slot + 1) & mask;
+    m_directory[slot].m_page = page;
+    m_directory[slot].m_index = index;
+
+    m_lastPage = page;
+    m_lastIndex = index;
+    return newPage;
+}
+
+void PagedBitset::growDirectory()
+{
+    cSArray<Slot> old(m_directory);
+    uint size = old.getSize() * 2;
+    m_directory.changeSize(size);
+    for (uint i = 0; i < size; i++)
+        m_directory[i].m_index = EMPTY_SLOT;
+
+    uint mask = size - 1;
+    for (uint i = 0; i < old.getSize(); i++)
+    {
+        if (old[i].m_index == EMPTY_SLOT)
+            continue;
+        uint slot = hashAddress(old[i].m_page, mask);
+        while (m_directory[slot].m_index != EMPTY_SLOT)
+            slot = (slot + 1) & mask;
+        m_directory[slot] = old[i];
+    }
+}
+
+uint32 PagedBitset::getWordMask(uint first, uint last)
+{
+    // Bits 'first' up to the end, minus the bits above 'last'
+    uint32 mask = 0xFFFFFFFF << first;
+    if (last < (WORD_BITS - 1))
+        mask&= ~(0xFFFFFFFF << (last + 1));
+    return mask;
+}
+
+bool PagedBitset::isSet(ProcessorAddress::uintAddress address) const
+{
+    const uint32* words = findPage(address >> PAGE_SHIFT);
+    if (words == NULL)
+        return false;
+
+    uint bit = (uint)(address & (PAGE_SIZE - 1));
+    return (words[bit >> WORD_SHIFT] >> (bit & (WORD_BITS - 1))) & 1;
+}
+
+bool PagedBitset::isSetConcurrent(ProcessorAddress::uintAddress address) const
+{
+    const uint32* words = lookupPage(address >> PAGE_SHIFT);
+    if (words == NULL)
+        return false;
+
+    uint bit = (uint)(address & (PAGE_SIZE - 1));
+    return (words[bit >> WORD_SHIFT] >> (bit & (WORD_BITS - 1))) & 1;
+}
+
+void PagedBitset::set(ProcessorAddress::uintAddress address)
+{
+    uint32* words = getPage(address >> PAGE_SHIFT);
+    uint bit = (uint)(address & (PAGE_SIZE - 1));
+    words[bit >> WORD_SHIFT]|= 1U << (bit & (WORD_BITS - 1));
+}
+
+void PagedBitset::setRange(ProcessorAddress::uintAddress start,
+                           ProcessorAddress::uintAddress length)
+{
+    while (length > 0)
+    {
+        // The part of the range inside the current page
+        uint first = (uint)(start & (PAGE_SIZE - 1));
+        uint count = (uint)t_min(length,
+                        (ProcessorAddress::uintAddress)(PAGE_SIZE - first));
+        uint last = first + count - 1;
+        uint32* words = getPage(start >> PAGE_SHIFT);
+
+        uint firstWord = first >> WORD_SHIFT;
+        uint lastWord = last >> WORD_SHIFT;
+        if (firstWord == lastWord)
+        {
+            words[firstWord]|= getWordMask(first & (WORD_BITS - 1),
+                                           last & (WORD_BITS - 1));
+        } else
+        {
+            words[firstWord]|= getWordMask(first & (WORD_BITS - 1),
+                                           WORD_BITS - 1);
+            for (uint i = firstWord + 1; i < lastWord; i++)
+                words[i] = 0xFFFFFFFF;
+            words[lastWord]|= getWordMask(0, last & (WORD_BITS - 1));
+        }
+
+        start+= count;
+        length-= count;
+    }
+}
+
+bool PagedBitset::isAnySet(ProcessorAddress::uintAddress start,
+                           ProcessorAddress::uintAddress length) const
+{
+    while (length > 0)
+    {
+        uint first = (uint)(start & (PAGE_SIZE - 1));
+        uint count = (uint)t_min(length,
+                        (ProcessorAddress::uintAddress)(PAGE_SIZE - first));
+        uint last = first + count - 1;
+        const uint32* words = findPage(start >> PAGE_SHIFT);
+
+        if (words != NULL)
+        {
+            uint firstWord = first >> WORD_SHIFT;
+            uint lastWord = last >> WORD_SHIFT;
+            if (firstWord == lastWord)
+            {
+                if ((words[firstWord] & getWordMask(first & (WORD_BITS - 1),
+                                                    last & (WORD_BITS - 1))) != 0)
+                    return true;
+            } else
+            {
+                if ((words[firstWord] & getWordMask(first & (WORD_BITS - 1),
+                                                    WORD_BITS - 1)) != 0)
+                    return true;
+                for (uint i = firstWord + 1; i < lastWord; i++)
+                    if (words[i] != 0)
+                        return true;
+                if ((words[lastWord] & getWordMask(0, last & (WORD_BITS - 1))) != 0)
+                    return true;
+            }
+        }
+
+        start+= count;
+        length-= count;
+    }
+
+    return false;
+}
@@ -0,0 +1,983 @@
+#include "dismount/dismount.h"
+/*
+ * ParallelFlowMapper.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/lock.h"
+#include "xStl/os/mutex.h"
+#include "xStl/os/thread.h"
+#include "xStl/os/event.h"
+#include "xStl/data/list.h"
+#include "xStl/data/array.h"
+#include "xStl/data/endian.h"
+#include "xStl/except/trace.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "dismount/Opcode.h"
+#include "dismount/OpcodeSubsystems.h"
+#include "dismount/StreamDisassemblerFactory.h"
+#include "dismount/DisassemblerEndOfStreamException.h"
+#include "dismount/FlowMapperException.h"
+#include "dismount/proc/ia32/opcodeTable.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/ParallelFlowMapper.h"
+
+/*
+ * The state of a single worker. Kept between the rounds.
+ */
+struct ParallelFlowMapper::WorkerContext {
+    WorkerContext(const BasicInputPtr& stream,
+                  OpcodeSubsystems::DisassemblerType type) :
+        m_disassembler(StreamDisassemblerFactory::disassemble(
+                type,
+                stream,
+                true,
+                ProcessorAddress(ProcessorAddress::PROCESSOR_32, 0), false)),
+        m_formatter(OPCODE_MARGIN),
+        m_next(0),
+        m_end(0),
+        m_blocksCount(0),
+        m_instructionsCount(0),
+        m_branchesCount(0),
+        m_isFailed(false)
+    {
+    }
+
+    // The disassembler over the worker's own stream
+    StreamDisassemblerPtr m_disassembler;
+    // Signaled when a round starts or the workers are stopped
+    cEvent m_roundStart;
+    // Used to parse the branches operands
+    DefaultOpcodeDataFormatter m_formatter;
+
+    // The range of frontier items left for this worker, guarded by m_lock
+    cMutex m_lock;
+    uint m_next;
+    uint m_end;
+
+    // The results of the current round. Block indexes refer to these arrays.
+    cSArray<Block> m_blocks;
+    uint m_blocksCount;
+    cSArray<Instruction> m_instructions;
+    uint m_instructionsCount;
+    cSArray<Branch> m_branches;
+    uint m_branchesCount;
+
+    // Set if the worker caught an exception
+    bool m_isFailed;
+};
+
+/*
+ * Walks the frontier items of each round until there are no items left in the
+ * round, until the workers are stopped
+ */
+class ParallelFlowMapper::Worker : public cThread {
+public:
+    Worker(ParallelFlowMapper& owner, uint index) :
+        m_owner(owner),
+        m_index(index)
+    {
+    }
+
+protected:
+    virtual uint run(void*)
+    {
+        WorkerContext& context = *m_owner.m_workers[m_index];
+        uint round = 0;
+        while (m_owner.waitRound(context, round))
+        {
+            XSTL_TRY
+            {
+                uint item;
+                while (m_owner.takeItem(m_index, item))
+                    m_owner.walk(context, m_owner.m_frontier[item]);
+            }
+            XSTL_CATCH_ALL
+            {
+                context.m_isFailed = true;
+            }
+            m_owner.endRound();
+        }
+        return 0;
+    }
+
+private:
+    ParallelFlowMapper& m_owner;
+    uint m_index;
+};
+
+ParallelFlowMapper::ParallelFlowMapper(
+        const BasicInputPtr& image,
+        const SectionMemoryInterfacePtr& memoryInterface,
+        uint workersCount,
+        OpcodeSubsystems::DisassemblerType type) :
+    m_memoryInterface(memoryInterface),
+    m_image(image->length()),
+    m_workers(workersCount),
+    m_round(0),
+    m_activeWorkers(0),
+    m_isStopping(false),
+    m_entriesCount(0),
+    m_frontierCount(0),
+    m_blocksCount(0),
+    m_instructionsCount(0),
+    m_heldBranchesCount(0),
+    m_potentialsCount(0),
+    m_unknownBranchesCount(0),
+    m_fallThroughsCount(0)
+{
+    CHECK(workersCount > 0);
+    CHECK(!m_memoryInterface.isEmpty());
+
+    // Read the whole image once. The stream position is kept.
+    uint position = image->getPointer();
+    image->seek(0, basicInput::IO_SEEK_SET);
+    image->pipeRead(m_image.getBuffer(), m_image.getSize());
+    image->seek(position, basicInput::IO_SEEK_SET);
+
+    // Each worker reads the buffer with its own stream
+    addressNumericValue start = getNumeric(m_image.getBuffer());
+    addressNumericValue end = start + m_image.getSize();
+    for (uint i = 0; i < workersCount; i++)
+    {
+        cVirtualMemoryAccesserPtr memory(new cThreadUnsafeMemoryAccesser());
+        BasicInputPtr stream(new cMemoryAccesserStream(memory, start, end));
+        m_workers[i] = WorkerContextPtr(new WorkerContext(stream, type));
+    }
+}
+
+ParallelFlowMapper::~ParallelFlowMapper()
+{
+    stopWorkers();
+}
+
+void ParallelFlowMapper::addEntryPoint(addressNumericValue address,
+                                       addressNumericValue forcedEnd)
+{
+    WorkItem item;
+    item.m_address = address;
+    item.m_forcedEnd = forcedEnd;
+    item.m_callerAddress = 0;
+    item.m_callerAlterProperty = Opcode::FLOW_NO_ALTER;
+    appendItem(m_entries, m_entriesCount, item);
+}
+
+void ParallelFlowMapper::addNoReturn(addressNumericValue address)
+{
+    m_noReturns.add(address);
+}
+
+bool ParallelFlowMapper::isEntryBefore(const WorkItem& a,
+                                       const WorkItem& b)
+{
+    if (a.m_address != b.m_address)
+        return a.m_address < b.m_address;
+    return a.m_forcedEnd < b.m_forcedEnd;
+}
+
+bool ParallelFlowMapper::isItemBefore(const WorkItem& a,
+                                      const WorkItem& b)
+{
+    return a.m_address < b.m_address;
+}
+
+bool ParallelFlowMapper::isBranchBefore(const Branch& a,
+                                        const Branch& b)
+{
+    if (a.m_target != b.m_target)
+        return a.m_target < b.m_target;
+    if (a.m_type != b.m_type)
+        return a.m_type > b.m_type;
+    return a.m_callerAddress < b.m_callerAddress;
+}
+
+bool ParallelFlowMapper::isCallerBefore(const Branch& a,
+                                        const Branch& b)
+{
+    return a.m_callerAddress < b.m_callerAddress;
+}
+
+uint ParallelFlowMapper::map()
+{
+    // Claim the entry points, in address order
+    heapSort(m_entries.getBuffer(), m_entriesCount, isEntryBefore);
+    m_frontierCount = 0;
+    for (uint i = 0; i < m_entriesCount; i++)
+    {
+        // Entry points inside visited code are ignored, as with FlowMapper
+        if (m_claimed.isSet(m_entries[i].m_address) ||
+            m_walkedInstructions.isSet(m_entries[i].m_address))
+            continue;
+        m_claimed.set(m_entries[i].m_address);
+        appendItem(m_frontier, m_frontierCount, m_entries[i]);
+    }
+    m_entriesCount = 0;
+
+    // The workers search the set concurrently
+    m_noReturns.sort();
+
+    // Walk round after round until no new targets are found
+    startWorkers();
+    bool isFailed = false;
+    while ((m_frontierCount > 0) && !isFailed)
+    {
+        isFailed = !runRound();
+        if (!isFailed)
+            mergeRound();
+    }
+    stopWorkers();
+
+    // One of the workers failed
+    CHECK(!isFailed);
+
+    // The blocks are split by the fall-through targets inside them
+    cList<FlowMapper::CodeSubset> listMap;
+    getMapList(listMap);
+    return listMap.length();
+}
+
+void ParallelFlowMapper::startWorkers()
+{
+    // The threads of a map which was stopped by an exception are reused
+    if (m_threads.length() > 0)
+        return;
+
+    // The new threads start before the first round
+    m_round = 0;
+    m_isStopping = false;
+    for (uint i = 0; i < m_workers.getSize(); i++)
+    {
+        cSmartPtr<Worker> worker(new Worker(*this, i));
+        m_threads.append(worker);
+        worker->start();
+    }
+}
+
+void ParallelFlowMapper::stopWorkers()
+{
+    {
+        cLock lock(m_poolLock);
+        m_isStopping = true;
+        for (uint i = 0; i < m_workers.getSize(); i++)
+            m_workers[i]->m_roundStart.setEvent();
+    }
+
+    cList<cSmartPtr<Worker> >::iterator w = m_threads.begin();
+    for (; w != m_threads.end(); ++w)
+        (*w)->wait();
+    m_threads.removeAll();
+}
+
+bool ParallelFlowMapper::runRound()
+{
+    // Split the frontier evenly, the workers balance it by stealing
+    uint workers = m_workers.getSize();
+    for (uint i = 0; i < workers; i++)
+    {
+        WorkerContext& context = *m_workers[i];
+        context.m_next = (uint)(((uint64)m_frontierCount * i) / workers);
+        context.m_end = (uint)(((uint64)m_frontierCount * (i + 1)) / workers);
+        context.m_isFailed = false;
+    }
+
+    // Start the round
+    {
+        cLock lock(m_poolLock);
+        m_round++;
+        m_activeWorkers = workers;
+        for (uint i = 0; i < workers; i++)
+            m_workers[i]->m_roundStart.setEvent();
+    }
+
+    // And wait for all the workers to finish it
+    while (true)
+    {
+        {
+            cLock lock(m_poolLock);
+            if (0 == m_activeWorkers)
+                break;
+            m_roundEnd.resetEvent();
+        }
+        m_roundEnd.wait();
+    }
+
+    bool isFailed = false;
+    for (uint i = 0; i < workers; i++)
+        isFailed = isFailed || m_workers[i]->m_isFailed;
+    return !isFailed;
+}
+
+bool ParallelFlowMapper::waitRound(WorkerContext& context, uint& round)
+{
+    while (true)
+    {
+        {
+            cLock lock(m_poolLock);
+            if (m_isStopping)
+                return false;
+            if (m_round != round)
+            {
+                round = m_round;
+                return true;
+            }
+            context.m_roundStart.resetEvent();
+        }
+        context.m_roundStart.wait();
+    }
+}
+
+void ParallelFlowMapper::endRound()
+{
+    cLock lock(m_poolLock);
+    m_activeWorkers--;
+    if (0 == m_activeWorkers)
+        m_roundEnd.setEvent();
+}
+
+bool ParallelFlowMapper::takeItem(uint index, uint& item)
+{
+    WorkerContext& own = *m_workers[index];
+    {
+        cLock lock(own.m_lock);
+        if (own.m_next < own.m_end)
+        {
+            item = own.m_next++;
+            return true;
+        }
+    }
+
+    // Steal the upper half of the range of another worker
+    uint workers = m_workers.getSize();
+    for (uint i = 1; i < workers; i++)
+    {
+        WorkerContext& victim = *m_workers[(index + i) % workers];
+        uint start;
+        uint end;
+        {
+            cLock lock(victim.m_lock);
+            uint left = victim.m_end - victim.m_next;
+            if (left == 0)
+                continue;
+            end = victim.m_end;
+            start = victim.m_next + left / 2;
+            victim.m_end = start;
+        }
+
+        // Keep the first stolen item, the rest is our new range
+        cLock lock(own.m_lock);
+        item = start;
+        own.m_next = start + 1;
+        own.m_end = end;
+        return true;
+    }
+
+    return false;
+}
+
+void ParallelFlowMapper::walk(WorkerContext& context, const WorkItem& item)
+{
+    uint rawAddress = m_memoryInterface->virtualToRawAddress(item.m_address);
+    if (0 == rawAddress)
+        return;
+
+    Block block;
+    block.m_start = item.m_address;
+    block.m_end = item.m_address;
+    block.m_callerAddress = item.m_callerAddress;
+    block.m_callerAlterProperty = item.m_callerAlterProperty;
+    block.m_endAlterProperty = Opcode::FLOW_NO_ALTER;
+    block.m_firstAlterProperty = Opcode::FLOW_NO_ALTER;
+    block.m_isPotential = false;
+    block.m_isCut = false;
+    block.m_isFallThrough = false;
+    block.m_firstInstruction = context.m_instructionsCount;
+    block.m_instructionsCount = 0;
+    block.m_firstBranch = context.m_branchesCount;
+    block.m_branchesCount = 0;
+
+    StreamDisassembler& disassembler = *context.m_disassembler;
+    disassembler.jumpToAddress(ProcessorAddress(ProcessorAddress::PROCESSOR_32,
+                                                item.m_address),
+                               rawAddress);
+
+    addressNumericValue imageBase = m_memoryInterface->getImageBase();
+    bool hasInstruction = false;
+    FlowMapper::SwitchGuard switchGuard;
+
+    // Loop until a break or an End-Of-Stream exception
+    XSTL_TRY
+    {
+        while (true)
+        {
+            OpcodePtr opcode = disassembler.next();
+            ProcessorAddress currAddress(gNullPointerProcessorAddress);
+            if (!opcode->getOpcodeAddress(currAddress))
+                XSTL_THROW(FlowMapperException);
+            addressNumericValue address = currAddress.getAddress();
+            int alterProperty = opcode->getAlterProperty();
+
+            // The end of the subset is this opcode
+            hasInstruction = true;
+            block.m_end = address;
+            block.m_endAlterProperty = alterProperty;
+
+            // Check if we reached the forced end
+            if ((0 != item.m_forcedEnd) && (item.m_forcedEnd <= address))
+            {
+                block.m_isPotential = (0 == (Opcode::FLOW_RET & alterProperty));
+                break;
+            }
+
+            // Code which was claimed or walked in an earlier round is mapped
+            // already. The subset falls through into it, as a sequential
+            // walk that reaches visited code.
+            if ((address != item.m_address) &&
+                (m_claimed.isSetConcurrent(address) ||
+                 m_walkedInstructions.isSetConcurrent(address)))
+            {
+                block.m_isFallThrough = true;
+                break;
+            }
+
+            if (0 == block.m_instructionsCount)
+                block.m_firstAlterProperty = alterProperty;
+            Instruction instruction;
+            instruction.m_offset = (uint32)(address - block.m_start);
+            instruction.m_alterProperty = (uint16)alterProperty;
+            appendItem(context.m_instructions, context.m_instructionsCount,
+                       instruction);
+            block.m_instructionsCount++;
+
+            // Check if the address is defined as executable
+            if (!m_memoryInterface->checkAddress(address,
+                        SectionMemoryInterface::SECTION_FLAG_EXECUTABLE))
+                break;
+
+            // Track the bound check of a switch statement
+            uint switchEntriesCount = switchGuard.update(opcode);
+
+            if (!opcode->isBranch())
+                continue;
+
+            // Returns and invalid opcodes end the subset
+            if ((Opcode::FLOW_RETF == alterProperty) ||
+                (0 != (Opcode::FLOW_RET & alterProperty)))
+                break;
+            if (Opcode::FLOW_INVALID == alterProperty)
+            {
+                block.m_isPotential = true;
+                break;
+            }
+
+            bool jmpAlways =
+                (Opcode::FLOW_COND_ALWAYS == alterProperty) ||
+                ((Opcode::FLOW_COND_ALWAYS | Opcode::FLOW_ACTION) == alterProperty);
+
+            // Calls to functions which don't return end the subset like a JMP
+            bool isCall = (0 != (Opcode::FLOW_STACK_CHANGE & alterProperty));
+
+            Branch branch;
+            branch.m_callerAddress = address;
+            branch.m_callerAlterProperty = alterProperty;
+            branch.m_entriesCount = FlowMapper::SWITCH_NO_BOUND;
+
+            // Don't walk the jump table of a switch statement, its entries
+            // are read after the round
+            if (opcode->isSwitch())
+            {
+                branch.m_target = opcode->getSwitchTableOffset() - imageBase;
+                branch.m_type = BRANCH_SWITCH_TABLE;
+                branch.m_entriesCount = switchEntriesCount;
+                appendItem(context.m_branches, context.m_branchesCount, branch);
+                block.m_branchesCount++;
+            }
+
+            // Get the address to jump to from the opcode operand
+            OpcodeFormatterPtr formatter =
+                disassembler.getOpcodeFormat(opcode, context.m_formatter);
+            ProcessorAddress jmpAddress(gNullPointerProcessorAddress);
+            uint operandType = formatter->parseOperandAddress(jmpAddress);
+            addressNumericValue target = jmpAddress.getAddress();
+
+            // Only 'relocated' addresses in a writable section are kept,
+            // without their destination
+            if (ia32dis::OPND_MODRM_dWORDPTR == operandType)
+            {
+                if (isCall && m_noReturns.containsSorted(target - imageBase))
+                    jmpAlways = true;
+                if (m_memoryInterface->checkAddress(target - imageBase,
+                        SectionMemoryInterface::SECTION_FLAG_WRITE))
+                    target = 0;
+                else if (jmpAlways)
+                    break;
+                else
+                    continue;
+            }
+
+            else if (isCall && m_noReturns.containsSorted(target))
+                jmpAlways = true;
+
+            // Non-executable destinations are treated as normal opcodes
+            if ((0 != target) &&
+                !m_memoryInterface->checkAddress(target,
+                        SectionMemoryInterface::SECTION_FLAG_EXECUTABLE))
+            {
+                if (jmpAlways)
+                    break;
+                continue;
+            }
+
+            branch.m_target = target;
+            branch.m_type = BRANCH_TARGET;
+            appendItem(context.m_branches, context.m_branchesCount, branch);
+            block.m_branchesCount++;
+
+            if (jmpAlways)
+                break;
+        }
+    }
+    XSTL_CATCH (DisassemblerEndOfStreamException&)
+    {
+        // End of stream. The subset ends at the last opcode.
+    }
+    XSTL_CATCH (cException&)
+    {
+        // Invalid opcode or unreadable address
+        block.m_isPotential = true;
+    }
+
+    if (!hasInstruction)
+    {
+        // Nothing was decoded, forget the branches
+        context.m_instructionsCount = block.m_firstInstruction;
+        context.m_branchesCount = block.m_firstBranch;
+        return;
+    }
+
+    block.m_walkEnd = block.m_end;
+    appendItem(context.m_blocks, context.m_blocksCount, block);
+}
+
+void ParallelFlowMapper::mergeRound()
+{
+    cSArray<Branch> branches;
+    uint branchesCount = 0;
+    uint firstNewPotential = m_potentialsCount;
+
+    // Collect the results of the workers. The order doesn't matter, the
+    // branches are sorted and the blocks have unique start addresses.
+    for (uint w = 0; w < m_workers.getSize(); w++)
+    {
+        WorkerContext& context = *m_workers[w];
+        for (uint i = 0; i < context.m_blocksCount; i++)
+        {
+            Block block = context.m_blocks[i];
+
+            uint first = block.m_firstInstruction;
+            block.m_firstInstruction = m_instructionsCount;
+            for (uint j = 0; j < block.m_instructionsCount; j++)
+            {
+                const Instruction& instruction = context.m_instructions[first + j];
+                appendItem(m_instructions, m_instructionsCount, instruction);
+
+                addressNumericValue address = block.m_start + instruction.m_offset;
+                if (m_walkedInstructions.isSet(address))
+                    m_sharedInstructions.set(address);
+                else
+                    m_walkedInstructions.set(address);
+            }
+
+            first = block.m_firstBranch;
+            if (block.m_isPotential)
+            {
+                // Hold the branches until the subset is reached
+                block.m_firstBranch = m_heldBranchesCount;
+                for (uint j = 0; j < block.m_branchesCount; j++)
+                    appendItem(m_heldBranches, m_heldBranchesCount,
+                               context.m_branches[first + j]);
+
+                BlockOrder order;
+                order.m_start = block.m_start;
+                order.m_index = m_blocksCount;
+                TailOrder tail;
+                tail.m_walkEnd = block.m_walkEnd;
+                tail.m_start = block.m_start;
+                tail.m_index = m_blocksCount;
+                // Both orders share m_potentialsCount
+                uint count = m_potentialsCount;
+                appendItem(m_potentials, count, order);
+                appendItem(m_tails, m_potentialsCount, tail);
+            } else
+            {
+                for (uint j = 0; j < block.m_branchesCount; j++)
+                    appendItem(branches, branchesCount,
+                               context.m_branches[first + j]);
+            }
+
+            if (block.m_isFallThrough)
+            {
+                // The edge from the last instruction into the earlier code
+                const Instruction& last = m_instructions[m_instructionsCount - 1];
+                Branch fallThrough;
+                fallThrough.m_target = block.m_end;
+                fallThrough.m_callerAddress = block.m_start + last.m_offset;
+                fallThrough.m_callerAlterProperty = last.m_alterProperty;
+                fallThrough.m_type = BRANCH_TARGET;
+                fallThrough.m_entriesCount = FlowMapper::SWITCH_NO_BOUND;
+                appendItem(m_fallThroughs, m_fallThroughsCount, fallThrough);
+                m_fallThroughTargets.set(block.m_end);
+            }
+
+            appendItem(m_blocks, m_blocksCount, block);
+        }
+
+        context.m_blocksCount = 0;
+        context.m_instructionsCount = 0;
+        context.m_branchesCount = 0;
+    }
+
+    // Keep the potential blocks sorted, only the new ones are sorted
+    mergeSorted(m_potentials, firstNewPotential, m_potentialsCount, isOrderBefore);
+    mergeSorted(m_tails, firstNewPotential, m_potentialsCount, isTailBefore);
+
+    cutPotentials(branches, branchesCount);
+
+    // Claim the targets. Promoted potential blocks release their branches,
+    // which are claimed in the next pass.
+    m_frontierCount = 0;
+    while (branchesCount > 0)
+    {
+        heapSort(branches.getBuffer(), branchesCount, isBranchBefore);
+        cSArray<Branch> promoted;
+        uint promotedCount = 0;
+        claimBranches(branches, branchesCount, promoted, promotedCount);
+        branches = promoted;
+        branchesCount = promotedCount;
+    }
+
+    heapSort(m_frontier.getBuffer(), m_frontierCount, isItemBefore);
+}
+
+void ParallelFlowMapper::claimBranches(const cSArray<Branch>& branches,
+                                       uint count,
+                                       cSArray<Branch>& promoted,
+                                       uint& promotedCount)
+{
+    for (uint i = 0; i < count; i++)
+    {
+        const Branch& branch = branches[i];
+
+        if (BRANCH_SWITCH_TABLE == branch.m_type)
+        {
+            m_claimed.set(branch.m_target);
+            readSwitchTable(branch, promoted, promotedCount);
+            continue;
+        }
+
+        // Branches without a known destination
+        if (0 == branch.m_target)
+        {
+            appendItem(m_unknownBranches, m_unknownBranchesCount, branch);
+            continue;
+        }
+
+        // The first branch to the target walks it, unless it was walked as
+        // part of another block. FlowMapper ignores such branches as well.
+        if (!m_claimed.isSet(branch.m_target))
+        {
+            m_claimed.set(branch.m_target);
+            if (m_walkedInstructions.isSet(branch.m_target))
+                continue;
+
+            WorkItem item;
+            item.m_address = branch.m_target;
+            item.m_forcedEnd = 0;
+            item.m_callerAddress = branch.m_callerAddress;
+            item.m_callerAlterProperty = branch.m_callerAlterProperty;
+            appendItem(m_frontier, m_frontierCount, item);
+            continue;
+        }
+
+        // A branch into a potential subset promotes it
+        uint index = findPotential(branch.m_target);
+        if ((index != m_blocksCount) && m_blocks[index].m_isPotential)
+        {
+            Block& block = m_blocks[index];
+            block.m_isPotential = false;
+            for (uint j = 0; j < block.m_branchesCount; j++)
+                appendItem(promoted, promotedCount,
+                           m_heldBranches[block.m_firstBranch + j]);
+        }
+    }
+}
+
+void ParallelFlowMapper::readSwitchTable(const Branch& table,
+                                         cSArray<Branch>& branches,
+                                         uint& branchesCount)
+{
+    uint entriesCount = table.m_entriesCount;
+    bool isBounded = (FlowMapper::SWITCH_NO_BOUND != entriesCount);
+    if (!isBounded)
+        entriesCount = FlowMapper::SWITCH_MAX_ENTRIES;
+
+    uint length = m_image.getSize();
+    addressNumericValue imageBase = m_memoryInterface->getImageBase();
+
+    for (uint i = 0; i < entriesCount; i++)
+    {
+        addressNumericValue entryAddress = table.m_target + i * sizeof(uint32);
+        if (!isBounded && (0 != i) &&
+            (m_claimed.isSet(entryAddress) ||
+             m_walkedInstructions.isSet(entryAddress)))
+            break;
+
+        uint rawAddress = m_memoryInterface->virtualToRawAddress(entryAddress);
+        if ((0 == rawAddress) || ((rawAddress + sizeof(uint32)) > length))
+            break;
+
+        addressNumericValue value =
+            cLittleEndian::readUint32(m_image.getBuffer() + rawAddress);
+        if (value < imageBase)
+            break;
+
+        addressNumericValue target = value - imageBase;
+        if (!m_memoryInterface->checkAddress(target,
+                SectionMemoryInterface::SECTION_FLAG_EXECUTABLE))
+            break;
+
+        m_claimed.set(entryAddress);
+
+        Branch branch;
+        branch.m_target = target;
+        branch.m_callerAddress = table.m_callerAddress;
+        branch.m_callerAlterProperty = table.m_callerAlterProperty;
+        branch.m_type = BRANCH_TARGET;
+        branch.m_entriesCount = FlowMapper::SWITCH_NO_BOUND;
+        appendItem(branches, branchesCount, branch);
+    }
+}
+
+bool ParallelFlowMapper::isTailBefore(const TailOrder& a,
+                                      const TailOrder& b)
+{
+    if (a.m_walkEnd != b.m_walkEnd)
+        return a.m_walkEnd < b.m_walkEnd;
+    return a.m_start < b.m_start;
+}
+
+void ParallelFlowMapper::cutPotentials(cSArray<Branch>& branches,
+                                       uint& branchesCount)
+{
+    // Walks which reach the same instruction decode the same code from there
+    // on, and end at the same address. All the blocks which were ever
+    // potential are grouped by their walk end.
+    const cSArray<TailOrder>& tails = m_tails;
+    uint i = 0;
+    while (i < m_potentialsCount)
+    {
+        uint groupEnd = i;
+        bool hasOwner = false;
+        while ((groupEnd < m_potentialsCount) &&
+               (tails[groupEnd].m_walkEnd == tails[i].m_walkEnd))
+        {
+            // A promoted block owns the shared code
+            const Block& block = m_blocks[tails[groupEnd].m_index];
+            if (!block.m_isPotential && !block.m_isCut)
+                hasOwner = true;
+            groupEnd++;
+        }
+
+        // Without a promoted block, the lowest block keeps the shared code
+        // potential, as the first walk of a sequential mapping. The others
+        // end where they reach the shared code.
+        for (; i < groupEnd; i++)
+        {
+            Block& block = m_blocks[tails[i].m_index];
+            if (!block.m_isPotential)
+                continue;
+            if (!hasOwner)
+            {
+                hasOwner = true;
+                continue;
+            }
+            cutBlock(block, branches, branchesCount);
+        }
+    }
+}
+
+void ParallelFlowMapper::cutBlock(Block& block,
+                                  cSArray<Branch>& branches,
+                                  uint& branchesCount)
+{
+    // Quick test for any shared instruction after the first one
+    if (block.m_end <= block.m_start)
+        return;
+    if (!m_sharedInstructions.isAnySet(block.m_start + 1,
+                                       block.m_end - block.m_start))
+        return;
+
+    for (uint j = 1; j < block.m_instructionsCount; j++)
+    {
+        const Instruction& instruction =
+            m_instructions[block.m_firstInstruction + j];
+        addressNumericValue address = block.m_start + instruction.m_offset;
+        if (!m_sharedInstructions.isSet(address))
+            continue;
+
+        // The subset ends at the shared instruction, as a sequential walk
+        // that reaches visited code. The branches from 'address' on aren't
+        // part of it.
+        block.m_isPotential = false;
+        block.m_isCut = true;
+        block.m_end = address;
+        block.m_endAlterProperty = instruction.m_alterProperty;
+        block.m_instructionsCount = j + 1;
+        for (uint k = 0; k < block.m_branchesCount; k++)
+        {
+            const Branch& branch = m_heldBranches[block.m_firstBranch + k];
+            if (branch.m_callerAddress < address)
+                appendItem(branches, branchesCount, branch);
+        }
+        return;
+    }
+}
+
+uint ParallelFlowMapper::findPotential(addressNumericValue address) const
+{
+    uint low = 0;
+    uint high = m_potentialsCount;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        addressNumericValue start = m_potentials[middle].m_start;
+        if (start == address)
+            return m_potentials[middle].m_index;
+        if (start < address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return m_blocksCount;
+}
+
+bool ParallelFlowMapper::isOrderBefore(const BlockOrder& a,
+                                       const BlockOrder& b)
+{
+    return a.m_start < b.m_start;
+}
+
+void ParallelFlowMapper::getMapList(cList<FlowMapper::CodeSubset>& listMap)
+{
+    listMap.removeAll();
+
+    // All the walked subsets, by address
+    cSArray<BlockOrder> order;
+    uint orderCount = 0;
+    PagedBitset starts;
+    for (uint i = 0; i < m_blocksCount; i++)
+    {
+        BlockOrder entry;
+        entry.m_start = m_blocks[i].m_start;
+        entry.m_index = i;
+        appendItem(order, orderCount, entry);
+        starts.set(entry.m_start);
+    }
+    heapSort(order.getBuffer(), orderCount, isOrderBefore);
+    heapSort(m_fallThroughs.getBuffer(), m_fallThroughsCount, isBranchBefore);
+
+    PagedBitset splits;
+    for (uint i = 0; i < orderCount; i++)
+    {
+        const Block& block = m_blocks[order[i].m_index];
+        if (!block.m_isPotential)
+            appendSubsets(block, starts, splits, listMap);
+    }
+
+    // The branches without a known destination
+    heapSort(m_unknownBranches.getBuffer(), m_unknownBranchesCount, isCallerBefore);
+    for (uint i = 0; i < m_unknownBranchesCount; i++)
+    {
+        const Branch& branch = m_unknownBranches[i];
+        listMap.append(FlowMapper::CodeSubset(
+                ProcessorAddress(gNullPointerProcessorAddress),
+                ProcessorAddress(gNullPointerProcessorAddress),
+                ProcessorAddress(ProcessorAddress::PROCESSOR_32, branch.m_callerAddress),
+                Opcode::FLOW_NO_ALTER,
+                branch.m_callerAlterProperty));
+    }
+}
+
+void ParallelFlowMapper::appendSubsets(const Block& block,
+                                       const PagedBitset& starts,
+                                       PagedBitset& splits,
+                                       cList<FlowMapper::CodeSubset>& listMap)
+{
+    // The current subset, if it's open
+    bool isOpen = true;
+    addressNumericValue start = block.m_start;
+    addressNumericValue callerAddress = block.m_callerAddress;
+    int callerAlterProperty = block.m_callerAlterProperty;
+
+    for (uint i = 1; i < block.m_instructionsCount; i++)
+    {
+        const Instruction& instruction = m_instructions[block.m_firstInstruction + i];
+        addressNumericValue address = block.m_start + instruction.m_offset;
+        bool isStart = starts.isSet(address);
+        if (!isStart && !m_fallThroughTargets.isSet(address))
+            continue;
+
+        // End the subset at the subset it falls into, potential or not
+        if (isOpen)
+        {
+            listMap.append(FlowMapper::CodeSubset(
+                    ProcessorAddress(ProcessorAddress::PROCESSOR_32, start),
+                    ProcessorAddress(ProcessorAddress::PROCESSOR_32, address),
+                    ProcessorAddress(ProcessorAddress::PROCESSOR_32, callerAddress),
+                    instruction.m_alterProperty,
+                    callerAlterProperty));
+            isOpen = false;
+        }
+
+        // The code from here is listed by the other block or split, until a
+        // block which was walked later falls through back into this one
+        if (isStart || splits.isSet(address))
+            continue;
+
+        // The code from here is the subset of the fall-through into it
+        splits.set(address);
+        const Branch& fallThrough = findFallThrough(address);
+        isOpen = true;
+        start = address;
+        callerAddress = fallThrough.m_callerAddress;
+        callerAlterProperty = fallThrough.m_callerAlterProperty;
+    }
+
+    if (isOpen)
+        listMap.append(FlowMapper::CodeSubset(
+                ProcessorAddress(ProcessorAddress::PROCESSOR_32, start),
+                ProcessorAddress(ProcessorAddress::PROCESSOR_32, block.m_end),
+                ProcessorAddress(ProcessorAddress::PROCESSOR_32, callerAddress),
+                block.m_endAlterProperty,
+                callerAlterProperty));
+}
+
+const ParallelFlowMapper::Branch& ParallelFlowMapper::findFallThrough(
+        addressNumericValue address) const
+{
+    uint low = 0;
+    uint high = m_fallThroughsCount;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        if (m_fallThroughs[middle].m_target < address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    CHECK((low < m_fallThroughsCount) && (m_fallThroughs[low].m_target == address));
+    return m_fallThroughs[low];
+}
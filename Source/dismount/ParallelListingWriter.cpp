@@ -0,0 +1,322 @@
+#include "dismount/dismount.h"
+/*
+ * ParallelListingWriter.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/os.h"
+#include "xStl/os/lock.h"
+#include "xStl/os/mutex.h"
+#include "xStl/os/thread.h"
+#include "xStl/os/event.h"
+#include "xStl/data/list.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/StreamDisassembler.h"
+#include "dismount/DisassemblerEndOfStreamException.h"
+#include "dismount/ListingWriter.h"
+#include "dismount/ParallelListingWriter.h"
+
+/*
+ * Formats the batches of each window until there are no more batches in the
+ * window, until the workers are stopped
+ */
+class ParallelListingWriter::Worker : public cThread {
+public:
+    /*
+     * Constructor.
+     *
+     * owner         - The writer which holds the batches
+     * dataFormatter - The formatter used only by this worker
+     */
+    Worker(ParallelListingWriter& owner,
+           OpcodeDataFormatter& dataFormatter) :
+        m_owner(owner),
+        m_writer(owner.m_disassembler, dataFormatter, owner.m_options),
+        m_isFailed(false)
+    {
+    }
+
+    /*
+     * Return true if the worker caught an exception in the last window
+     */
+    bool isFailed() const
+    {
+        return m_isFailed;
+    }
+
+    /*
+     * Wakes the worker for a new window, or to stop. Called with the pool
+     * lock held.
+     */
+    void startWindow()
+    {
+        m_isFailed = false;
+        m_windowStart.setEvent();
+    }
+
+protected:
+    virtual uint run(void*)
+    {
+        uint window = 0;
+        while (m_owner.waitWindow(m_windowStart, window))
+        {
+            XSTL_TRY
+            {
+                Batch* batch;
+                while ((batch = m_owner.takeBatch()) != NULL)
+                {
+                    m_writer.clear();
+                    cList<OpcodePtr>::iterator i = batch->m_opcodes.begin();
+                    for (; i != batch->m_opcodes.end(); ++i)
+                        m_writer.format(*i);
+
+                    batch->m_textLength = m_writer.getLength();
+                    batch->m_text.changeSize(batch->m_textLength);
+                    cOS::memcpy(batch->m_text.getBuffer(),
+                                m_writer.getBuffer(),
+                                batch->m_textLength);
+                }
+            }
+            XSTL_CATCH_ALL
+            {
+                m_isFailed = true;
+            }
+            m_owner.endWindow();
+        }
+        return 0;
+    }
+
+private:
+    // The writer which holds the batches
+    ParallelListingWriter& m_owner;
+    // The formatter of the lines
+    ListingWriter m_writer;
+    // Set if the worker caught an exception
+    bool m_isFailed;
+    // Signaled when a window is ready or the workers are stopped
+    cEvent m_windowStart;
+};
+
+ParallelListingWriter::Batch::Batch() :
+    m_textLength(0)
+{
+}
+
+ParallelListingWriter::ParallelListingWriter(
+        StreamDisassembler& disassembler,
+        const cList<OpcodeDataFormatterPtr>& formatters,
+        const ListingWriter::Options& options,
+        uint batchSize) :
+    m_disassembler(disassembler),
+    m_formatters(formatters),
+    m_options(options),
+    m_batchSize(batchSize),
+    m_windowNumber(0),
+    m_activeWorkers(0),
+    m_isStopping(false)
+{
+    CHECK(m_formatters.length() > 0);
+    CHECK(m_batchSize > 0);
+}
+
+ParallelListingWriter::~ParallelListingWriter()
+{
+    stopWorkers();
+}
+
+uint ParallelListingWriter::write(basicOutput& output)
+{
+    return writeInstructions(output, false, 0);
+}
+
+uint ParallelListingWriter::write(basicOutput& output,
+                                  const ProcessorAddress& start,
+                                  ProcessorAddress::uintAddress end)
+{
+    m_disassembler.jumpToAddress(start);
+    return writeInstructions(output, true, end);
+}
+
+uint ParallelListingWriter::writeInstructions(basicOutput& output,
+                                              bool shouldLimit,
+                                              ProcessorAddress::uintAddress end)
+{
+    uint windowSize = m_formatters.length() * BATCHES_PER_WORKER;
+    uint count = 0;
+    bool hasMore = true;
+
+    // The threads are kept for all the windows
+    startWorkers();
+
+    while (hasMore)
+    {
+        // Decode the window. The instructions boundaries are known only after
+        // decoding, so this part is serial.
+        m_window.removeAll();
+        for (uint i = 0; (i < windowSize) && hasMore; i++)
+        {
+            BatchPtr batch(new Batch());
+            hasMore = decodeBatch(*batch, shouldLimit, end);
+            if (batch->m_opcodes.length() == 0)
+                break;
+            count+= batch->m_opcodes.length();
+            m_window.append(batch);
+        }
+
+        if (m_window.length() == 0)
+            break;
+
+        formatWindow();
+
+        // Write the batches in address order
+        cList<BatchPtr>::iterator i = m_window.begin();
+        for (; i != m_window.end(); ++i)
+            if ((*i)->m_textLength > 0)
+                output.pipeWrite((*i)->m_text.getBuffer(), (*i)->m_textLength);
+    }
+
+    stopWorkers();
+    m_window.removeAll();
+    return count;
+}
+
+bool ParallelListingWriter::decodeBatch(Batch& batch,
+                                        bool shouldLimit,
+                                        ProcessorAddress::uintAddress end)
+{
+    ProcessorAddress next(gNullPointerProcessorAddress);
+
+    XSTL_TRY
+    {
+        for (uint i = 0; i < m_batchSize; i++)
+        {
+            if (m_disassembler.isEndOfStream())
+                return false;
+
+            if (shouldLimit && m_disassembler.getNextOpcodeLocation(next) &&
+                (next.getAddress() >= end))
+                return false;
+
+            batch.m_opcodes.append(m_disassembler.next());
+        }
+    }
+    XSTL_CATCH (DisassemblerEndOfStreamException&)
+    {
+        // End of stream.
+        return false;
+    }
+
+    return true;
+}
+
+void ParallelListingWriter::startWorkers()
+{
+    // The threads of a write which was stopped by an exception are reused
+    if (m_workers.length() > 0)
+        return;
+
+    // The new threads start before the first window
+    m_windowNumber = 0;
+    m_isStopping = false;
+    cList<OpcodeDataFormatterPtr>::iterator i = m_formatters.begin();
+    for (; i != m_formatters.end(); ++i)
+    {
+        cSmartPtr<Worker> worker(new Worker(*this, **i));
+        m_workers.append(worker);
+        worker->start();
+    }
+}
+
+void ParallelListingWriter::stopWorkers()
+{
+    {
+        cLock lock(m_poolLock);
+        m_isStopping = true;
+        cList<cSmartPtr<Worker> >::iterator w = m_workers.begin();
+        for (; w != m_workers.end(); ++w)
+            (*w)->startWindow();
+    }
+
+    cList<cSmartPtr<Worker> >::iterator w = m_workers.begin();
+    for (; w != m_workers.end(); ++w)
+        (*w)->wait();
+    m_workers.removeAll();
+}
+
+void ParallelListingWriter::formatWindow()
+{
+    m_nextBatch = m_window.begin();
+
+    // Start the window
+    {
+        cLock lock(m_poolLock);
+        m_windowNumber++;
+        m_activeWorkers = m_workers.length();
+        cList<cSmartPtr<Worker> >::iterator w = m_workers.begin();
+        for (; w != m_workers.end(); ++w)
+            (*w)->startWindow();
+    }
+
+    // And wait for all the batches to be formatted
+    while (true)
+    {
+        {
+            cLock lock(m_poolLock);
+            if (0 == m_activeWorkers)
+                break;
+            m_windowEnd.resetEvent();
+        }
+        m_windowEnd.wait();
+    }
+
+    bool isFailed = false;
+    cList<cSmartPtr<Worker> >::iterator w = m_workers.begin();
+    for (; w != m_workers.end(); ++w)
+        isFailed = isFailed || (*w)->isFailed();
+
+    // One of the instructions couldn't be formatted
+    CHECK(!isFailed);
+}
+
+bool ParallelListingWriter::waitWindow(cEvent& windowStart, uint& window)
+{
+    while (true)
+    {
+        {
+            cLock lock(m_poolLock);
+            if (m_isStopping)
+                return false;
+            if (m_windowNumber != window)
+            {
+                window = m_windowNumber;
+                return true;
+            }
+            windowStart.resetEvent();
+        }
+        windowStart.wait();
+    }
+}
+
+void ParallelListingWriter::endWindow()
+{
+    cLock lock(m_poolLock);
+    m_activeWorkers--;
+    if (0 == m_activeWorkers)
+        m_windowEnd.setEvent();
+}
+
+ParallelListingWriter::Batch* ParallelListingWriter::takeBatch()
+{
+    cLock lock(m_nextBatchLock);
+    if (m_nextBatch == m_window.end())
+        return NULL;
+
+    Batch* ret = m_nextBatch->getPointer();
+    ++m_nextBatch;
+    return ret;
+}
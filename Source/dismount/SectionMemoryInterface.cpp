@@ -8,36 +8,112 @@
 #include "dismount/dismount.h"
 #include "dismount/SectionMemoryInterface.h"
 
-void SectionMemoryInterface::initMaps()
+void SectionMemoryInterface::initIntervals()
 {
-    // Create the arrays, initialized to zero
-    uint mapLength = 8 * ((m_memorySize / 8) + 1);
-    //m_readMap  = cBuffer(mapLength);
-    m_writeMap = cBuffer(mapLength);
-    m_execMap  = cBuffer(mapLength);
-    for (uint i = 0; i < mapLength; i++)
-    {
-        //m_readMap[i]  = 0;
-        m_writeMap[i] = 0;
-        m_execMap[i]  = 0;
-    }
+    m_intervals.changeSize(m_sectionList.length());
 
-    // Enumerate the sections and fill the maps
+    // Insertion sort by the start address (There are only a few sections)
+    uint count = 0;
     for (cList<SectionMemoryInterface::GeneralSection>::iterator i = m_sectionList.begin();
          i != m_sectionList.end();
          ++i)
     {
+        if ((*i).m_start >= (*i).m_end)
+            continue;
+
+        uint position = count;
+        while ((position > 0) && (m_intervals[position - 1].m_start > (*i).m_start))
+        {
+            m_intervals[position] = m_intervals[position - 1];
+            position--;
+        }
+
+        m_intervals[position].m_start = (*i).m_start;
+        m_intervals[position].m_end = (*i).m_end;
+        m_intervals[position].m_rawDataAddress = (*i).m_rawDataAddress;
+        m_intervals[position].m_flags = (*i).m_flags;
+        count++;
+    }
+
+    m_intervals.changeSize(count);
+}
+
+void SectionMemoryInterface::addPageFlags(uint page,
+                                          addressNumericValue start,
+                                          addressNumericValue end,
+                                          uint flags)
+{
+    uint16& entry = m_pagesFlags[page];
+
+    // The whole page is covered by the range
+    if ((end - start) == PERMISSION_PAGE_SIZE)
+    {
+        if (!(entry & PERMISSION_PAGE_MIXED))
+        {
+            entry |= (uint16)flags;
+            return;
+        }
+
+        uint8* pageFlags = m_mixedPagesFlags.getBuffer() +
+                           (entry & ~PERMISSION_PAGE_MIXED) * PERMISSION_PAGE_SIZE;
+        for (uint i = 0; i < PERMISSION_PAGE_SIZE; i++)
+            pageFlags[i] |= (uint8)flags;
+        return;
+    }
+
+    // Part of the page is covered, fall back to flags per address
+    if (!(entry & PERMISSION_PAGE_MIXED))
+    {
+        CHECK(m_mixedPagesCount < PERMISSION_MAX_MIXED_PAGES);
+        if (((m_mixedPagesCount + 1) * PERMISSION_PAGE_SIZE) > m_mixedPagesFlags.getSize())
+            m_mixedPagesFlags.changeSize(m_mixedPagesFlags.getSize() * 2 + PERMISSION_PAGE_SIZE);
+
+        // Start with the flags of the whole page
+        memset(m_mixedPagesFlags.getBuffer() + m_mixedPagesCount * PERMISSION_PAGE_SIZE,
+               entry,
+               PERMISSION_PAGE_SIZE);
+        entry = (uint16)(PERMISSION_PAGE_MIXED | m_mixedPagesCount);
+        m_mixedPagesCount++;
+    }
+
+    uint8* pageFlags = m_mixedPagesFlags.getBuffer() +
+                       (entry & ~PERMISSION_PAGE_MIXED) * PERMISSION_PAGE_SIZE;
+    for (uint i = (uint)(start % PERMISSION_PAGE_SIZE); start < end; start++, i++)
+        pageFlags[i] |= (uint8)flags;
+}
+
+void SectionMemoryInterface::initMaps()
+{
+    // One entry per page, covering the addresses 0 until m_memorySize (including)
+    uint pagesCount = (m_memorySize >> PERMISSION_PAGE_SHIFT) + 1;
+    m_pagesFlags.changeSize(pagesCount);
+    memset(m_pagesFlags.getBuffer(), 0, pagesCount * sizeof(uint16));
+    m_mixedPagesFlags.changeSize(0);
+    m_mixedPagesCount = 0;
+
+    // Enumerate the sections and fill the table
+    addressNumericValue tableEnd = (addressNumericValue)pagesCount << PERMISSION_PAGE_SHIFT;
+    for (uint i = 0; i < m_intervals.getSize(); i++)
+    {
+        const SectionInterval& section = m_intervals[i];
+
         // Skip this section if it isn't of any of the types we want
-        //if (!((*i).m_flags & (SECTION_FLAG_READ | SECTION_FLAG_WRITE | SECTION_FLAG_EXECUTABLE)))
-        if (!((*i).m_flags & (SECTION_FLAG_WRITE | SECTION_FLAG_EXECUTABLE)))
+        uint flags = section.m_flags & PERMISSION_FLAGS_MASK;
+        if (0 == flags)
             continue;
 
-        for (addressNumericValue addr = (*i).m_start; addr < (*i).m_end; addr++)
+        // Clip the range to the table
+        addressNumericValue start = section.m_start;
+        addressNumericValue end = t_min(section.m_end, tableEnd);
+
+        // Fill page by page
+        while (start < end)
         {
-            uint bitField = (1 << ((uint)addr % 8));
-            //if ((*i).m_flags & SECTION_FLAG_READ)       m_readMap[addr / 8]  |= bitField;
-            if ((*i).m_flags & SECTION_FLAG_WRITE)      m_writeMap[addr / 8] |= bitField;
-            if ((*i).m_flags & SECTION_FLAG_EXECUTABLE) m_execMap[addr / 8]  |= bitField;
+            uint page = (uint)(start >> PERMISSION_PAGE_SHIFT);
+            addressNumericValue pageEnd = ((addressNumericValue)page + 1) << PERMISSION_PAGE_SHIFT;
+            addressNumericValue rangeEnd = t_min(end, pageEnd);
+            addPageFlags(page, start, rangeEnd, flags);
+            start = rangeEnd;
         }
     }
 }
@@ -49,31 +125,38 @@ bool SectionMemoryInterface::checkAddress(addressNumericValue address, uint flag
         return false;
 
     // If the flags aren't of any of the types we manage
-    if (!(flags & (SECTION_FLAG_READ | SECTION_FLAG_WRITE | SECTION_FLAG_EXECUTABLE)))
+    flags &= PERMISSION_FLAGS_MASK;
+    if (0 == flags)
         return false;
 
-    uint bitField = (1 << ((uint)address % 8));
-    /*if ((flags & SECTION_FLAG_READ) && (!(m_readMap[(uint)address / 8] & bitField)))
-        return false;*/
-    if ((flags & SECTION_FLAG_WRITE) && (!(m_writeMap[(uint)address / 8] & bitField)))
-        return false;
-    if ((flags & SECTION_FLAG_EXECUTABLE) && (!(m_execMap[(uint)address / 8] & bitField)))
-        return false;
+    uint entry = m_pagesFlags[(uint)(address >> PERMISSION_PAGE_SHIFT)];
+    if (entry & PERMISSION_PAGE_MIXED)
+        entry = m_mixedPagesFlags[(entry & ~PERMISSION_PAGE_MIXED) * PERMISSION_PAGE_SIZE +
+                                  ((uint)address & (PERMISSION_PAGE_SIZE - 1))];
 
-    return true;
+    return (entry & flags) == flags;
 }
 
 uint SectionMemoryInterface::virtualToRawAddress(addressNumericValue virtualAddress)
 {
-    // Enumerate the sections to find the section the address belongs to
-    cList<SectionMemoryInterface::GeneralSection>::iterator i = m_sectionList.begin();
-    for (; i != m_sectionList.end(); ++i)
+    // Binary search for the last section which starts at or before the address
+    uint low = 0;
+    uint high = m_intervals.getSize();
+    while (low < high)
     {
-        if ((virtualAddress >= (*i).m_start) && (virtualAddress < (*i).m_end))
-            return (uint)(virtualAddress - (*i).m_start + (*i).m_rawDataAddress);
+        uint middle = low + (high - low) / 2;
+        if (m_intervals[middle].m_start <= virtualAddress)
+            low = middle + 1;
+        else
+            high = middle;
     }
 
-    return 0;
+    // Check that the address is inside the section
+    if ((0 == low) || (virtualAddress >= m_intervals[low - 1].m_end))
+        return 0;
+
+    const SectionInterval& section = m_intervals[low - 1];
+    return (uint)(virtualAddress - section.m_start + section.m_rawDataAddress);
 }
 
 SectionMemoryInterface::SectionMemoryInterface(addressNumericValue moduleBaseAddress,
@@ -83,7 +166,9 @@ SectionMemoryInterface::SectionMemoryInterface(addressNumericValue moduleBaseAdd
     m_moduleBaseAddress(moduleBaseAddress),
     m_imageBase(imageBase),
     m_memorySize(memorySize),
-    m_sectionList(sectionList)
+    m_sectionList(sectionList),
+    m_mixedPagesCount(0)
 {
+    initIntervals();
     initMaps();
 }
@@ -0,0 +1,33 @@
+#include "dismount/dismount.h"
+/*
+ * SymbolOpcodeDataFormatter.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/string.h"
+#include "dismount/SymbolTable.h"
+#include "dismount/DefaultOpcodeDataFormatter.h"
+#include "dismount/SymbolOpcodeDataFormatter.h"
+
+SymbolOpcodeDataFormatter::SymbolOpcodeDataFormatter(
+        uint opcodeNameAlignment,
+        const SymbolTable& symbols,
+        ProcessorAddress::uintAddress maxOffset) :
+    DefaultOpcodeDataFormatter(opcodeNameAlignment),
+    m_symbols(symbols),
+    m_maxOffset(maxOffset)
+{
+}
+
+cString SymbolOpcodeDataFormatter::translateAbsoluteAddress(
+    const ProcessorAddress& absoulte)
+{
+    cString ret;
+    if (m_symbols.render(absoulte.getAddress(), m_maxOffset, ret))
+        return ret;
+
+    return DefaultOpcodeDataFormatter::translateAbsoluteAddress(absoulte);
+}
@@ -0,0 +1,293 @@
+#include "dismount/dismount.h"
+/*
+ * SymbolTable.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/os.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/except/trace.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/SymbolTable.h"
+
+// The initial number of symbols and names characters allocated
+enum {
+    SYMBOLS_INITIAL_SIZE = 1024,
+    NAMES_INITIAL_SIZE = 16 * 1024,
+    // The size of each read from the symbols file
+    LOAD_CHUNK_SIZE = 64 * 1024
+};
+
+SymbolTable::SymbolTable() :
+    m_symbols(SYMBOLS_INITIAL_SIZE),
+    m_count(0),
+    m_names(NAMES_INITIAL_SIZE),
+    m_namesLength(0),
+    m_isSorted(true)
+{
+    buildHash();
+}
+
+void SymbolTable::addSymbol(ProcessorAddress::uintAddress address,
+                            const cString& name)
+{
+    cSArray<char> ascii = name.getASCIIstring();
+    addSymbol(address, ascii.getBuffer());
+}
+
+void SymbolTable::addSymbol(ProcessorAddress::uintAddress address,
+                            const char* name)
+{
+    uint length = (uint)strlen(name) + 1;
+
+    // Grow the arrays geometrically
+    if (m_count == m_symbols.getSize())
+        m_symbols.changeSize(m_symbols.getSize() * 2);
+    if ((m_namesLength + length) > m_names.getSize())
+        m_names.changeSize(t_max(m_names.getSize() * 2, m_namesLength + length));
+
+    cOS::memcpy(m_names.getBuffer() + m_namesLength, name, length);
+    m_symbols[m_count].m_address = address;
+    m_symbols[m_count].m_nameOffset = m_namesLength;
+    m_namesLength+= length;
+    m_count++;
+
+    m_isSorted = false;
+}
+
+uint SymbolTable::load(basicInput& input)
+{
+    // Read the whole file
+    cSArray<char> data(LOAD_CHUNK_SIZE);
+    uint dataLength = 0;
+    while (!input.isEOS())
+    {
+        if ((dataLength + LOAD_CHUNK_SIZE) > data.getSize())
+            data.changeSize(data.getSize() * 2);
+        uint readed = input.read(data.getBuffer() + dataLength, LOAD_CHUNK_SIZE);
+        if (readed == 0)
+            break;
+        dataLength+= readed;
+    }
+    // Room for the terminator of the last line
+    if (dataLength == data.getSize())
+        data.changeSize(dataLength + 1);
+
+    // Parse it line by line, in place. The symbols of a malformed file are
+    // removed again, so the table is left as it was before the call.
+    uint previousCount = m_count;
+    uint previousNamesLength = m_namesLength;
+    uint count = 0;
+    char* position = data.getBuffer();
+    char* end = position + dataLength;
+    while (position < end)
+    {
+        // Find the end of the line
+        char* lineEnd = position;
+        while ((lineEnd < end) && (*lineEnd != '\n'))
+            lineEnd++;
+        char* next = lineEnd + 1;
+
+        // Trim the line
+        while ((position < lineEnd) && ((*position == ' ') || (*position == '\t')))
+            position++;
+        while ((lineEnd > position) && ((lineEnd[-1] == ' ') ||
+                                         (lineEnd[-1] == '\t') ||
+                                         (lineEnd[-1] == '\r')))
+            lineEnd--;
+
+        if ((position == lineEnd) || (*position == '#') || (*position == ';'))
+        {
+            position = next;
+            continue;
+        }
+
+        // Parse the address
+        if (((lineEnd - position) > 2) && (position[0] == '0') &&
+            ((position[1] == 'x') || (position[1] == 'X')))
+            position+= 2;
+
+        ProcessorAddress::uintAddress address = 0;
+        uint digits = 0;
+        for (; position < lineEnd; position++, digits++)
+        {
+            char c = *position;
+            uint value;
+            if ((c >= '0') && (c <= '9'))
+                value = c - '0';
+            else if ((c >= 'a') && (c <= 'f'))
+                value = c - 'a' + 10;
+            else if ((c >= 'A') && (c <= 'F'))
+                value = c - 'A' + 10;
+            else
+                break;
+            address = (address << 4) | value;
+        }
+        if ((position < lineEnd) && ((*position == 'h') || (*position == 'H')))
+            position++;
+
+        // Malformed line, the address must be followed by a name
+        if ((digits == 0) || (digits > 16) || (position == lineEnd) ||
+            ((*position != ' ') && (*position != '\t')))
+        {
+            m_count = previousCount;
+            m_namesLength = previousNamesLength;
+            sort();
+            CHECK_FAIL();
+        }
+        while ((position < lineEnd) && ((*position == ' ') || (*position == '\t')))
+            position++;
+
+        // The name is the rest of the line
+        *lineEnd = '\0';
+        addSymbol(address, position);
+        count++;
+
+        position = next;
+    }
+
+    sort();
+    return count;
+}
+
+bool SymbolTable::isBefore(const Symbol& a, const Symbol& b)
+{
+    if (a.m_address != b.m_address)
+        return a.m_address < b.m_address;
+    return a.m_nameOffset < b.m_nameOffset;
+}
+
+void SymbolTable::sort()
+{
+    if (m_isSorted)
+        return;
+
+    // Heap sort, no recursion and no extra memory for huge tables
+    Symbol* symbols = m_symbols.getBuffer();
+    heapSort(symbols, m_count, isBefore);
+
+    // Remove duplicated addresses, keep the first added symbol which is
+    // sorted first
+    uint newCount = 0;
+    for (uint i = 0; i < m_count; i++)
+    {
+        if ((newCount > 0) &&
+            (symbols[newCount - 1].m_address == symbols[i].m_address))
+            continue;
+        symbols[newCount++] = symbols[i];
+    }
+    m_count = newCount;
+
+    buildHash();
+    m_isSorted = true;
+}
+
+void SymbolTable::buildHash()
+{
+    // Keep the load factor at most 50%
+    uint size = 16;
+    while (size < (m_count * 2))
+        size*= 2;
+
+    m_hash.changeSize(size);
+    memset(m_hash.getBuffer(), 0xFF, size * sizeof(uint));
+
+    uint mask = size - 1;
+    for (uint i = 0; i < m_count; i++)
+    {
+        uint slot = hashAddress(m_symbols[i].m_address, mask);
+        while (m_hash[slot] != EMPTY_SLOT)
+            slot = (slot + 1) & mask;
+        m_hash[slot] = i;
+    }
+}
+
+uint SymbolTable::getCount() const
+{
+    return m_count;
+}
+
+ProcessorAddress::uintAddress SymbolTable::getAddress(uint index) const
+{
+    CHECK(m_isSorted);
+    CHECK(index < m_count);
+    return m_symbols[index].m_address;
+}
+
+const char* SymbolTable::getName(uint index) const
+{
+    CHECK(m_isSorted);
+    CHECK(index < m_count);
+    return m_names.getBuffer() + m_symbols[index].m_nameOffset;
+}
+
+const char* SymbolTable::find(ProcessorAddress::uintAddress address) const
+{
+    CHECK(m_isSorted);
+
+    uint mask = m_hash.getSize() - 1;
+    uint slot = hashAddress(address, mask);
+    while (m_hash[slot] != EMPTY_SLOT)
+    {
+        const Symbol& symbol = m_symbols[m_hash[slot]];
+        if (symbol.m_address == address)
+            return m_names.getBuffer() + symbol.m_nameOffset;
+        slot = (slot + 1) & mask;
+    }
+
+    return NULL;
+}
+
+const char* SymbolTable::findNearest(
+        ProcessorAddress::uintAddress address,
+        ProcessorAddress::uintAddress& symbolAddress) const
+{
+    CHECK(m_isSorted);
+
+    // Find the first symbol above 'address'
+    const Symbol* symbols = m_symbols.getBuffer();
+    uint low = 0;
+    uint high = m_count;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        if (symbols[middle].m_address <= address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == 0)
+        return NULL;
+
+    symbolAddress = symbols[low - 1].m_address;
+    return m_names.getBuffer() + symbols[low - 1].m_nameOffset;
+}
+
+bool SymbolTable::render(ProcessorAddress::uintAddress address,
+                         ProcessorAddress::uintAddress maxOffset,
+                         cString& output) const
+{
+    ProcessorAddress::uintAddress symbolAddress;
+    const char* name = find(address);
+    if (name != NULL)
+    {
+        output = name;
+        return true;
+    }
+
+    name = findNearest(address, symbolAddress);
+    if ((name == NULL) || ((address - symbolAddress) > maxOffset))
+        return false;
+
+    output = name;
+    output+= "+";
+    output+= HEXNUMBER((uint)(address - symbolAddress));
+    output+= "h";
+    return true;
+}
@@ -0,0 +1,224 @@
+#include "dismount/dismount.h"
+/*
+ * XrefIndex.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "dismount/ArrayUtils.h"
+#include "dismount/XrefIndex.h"
+
+XrefIndex::Records::Records() :
+    m_count(0)
+{
+}
+
+void XrefIndex::Records::clear()
+{
+    m_count = 0;
+}
+
+void XrefIndex::Records::add(addressNumericValue source,
+                             addressNumericValue target,
+                             uint kind)
+{
+    Xref xref;
+    xref.m_source = source;
+    xref.m_target = target;
+    xref.m_kind = kind;
+    appendItem(m_xrefs, m_count, xref);
+}
+
+uint XrefIndex::Records::getCount() const
+{
+    return m_count;
+}
+
+const XrefIndex::Xref& XrefIndex::Records::get(uint index) const
+{
+    CHECK(index < m_count);
+    return m_xrefs[index];
+}
+
+void XrefIndex::Records::truncate(uint count)
+{
+    CHECK(count <= m_count);
+    m_count = count;
+}
+
+void XrefIndex::Records::append(const Records& other, uint first, uint count)
+{
+    CHECK((first <= other.m_count) && (count <= (other.m_count - first)));
+
+    for (uint i = 0; i < count; i++)
+        appendItem(m_xrefs, m_count, other.m_xrefs[first + i]);
+}
+
+void XrefIndex::Records::moveDown(uint first, uint count, uint to)
+{
+    CHECK((first <= m_count) && (count <= (m_count - first)) && (to <= first));
+
+    for (uint i = 0; i < count; i++)
+        m_xrefs[to + i] = m_xrefs[first + i];
+}
+
+XrefIndex::XrefIndex() :
+    m_xrefsCount(0),
+    m_targetsCount(0),
+    m_targetOffsets(1)
+{
+    m_targetOffsets[0] = 0;
+}
+
+bool XrefIndex::isSourceBefore(const Xref& a, const Xref& b)
+{
+    if (a.m_source != b.m_source)
+        return a.m_source < b.m_source;
+    if (a.m_target != b.m_target)
+        return a.m_target < b.m_target;
+    return a.m_kind < b.m_kind;
+}
+
+bool XrefIndex::isTargetBefore(const Xref& a, const Xref& b)
+{
+    if (a.m_target != b.m_target)
+        return a.m_target < b.m_target;
+    if (a.m_source != b.m_source)
+        return a.m_source < b.m_source;
+    return a.m_kind < b.m_kind;
+}
+
+void XrefIndex::build(const Records& records)
+{
+    // Sort the references by the source and remove the duplicates (an
+    // instruction which was walked by more than one potential subset)
+    uint count = records.getCount();
+    m_xrefs.changeSize(count);
+    for (uint i = 0; i < count; i++)
+        m_xrefs[i] = records.get(i);
+    heapSort(m_xrefs.getBuffer(), count, isSourceBefore);
+
+    m_xrefsCount = 0;
+    for (uint i = 0; i < count; i++)
+    {
+        if ((m_xrefsCount > 0) &&
+            !isSourceBefore(m_xrefs[m_xrefsCount - 1], m_xrefs[i]))
+            continue;
+        m_xrefs[m_xrefsCount++] = m_xrefs[i];
+    }
+
+    // Group the references by the target
+    m_byTarget.changeSize(m_xrefsCount);
+    for (uint i = 0; i < m_xrefsCount; i++)
+        m_byTarget[i] = m_xrefs[i];
+    heapSort(m_byTarget.getBuffer(), m_xrefsCount, isTargetBefore);
+
+    m_targetsCount = 0;
+    for (uint i = 0; i < m_xrefsCount; i++)
+    {
+        if ((i == 0) || (m_byTarget[i - 1].m_target != m_byTarget[i].m_target))
+            m_targetsCount++;
+    }
+    m_targets.changeSize(m_targetsCount);
+    m_targetOffsets.changeSize(m_targetsCount + 1);
+    uint target = 0;
+    for (uint i = 0; i < m_xrefsCount; i++)
+    {
+        if ((i == 0) || (m_byTarget[i - 1].m_target != m_byTarget[i].m_target))
+        {
+            m_targets[target] = m_byTarget[i].m_target;
+            m_targetOffsets[target] = i;
+            target++;
+        }
+    }
+    m_targetOffsets[m_targetsCount] = m_xrefsCount;
+}
+
+uint XrefIndex::getXrefsCount() const
+{
+    return m_xrefsCount;
+}
+
+const XrefIndex::Xref& XrefIndex::getXref(uint index) const
+{
+    CHECK(index < m_xrefsCount);
+    return m_xrefs[index];
+}
+
+uint XrefIndex::findFrom(addressNumericValue source, uint& count) const
+{
+    count = 0;
+
+    // Find the first reference whose source isn't below 'source'
+    uint low = 0;
+    uint high = m_xrefsCount;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        if (m_xrefs[middle].m_source < source)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if ((low == m_xrefsCount) || (m_xrefs[low].m_source != source))
+        return NOT_FOUND;
+
+    while (((low + count) < m_xrefsCount) &&
+           (m_xrefs[low + count].m_source == source))
+        count++;
+    return low;
+}
+
+uint XrefIndex::findTo(addressNumericValue target, uint& count) const
+{
+    count = 0;
+
+    uint low = 0;
+    uint high = m_targetsCount;
+    while (low < high)
+    {
+        uint middle = low + (high - low) / 2;
+        if (m_targets[middle] < target)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if ((low == m_targetsCount) || (m_targets[low] != target))
+        return NOT_FOUND;
+
+    count = getTargetXrefsCount(low);
+    return getTargetFirstXref(low);
+}
+
+uint XrefIndex::getTargetsCount() const
+{
+    return m_targetsCount;
+}
+
+addressNumericValue XrefIndex::getTarget(uint index) const
+{
+    CHECK(index < m_targetsCount);
+    return m_targets[index];
+}
+
+uint XrefIndex::getTargetXrefsCount(uint index) const
+{
+    CHECK(index < m_targetsCount);
+    return m_targetOffsets[index + 1] - m_targetOffsets[index];
+}
+
+uint XrefIndex::getTargetFirstXref(uint index) const
+{
+    CHECK(index < m_targetsCount);
+    return m_targetOffsets[index];
+}
+
+const XrefIndex::Xref& XrefIndex::getXrefTo(uint position) const
+{
+    CHECK(position < m_xrefsCount);
+    return m_byTarget[position];
+}
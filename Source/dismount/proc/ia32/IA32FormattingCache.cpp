@@ -0,0 +1,215 @@
+#include "dismount/dismount.h"
+/*
+ * IA32FormattingCache.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/os.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/data/smartptr.h"
+#include "xStl/except/trace.h"
+#include "dismount/OpcodeSubsystems.h"
+#include "dismount/proc/ia32/IA32IntelNotation.h"
+#include "dismount/proc/ia32/IA32FormattingCache.h"
+
+IA32FormattingCache::IA32FormattingCache(OpcodeDataFormatter& dataFormatter,
+                                         uint slots) :
+    m_dataFormatter(dataFormatter),
+    m_hits(0),
+    m_misses(0)
+{
+    uint size = 16;
+    while (size < slots)
+        size*= 2;
+    m_entries.changeSize(size);
+    clear();
+}
+
+OpcodeDataFormatter& IA32FormattingCache::getDataFormatter()
+{
+    return m_dataFormatter;
+}
+
+void IA32FormattingCache::clear()
+{
+    memset(m_entries.getBuffer(), 0, m_entries.getSize() * sizeof(Entry));
+}
+
+uint IA32FormattingCache::getHits() const
+{
+    return m_hits;
+}
+
+uint IA32FormattingCache::getMisses() const
+{
+    return m_misses;
+}
+
+uint IA32FormattingCache::hashEncoding(const uint8* bytes,
+                                       uint length,
+                                       uint type) const
+{
+    // FNV-1a over the bytes and the mode
+    uint32 hash = 2166136261U ^ type;
+    for (uint i = 0; i < length; i++)
+    {
+        hash^= bytes[i];
+        hash*= 16777619U;
+    }
+    hash^= hash >> 15;
+    return hash & (m_entries.getSize() - 1);
+}
+
+bool IA32FormattingCache::getRelativeOperand(
+        const IA32Opcode& opcode,
+        ProcessorAddress::intAddress& relative)
+{
+    if (opcode.m_opcode->m_secondOperand != ia32dis::OPND_NO_OPERAND)
+        return false;
+
+    switch (opcode.m_opcode->m_firstOperand)
+    {
+    case ia32dis::OPND_IMMEDIATE_OFFSET_SHORT_8:
+        relative = (int8)opcode.m_immediate.offset;
+        break;
+    case ia32dis::OPND_IMMEDIATE_OFFSET_LONG_32:
+        relative = (int32)opcode.m_immediate.offset;
+        break;
+    case ia32dis::OPND_IMMEDIATE_OFFSET_DS:
+        switch (opcode.m_addressSize)
+        {
+        case IntegerEncoding::INTEGER_16BIT:
+            relative = (int16)opcode.m_immediate.offset; break;
+        case IntegerEncoding::INTEGER_32BIT:
+            relative = (int32)opcode.m_immediate.offset; break;
+        default:
+            return false;
+        }
+        break;
+    default:
+        // Far pointers and all other operands are not relative
+        return false;
+    }
+
+    // NOTE: All ia32 relative calculate are from the next operation
+    relative+= opcode.m_opcodeData.getSize();
+    return true;
+}
+
+cString IA32FormattingCache::string(
+        const OpcodePtr& instruction,
+        OpcodeFormatter::OpcodeFormatStruct* formatStruct)
+{
+    uint type = instruction->getType();
+    CHECK((type == OpcodeSubsystems::DISASSEMBLER_INTEL_16) ||
+          (type == OpcodeSubsystems::DISASSEMBLER_INTEL_32));
+    const IA32Opcode& opcode = *((const IA32Opcode*)instruction.getPointer());
+
+    const uint8* bytes = opcode.m_opcodeData.getBuffer();
+    uint length = opcode.m_opcodeData.getSize();
+
+    ProcessorAddress::intAddress relative = 0;
+    bool isRelative = getRelativeOperand(opcode, relative);
+
+    // Instructions with too many prefixes are formatted directly
+    if (length > MAX_CACHED_BYTES)
+    {
+        m_misses++;
+        return IA32IntelNotation(instruction, m_dataFormatter).
+                    string(formatStruct);
+    }
+
+    Entry& entry = m_entries[hashEncoding(bytes, length, type)];
+    if (entry.m_isValid &&
+        (entry.m_length == length) &&
+        (entry.m_type == type) &&
+        (memcmp(entry.m_bytes, bytes, length) == 0))
+    {
+        m_hits++;
+        if (formatStruct != NULL)
+        {
+            formatStruct->m_opcodeNameStart = entry.m_opcodeNameStart;
+            formatStruct->m_opcodeOperandsStart = entry.m_opcodeOperandsStart;
+        }
+
+        ProcessorAddress ipAddress(gNullPointerProcessorAddress);
+        bool shouldUseIp = instruction->getOpcodeAddress(ipAddress);
+        m_dataFormatter.newInstruction(shouldUseIp, ipAddress);
+
+        if (!entry.m_isRelative)
+            return cString(entry.m_text);
+
+        // Translate the operand for the current address
+        cString ret(entry.m_text);
+        ret+= m_dataFormatter.reparseFirstOperand(
+                    m_dataFormatter.translateRelativeAddress(relative,
+                                                             shouldUseIp,
+                                                             ipAddress));
+        return m_dataFormatter.endInstruction(ret);
+    }
+
+    // Format the instruction and store it
+    m_misses++;
+    OpcodeFormatter::OpcodeFormatStruct positions;
+    cString ret = IA32IntelNotation(instruction, m_dataFormatter).
+                        string(&positions);
+    if (formatStruct != NULL)
+        *formatStruct = positions;
+
+    uint textLength = isRelative ? positions.m_opcodeOperandsStart :
+                                   ret.length();
+    if ((textLength > MAX_CACHED_TEXT) || (ret.length() < textLength))
+        return ret;
+
+    entry.m_isValid = true;
+    entry.m_isRelative = isRelative;
+    entry.m_length = (uint8)length;
+    entry.m_type = (uint8)type;
+    cOS::memcpy(entry.m_bytes, bytes, length);
+    entry.m_opcodeNameStart = (uint8)positions.m_opcodeNameStart;
+    entry.m_opcodeOperandsStart = (uint8)positions.m_opcodeOperandsStart;
+    cOS::memcpy(entry.m_text, ret.getBuffer(), textLength * sizeof(character));
+    entry.m_text[textLength] = XSTL_CHAR('\0');
+
+    return ret;
+}
+
+OpcodeFormatterPtr IA32FormattingCache::getOpcodeFormat(
+        const OpcodePtr& instruction)
+{
+    return OpcodeFormatterPtr(new CachedFormatter(*this, instruction));
+}
+
+IA32FormattingCache::CachedFormatter::CachedFormatter(
+        IA32FormattingCache& cache,
+        const OpcodePtr& instruction) :
+    m_cache(cache),
+    m_instruction(instruction)
+{
+    switch (m_instruction->getType())
+    {
+    case OpcodeSubsystems::DISASSEMBLER_INTEL_16:
+    case OpcodeSubsystems::DISASSEMBLER_INTEL_32:
+        break;
+    default:
+        // Unsupported instruction
+        CHECK_FAIL();
+    }
+}
+
+cString IA32FormattingCache::CachedFormatter::string(
+        OpcodeFormatStruct* formatStruct) const
+{
+    return m_cache.string(m_instruction, formatStruct);
+}
+
+uint IA32FormattingCache::CachedFormatter::parseOperandAddress(
+        ProcessorAddress& address)
+{
+    return IA32IntelNotation(m_instruction, m_cache.getDataFormatter()).
+                parseOperandAddress(address);
+}
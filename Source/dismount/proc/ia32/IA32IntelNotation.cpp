@@ -61,43 +61,13 @@ cString IA32IntelNotation::string(OpcodeFormatStruct* formatStruct) const
     if (formatStruct != NULL)
         formatStruct->m_opcodeNameStart = ret.length();
 
-    // Add the opcode name
-    cString opcodeName = m_opcode->m_opcode->m_opcodeName;
-    // Replace name convenstion
-    if (opcodeName.find("/") < opcodeName.length())
-    {
-        // TODO! 64bit
-        if (is32bit())
-            opcodeName = opcodeName.left(opcodeName.find("/"));
-        else
-            opcodeName = opcodeName.part(opcodeName.find("/") + 1,
-                                         opcodeName.length() - 1);
-    }
-
-    uint namePos = opcodeName.find("#");
-    while (namePos != opcodeName.length()) {
-        switch (opcodeName[namePos + 1])
-        {
-        case XSTL_CHAR('d'):
-            opcodeName = opcodeName.left(namePos) +
-                (is32bit() ? "d" : "") +
-                opcodeName.part(namePos + 2, opcodeName.length() - 1);
-            break;
-        case XSTL_CHAR('e'):
-            opcodeName = opcodeName.left(namePos) +
-                (is32bit() ? "e" : "") +
-                opcodeName.part(namePos + 2, opcodeName.length() - 1);
-            break;
-        case XSTL_CHAR('#'):
-            opcodeName = opcodeName.left(namePos) +
-                (is32bit() ? "d" : "w") +
-                opcodeName.part(namePos + 2, opcodeName.length() - 1);
-            break;
-        }
-        namePos = opcodeName.find("#");
-    }
-
-    ret+= m_dataFormatter.reparseOpcode(opcodeName);
+    // Add the opcode name. The name symbols were already resolved into both
+    // spellings while the opcode tables were built.
+    // TODO! 64bit
+    ret+= m_dataFormatter.reparseOpcode(ia32dis::getResolvedOpcodeName(
+                    m_opcode->m_opcode,
+                    is32bit() ? ia32dis::MNEMONIC_32BIT :
+                                ia32dis::MNEMONIC_16BIT));
 
     if (formatStruct != NULL)
         formatStruct->m_opcodeOperandsStart = ret.length();
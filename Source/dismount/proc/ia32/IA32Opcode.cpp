@@ -103,6 +103,29 @@ uint32 IA32Opcode::getSwitchTableOffset() const
     return 0;
 }
 
+uint IA32Opcode::getSwitchIndexRegister() const
+{
+    return m_sib.m_bits.m_index;
+}
+
+bool IA32Opcode::getRegisterCompare(uint& reg, uint32& value) const
+{
+    if ((0x3D == m_opcodeData[0]) && (4 == m_immediateLength))
+        reg = ia32dis::IA32_GP32_EAX;                                   // cmp eax, imm32
+    else if (((0x81 == m_opcodeData[0]) || (0x83 == m_opcodeData[0])) &&
+             (3 == m_modrm.m_bits.m_mod) &&                             // Register operand
+             (7 == m_modrm.m_bits.m_regOpcode))                         // /7 is CMP
+        reg = m_modrm.m_bits.m_rm;
+    else
+        return false;
+
+    value = (uint32)m_immediate.offset;
+    // imm8 is sign-extended, a negative constant doesn't bound an index
+    if ((1 == m_immediateLength) && (0 != (value & 0x80)))
+        return false;
+    return true;
+}
+
 int IA32Opcode::getAlterProperty() const
 {
     return getOpcodeEntry()->m_alterProperty;
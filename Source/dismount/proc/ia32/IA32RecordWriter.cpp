@@ -0,0 +1,598 @@
+#include "dismount/dismount.h"
+/*
+ * IA32RecordWriter.cpp
+ *
+ * Implementation file
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/os/os.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "xStl/stream/basicIO.h"
+#include "dismount/Opcode.h"
+#include "dismount/IntegerEncoding.h"
+#include "dismount/DisassemblyRecord.h"
+#include "dismount/proc/ia32/opcodeTable.h"
+#include "dismount/proc/ia32/IA32Opcode.h"
+#include "dismount/proc/ia32/IA32RecordWriter.h"
+
+IA32RecordWriter::IA32RecordWriter(
+        basicOutput& output,
+        OpcodeSubsystems::DisassemblerType processorType,
+        uint bufferedRecords) :
+    m_output(output),
+    m_invalidMnemonic(0),
+    m_records(bufferedRecords),
+    m_used(0),
+    m_count(0)
+{
+    CHECK(bufferedRecords > 0);
+    CHECK((processorType == OpcodeSubsystems::DISASSEMBLER_INTEL_16) ||
+          (processorType == OpcodeSubsystems::DISASSEMBLER_INTEL_32));
+    writeHeader(processorType);
+}
+
+void IA32RecordWriter::writeHeader(
+        OpcodeSubsystems::DisassemblerType processorType)
+{
+    // Collect all the distinct mnemonics into the string table
+    uint entries = ia32dis::getOpcodeEntriesCount();
+    m_mnemonics.changeSize(entries * ia32dis::MNEMONIC_VARIANTS_COUNT);
+
+    cSArray<char> strings(entries * ia32dis::MAX_MNEMONIC_LENGTH);
+    uint stringsLength = 0;
+    cSArray<uint32> distinct(entries * ia32dis::MNEMONIC_VARIANTS_COUNT + 1);
+    uint distinctCount = 0;
+
+    for (uint i = 0; i <= entries * ia32dis::MNEMONIC_VARIANTS_COUNT; i++)
+    {
+        const char* name;
+        if (i == entries * ia32dis::MNEMONIC_VARIANTS_COUNT)
+            name = ia32dis::INVALID;
+        else
+            name = ia32dis::getResolvedOpcodeName(
+                ia32dis::getOpcodeEntry(i / ia32dis::MNEMONIC_VARIANTS_COUNT),
+                (ia32dis::MnemonicVariant)(i % ia32dis::MNEMONIC_VARIANTS_COUNT));
+
+        // Look for the name, there are only few hundreds distinct names
+        uint32 id = stringsLength;
+        for (uint j = 0; j < distinctCount; j++)
+            if (strcmp(strings.getBuffer() + distinct[j], name) == 0)
+            {
+                id = distinct[j];
+                break;
+            }
+
+        if (id == stringsLength)
+        {
+            uint length = (uint)strlen(name) + 1;
+            if ((stringsLength + length) > strings.getSize())
+                strings.changeSize((stringsLength + length) * 2);
+            cOS::memcpy(strings.getBuffer() + stringsLength, name, length);
+            stringsLength+= length;
+            distinct[distinctCount++] = id;
+        }
+
+        if (i == entries * ia32dis::MNEMONIC_VARIANTS_COUNT)
+            m_invalidMnemonic = id;
+        else
+            m_mnemonics[i] = id;
+    }
+
+    // Pad the string table to the records alignment
+    uint recordsOffset = sizeof(DisassemblyRecord::Header) + stringsLength;
+    uint padding = (DisassemblyRecord::RECORDS_ALIGNMENT -
+        (recordsOffset % DisassemblyRecord::RECORDS_ALIGNMENT)) %
+        DisassemblyRecord::RECORDS_ALIGNMENT;
+    if ((stringsLength + padding) > strings.getSize())
+        strings.changeSize(stringsLength + padding);
+    memset(strings.getBuffer() + stringsLength, 0, padding);
+
+    DisassemblyRecord::Header header;
+    memset(&header, 0, sizeof(header));
+    header.m_magic = DisassemblyRecord::MAGIC;
+    header.m_version = DisassemblyRecord::VERSION;
+    header.m_recordSize = sizeof(DisassemblyRecord::Record);
+    header.m_stringTableOffset = sizeof(DisassemblyRecord::Header);
+    header.m_stringTableSize = stringsLength;
+    header.m_recordsOffset = recordsOffset + padding;
+    header.m_processorType = processorType;
+
+    m_output.pipeWrite(&header, sizeof(header));
+    m_output.pipeWrite(strings.getBuffer(), stringsLength + padding);
+}
+
+void IA32RecordWriter::write(const OpcodePtr& opcode)
+{
+    if (m_used == m_records.getSize())
+        flush();
+
+    DisassemblyRecord::Record& record = m_records[m_used];
+
+    if (opcode->getType() == OpcodeSubsystems::DISASSEMBLER_INVALID_OPCODE)
+    {
+        memset(&record, 0, sizeof(record));
+        ProcessorAddress address(gNullPointerProcessorAddress);
+        if (opcode->getOpcodeAddress(address))
+        {
+            record.m_address = address.getAddress();
+            record.m_flags|= DisassemblyRecord::FLAG_HAS_ADDRESS;
+        }
+        record.m_mnemonic = m_invalidMnemonic;
+        record.m_alterProperty = opcode->getAlterProperty();
+        record.m_flags|= DisassemblyRecord::FLAG_INVALID;
+        record.m_length = (uint8)opcode->getOpcodeSize();
+    } else
+    {
+        CHECK((opcode->getType() == OpcodeSubsystems::DISASSEMBLER_INTEL_16) ||
+              (opcode->getType() == OpcodeSubsystems::DISASSEMBLER_INTEL_32));
+        translate(*((const IA32Opcode*)opcode.getPointer()), record);
+    }
+
+    m_used++;
+}
+
+void IA32RecordWriter::flush()
+{
+    if (m_used == 0)
+        return;
+
+    m_output.pipeWrite(m_records.getBuffer(),
+                       m_used * sizeof(DisassemblyRecord::Record));
+    m_count+= m_used;
+    m_used = 0;
+}
+
+uint IA32RecordWriter::getRecordsCount() const
+{
+    return m_count + m_used;
+}
+
+void IA32RecordWriter::translate(const IA32Opcode& opcode,
+                                 DisassemblyRecord::Record& record) const
+{
+    memset(&record, 0, sizeof(record));
+
+    if (opcode.m_shouldUseAddress)
+    {
+        record.m_address = opcode.m_opcodeAddress.getAddress();
+        record.m_flags|= DisassemblyRecord::FLAG_HAS_ADDRESS;
+    }
+
+    // The spelling is chosen by the processor mode, as IA32IntelNotation does
+    ia32dis::MnemonicVariant variant =
+        (opcode.m_type == IA32eInstructionSet::INTEL_32) ?
+            ia32dis::MNEMONIC_32BIT : ia32dis::MNEMONIC_16BIT;
+    record.m_mnemonic = m_mnemonics[
+        ia32dis::getOpcodeEntryIndex(opcode.m_opcode) *
+        ia32dis::MNEMONIC_VARIANTS_COUNT + variant];
+
+    record.m_alterProperty = opcode.m_opcode->m_alterProperty;
+    record.m_length = (uint8)opcode.m_opcodeData.getSize();
+    if (opcode.isBranch())
+        record.m_flags|= DisassemblyRecord::FLAG_BRANCH;
+    if (opcode.isSwitch())
+    {
+        record.m_flags|= DisassemblyRecord::FLAG_SWITCH |
+                         DisassemblyRecord::FLAG_HAS_BRANCH_TARGET;
+        record.m_branchTarget = opcode.getSwitchTableOffset();
+    }
+
+    // The prefixs
+    for (uint i = 0; i < opcode.m_prefixsCount; i++)
+    {
+        switch (opcode.m_prefixs[i])
+        {
+        case 0xF0: record.m_flags|= DisassemblyRecord::FLAG_LOCK; break;
+        case 0xF2: record.m_flags|= DisassemblyRecord::FLAG_REPNE; break;
+        case 0xF3: record.m_flags|= DisassemblyRecord::FLAG_REP; break;
+        }
+    }
+
+    // The operands
+    const ia32dis::OperandType operands[DisassemblyRecord::MAX_OPERANDS] = {
+        opcode.m_opcode->m_firstOperand,
+        opcode.m_opcode->m_secondOperand,
+        opcode.m_opcode->m_thridOperand
+    };
+    for (uint i = 0; i < DisassemblyRecord::MAX_OPERANDS; i++)
+    {
+        if (operands[i] == ia32dis::OPND_NO_OPERAND)
+            break;
+        translateOperand(opcode, operands[i], record.m_operands[i], record);
+        record.m_operandsCount++;
+    }
+}
+
+void IA32RecordWriter::translateOperand(const IA32Opcode& opcode,
+                                        ia32dis::OperandType type,
+                                        DisassemblyRecord::Operand& operand,
+                                        DisassemblyRecord::Record& record) const
+{
+    uint operandSet = getGPSet(opcode.m_operandSize);
+    uint regOpcode = opcode.m_modrm.m_bits.m_regOpcode;
+
+    // Register operands
+    operand.m_type = DisassemblyRecord::OPERAND_REGISTER;
+    switch (type)
+    {
+    case ia32dis::OPND_GP_16_32BIT:
+        operand.m_base = getRegister(operandSet, regOpcode);
+        operand.m_size = (uint8)opcode.m_operandSize;
+        return;
+    case ia32dis::OPND_GP_8BIT_MODRM:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_GP8,
+                                     regOpcode);
+        operand.m_size = 1;
+        return;
+    case ia32dis::OPND_GP_16BIT_MODRM:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_GP16,
+                                     regOpcode);
+        operand.m_size = 2;
+        return;
+    case ia32dis::OPND_SIMD_MODRM:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_SIMD,
+                                     regOpcode);
+        operand.m_size = 16;
+        return;
+    case ia32dis::OPND_CTRL_MODRM:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_CONTROL,
+                                     regOpcode);
+        operand.m_size = 4;
+        return;
+    case ia32dis::OPND_DBG_MODRM:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_DEBUG,
+                                     regOpcode);
+        operand.m_size = 4;
+        return;
+    case ia32dis::OPND_GP_SEGMENT_MODRM:
+        CHECK(regOpcode < ia32dis::NUMBER_OF_SEGMENTS_REGISTERS);
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_SEGMENT,
+                                     regOpcode);
+        operand.m_size = 2;
+        return;
+    case ia32dis::OPND_ONEBYTES_OPCODE_GP_16_32:
+        operand.m_base = getRegister(operandSet, opcode.m_lastOpcodeByte & 7);
+        operand.m_size = (uint8)opcode.m_operandSize;
+        return;
+    case ia32dis::OPND_ONEBYTES_OPCODE_GP_8:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_GP8,
+                                     opcode.m_lastOpcodeByte & 7);
+        operand.m_size = 1;
+        return;
+    case ia32dis::OPND_AL:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_GP8,
+                                     ia32dis::IA32_GP8_AL);
+        operand.m_size = 1;
+        return;
+    case ia32dis::OPND_CL:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_GP8,
+                                     ia32dis::IA32_GP8_CL);
+        operand.m_size = 1;
+        return;
+    case ia32dis::OPND_DX:
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_GP16,
+                                     ia32dis::IA32_GP16_DX);
+        operand.m_size = 2;
+        return;
+    case ia32dis::OPND_eAX:
+    case ia32dis::OPND_eBX:
+    case ia32dis::OPND_eBP:
+    case ia32dis::OPND_eSI:
+    case ia32dis::OPND_eDI:
+        switch (type)
+        {
+        case ia32dis::OPND_eAX: regOpcode = ia32dis::IA32_GP32_EAX; break;
+        case ia32dis::OPND_eBX: regOpcode = ia32dis::IA32_GP32_EBX; break;
+        case ia32dis::OPND_eBP: regOpcode = ia32dis::IA32_GP32_EBP; break;
+        case ia32dis::OPND_eSI: regOpcode = ia32dis::IA32_GP32_ESI; break;
+        default:                regOpcode = ia32dis::IA32_GP32_EDI; break;
+        }
+        operand.m_base = getRegister(operandSet, regOpcode);
+        operand.m_size = (uint8)opcode.m_operandSize;
+        return;
+    case ia32dis::OPND_CS:
+    case ia32dis::OPND_DS:
+    case ia32dis::OPND_ES:
+    case ia32dis::OPND_SS:
+    case ia32dis::OPND_FS:
+    case ia32dis::OPND_GS:
+        switch (type)
+        {
+        case ia32dis::OPND_CS: regOpcode = ia32dis::IA32_SEG_CS; break;
+        case ia32dis::OPND_DS: regOpcode = ia32dis::IA32_SEG_DS; break;
+        case ia32dis::OPND_ES: regOpcode = ia32dis::IA32_SEG_ES; break;
+        case ia32dis::OPND_SS: regOpcode = ia32dis::IA32_SEG_SS; break;
+        case ia32dis::OPND_FS: regOpcode = ia32dis::IA32_SEG_FS; break;
+        default:               regOpcode = ia32dis::IA32_SEG_GS; break;
+        }
+        operand.m_base = getRegister(DisassemblyRecord::REGISTER_SET_SEGMENT,
+                                     regOpcode);
+        operand.m_size = 2;
+        return;
+    default:
+        break;
+    }
+
+    // Immediates
+    operand.m_type = DisassemblyRecord::OPERAND_IMMEDIATE;
+    switch (type)
+    {
+    case ia32dis::OPND_ONE:
+        operand.m_value = 1;
+        operand.m_size = 1;
+        return;
+    case ia32dis::OPND_THREE:
+        operand.m_value = 3;
+        operand.m_size = 1;
+        return;
+    case ia32dis::OPND_IMMEDIATE_8BIT:
+        operand.m_value = (uint8)opcode.m_immediate.offset;
+        operand.m_size = 1;
+        return;
+    case ia32dis::OPND_IMMEDIATE_16BIT:
+        operand.m_value = (uint16)opcode.m_immediate.offset;
+        operand.m_size = 2;
+        return;
+    case ia32dis::OPND_IMMEDIATE_DS:
+        switch (opcode.m_operandSize)
+        {
+        case IntegerEncoding::INTEGER_16BIT:
+            operand.m_value = (uint16)opcode.m_immediate.offset;
+            break;
+        case IntegerEncoding::INTEGER_32BIT:
+            operand.m_value = (uint32)opcode.m_immediate.offset;
+            break;
+        default:
+            CHECK_FAIL();
+        }
+        operand.m_size = (uint8)opcode.m_operandSize;
+        return;
+    default:
+        break;
+    }
+
+    // Memory references
+    switch (type)
+    {
+    case ia32dis::OPND_MODRM_dWORDPTR:
+    case ia32dis::OPND_MODRM_WORDPTR:
+    case ia32dis::OPND_MODRM_BYTEPTR:
+    case ia32dis::OPND_MODRM_MEM:
+        translateModrm(opcode, type, operand);
+        return;
+
+    case ia32dis::OPND_MEMREF_OFFSET_DS:
+        operand.m_type = DisassemblyRecord::OPERAND_MEMORY;
+        operand.m_segment = getSegmentOverride(opcode);
+        operand.m_scale = 1;
+        switch (opcode.m_addressSize)
+        {
+        case IntegerEncoding::INTEGER_16BIT:
+            operand.m_value = (uint16)opcode.m_immediate.offset;
+            break;
+        case IntegerEncoding::INTEGER_32BIT:
+            operand.m_value = (uint32)opcode.m_immediate.offset;
+            break;
+        default:
+            CHECK_FAIL();
+        }
+        return;
+    default:
+        break;
+    }
+
+    // Branches. NOTE: All ia32 relative calculate are from the next operation
+    switch (type)
+    {
+    case ia32dis::OPND_IMMEDIATE_OFFSET_SHORT_8:
+        translateBranch(opcode, (int8)opcode.m_immediate.offset, operand, record);
+        return;
+    case ia32dis::OPND_IMMEDIATE_OFFSET_LONG_32:
+        translateBranch(opcode, (int32)opcode.m_immediate.offset, operand, record);
+        return;
+    case ia32dis::OPND_IMMEDIATE_OFFSET_DS:
+        switch (opcode.m_addressSize)
+        {
+        case IntegerEncoding::INTEGER_16BIT:
+            translateBranch(opcode, (int16)opcode.m_immediate.offset, operand,
+                            record);
+            return;
+        case IntegerEncoding::INTEGER_32BIT:
+            translateBranch(opcode, (int32)opcode.m_immediate.offset, operand,
+                            record);
+            return;
+        default:
+            CHECK_FAIL();
+        }
+    case ia32dis::OPND_IMMEDIATE_OFFSET_FAR:
+        operand.m_type = DisassemblyRecord::OPERAND_FAR;
+        operand.m_farSegment = opcode.m_immediate.segment;
+        switch (opcode.m_addressSize)
+        {
+        case IntegerEncoding::INTEGER_16BIT:
+            operand.m_value = (uint16)opcode.m_immediate.offset;
+            break;
+        case IntegerEncoding::INTEGER_32BIT:
+            operand.m_value = (uint32)opcode.m_immediate.offset;
+            break;
+        default:
+            CHECK_FAIL();
+        }
+        return;
+    default:
+        // Not ready yet!! See IA32IntelNotation::stringOperand
+        CHECK_FAIL();
+    }
+}
+
+void IA32RecordWriter::translateModrm(const IA32Opcode& opcode,
+                                      ia32dis::OperandType type,
+                                      DisassemblyRecord::Operand& operand) const
+{
+    uint rm = opcode.m_modrm.m_bits.m_rm;
+    uint mod = opcode.m_modrm.m_bits.m_mod;
+
+    const ia32dis::ModRMTranslation* translation = NULL;
+    switch (opcode.m_addressSize)
+    {
+    case IntegerEncoding::INTEGER_16BIT:
+        translation = &ia32dis::gIa32ModRM16[mod][rm];
+        break;
+    case IntegerEncoding::INTEGER_32BIT:
+        translation = &ia32dis::gIa32ModRM32[mod][rm];
+        break;
+    default:
+        // For 64bit and all other unknown value.
+        CHECK_FAIL();
+    }
+
+    // The size of the accessed data
+    switch (type)
+    {
+    case ia32dis::OPND_MODRM_dWORDPTR:
+        operand.m_size = (uint8)opcode.m_operandSize; break;
+    case ia32dis::OPND_MODRM_WORDPTR:
+        operand.m_size = 2; break;
+    case ia32dis::OPND_MODRM_BYTEPTR:
+        operand.m_size = 1; break;
+    default:
+        operand.m_size = 0; break;
+    }
+
+    uint addressSet = getGPSet(opcode.m_addressSize);
+    if (!translation->m_isReference)
+    {
+        // Direct register mode (11)
+        uint set = addressSet;
+        switch (type)
+        {
+        case ia32dis::OPND_MODRM_dWORDPTR:
+            set = getGPSet(opcode.m_operandSize); break;
+        case ia32dis::OPND_MODRM_WORDPTR:
+            set = DisassemblyRecord::REGISTER_SET_GP16; break;
+        case ia32dis::OPND_MODRM_BYTEPTR:
+            set = DisassemblyRecord::REGISTER_SET_GP8; break;
+        default:
+            break;
+        }
+        operand.m_type = DisassemblyRecord::OPERAND_REGISTER;
+        operand.m_base = getRegister(set, translation->m_firstRegisterPointer);
+        return;
+    }
+
+    operand.m_type = DisassemblyRecord::OPERAND_MEMORY;
+    operand.m_segment = getSegmentOverride(opcode);
+    operand.m_scale = 1;
+
+    if (translation->m_firstRegisterPointer != ia32dis::NO_REGISTER)
+        operand.m_base = getRegister(addressSet,
+                                     translation->m_firstRegisterPointer);
+    if (translation->m_secondRegisterPointer != ia32dis::NO_REGISTER)
+        operand.m_index = getRegister(addressSet,
+                                      translation->m_secondRegisterPointer);
+
+    if (translation->m_forceSib)
+    {
+        // [base + index * scale], base EBP with mod 00 means disp32 only and
+        // index ESP means no index
+        const IA32OpcodeDatastruct::SIB& sib = opcode.m_sib;
+        if ((sib.m_bits.m_base != ia32dis::IA32_GP32_EBP) || (mod != 0))
+            operand.m_base = getRegister(addressSet, sib.m_bits.m_base);
+        if (sib.m_bits.m_index != ia32dis::IA32_GP32_ESP)
+        {
+            operand.m_index = getRegister(addressSet, sib.m_bits.m_index);
+            operand.m_scale = (uint8)(1 << sib.m_bits.m_scale);
+        }
+    }
+
+    // The displacement, sign-extended unless it's an absolute address
+    bool isAbsolute = (operand.m_base == DisassemblyRecord::REGISTER_NONE) &&
+                      (operand.m_index == DisassemblyRecord::REGISTER_NONE);
+    switch (opcode.m_displacementLength)
+    {
+    case 0:
+        break;
+    case 1:
+        operand.m_value = (int64)(int8)opcode.m_displacement;
+        break;
+    case 2:
+        if (isAbsolute)
+            operand.m_value = (uint16)opcode.m_displacement;
+        else
+            operand.m_value = (int64)(int16)opcode.m_displacement;
+        break;
+    case 4:
+        if (isAbsolute)
+            operand.m_value = (uint32)opcode.m_displacement;
+        else
+            operand.m_value = (int64)(int32)opcode.m_displacement;
+        break;
+    default:
+        CHECK_FAIL();
+    }
+}
+
+void IA32RecordWriter::translateBranch(const IA32Opcode& opcode,
+                                       int64 relative,
+                                       DisassemblyRecord::Operand& operand,
+                                       DisassemblyRecord::Record& record) const
+{
+    operand.m_type = DisassemblyRecord::OPERAND_BRANCH;
+    operand.m_size = (uint8)opcode.m_addressSize;
+    relative+= opcode.m_opcodeData.getSize();
+
+    if (!opcode.m_shouldUseAddress)
+    {
+        operand.m_value = (uint64)relative;
+        return;
+    }
+
+    ProcessorAddress target = opcode.m_opcodeAddress + relative;
+    operand.m_value = target.getAddress();
+    record.m_branchTarget = operand.m_value;
+    record.m_flags|= DisassemblyRecord::FLAG_HAS_BRANCH_TARGET;
+}
+
+uint8 IA32RecordWriter::getRegister(uint set, uint number)
+{
+    return (uint8)((set << DisassemblyRecord::REGISTER_SET_SHIFT) |
+                   (number & DisassemblyRecord::REGISTER_NUMBER_MASK));
+}
+
+uint IA32RecordWriter::getGPSet(IntegerEncoding::IntegerEncodingType size)
+{
+    switch (size)
+    {
+    case IntegerEncoding::INTEGER_16BIT:
+        return DisassemblyRecord::REGISTER_SET_GP16;
+    case IntegerEncoding::INTEGER_32BIT:
+        return DisassemblyRecord::REGISTER_SET_GP32;
+    default:
+        // TODO! 64 bit
+        CHECK_FAIL();
+    }
+}
+
+uint8 IA32RecordWriter::getSegmentOverride(const IA32Opcode& opcode)
+{
+    for (uint i = 0; i < opcode.m_prefixsCount; i++)
+    {
+        uint segment;
+        switch (opcode.m_prefixs[i])
+        {
+        case 0x26: segment = ia32dis::IA32_SEG_ES; break;
+        case 0x2E: segment = ia32dis::IA32_SEG_CS; break;
+        case 0x36: segment = ia32dis::IA32_SEG_SS; break;
+        case 0x3E: segment = ia32dis::IA32_SEG_DS; break;
+        case 0x64: segment = ia32dis::IA32_SEG_FS; break;
+        case 0x65: segment = ia32dis::IA32_SEG_GS; break;
+        default:
+            continue;
+        }
+        return getRegister(DisassemblyRecord::REGISTER_SET_SEGMENT, segment);
+    }
+    return DisassemblyRecord::REGISTER_NONE;
+}
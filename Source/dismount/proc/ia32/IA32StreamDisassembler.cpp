@@ -340,10 +340,20 @@ OpcodeFormatterPtr IA32StreamDisassembler::getOpcodeFormat(
                                                              dataFormatter));
 
     CHECK(instruction->getType() == getType());
+    if ((!m_formattingCache.isEmpty()) &&
+        (&m_formattingCache->getDataFormatter() == &dataFormatter))
+        return m_formattingCache->getOpcodeFormat(instruction);
+
     return OpcodeFormatterPtr(new IA32IntelNotation(instruction,
                                                     dataFormatter));
 }
 
+void IA32StreamDisassembler::setFormattingCache(
+        const IA32FormattingCachePtr& formattingCache)
+{
+    m_formattingCache = formattingCache;
+}
+
 OpcodeSubsystems::DisassemblerType IA32StreamDisassembler::getType() const
 {
     switch (m_type)
@@ -813,5 +813,179 @@ const OpcodeEntry gIa32FPUOpcodeTable[] = {
 const char* INVALID = "***";
 const char* OPCODEEOT = "---";
 
+/*
+ * The resolved names of a single opcode entry, one for each MnemonicVariant
+ */
+struct ResolvedOpcodeName {
+    char m_name[MNEMONIC_VARIANTS_COUNT][MAX_MNEMONIC_LENGTH];
+};
+
+// The number of entries in an opcode table, including the end marker
+#define OPCODE_TABLE_LENGTH(table) (sizeof(table) / sizeof(table[0]))
+
+// The resolved names, indexed exactly as the opcode tables
+static ResolvedOpcodeName gIa32OneByteResolvedNames[OPCODE_TABLE_LENGTH(gIa32OneByteOpcodeTable)];
+static ResolvedOpcodeName gIa32TwoBytesResolvedNames[OPCODE_TABLE_LENGTH(gIa32TwoBytesOpcodeTable)];
+static ResolvedOpcodeName gIa32FPUResolvedNames[OPCODE_TABLE_LENGTH(gIa32FPUOpcodeTable)];
+
+/*
+ * Substitute the symbols of 'name' (See OpcodeEntry::m_opcodeName) into
+ * 'output' according to 'variant'.
+ */
+static void resolveOpcodeName(const char* name,
+                              MnemonicVariant variant,
+                              char* output)
+{
+    bool is32bit = (variant == MNEMONIC_32BIT);
+
+    // The '/' separates the 16bit name from the 32bit name
+    const char* end = name + strlen(name);
+    const char* separator = strchr(name, '/');
+    if (separator != NULL)
+    {
+        if (is32bit)
+            end = separator;
+        else
+            name = separator + 1;
+    }
+
+    uint length = 0;
+    for (const char* i = name; i < end; i++)
+    {
+        const char* substitute = NULL;
+        if ((*i == '#') && ((i + 1) < end))
+        {
+            switch (i[1])
+            {
+            case 'd': substitute = is32bit ? "d" : ""; break;
+            case 'e': substitute = is32bit ? "e" : ""; break;
+            case '#': substitute = is32bit ? "d" : "w"; break;
+            }
+        }
+
+        if (substitute != NULL)
+        {
+            for (; *substitute != '\0'; substitute++)
+                output[length++] = *substitute;
+            i++;
+        } else
+        {
+            output[length++] = *i;
+        }
+
+        // The table contains a name which is too long
+        CHECK(length < MAX_MNEMONIC_LENGTH);
+    }
+    output[length] = '\0';
+}
+
+/*
+ * Resolve all the names of an opcode table into 'names'
+ */
+static void resolveOpcodeTable(const OpcodeEntry* table,
+                               uint count,
+                               ResolvedOpcodeName* names)
+{
+    for (uint i = 0; i < count; i++)
+    {
+        resolveOpcodeName(table[i].m_opcodeName, MNEMONIC_16BIT,
+                          names[i].m_name[MNEMONIC_16BIT]);
+        resolveOpcodeName(table[i].m_opcodeName, MNEMONIC_32BIT,
+                          names[i].m_name[MNEMONIC_32BIT]);
+    }
+}
+
+/*
+ * Resolves the opcode names right after the opcode tables are built.
+ * NOTE: Must be declared after the tables, static objects inside a single
+ *       module are constructed in the order of their declaration.
+ */
+class OpcodeNamesResolver {
+public:
+    OpcodeNamesResolver()
+    {
+        resolveOpcodeTable(gIa32OneByteOpcodeTable,
+                           OPCODE_TABLE_LENGTH(gIa32OneByteOpcodeTable),
+                           gIa32OneByteResolvedNames);
+        resolveOpcodeTable(gIa32TwoBytesOpcodeTable,
+                           OPCODE_TABLE_LENGTH(gIa32TwoBytesOpcodeTable),
+                           gIa32TwoBytesResolvedNames);
+        resolveOpcodeTable(gIa32FPUOpcodeTable,
+                           OPCODE_TABLE_LENGTH(gIa32FPUOpcodeTable),
+                           gIa32FPUResolvedNames);
+    }
+};
+static OpcodeNamesResolver gOpcodeNamesResolver;
+
+const char* getResolvedOpcodeName(const OpcodeEntry* opcode,
+                                  MnemonicVariant variant)
+{
+    CHECK((uint)variant < MNEMONIC_VARIANTS_COUNT);
+
+    if ((opcode >= gIa32OneByteOpcodeTable) &&
+        (opcode < gIa32OneByteOpcodeTable + OPCODE_TABLE_LENGTH(gIa32OneByteOpcodeTable)))
+        return gIa32OneByteResolvedNames[opcode - gIa32OneByteOpcodeTable].m_name[variant];
+
+    if ((opcode >= gIa32TwoBytesOpcodeTable) &&
+        (opcode < gIa32TwoBytesOpcodeTable + OPCODE_TABLE_LENGTH(gIa32TwoBytesOpcodeTable)))
+        return gIa32TwoBytesResolvedNames[opcode - gIa32TwoBytesOpcodeTable].m_name[variant];
+
+    if ((opcode >= gIa32FPUOpcodeTable) &&
+        (opcode < gIa32FPUOpcodeTable + OPCODE_TABLE_LENGTH(gIa32FPUOpcodeTable)))
+        return gIa32FPUResolvedNames[opcode - gIa32FPUOpcodeTable].m_name[variant];
+
+    // The entry is not part of the opcode tables
+    CHECK_FAIL();
+}
+
+// The number of entries in each of the opcode tables
+static const uint gIa32OneByteOpcodeTableLength =
+    OPCODE_TABLE_LENGTH(gIa32OneByteOpcodeTable);
+static const uint gIa32TwoBytesOpcodeTableLength =
+    OPCODE_TABLE_LENGTH(gIa32TwoBytesOpcodeTable);
+static const uint gIa32FPUOpcodeTableLength =
+    OPCODE_TABLE_LENGTH(gIa32FPUOpcodeTable);
+
+uint getOpcodeEntriesCount()
+{
+    return gIa32OneByteOpcodeTableLength +
+           gIa32TwoBytesOpcodeTableLength +
+           gIa32FPUOpcodeTableLength;
+}
+
+uint getOpcodeEntryIndex(const OpcodeEntry* opcode)
+{
+    if ((opcode >= gIa32OneByteOpcodeTable) &&
+        (opcode < gIa32OneByteOpcodeTable + gIa32OneByteOpcodeTableLength))
+        return (uint)(opcode - gIa32OneByteOpcodeTable);
+
+    if ((opcode >= gIa32TwoBytesOpcodeTable) &&
+        (opcode < gIa32TwoBytesOpcodeTable + gIa32TwoBytesOpcodeTableLength))
+        return gIa32OneByteOpcodeTableLength +
+               (uint)(opcode - gIa32TwoBytesOpcodeTable);
+
+    if ((opcode >= gIa32FPUOpcodeTable) &&
+        (opcode < gIa32FPUOpcodeTable + gIa32FPUOpcodeTableLength))
+        return gIa32OneByteOpcodeTableLength + gIa32TwoBytesOpcodeTableLength +
+               (uint)(opcode - gIa32FPUOpcodeTable);
+
+    // The entry is not part of the opcode tables
+    CHECK_FAIL();
+}
+
+const OpcodeEntry* getOpcodeEntry(uint index)
+{
+    if (index < gIa32OneByteOpcodeTableLength)
+        return gIa32OneByteOpcodeTable + index;
+    index-= gIa32OneByteOpcodeTableLength;
+
+    if (index < gIa32TwoBytesOpcodeTableLength)
+        return gIa32TwoBytesOpcodeTable + index;
+    index-= gIa32TwoBytesOpcodeTableLength;
+
+    CHECK(index < gIa32FPUOpcodeTableLength);
+    return gIa32FPUOpcodeTable + index;
+}
+
 
 }; // end of namespace ia32dis
@@ -0,0 +1,146 @@
+/*
+ * testCallGraph.cpp
+ *
+ * Tests building a CallGraph over a ControlFlowGraph, and its strongly
+ * connected components
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/PagedBitset.h"
+#include "dismount/ControlFlowGraph.h"
+#include "dismount/CallGraph.h"
+
+class TestObjectTestCallGraph : public cTestObject {
+public:
+    /*
+     * Checks that function 'index' of 'callGraph' starts at 'start' and
+     * belongs to SCC 'scc'
+     */
+    void testFunction(const CallGraph& callGraph,
+                      uint index,
+                      addressNumericValue start,
+                      uint scc)
+    {
+        TESTS_ASSERT_EQUAL(callGraph.getFunction(index).m_start, start);
+        TESTS_ASSERT_EQUAL(callGraph.getFunction(index).m_scc, scc);
+    }
+
+    virtual void test()
+    {
+        ControlFlowGraph::Records records;
+        PagedBitset instructions;
+        static const addressNumericValue gInstructions[] = {
+            0x1000, 0x1004, 0x100C,
+            0x1100, 0x1104, 0x110C,
+            0x1200, 0x1204, 0x1208,
+            0x1300, 0x1304, 0x1308,
+            0x1400, 0x140C,
+            0x1500,
+            0x1600 };
+        for (uint i = 0; i < (sizeof(gInstructions) / sizeof(gInstructions[0])); i++)
+            instructions.set(gInstructions[i]);
+
+        // 1000: Calls 1100, and tail calls 1400
+        records.addBlock(0x1000, 0x1010);
+        records.addEdge(0x1004, 0x1100, ControlFlowGraph::EDGE_CALL);
+        records.addEdge(0x100C, 0x1400, ControlFlowGraph::EDGE_UNCONDITIONAL);
+        // 1100 and 1200 call each other, 1100 jumps into the shared code
+        records.addBlock(0x1100, 0x1110);
+        records.addEdge(0x1104, 0x1200, ControlFlowGraph::EDGE_CALL);
+        records.addEdge(0x110C, 0x1500, ControlFlowGraph::EDGE_UNCONDITIONAL);
+        records.addBlock(0x1200, 0x1210);
+        records.addEdge(0x1204, 0x1100, ControlFlowGraph::EDGE_CALL);
+        records.addEdge(0x1208, 0x1300, ControlFlowGraph::EDGE_CALL);
+        // 1300 calls itself, and 1400
+        records.addBlock(0x1300, 0x1310);
+        records.addEdge(0x1304, 0x1300, ControlFlowGraph::EDGE_CALL);
+        records.addEdge(0x1308, 0x1400, ControlFlowGraph::EDGE_CALL);
+        // 1400 jumps into the shared code
+        records.addBlock(0x1400, 0x1410);
+        records.addEdge(0x140C, 0x1500, ControlFlowGraph::EDGE_UNCONDITIONAL);
+        // The shared code, and an unreachable block
+        records.addBlock(0x1500, 0x1510);
+        records.addBlock(0x1600, 0x1610);
+
+        ControlFlowGraph graph;
+        graph.build(records, instructions);
+        TESTS_ASSERT_EQUAL(graph.getBlocksCount(), 7U);
+
+        // An entry point in the middle of a block is ignored
+        static const addressNumericValue gEntryPoints[] = { 0x1000, 0x1004 };
+        CallGraph callGraph;
+        callGraph.build(graph, gEntryPoints, 2);
+
+        // The entry point and the call targets, by address
+        TESTS_ASSERT_EQUAL(callGraph.getFunctionsCount(), 5U);
+        TESTS_ASSERT_EQUAL(callGraph.findFunction(0x1300), 3U);
+        TESTS_ASSERT_EQUAL(callGraph.findFunction(0x1004),
+                           (uint)CallGraph::NO_FUNCTION);
+        TESTS_ASSERT_EQUAL(callGraph.findFunction(0x1500),
+                           (uint)CallGraph::NO_FUNCTION);
+
+        // The shared code belongs to the lowest function which reaches it
+        TESTS_ASSERT_EQUAL(callGraph.getBlockFunction(5), 1U);
+        TESTS_ASSERT_EQUAL(callGraph.getBlockFunction(6),
+                           (uint)CallGraph::NO_FUNCTION);
+        TESTS_ASSERT_EQUAL(callGraph.getFunctionBlocksCount(1), 2U);
+        TESTS_ASSERT_EQUAL(callGraph.getFunctionBlock(1, 0), 1U);
+        TESTS_ASSERT_EQUAL(callGraph.getFunctionBlock(1, 1), 5U);
+        TESTS_ASSERT_EQUAL(callGraph.getFunctionBlocksCount(4), 1U);
+
+        // The tail call is a call, the jumps into the shared code aren't
+        TESTS_ASSERT_EQUAL(callGraph.getCallsCount(), 7U);
+        TESTS_ASSERT_EQUAL(callGraph.getCalleesCount(0), 2U);
+        TESTS_ASSERT_EQUAL(callGraph.getCallee(0, 0), 1U);
+        TESTS_ASSERT_EQUAL(callGraph.getCallee(0, 1), 4U);
+        TESTS_ASSERT_EQUAL(callGraph.getCalleesCount(4), 0U);
+        TESTS_ASSERT_EQUAL(callGraph.getCallersCount(1), 2U);
+        TESTS_ASSERT_EQUAL(callGraph.getCaller(1, 0), 0U);
+        TESTS_ASSERT_EQUAL(callGraph.getCaller(1, 1), 2U);
+        TESTS_ASSERT_EQUAL(callGraph.getCallersCount(4), 2U);
+        TESTS_ASSERT_EQUAL(callGraph.getCaller(4, 0), 0U);
+        TESTS_ASSERT_EQUAL(callGraph.getCaller(4, 1), 3U);
+
+        // The mutual recursion is a single SCC, numbered bottom-up
+        TESTS_ASSERT_EQUAL(callGraph.getSccsCount(), 4U);
+        testFunction(callGraph, 0, 0x1000, 3);
+        testFunction(callGraph, 1, 0x1100, 2);
+        testFunction(callGraph, 2, 0x1200, 2);
+        testFunction(callGraph, 3, 0x1300, 1);
+        testFunction(callGraph, 4, 0x1400, 0);
+        TESTS_ASSERT_EQUAL(callGraph.getSccFunctionsCount(2), 2U);
+        TESTS_ASSERT_EQUAL(callGraph.getSccFunctionsCount(3), 1U);
+        TESTS_ASSERT_EQUAL(callGraph.getSccFunction(3, 0), 0U);
+
+        // Every callee is in the same SCC or in a lower one
+        for (uint function = 0; function < callGraph.getFunctionsCount(); function++)
+            for (uint i = 0; i < callGraph.getCalleesCount(function); i++)
+                TESTS_ASSERT_EQUAL(
+                    callGraph.getFunction(callGraph.getCallee(function, i)).m_scc <=
+                    callGraph.getFunction(function).m_scc,
+                    true);
+
+        // The self call and the mutual calls are recursive
+        TESTS_ASSERT_EQUAL(callGraph.isSccRecursive(0), false);
+        TESTS_ASSERT_EQUAL(callGraph.isSccRecursive(1), true);
+        TESTS_ASSERT_EQUAL(callGraph.isSccRecursive(2), true);
+        TESTS_ASSERT_EQUAL(callGraph.isSccRecursive(3), false);
+
+        // The levels follow the longest chain of calls between the SCCs
+        TESTS_ASSERT_EQUAL(callGraph.getSccLevel(0), 0U);
+        TESTS_ASSERT_EQUAL(callGraph.getSccLevel(1), 1U);
+        TESTS_ASSERT_EQUAL(callGraph.getSccLevel(2), 2U);
+        TESTS_ASSERT_EQUAL(callGraph.getSccLevel(3), 3U);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestCallGraph g_globalTestCallGraph;
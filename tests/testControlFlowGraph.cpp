@@ -0,0 +1,142 @@
+/*
+ * testControlFlowGraph.cpp
+ *
+ * Tests building a ControlFlowGraph from walked records
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/PagedBitset.h"
+#include "dismount/ControlFlowGraph.h"
+
+class TestObjectTestControlFlowGraph : public cTestObject {
+public:
+    /*
+     * Checks that block 'index' of 'graph' is between 'start' and 'end'
+     */
+    void testBlock(const ControlFlowGraph& graph,
+                   uint index,
+                   addressNumericValue start,
+                   addressNumericValue end)
+    {
+        TESTS_ASSERT_EQUAL(graph.getBlock(index).m_start, start);
+        TESTS_ASSERT_EQUAL(graph.getBlock(index).m_end, end);
+    }
+
+    /*
+     * Checks successor 'i' of block 'index' of 'graph'
+     */
+    void testSuccessor(const ControlFlowGraph& graph,
+                       uint index,
+                       uint i,
+                       uint block,
+                       uint kind)
+    {
+        TESTS_ASSERT_EQUAL(graph.getSuccessor(index, i).m_block, block);
+        TESTS_ASSERT_EQUAL(graph.getSuccessor(index, i).m_kind, kind);
+    }
+
+    virtual void test()
+    {
+        ControlFlowGraph::Records records;
+        PagedBitset instructions;
+        static const addressNumericValue gInstructions[] = {
+            0x1000, 0x1004, 0x1008, 0x1010, 0x101C,
+            0x1100, 0x1104, 0x1110, 0x1118,
+            0x1200, 0x1204, 0x1208, 0x1210, 0x1214 };
+        for (uint i = 0; i < (sizeof(gInstructions) / sizeof(gInstructions[0])); i++)
+            instructions.set(gInstructions[i]);
+
+        // A walk, and a nested walk which started in its middle
+        records.addBlock(0x1000, 0x1020);
+        records.addBlock(0x1008, 0x1020);
+        // A block with a jump into its middle
+        records.addBlock(0x1100, 0x1120);
+        // The same code decoded from two different offsets
+        records.addBlock(0x1200, 0x1210);
+        records.addBlock(0x1208, 0x1218);
+        // An empty block is ignored
+        records.addBlock(0x1300, 0x1300);
+
+        // A target in the middle of a block, recorded twice
+        records.addEdge(0x101C, 0x1110, ControlFlowGraph::EDGE_CONDITIONAL);
+        records.addEdge(0x101C, 0x1110, ControlFlowGraph::EDGE_CONDITIONAL);
+        // A target which isn't the start of an instruction
+        records.addEdge(0x1104, 0x1105, ControlFlowGraph::EDGE_UNCONDITIONAL);
+        records.addEdge(0x1118, 0x1200, ControlFlowGraph::EDGE_UNCONDITIONAL);
+        // A target outside of the walked code
+        records.addEdge(0x1214, 0x5000, ControlFlowGraph::EDGE_UNCONDITIONAL);
+
+        TESTS_ASSERT_EQUAL(records.getBlocksCount(), 5U);
+        TESTS_ASSERT_EQUAL(records.getEdgesCount(), 5U);
+
+        ControlFlowGraph graph;
+        graph.build(records, instructions);
+
+        // The nested walk and the jump target split their blocks, the
+        // overlapping decode is trimmed
+        TESTS_ASSERT_EQUAL(graph.getBlocksCount(), 6U);
+        testBlock(graph, 0, 0x1000, 0x1008);
+        testBlock(graph, 1, 0x1008, 0x1020);
+        testBlock(graph, 2, 0x1100, 0x1110);
+        testBlock(graph, 3, 0x1110, 0x1120);
+        testBlock(graph, 4, 0x1200, 0x1208);
+        testBlock(graph, 5, 0x1208, 0x1218);
+
+        TESTS_ASSERT_EQUAL(graph.findBlock(0x1000), 0U);
+        TESTS_ASSERT_EQUAL(graph.findBlock(0x101F), 1U);
+        TESTS_ASSERT_EQUAL(graph.findBlock(0x1105), 2U);
+        TESTS_ASSERT_EQUAL(graph.findBlock(0x1210), 5U);
+        TESTS_ASSERT_EQUAL(graph.findBlock(0x0FFF),
+                           (uint)ControlFlowGraph::NO_BLOCK);
+        TESTS_ASSERT_EQUAL(graph.findBlock(0x1020),
+                           (uint)ControlFlowGraph::NO_BLOCK);
+        TESTS_ASSERT_EQUAL(graph.findBlock(0x1218),
+                           (uint)ControlFlowGraph::NO_BLOCK);
+
+        // The parts of a split block are joined with fall-through edges, the
+        // duplicated edge is kept once, and the edges into the middle of an
+        // instruction or out of the code are dropped
+        TESTS_ASSERT_EQUAL(graph.getEdgesCount(), 4U);
+        TESTS_ASSERT_EQUAL(graph.getSuccessorsCount(0), 1U);
+        testSuccessor(graph, 0, 0, 1, ControlFlowGraph::EDGE_FALLTHROUGH);
+        TESTS_ASSERT_EQUAL(graph.getSuccessorsCount(1), 1U);
+        testSuccessor(graph, 1, 0, 3, ControlFlowGraph::EDGE_CONDITIONAL);
+        TESTS_ASSERT_EQUAL(graph.getSuccessorsCount(2), 1U);
+        testSuccessor(graph, 2, 0, 3, ControlFlowGraph::EDGE_FALLTHROUGH);
+        TESTS_ASSERT_EQUAL(graph.getSuccessorsCount(3), 1U);
+        testSuccessor(graph, 3, 0, 4, ControlFlowGraph::EDGE_UNCONDITIONAL);
+        TESTS_ASSERT_EQUAL(graph.getSuccessorsCount(4), 0U);
+        TESTS_ASSERT_EQUAL(graph.getSuccessorsCount(5), 0U);
+
+        // The predecessors are sorted by the source block
+        TESTS_ASSERT_EQUAL(graph.getPredecessorsCount(3), 2U);
+        TESTS_ASSERT_EQUAL(graph.getPredecessor(3, 0).m_block, 1U);
+        TESTS_ASSERT_EQUAL(graph.getPredecessor(3, 0).m_kind,
+                           (uint)ControlFlowGraph::EDGE_CONDITIONAL);
+        TESTS_ASSERT_EQUAL(graph.getPredecessor(3, 1).m_block, 2U);
+        TESTS_ASSERT_EQUAL(graph.getPredecessor(3, 1).m_kind,
+                           (uint)ControlFlowGraph::EDGE_FALLTHROUGH);
+        TESTS_ASSERT_EQUAL(graph.getPredecessorsCount(0), 0U);
+        TESTS_ASSERT_EQUAL(graph.getPredecessorsCount(4), 1U);
+        TESTS_ASSERT_EQUAL(graph.getPredecessorsCount(5), 0U);
+
+        // Building again drops the previous graph
+        records.clear();
+        records.addBlock(0x1000, 0x1008);
+        graph.build(records, instructions);
+        TESTS_ASSERT_EQUAL(graph.getBlocksCount(), 1U);
+        TESTS_ASSERT_EQUAL(graph.getEdgesCount(), 0U);
+        testBlock(graph, 0, 0x1000, 0x1008);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestControlFlowGraph g_globalTestControlFlowGraph;
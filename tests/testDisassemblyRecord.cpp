@@ -0,0 +1,159 @@
+/*
+ * testDisassemblyRecord.cpp
+ *
+ * Tests writing ia32 instructions as binary disassembly records, and reading
+ * them back with DisassemblyRecordReader
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/string.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/basicIO.h"
+#include "xStl/stream/fileStream.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/OpcodeSubsystems.h"
+#include "dismount/StreamDisassembler.h"
+#include "dismount/StreamDisassemblerFactory.h"
+#include "dismount/DisassemblyRecord.h"
+#include "dismount/DisassemblyRecordReader.h"
+#include "dismount/proc/ia32/IA32RecordWriter.h"
+
+#define RECORDS_FILE    (XSTL_STRING("records.bin"))
+
+class TestObjectTestDisassemblyRecord : public cTestObject {
+public:
+    /*
+     * Return true if DisassemblyRecordReader rejects 'data'
+     */
+    bool isRejected(const cSArray<uint8>& data, uint size)
+    {
+        bool isThrown = false;
+        XSTL_TRY
+        {
+            DisassemblyRecordReader reader(data.getBuffer(), size);
+        }
+        XSTL_CATCH_ALL
+        {
+            isThrown = true;
+        }
+        return isThrown;
+    }
+
+    /*
+     * Checks that the mnemonic of 'record' is 'expected'
+     */
+    void testMnemonic(const DisassemblyRecordReader& reader,
+                      const DisassemblyRecord::Record& record,
+                      const char* expected)
+    {
+        TESTS_ASSERT_EQUAL(cString(reader.getMnemonic(record)) == cString(expected),
+                           true);
+    }
+
+    virtual void test()
+    {
+        static const uint8 gCode[] = {
+            // push ebp / mov ebp, esp / mov eax, [ebp+8]
+            0x55, 0x8B, 0xEC, 0x8B, 0x45, 0x08,
+            // jnz +1 / ret / lock inc dword ptr [eax] / ret
+            0x75, 0x01, 0xC3, 0xF0, 0xFF, 0x00, 0xC3 };
+        enum { INSTRUCTIONS_COUNT = 7 };
+
+        // Write the records through a small buffer, so it's flushed on the way
+        {
+            cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+            BasicInputPtr code(new cMemoryAccesserStream(context,
+                                                         getNumeric(gCode),
+                                                         getNumeric(gCode) + sizeof(gCode)));
+            StreamDisassemblerPtr disassembler =
+                StreamDisassemblerFactory::disassemble(
+                        OpcodeSubsystems::DISASSEMBLER_INTEL_32, code);
+            cFileStream output(RECORDS_FILE, cFile::CREATE | cFile::WRITE);
+            IA32RecordWriter writer(output,
+                                    OpcodeSubsystems::DISASSEMBLER_INTEL_32,
+                                    3);
+            for (uint i = 0; i < INSTRUCTIONS_COUNT; i++)
+                writer.write(disassembler->next());
+            writer.flush();
+            TESTS_ASSERT_EQUAL(writer.getRecordsCount(), (uint)INSTRUCTIONS_COUNT);
+        }
+
+        cSArray<uint8> data;
+        {
+            cFileStream input(RECORDS_FILE, cFile::READ);
+            data.changeSize(input.length());
+            input.pipeRead(data.getBuffer(), data.getSize());
+        }
+
+        // Read them back
+        {
+            DisassemblyRecordReader reader(data.getBuffer(), data.getSize());
+            const DisassemblyRecord::Header& header = reader.getHeader();
+            TESTS_ASSERT_EQUAL(header.m_magic, (uint32)DisassemblyRecord::MAGIC);
+            TESTS_ASSERT_EQUAL(header.m_processorType,
+                               (uint32)OpcodeSubsystems::DISASSEMBLER_INTEL_32);
+            TESTS_ASSERT_EQUAL(header.m_recordsOffset %
+                               DisassemblyRecord::RECORDS_ALIGNMENT, 0U);
+            TESTS_ASSERT_EQUAL(reader.getRecordsCount(), (uint)INSTRUCTIONS_COUNT);
+
+            static const uint8 gLengths[INSTRUCTIONS_COUNT] = { 1, 2, 3, 2, 1, 3, 1 };
+            static const char* gMnemonics[INSTRUCTIONS_COUNT] = {
+                "push", "mov", "mov", "jnz", "ret", "inc", "ret" };
+            for (uint i = 0; i < INSTRUCTIONS_COUNT; i++)
+            {
+                const DisassemblyRecord::Record& record = reader.getRecord(i);
+                TESTS_ASSERT_EQUAL(record.m_length, gLengths[i]);
+                testMnemonic(reader, record, gMnemonics[i]);
+            }
+
+            // The operands of "mov eax, [ebp+8]"
+            const DisassemblyRecord::Record& load = reader.getRecord(2);
+            TESTS_ASSERT_EQUAL(load.m_operandsCount, 2U);
+            TESTS_ASSERT_EQUAL(load.m_operands[0].m_type,
+                               (uint8)DisassemblyRecord::OPERAND_REGISTER);
+            TESTS_ASSERT_EQUAL(load.m_operands[1].m_type,
+                               (uint8)DisassemblyRecord::OPERAND_MEMORY);
+            TESTS_ASSERT_EQUAL(load.m_operands[1].m_value, (uint64)8);
+
+            // The branches and the prefixes
+            TESTS_ASSERT_EQUAL(0 != (reader.getRecord(0).m_flags &
+                                     DisassemblyRecord::FLAG_BRANCH), false);
+            TESTS_ASSERT_EQUAL(0 != (reader.getRecord(3).m_flags &
+                                     DisassemblyRecord::FLAG_BRANCH), true);
+            TESTS_ASSERT_EQUAL(reader.getRecord(3).m_operands[0].m_type,
+                               (uint8)DisassemblyRecord::OPERAND_BRANCH);
+            TESTS_ASSERT_EQUAL(0 != (reader.getRecord(4).m_flags &
+                                     DisassemblyRecord::FLAG_BRANCH), true);
+            TESTS_ASSERT_EQUAL(0 != (reader.getRecord(5).m_flags &
+                                     DisassemblyRecord::FLAG_LOCK), true);
+        }
+
+        // A file which is cut in the middle of a record
+        TESTS_ASSERT_EQUAL(isRejected(data, data.getSize() - 1), true);
+        // A file which is cut inside the string table
+        DisassemblyRecord::Header* header = (DisassemblyRecord::Header*)data.getBuffer();
+        TESTS_ASSERT_EQUAL(isRejected(data, header->m_stringTableOffset + 4), true);
+
+        // A string table which doesn't end with a null
+        uint32 stringTableSize = header->m_stringTableSize;
+        header->m_stringTableSize = stringTableSize - 1;
+        TESTS_ASSERT_EQUAL(isRejected(data, data.getSize()), true);
+        // A string table which runs into the records
+        header->m_stringTableSize = header->m_recordsOffset -
+                                    header->m_stringTableOffset + 1;
+        TESTS_ASSERT_EQUAL(isRejected(data, data.getSize()), true);
+        header->m_stringTableSize = stringTableSize;
+        TESTS_ASSERT_EQUAL(isRejected(data, data.getSize()), false);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestDisassemblyRecord g_globalTestDisassemblyRecord;
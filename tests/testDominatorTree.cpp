@@ -0,0 +1,202 @@
+/*
+ * testDominatorTree.cpp
+ *
+ * Tests the dominators and the loops of DominatorTree over a hand-built
+ * control flow graph
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/PagedBitset.h"
+#include "dismount/ControlFlowGraph.h"
+#include "dismount/CallGraph.h"
+#include "dismount/DominatorTree.h"
+
+class TestObjectTestDominatorTree : public cTestObject {
+public:
+    // The size of each block of the graph
+    enum { BLOCK_SIZE = 0x10 };
+
+    /*
+     * Adds a block at 'start' with a single instruction
+     */
+    void addBlock(ControlFlowGraph::Records& records,
+                  PagedBitset& instructions,
+                  addressNumericValue start)
+    {
+        records.addBlock(start, start + BLOCK_SIZE);
+        instructions.set(start);
+    }
+
+    /*
+     * Return the loop whose header is the block at 'header'
+     */
+    uint findLoop(const ControlFlowGraph& graph,
+                  const DominatorTree& dominators,
+                  addressNumericValue header)
+    {
+        uint block = graph.findBlock(header);
+        for (uint i = 0; i < dominators.getLoopsCount(); i++)
+        {
+            if (dominators.getLoop(i).m_header == block)
+                return i;
+        }
+        return DominatorTree::NO_LOOP;
+    }
+
+    /*
+     * Return true if the edge from the block at 'source' into the block at
+     * 'header' is a back edge
+     */
+    bool isBackEdge(const ControlFlowGraph& graph,
+                    const DominatorTree& dominators,
+                    addressNumericValue source,
+                    addressNumericValue header)
+    {
+        for (uint i = 0; i < dominators.getBackEdgesCount(); i++)
+        {
+            const DominatorTree::BackEdge& edge = dominators.getBackEdge(i);
+            if ((edge.m_source == graph.findBlock(source)) &&
+                (edge.m_header == graph.findBlock(header)))
+                return true;
+        }
+        return false;
+    }
+
+    /*
+     * Return the immediate dominator of the block at 'address', as an address
+     */
+    addressNumericValue getIdom(const ControlFlowGraph& graph,
+                                const DominatorTree& dominators,
+                                addressNumericValue address)
+    {
+        uint idom = dominators.getImmediateDominator(graph.findBlock(address));
+        if (DominatorTree::NO_BLOCK == idom)
+            return 0;
+        return graph.getBlock(idom).m_start;
+    }
+
+    virtual void test()
+    {
+        // The first function:
+        //   1000: diamond 1010 / 1020, joined at 1030
+        //   1040: the outer loop, closed by 1070 -> 1040
+        //   1050: the inner loop, closed by 1060 -> 1050
+        //   1080: a self loop
+        //   1090: the exit
+        // The second function:
+        //   2000: enters the cycle 2010 <-> 2020 on both of its blocks
+        //         (irreducible, no loop)
+        //   2030: the exit
+        ControlFlowGraph::Records records;
+        PagedBitset instructions;
+        static const addressNumericValue gBlocks[] = {
+            0x1000, 0x1010, 0x1020, 0x1030, 0x1040, 0x1050, 0x1060, 0x1070,
+            0x1080, 0x1090,
+            0x2000, 0x2010, 0x2020, 0x2030 };
+        for (uint i = 0; i < (sizeof(gBlocks) / sizeof(gBlocks[0])); i++)
+            addBlock(records, instructions, gBlocks[i]);
+
+        records.addEdge(0x1000, 0x1010, ControlFlowGraph::EDGE_CONDITIONAL);
+        records.addEdge(0x1000, 0x1020, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x1010, 0x1030, ControlFlowGraph::EDGE_UNCONDITIONAL);
+        records.addEdge(0x1020, 0x1030, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x1030, 0x1040, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x1040, 0x1050, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x1050, 0x1060, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x1060, 0x1050, ControlFlowGraph::EDGE_CONDITIONAL);
+        records.addEdge(0x1060, 0x1070, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x1070, 0x1040, ControlFlowGraph::EDGE_CONDITIONAL);
+        records.addEdge(0x1070, 0x1080, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x1080, 0x1080, ControlFlowGraph::EDGE_CONDITIONAL);
+        records.addEdge(0x1080, 0x1090, ControlFlowGraph::EDGE_FALLTHROUGH);
+
+        records.addEdge(0x2000, 0x2020, ControlFlowGraph::EDGE_CONDITIONAL);
+        records.addEdge(0x2000, 0x2010, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x2010, 0x2030, ControlFlowGraph::EDGE_CONDITIONAL);
+        records.addEdge(0x2010, 0x2020, ControlFlowGraph::EDGE_FALLTHROUGH);
+        records.addEdge(0x2020, 0x2010, ControlFlowGraph::EDGE_UNCONDITIONAL);
+
+        ControlFlowGraph graph;
+        graph.build(records, instructions);
+        TESTS_ASSERT_EQUAL(graph.getBlocksCount(), 14U);
+
+        static const addressNumericValue gEntryPoints[] = { 0x1000, 0x2000 };
+        CallGraph callGraph;
+        callGraph.build(graph, gEntryPoints, 2);
+        TESTS_ASSERT_EQUAL(callGraph.getFunctionsCount(), 2U);
+
+        DominatorTree dominators;
+        dominators.build(graph, callGraph);
+
+        // The immediate dominators
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1000), 0);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1010), 0x1000);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1020), 0x1000);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1030), 0x1000);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1040), 0x1030);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1050), 0x1040);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1060), 0x1050);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1070), 0x1060);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1080), 0x1070);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x1090), 0x1080);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x2000), 0);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x2010), 0x2000);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x2020), 0x2000);
+        TESTS_ASSERT_EQUAL(getIdom(graph, dominators, 0x2030), 0x2010);
+        TESTS_ASSERT_EQUAL(dominators.dominates(graph.findBlock(0x1010),
+                                                graph.findBlock(0x1030)),
+                           false);
+        TESTS_ASSERT_EQUAL(dominators.dominates(graph.findBlock(0x2010),
+                                                graph.findBlock(0x2020)),
+                           false);
+
+        // The loops: the inner, the outer and the self loop. The irreducible
+        // cycle isn't a loop.
+        TESTS_ASSERT_EQUAL(dominators.getLoopsCount(), 3U);
+        uint outer = findLoop(graph, dominators, 0x1040);
+        uint inner = findLoop(graph, dominators, 0x1050);
+        uint self = findLoop(graph, dominators, 0x1080);
+        TESTS_ASSERT_EQUAL(outer != DominatorTree::NO_LOOP, true);
+        TESTS_ASSERT_EQUAL(inner != DominatorTree::NO_LOOP, true);
+        TESTS_ASSERT_EQUAL(self != DominatorTree::NO_LOOP, true);
+        TESTS_ASSERT_EQUAL(inner < outer, true);
+
+        TESTS_ASSERT_EQUAL(dominators.getLoop(outer).m_parent,
+                           (uint)DominatorTree::NO_LOOP);
+        TESTS_ASSERT_EQUAL(dominators.getLoop(outer).m_depth, 1U);
+        TESTS_ASSERT_EQUAL(dominators.getLoop(inner).m_parent, outer);
+        TESTS_ASSERT_EQUAL(dominators.getLoop(inner).m_depth, 2U);
+        TESTS_ASSERT_EQUAL(dominators.getLoop(self).m_parent,
+                           (uint)DominatorTree::NO_LOOP);
+        TESTS_ASSERT_EQUAL(dominators.getLoop(self).m_depth, 1U);
+
+        TESTS_ASSERT_EQUAL(dominators.getBlockLoop(graph.findBlock(0x1030)),
+                           (uint)DominatorTree::NO_LOOP);
+        TESTS_ASSERT_EQUAL(dominators.getBlockLoop(graph.findBlock(0x1060)),
+                           inner);
+        TESTS_ASSERT_EQUAL(dominators.getBlockLoop(graph.findBlock(0x1070)),
+                           outer);
+        TESTS_ASSERT_EQUAL(dominators.getLoopDepth(graph.findBlock(0x1060)), 2U);
+        TESTS_ASSERT_EQUAL(dominators.getLoopDepth(graph.findBlock(0x1090)), 0U);
+        TESTS_ASSERT_EQUAL(dominators.getLoopDepth(graph.findBlock(0x2010)), 0U);
+        TESTS_ASSERT_EQUAL(dominators.getLoopDepth(graph.findBlock(0x2020)), 0U);
+
+        // The back edges
+        TESTS_ASSERT_EQUAL(dominators.getBackEdgesCount(), 3U);
+        TESTS_ASSERT_EQUAL(isBackEdge(graph, dominators, 0x1060, 0x1050), true);
+        TESTS_ASSERT_EQUAL(isBackEdge(graph, dominators, 0x1070, 0x1040), true);
+        TESTS_ASSERT_EQUAL(isBackEdge(graph, dominators, 0x1080, 0x1080), true);
+        TESTS_ASSERT_EQUAL(isBackEdge(graph, dominators, 0x2020, 0x2010), false);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestDominatorTree g_globalTestDominatorTree;
@@ -26,6 +26,8 @@
 #include "pe/ntDirExport.h"
 #include "pe/ntDirReloc.h"
 #include "dismount/FlowMapper.h"
+#include "dismount/ParallelFlowMapper.h"
+#include "dismount/PagedBitset.h"
 #include "xStl/enc/digest/md5.h"
 
 #include "dismount/Opcode.h"
@@ -43,6 +45,209 @@
 
 class TestObjectTestFlowMap : public cTestObject {
 public:
+    // The layout of the parallel mapping test image, and the number of
+    // threads compared with a single thread
+    enum {
+        IMAGE_BASE = 0x400000,
+        SECTION_START = 0x1000,
+        ENTRY_POINT1 = 0x1010,
+        ENTRY_POINT2 = 0x1040,
+        PARALLEL_THREADS = 4
+    };
+
+    /*
+     * Return true if the two map lists are the same
+     */
+    bool isSameMapList(cList<FlowMapper::CodeSubset>& a,
+                       cList<FlowMapper::CodeSubset>& b)
+    {
+        if (a.length() != b.length())
+            return false;
+        cList<FlowMapper::CodeSubset>::iterator j = b.begin();
+        for (cList<FlowMapper::CodeSubset>::iterator i = a.begin();
+             i != a.end();
+             i++, j++)
+        {
+            if (((*i).m_startAddress.getAddress() != (*j).m_startAddress.getAddress()) ||
+                ((*i).m_endAddress.getAddress() != (*j).m_endAddress.getAddress()) ||
+                ((*i).m_callerAddress.getAddress() != (*j).m_callerAddress.getAddress()) ||
+                ((*i).m_endAlterProperty != (*j).m_endAlterProperty) ||
+                ((*i).m_callerAlterProperty != (*j).m_callerAlterProperty))
+                return false;
+        }
+        return true;
+    }
+
+    /*
+     * Sets in 'covered' the addresses of the subsets of 'listMap', from the
+     * start of each subset up to its last instruction
+     */
+    void coverMapList(cList<FlowMapper::CodeSubset>& listMap, PagedBitset& covered)
+    {
+        for (cList<FlowMapper::CodeSubset>::iterator i = listMap.begin();
+             i != listMap.end();
+             i++)
+        {
+            addressNumericValue start = (*i).m_startAddress.getAddress();
+            addressNumericValue end = (*i).m_endAddress.getAddress();
+            if (0 == start)
+                continue;
+            for (addressNumericValue address = start; address <= end; address++)
+                covered.set(address);
+        }
+    }
+
+    /*
+     * Return true if a subset of 'listMap' starts at 'address'
+     */
+    bool isSubsetStart(cList<FlowMapper::CodeSubset>& listMap,
+                       addressNumericValue address)
+    {
+        for (cList<FlowMapper::CodeSubset>::iterator i = listMap.begin();
+             i != listMap.end();
+             i++)
+        {
+            if ((*i).m_startAddress.getAddress() == address)
+                return true;
+        }
+        return false;
+    }
+
+    /*
+     * Maps two functions with FlowMapper::mapAll and with ParallelFlowMapper.
+     * The parallel mapping must be the same for any number of threads, and
+     * must cover the same code as the sequential mapping. (The parallel
+     * mapper may split a subset where a later walk falls into it, see
+     * ParallelFlowMapper.h)
+     */
+    void testParallelMapping()
+    {
+        static const uint8 gImage[] = {
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1010: push ebp / mov ebp, esp / xor eax, eax
+            0x55, 0x8B, 0xEC, 0x33, 0xC0,
+            // 1015: inc eax / cmp eax, 10 / jne 1015
+            0x40, 0x83, 0xF8, 0x0A, 0x75, 0xFA,
+            // 101B: call 1030
+            0xE8, 0x10, 0x00, 0x00, 0x00,
+            // 1020: test eax, eax / je 1029 / call 1040
+            0x85, 0xC0, 0x74, 0x05, 0xE8, 0x17, 0x00, 0x00, 0x00,
+            // 1029: pop ebp / ret
+            0x5D, 0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1030: nop / jmp 1038
+            0x90, 0xEB, 0x05,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1038: ret
+            0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1040: dec eax / jne 1030 / ret
+            0x48, 0x75, 0xED, 0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC };
+
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        cList<SectionMemoryInterface::GeneralSection> sections;
+        sections.append(SectionMemoryInterface::GeneralSection(
+                SECTION_START,
+                SECTION_START + sizeof(gImage),
+                0,
+                SectionMemoryInterface::SECTION_FLAG_EXECUTABLE |
+                SectionMemoryInterface::SECTION_FLAG_READ));
+        SectionMemoryInterfacePtr memoryInterface(new SectionMemoryInterface(
+                IMAGE_BASE, IMAGE_BASE, SECTION_START + sizeof(gImage), sections));
+
+        // The sequential mapping
+        BasicInputPtr stream(new cMemoryAccesserStream(context,
+                                                       getNumeric(gImage),
+                                                       getNumeric(gImage) + sizeof(gImage)));
+        FlowMapper mapper(stream, memoryInterface);
+        FlowMapper::addresses entryPoints;
+        entryPoints.append(ENTRY_POINT1);
+        entryPoints.append(ENTRY_POINT2);
+        mapper.mapAll(entryPoints);
+        cList<FlowMapper::CodeSubset> sequentialMap;
+        mapper.getMapList(sequentialMap);
+
+        // The parallel mapping with a single thread, and with several threads
+        cList<FlowMapper::CodeSubset> parallelMap[2];
+        uint threads[2] = { 1, PARALLEL_THREADS };
+        for (uint i = 0; i < 2; i++)
+        {
+            ParallelFlowMapper parallelMapper(stream, memoryInterface, threads[i]);
+            parallelMapper.addEntryPoint(ENTRY_POINT1, ENTRY_POINT2);
+            parallelMapper.addEntryPoint(ENTRY_POINT2);
+            TESTS_ASSERT_EQUAL(parallelMapper.map(), 4U);
+            parallelMapper.getMapList(parallelMap[i]);
+        }
+        TESTS_ASSERT_EQUAL(isSameMapList(parallelMap[0], parallelMap[1]), true);
+
+        // The same code is covered, and every sequential subset is also a
+        // parallel subset
+        PagedBitset sequentialCover;
+        PagedBitset parallelCover;
+        coverMapList(sequentialMap, sequentialCover);
+        coverMapList(parallelMap[0], parallelCover);
+        for (addressNumericValue address = SECTION_START;
+             address < (SECTION_START + sizeof(gImage));
+             address++)
+            TESTS_ASSERT_EQUAL(sequentialCover.isSet(address),
+                               parallelCover.isSet(address));
+        for (cList<FlowMapper::CodeSubset>::iterator i = sequentialMap.begin();
+             i != sequentialMap.end();
+             i++)
+            TESTS_ASSERT_EQUAL(isSubsetStart(parallelMap[0],
+                                             (*i).m_startAddress.getAddress()),
+                               true);
+    }
+
+    /*
+     * Maps the exports and the offsets of 'filename' with ParallelFlowMapper
+     * and 'threadsCount' threads
+     *
+     * exportArray - The exports, sorted
+     * listOffsets - The offsets, sorted
+     * listMap     - Will be filled with the map list
+     */
+    void mapParallel(const cString& filename,
+                     const SectionMemoryInterfacePtr& memoryInterface,
+                     const cNtDirExport::ExportTable& exportArray,
+                     cList<ProcessorAddress>& listOffsets,
+                     uint threadsCount,
+                     cList<FlowMapper::CodeSubset>& listMap)
+    {
+        ParallelFlowMapper parallelMapper(BasicInputPtr(new cFileStream(filename)),
+                                          memoryInterface,
+                                          threadsCount);
+
+        // Each entry point ends at the next one, and the duplicates are
+        // ignored, as with the sequential mapping
+        for (uint i = 0; i < exportArray.getSize(); i++)
+        {
+            addressNumericValue address = exportArray[i].m_address.getAddressValue();
+            addressNumericValue nextAddress = 0;
+            if (i < exportArray.getSize() - 1)
+                nextAddress = exportArray[i + 1].m_address.getAddressValue();
+            if (address != nextAddress)
+                parallelMapper.addEntryPoint(address, nextAddress);
+        }
+        cList<ProcessorAddress>::iterator offsetIter = listOffsets.begin();
+        while (offsetIter != listOffsets.end())
+        {
+            addressNumericValue address = (*offsetIter).getAddress();
+            offsetIter++;
+            addressNumericValue nextAddress = 0;
+            if (offsetIter != listOffsets.end())
+                nextAddress = (*offsetIter).getAddress();
+            if (address != nextAddress)
+                parallelMapper.addEntryPoint(address, nextAddress);
+        }
+
+        uint count = parallelMapper.map();
+        parallelMapper.getMapList(listMap);
+        TESTS_ASSERT_EQUAL(count, listMap.length());
+    }
+
     bool mapExports(FlowMapper& currMapper, const cNtDirExport::ExportTable& exportArray)
     {
         uint32 subsetsFound = 0;
@@ -281,43 +486,6 @@ public:
     }
 #endif
 
-    void buildBPList(cList<FlowMapper::CodeSubset>& listMap, cList<addressNumericValue>& bpList)
-    {
-        cout << "[*] Building breakpoint list" << endl;
-
-        uint32 numRets = 0, numCalls = 0, numJmps = 0;
-
-        for (cList<FlowMapper::CodeSubset>::iterator iter = listMap.begin(); iter != listMap.end(); iter++)
-        {
-            int endAlterProperty = (*iter).m_endAlterProperty;
-            int callerAlterProperty = (*iter).m_callerAlterProperty;
-
-            // End address - Get only rets, and only those we can handle
-            if ((Opcode::FLOW_RET | Opcode::FLOW_ACTION) == endAlterProperty)
-            {
-                if (!bpList.isIn((*iter).m_endAddress.getAddress()))
-                {
-                    bpList.append((*iter).m_endAddress.getAddress());
-                    numRets++;
-                }
-            }
-
-            // Caller address - Make sure we can handle the calling opcode
-            if (Opcode::FLOW_ACTION & callerAlterProperty)
-            {
-                if (!bpList.isIn((*iter).m_callerAddress.getAddress()))
-                {
-                    bpList.append((*iter).m_callerAddress.getAddress());
-
-                    if (Opcode::FLOW_STACK_CHANGE & callerAlterProperty)
-                        numCalls++;
-                    else if (Opcode::FLOW_COND_ALWAYS & callerAlterProperty)
-                        numJmps++;
-                }
-            }
-        }
-    }
-
     bool testSingleFile(cString filename)
     {
         cout << "[*] Testing file: " << filename << endl;
@@ -452,6 +620,8 @@ public:
 
     virtual void test()
     {
+        testParallelMapping();
+
         cString filename = FILE_PATH;
         cout << "[*] Started TestFlowMap::test() on " << filename << endl;
 
@@ -561,9 +731,23 @@ public:
         currMapper.getMapList(listMap);
         cout << "[*] Total subsets found: " << listMap.length() << endl;
 
-        cList<addressNumericValue> bpList;
-        buildBPList(listMap, bpList);
-        cout << "[*] Breakpoints: " << bpList.length() << endl;
+        // The parallel mapping doesn't depend on the number of threads
+        cList<FlowMapper::CodeSubset> singleThreadMap;
+        cList<FlowMapper::CodeSubset> threadsMap;
+        mapParallel(filename, memoryInterface, exportDir.getExportArray(),
+                    listOffsets, 1, singleThreadMap);
+        mapParallel(filename, memoryInterface, exportDir.getExportArray(),
+                    listOffsets, PARALLEL_THREADS, threadsMap);
+        TESTS_ASSERT_EQUAL(isSameMapList(singleThreadMap, threadsMap), true);
+        cout << "[*] Parallel subsets found: " << threadsMap.length() << endl;
+
+        cout << "[*] Building breakpoint list" << endl;
+        FlowMapper::BreakpointPlan bpPlan;
+        currMapper.buildBreakpointPlan(bpPlan);
+        cout << "[*] Breakpoints: " << bpPlan.m_addresses.getSize() << " (" <<
+                bpPlan.m_endsCount << " rets, " <<
+                bpPlan.m_callsCount << " calls, " <<
+                bpPlan.m_jmpsCount << " jmps)" << endl;
 
         /*
         BasicOutputPtr mapDumpFileStream(new cFileStream(OUTPUT_FILE, cFile::CREATE | cFile::WRITE), SMARTPTR_DESTRUCT_NONE);
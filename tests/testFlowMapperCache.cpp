@@ -0,0 +1,290 @@
+/*
+ * testFlowMapperCache.cpp
+ *
+ * Tests that the stored results of FlowMapperCache are used only for the same
+ * image, sections, mapper version and entry points
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/list.h"
+#include "xStl/os/os.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/basicIO.h"
+#include "xStl/stream/fileStream.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/FlowMapper.h"
+#include "dismount/FlowMapperCache.h"
+#include "dismount/SectionMemoryInterface.h"
+#ifdef XSTL_WINDOWS
+#include <windows.h>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+/*
+ * A new directory for the stored results of a single run, removed with all
+ * its files at the end of the run
+ */
+class TemporaryCacheDirectory {
+public:
+    // The length of the path buffer
+    enum { MAX_PATH_LENGTH = 512 };
+
+    /*
+     * Constructor. Creates the directory, throws if it can't be created.
+     */
+    TemporaryCacheDirectory()
+    {
+        #ifdef XSTL_WINDOWS
+        char temporaryPath[MAX_PATH_LENGTH];
+        CHECK(GetTempPathA(sizeof(temporaryPath), temporaryPath) != 0);
+        CHECK(GetTempFileNameA(temporaryPath, "dmc", 0, m_path) != 0);
+        // GetTempFileName creates a file with the unique name
+        CHECK(DeleteFileA(m_path));
+        CHECK(CreateDirectoryA(m_path, NULL));
+        #else
+        const char* temporaryPath = getenv("TMPDIR");
+        if (temporaryPath == NULL)
+            temporaryPath = "/tmp";
+        snprintf(m_path, sizeof(m_path), "%s/dismount_cache_XXXXXX", temporaryPath);
+        CHECK(mkdtemp(m_path) != NULL);
+        #endif
+    }
+
+    /*
+     * Destructor. Removes the files of the directory and the directory
+     */
+    ~TemporaryCacheDirectory()
+    {
+        char fileName[MAX_PATH_LENGTH];
+        #ifdef XSTL_WINDOWS
+        char pattern[MAX_PATH_LENGTH];
+        _snprintf(pattern, sizeof(pattern), "%s\\*.map", m_path);
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA(pattern, &data);
+        if (find != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                _snprintf(fileName, sizeof(fileName), "%s\\%s", m_path, data.cFileName);
+                DeleteFileA(fileName);
+            } while (FindNextFileA(find, &data));
+            FindClose(find);
+        }
+        RemoveDirectoryA(m_path);
+        #else
+        DIR* directory = opendir(m_path);
+        if (directory != NULL)
+        {
+            struct dirent* entry;
+            while ((entry = readdir(directory)) != NULL)
+            {
+                if (entry->d_name[0] == '.')
+                    continue;
+                snprintf(fileName, sizeof(fileName), "%s/%s", m_path, entry->d_name);
+                unlink(fileName);
+            }
+            closedir(directory);
+        }
+        rmdir(m_path);
+        #endif
+    }
+
+    /*
+     * Return the path of the directory
+     */
+    cString getPath() const { return cString(m_path); }
+
+private:
+    // Deny copy-constructor and operator =
+    TemporaryCacheDirectory(const TemporaryCacheDirectory& other);
+    TemporaryCacheDirectory& operator = (const TemporaryCacheDirectory& other);
+
+    char m_path[MAX_PATH_LENGTH];
+};
+
+class TestObjectTestFlowMapperCache : public cTestObject {
+public:
+    // The image layout
+    enum {
+        IMAGE_BASE = 0x400000,
+        SECTION_START = 0x1000,
+        // The first entry point. The first bytes of the section are padding.
+        ENTRY_POINT1 = 0x1010,
+        ENTRY_POINT2 = 0x1020
+    };
+
+    /*
+     * Maps 'entryPoints' of 'image' through a new cache.
+     *
+     * directory    - The directory of the stored results
+     * image        - The bytes of the image, from SECTION_START
+     * sectionFlags - The flags of the single section of the image
+     * version      - The mapper version of the cache
+     * entryPoints  - The entry points to map
+     * subsets      - Will be filled with the map list
+     *
+     * Return true if the result was loaded from the cache.
+     */
+    bool mapCached(const cString& directory,
+                   const uint8* image,
+                   uint imageSize,
+                   uint sectionFlags,
+                   uint version,
+                   const FlowMapper::addresses& entryPoints,
+                   cList<FlowMapper::CodeSubset>& subsets)
+    {
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        BasicInputPtr stream(new cMemoryAccesserStream(context,
+                                                       getNumeric(image),
+                                                       getNumeric(image) + imageSize));
+        cList<SectionMemoryInterface::GeneralSection> sections;
+        sections.append(SectionMemoryInterface::GeneralSection(
+                SECTION_START, SECTION_START + imageSize, 0, sectionFlags));
+        SectionMemoryInterfacePtr memoryInterface(new SectionMemoryInterface(
+                IMAGE_BASE, IMAGE_BASE, SECTION_START + imageSize, sections));
+
+        FlowMapper mapper(stream, memoryInterface);
+        FlowMapperCache cache(directory, mapper, stream, memoryInterface,
+                              version);
+        TESTS_ASSERT_EQUAL(mapper.isEmpty(), true);
+        uint count = cache.mapAll(entryPoints);
+        TESTS_ASSERT_EQUAL(mapper.isEmpty(), false);
+        mapper.getMapList(subsets);
+        TESTS_ASSERT_EQUAL(count, subsets.length());
+
+        // The graph isn't stored with the map list
+        bool isGraphThrown = false;
+        XSTL_TRY
+        {
+            mapper.getGraph();
+        }
+        XSTL_CATCH_ALL
+        {
+            isGraphThrown = true;
+        }
+        TESTS_ASSERT_EQUAL(isGraphThrown, cache.isHit());
+
+        // The result of a second mapping would depend on the first one
+        bool isSecondMappingThrown = false;
+        XSTL_TRY
+        {
+            cache.mapAll(entryPoints);
+        }
+        XSTL_CATCH_ALL
+        {
+            isSecondMappingThrown = true;
+        }
+        TESTS_ASSERT_EQUAL(isSecondMappingThrown, true);
+        return cache.isHit();
+    }
+
+    /*
+     * Return true if the two map lists are the same
+     */
+    bool isSameMapList(cList<FlowMapper::CodeSubset>& a,
+                       cList<FlowMapper::CodeSubset>& b)
+    {
+        if (a.length() != b.length())
+            return false;
+        cList<FlowMapper::CodeSubset>::iterator j = b.begin();
+        for (cList<FlowMapper::CodeSubset>::iterator i = a.begin();
+             i != a.end();
+             i++, j++)
+        {
+            if (((*i).m_startAddress.getAddress() != (*j).m_startAddress.getAddress()) ||
+                ((*i).m_endAddress.getAddress() != (*j).m_endAddress.getAddress()) ||
+                ((*i).m_callerAddress.getAddress() != (*j).m_callerAddress.getAddress()) ||
+                ((*i).m_endAlterProperty != (*j).m_endAlterProperty))
+                return false;
+        }
+        return true;
+    }
+
+    virtual void test()
+    {
+        // 1010: call 1030
+        //       ret
+        // 1020: nop
+        //       ret
+        // 1030: nop
+        //       ret
+        uint8 image[0x40];
+        cOS::memset(image, 0xCC, sizeof(image));
+        static const uint8 gEntryPoint1[] = { 0xE8, 0x1B, 0x00, 0x00, 0x00, 0xC3 };
+        static const uint8 gEntryPoint2[] = { 0x90, 0xC3 };
+        cOS::memcpy(image + (ENTRY_POINT1 - SECTION_START), gEntryPoint1, sizeof(gEntryPoint1));
+        cOS::memcpy(image + (ENTRY_POINT2 - SECTION_START), gEntryPoint2, sizeof(gEntryPoint2));
+        cOS::memcpy(image + 0x30, gEntryPoint2, sizeof(gEntryPoint2));
+        uint flags = SectionMemoryInterface::SECTION_FLAG_EXECUTABLE |
+                     SectionMemoryInterface::SECTION_FLAG_READ;
+        uint version = FlowMapperCache::MAPPER_VERSION;
+        TemporaryCacheDirectory temporaryDirectory;
+        cString directory = temporaryDirectory.getPath();
+
+        FlowMapper::addresses entryPoints;
+        entryPoints.append(ENTRY_POINT1);
+        entryPoints.append(ENTRY_POINT2);
+        FlowMapper::addresses permutedEntryPoints;
+        permutedEntryPoints.append(ENTRY_POINT2);
+        permutedEntryPoints.append(ENTRY_POINT1);
+        permutedEntryPoints.append(ENTRY_POINT2);
+
+        // The first mapping is stored
+        cList<FlowMapper::CodeSubset> mapped;
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image), flags, version,
+                                     entryPoints, mapped), false);
+        TESTS_ASSERT_EQUAL(mapped.length() > 0, true);
+
+        // The same image is a hit, also with the entry points in another
+        // order and repeated
+        cList<FlowMapper::CodeSubset> loaded;
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image), flags, version,
+                                     entryPoints, loaded), true);
+        TESTS_ASSERT_EQUAL(isSameMapList(mapped, loaded), true);
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image), flags, version,
+                                     permutedEntryPoints, loaded), true);
+        TESTS_ASSERT_EQUAL(isSameMapList(mapped, loaded), true);
+
+        // Another entry point set is a miss
+        FlowMapper::addresses otherEntryPoints;
+        otherEntryPoints.append(ENTRY_POINT1);
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image), flags, version,
+                                     otherEntryPoints, loaded), false);
+
+        // A change of the section flags is a miss
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image),
+                                     SectionMemoryInterface::SECTION_FLAG_EXECUTABLE,
+                                     version, entryPoints, loaded), false);
+
+        // A change of a single byte of the image, even outside of the code,
+        // is a miss
+        image[0]++;
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image), flags, version,
+                                     entryPoints, loaded), false);
+        TESTS_ASSERT_EQUAL(isSameMapList(mapped, loaded), true);
+        image[0]--;
+
+        // A change of the mapper version is a miss
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image), flags, version + 1,
+                                     entryPoints, loaded), false);
+
+        // And the original is still a hit
+        TESTS_ASSERT_EQUAL(mapCached(directory, image, sizeof(image), flags, version,
+                                     entryPoints, loaded), true);
+        TESTS_ASSERT_EQUAL(isSameMapList(mapped, loaded), true);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestFlowMapperCache g_globalTestFlowMapperCache;
@@ -0,0 +1,106 @@
+/*
+ * testFunctionSeeder.cpp
+ *
+ * Tests scanning a section for function start candidates
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/list.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/SectionMemoryInterface.h"
+#include "dismount/FunctionSeeder.h"
+
+class TestObjectTestFunctionSeeder : public cTestObject {
+public:
+    // The layout of the test image
+    enum {
+        IMAGE_BASE = 0x400000,
+        SECTION_START = 0x1000
+    };
+
+    /*
+     * Checks that candidate 'index' of 'seeder' is at 'address' and was
+     * found by 'kinds'
+     */
+    void testCandidate(FunctionSeeder& seeder,
+                       uint index,
+                       addressNumericValue address,
+                       uint kinds)
+    {
+        TESTS_ASSERT_EQUAL(seeder.getCandidate(index).m_address, address);
+        TESTS_ASSERT_EQUAL(seeder.getCandidate(index).m_kinds, kinds);
+    }
+
+    virtual void test()
+    {
+        static const uint8 gImage[] = {
+            // 1000: sub esp, 8 at the start of the section / ret
+            0x83, 0xEC, 0x08, 0xC3,
+            // 1004: sub esp, 16 after a ret
+            0x83, 0xEC, 0x10,
+            // 1007: push ebp / mov ebp, esp, across the end of the first
+            // word / ret
+            0x55, 0x8B, 0xEC, 0xC3,
+            // 100B: padding which doesn't end at an aligned address
+            0xCC, 0xCC, 0xCC,
+            // 100E: mov edi, edi / push ebp / mov ebp, esp, the push starts
+            // the third word / ret
+            0x8B, 0xFF, 0x55, 0x8B, 0xEC, 0xC3,
+            // 1014: Bytes which start no pattern
+            0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+            // 101E: padding which ends at an aligned address
+            0xCC, 0xCC,
+            // 1020: sub esp, 4 / ret
+            0x83, 0xEC, 0x04, 0xC3,
+            // 1024: a cut prologue at the end of the section
+            0x55, 0x8B };
+
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        cList<SectionMemoryInterface::GeneralSection> sections;
+        sections.append(SectionMemoryInterface::GeneralSection(
+                SECTION_START,
+                SECTION_START + sizeof(gImage),
+                0,
+                SectionMemoryInterface::SECTION_FLAG_EXECUTABLE |
+                SectionMemoryInterface::SECTION_FLAG_READ));
+        SectionMemoryInterfacePtr memoryInterface(new SectionMemoryInterface(
+                IMAGE_BASE, IMAGE_BASE, SECTION_START + sizeof(gImage), sections));
+        BasicInputPtr stream(new cMemoryAccesserStream(context,
+                                                       getNumeric(gImage),
+                                                       getNumeric(gImage) + sizeof(gImage)));
+
+        // All the sources, and a user candidate which a prologue found too
+        FunctionSeeder seeder(stream, memoryInterface);
+        seeder.scanSections();
+        seeder.addCandidate(0x1007);
+        TESTS_ASSERT_EQUAL(stream->getPointer(), 0U);
+        TESTS_ASSERT_EQUAL(seeder.getCandidatesCount(), 5U);
+        testCandidate(seeder, 0, 0x1000, FunctionSeeder::SEED_STACK_PROLOGUE);
+        testCandidate(seeder, 1, 0x1004, FunctionSeeder::SEED_STACK_PROLOGUE);
+        testCandidate(seeder, 2, 0x1007, FunctionSeeder::SEED_FRAME_PROLOGUE |
+                                         FunctionSeeder::SEED_USER);
+        testCandidate(seeder, 3, 0x100E, FunctionSeeder::SEED_FRAME_PROLOGUE);
+        testCandidate(seeder, 4, 0x1020, FunctionSeeder::SEED_STACK_PROLOGUE |
+                                         FunctionSeeder::SEED_PADDING);
+
+        // Only the frame prologues
+        FunctionSeeder frames(stream, memoryInterface,
+                              FunctionSeeder::SEED_FRAME_PROLOGUE);
+        frames.scanSections();
+        frames.addCandidate(0x1020);
+        TESTS_ASSERT_EQUAL(frames.getCandidatesCount(), 2U);
+        testCandidate(frames, 0, 0x1007, FunctionSeeder::SEED_FRAME_PROLOGUE);
+        testCandidate(frames, 1, 0x100E, FunctionSeeder::SEED_FRAME_PROLOGUE);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestFunctionSeeder g_globalTestFunctionSeeder;
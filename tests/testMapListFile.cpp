@@ -0,0 +1,172 @@
+/*
+ * testMapListFile.cpp
+ *
+ * Tests writing and reading the map list files of FlowMapper, through the
+ * stream loader and through MapListReader
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/array.h"
+#include "xStl/data/list.h"
+#include "xStl/os/os.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/basicIO.h"
+#include "xStl/stream/fileStream.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/FlowMapper.h"
+#include "dismount/MapListFile.h"
+#include "dismount/MapListReader.h"
+#include "dismount/SectionMemoryInterface.h"
+
+#define VERSION1_FILE   (XSTL_STRING("maplist_v1.bin"))
+#define VERSION2_FILE   (XSTL_STRING("maplist_v2.bin"))
+
+class TestObjectTestMapListFile : public cTestObject {
+public:
+    // The number of subsets in the test files
+    enum { SUBSETS_COUNT = 3 };
+
+    /*
+     * Return a new mapper. The map lists are only loaded and dumped, so the
+     * code is a single ret.
+     */
+    FlowMapper* createMapper()
+    {
+        static const uint8 gCode[] = { 0xC3 };
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        BasicInputPtr stream(new cMemoryAccesserStream(context,
+                                                       getNumeric(gCode),
+                                                       getNumeric(gCode) + sizeof(gCode)));
+        cList<SectionMemoryInterface::GeneralSection> sections;
+        sections.append(SectionMemoryInterface::GeneralSection(
+                0, sizeof(gCode), 0, SectionMemoryInterface::SECTION_FLAG_EXECUTABLE));
+        SectionMemoryInterfacePtr memoryInterface(new SectionMemoryInterface(
+                0, 0, sizeof(gCode), sections));
+        return new FlowMapper(stream, memoryInterface);
+    }
+
+    /*
+     * Writes 'subsets' in the first version of the format: the
+     * number of subsets, and five DWORDs for each subset
+     */
+    void writeVersion1(const uint32 subsets[SUBSETS_COUNT][5])
+    {
+        cFileStream output(VERSION1_FILE, cFile::CREATE | cFile::WRITE);
+        uint32 count = SUBSETS_COUNT;
+        output.pipeWrite(&count, sizeof(count));
+        for (uint i = 0; i < SUBSETS_COUNT; i++)
+            output.pipeWrite(subsets[i], sizeof(subsets[i]));
+    }
+
+    /*
+     * Loads 'fileName' with the stream loader
+     */
+    bool loadStream(FlowMapper& mapper, const cString& fileName)
+    {
+        BasicInputPtr input(new cFileStream(fileName, cFile::READ));
+        return mapper.loadMapList(input);
+    }
+
+    /*
+     * Checks that the map list of 'mapper' matches 'subsets'
+     */
+    void testMapList(FlowMapper& mapper, const uint32 subsets[SUBSETS_COUNT][5])
+    {
+        cList<FlowMapper::CodeSubset> list;
+        mapper.getMapList(list);
+        TESTS_ASSERT_EQUAL(list.length(), (uint)SUBSETS_COUNT);
+
+        uint i = 0;
+        for (cList<FlowMapper::CodeSubset>::iterator iter = list.begin();
+             iter != list.end();
+             iter++, i++)
+        {
+            TESTS_ASSERT_EQUAL((*iter).m_startAddress.getAddress(), subsets[i][0]);
+            TESTS_ASSERT_EQUAL((*iter).m_endAddress.getAddress(), subsets[i][1]);
+            TESTS_ASSERT_EQUAL((*iter).m_callerAddress.getAddress(), subsets[i][2]);
+            TESTS_ASSERT_EQUAL((uint32)(*iter).m_endAlterProperty, subsets[i][3]);
+            TESTS_ASSERT_EQUAL((uint32)(*iter).m_callerAlterProperty, subsets[i][4]);
+        }
+    }
+
+    virtual void test()
+    {
+        // Start, end, caller, end property and caller property
+        static const uint32 gSubsets[SUBSETS_COUNT][5] = {
+            { 0x1000, 0x1010, 0,      0x0800, 0 },
+            { 0x1020, 0x1024, 0x1008, 0x0201, 0x0201 },
+            { 0x2000, 0x2000, 0x1010, 0x0001, 0x0041 } };
+
+        // The first version of the format is still loaded
+        writeVersion1(gSubsets);
+        cSmartPtr<FlowMapper> mapper(createMapper());
+        TESTS_ASSERT_EQUAL(loadStream(*mapper, VERSION1_FILE), true);
+        testMapList(*mapper, gSubsets);
+
+        // Dump the list in the current version
+        {
+            BasicOutputPtr output(new cFileStream(VERSION2_FILE,
+                                                  cFile::CREATE | cFile::WRITE));
+            TESTS_ASSERT_EQUAL(mapper->dumpMapList(output), true);
+        }
+
+        // And load it back through the stream loader
+        cSmartPtr<FlowMapper> streamMapper(createMapper());
+        TESTS_ASSERT_EQUAL(loadStream(*streamMapper, VERSION2_FILE), true);
+        testMapList(*streamMapper, gSubsets);
+
+        // And through the reader, from memory
+        cSArray<uint8> data;
+        {
+            cFileStream input(VERSION2_FILE, cFile::READ);
+            data.changeSize(input.length());
+            input.pipeRead(data.getBuffer(), data.getSize());
+        }
+        MapListReader reader(data.getBuffer(), data.getSize());
+        TESTS_ASSERT_EQUAL(reader.getHeader().m_version, (uint16)MapListFile::VERSION);
+        TESTS_ASSERT_EQUAL(reader.getSubsetsCount(), (uint64)SUBSETS_COUNT);
+        for (uint i = 0; i < SUBSETS_COUNT; i++)
+        {
+            const MapListFile::Subset& subset = reader.getSubset(i);
+            TESTS_ASSERT_EQUAL(subset.m_startAddress, (uint64)gSubsets[i][0]);
+            TESTS_ASSERT_EQUAL(subset.m_endAddress, (uint64)gSubsets[i][1]);
+            TESTS_ASSERT_EQUAL(subset.m_callerAddress, (uint64)gSubsets[i][2]);
+        }
+
+        cSmartPtr<FlowMapper> readerMapper(createMapper());
+        readerMapper->loadMapList(reader);
+        testMapList(*readerMapper, gSubsets);
+
+        // A truncated file is rejected by the reader, and by the stream
+        // loader which leaves the list empty
+        bool isThrown = false;
+        XSTL_TRY
+        {
+            MapListReader truncated(data.getBuffer(), data.getSize() - 1);
+        }
+        XSTL_CATCH_ALL
+        {
+            isThrown = true;
+        }
+        TESTS_ASSERT_EQUAL(isThrown, true);
+
+        {
+            cFileStream output(VERSION2_FILE, cFile::CREATE | cFile::WRITE);
+            output.pipeWrite(data.getBuffer(), data.getSize() - 1);
+        }
+        TESTS_ASSERT_EQUAL(loadStream(*streamMapper, VERSION2_FILE), false);
+        cList<FlowMapper::CodeSubset> list;
+        streamMapper->getMapList(list);
+        TESTS_ASSERT_EQUAL(list.length(), 0U);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestMapListFile g_globalTestMapListFile;
@@ -0,0 +1,145 @@
+/*
+ * testNoReturnAnalysis.cpp
+ *
+ * Tests inferring the functions which don't return over a mapped image
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/list.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/SectionMemoryInterface.h"
+#include "dismount/FlowMapper.h"
+#include "dismount/CallGraph.h"
+#include "dismount/NoReturnAnalysis.h"
+
+class TestObjectTestNoReturnAnalysis : public cTestObject {
+public:
+    // The layout of the test image
+    enum {
+        IMAGE_BASE = 0x400000,
+        SECTION_START = 0x1000,
+        MAIN = 0x1010,
+        LOOP = 0x1020,
+        RETURNING = 0x1030,
+        CALLER = 0x1040,
+        SEEDED = 0x1050,
+        SEEDED_CALLER = 0x1060
+    };
+
+    /*
+     * Maps the entry points of the test image with 'noReturn' applied
+     */
+    void mapImage(FlowMapper& mapper, NoReturnAnalysis& noReturn)
+    {
+        noReturn.apply(mapper);
+        FlowMapper::addresses entryPoints;
+        entryPoints.append(MAIN);
+        entryPoints.append(RETURNING);
+        entryPoints.append(CALLER);
+        entryPoints.append(SEEDED_CALLER);
+        mapper.mapAll(entryPoints);
+    }
+
+    virtual void test()
+    {
+        static const uint8 gImage[] = {
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1010: call 1020 / ret
+            0xE8, 0x0B, 0x00, 0x00, 0x00, 0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1020: jmp 1020
+            0xEB, 0xFE,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1030: test eax, eax / je 1035 / ret
+            0x85, 0xC0, 0x74, 0x01, 0xC3,
+            // 1035: call 1010 / ret
+            0xE8, 0xD6, 0xFF, 0xFF, 0xFF, 0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1040: call 1010 / ret
+            0xE8, 0xCB, 0xFF, 0xFF, 0xFF, 0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1050: ret
+            0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1060: call 1050 / ret
+            0xE8, 0xEB, 0xFF, 0xFF, 0xFF, 0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC };
+
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        cList<SectionMemoryInterface::GeneralSection> sections;
+        sections.append(SectionMemoryInterface::GeneralSection(
+                SECTION_START,
+                SECTION_START + sizeof(gImage),
+                0,
+                SectionMemoryInterface::SECTION_FLAG_EXECUTABLE |
+                SectionMemoryInterface::SECTION_FLAG_READ));
+        SectionMemoryInterfacePtr memoryInterface(new SectionMemoryInterface(
+                IMAGE_BASE, IMAGE_BASE, SECTION_START + sizeof(gImage), sections));
+        BasicInputPtr stream(new cMemoryAccesserStream(context,
+                                                       getNumeric(gImage),
+                                                       getNumeric(gImage) + sizeof(gImage)));
+
+        // The seeded function returns, but the analysis trusts the seed
+        NoReturnAnalysis noReturn;
+        noReturn.addAddress(SEEDED);
+        TESTS_ASSERT_EQUAL(noReturn.getAddressesCount(), 1U);
+
+        // The first mapping walks the rets after the calls
+        FlowMapper mapper(stream, memoryInterface);
+        mapImage(mapper, noReturn);
+        static const addressNumericValue gEntryPoints[] = {
+            MAIN, RETURNING, CALLER, SEEDED_CALLER };
+        CallGraph callGraph;
+        callGraph.build(mapper.getGraph(), gEntryPoints, 4);
+        TESTS_ASSERT_EQUAL(callGraph.getFunctionsCount(), 6U);
+        TESTS_ASSERT_EQUAL(callGraph.findFunction(LOOP), 1U);
+        TESTS_ASSERT_EQUAL(callGraph.findFunction(SEEDED), 4U);
+
+        // The ret of 1010 is reached only through the call to the endless
+        // loop, and the ret of 1040 only through the call to 1010. 1030 has
+        // a path to a ret which doesn't go through the call.
+        TESTS_ASSERT_EQUAL(noReturn.analyze(mapper, callGraph), 5U);
+        TESTS_ASSERT_EQUAL(noReturn.isFunctionNoReturn(callGraph.findFunction(MAIN)), true);
+        TESTS_ASSERT_EQUAL(noReturn.isFunctionNoReturn(callGraph.findFunction(LOOP)), true);
+        TESTS_ASSERT_EQUAL(noReturn.isFunctionNoReturn(callGraph.findFunction(RETURNING)), false);
+        TESTS_ASSERT_EQUAL(noReturn.isFunctionNoReturn(callGraph.findFunction(CALLER)), true);
+        TESTS_ASSERT_EQUAL(noReturn.isFunctionNoReturn(callGraph.findFunction(SEEDED)), true);
+        TESTS_ASSERT_EQUAL(noReturn.isFunctionNoReturn(callGraph.findFunction(SEEDED_CALLER)), true);
+
+        TESTS_ASSERT_EQUAL(noReturn.getAddressesCount(), 5U);
+        TESTS_ASSERT_EQUAL(noReturn.getAddress(0), (addressNumericValue)MAIN);
+        TESTS_ASSERT_EQUAL(noReturn.isNoReturn(RETURNING), false);
+        TESTS_ASSERT_EQUAL(noReturn.isNoReturn(SEEDED_CALLER), true);
+
+        // Mapping again stops after the calls to the functions which don't
+        // return
+        FlowMapper again(stream, memoryInterface);
+        mapImage(again, noReturn);
+        cList<FlowMapper::CodeSubset> listMap;
+        again.getMapList(listMap);
+        for (cList<FlowMapper::CodeSubset>::iterator i = listMap.begin();
+             i != listMap.end();
+             i++)
+        {
+            addressNumericValue start = (*i).m_startAddress.getAddress();
+            addressNumericValue end = (*i).m_endAddress.getAddress();
+            if ((MAIN == start) || (CALLER == start) || (SEEDED_CALLER == start))
+                TESTS_ASSERT_EQUAL(end, start);
+            TESTS_ASSERT_EQUAL((start <= 0x1015) && (end >= 0x1015), false);
+        }
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestNoReturnAnalysis g_globalTestNoReturnAnalysis;
@@ -0,0 +1,166 @@
+/*
+ * testSwitchTable.cpp
+ *
+ * Tests walking the targets of switch jump tables, with and without a bound
+ * check before the jump
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/list.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/SectionMemoryInterface.h"
+#include "dismount/FlowMapper.h"
+#include "dismount/ParallelFlowMapper.h"
+#include "dismount/ControlFlowGraph.h"
+#include "dismount/XrefIndex.h"
+
+class TestObjectTestSwitchTable : public cTestObject {
+public:
+    // The layout of the test images
+    enum {
+        IMAGE_BASE = 0x400000,
+        SECTION_START = 0x1000,
+        ENTRY_POINT = 0x1010
+    };
+
+    /*
+     * Return true if a subset of 'listMap' starts at 'address'
+     */
+    bool isSubsetStart(cList<FlowMapper::CodeSubset>& listMap,
+                       addressNumericValue address)
+    {
+        for (cList<FlowMapper::CodeSubset>::iterator i = listMap.begin();
+             i != listMap.end();
+             i++)
+        {
+            if ((*i).m_startAddress.getAddress() == address)
+                return true;
+        }
+        return false;
+    }
+
+    /*
+     * Maps 'image' from ENTRY_POINT, and checks the switch at 'jump'.
+     *
+     * image, size   - The bytes of the executable section
+     * jump          - The address of the switch jump
+     * cases         - The number of table entries which should be walked
+     * extra         - The target of the last table entry which is code
+     * isExtraWalked - Whether 'extra' should be walked
+     * subsetsCount  - The number of subsets of the mapping
+     */
+    void testSwitch(const uint8* image,
+                    uint size,
+                    addressNumericValue jump,
+                    uint cases,
+                    addressNumericValue extra,
+                    bool isExtraWalked,
+                    uint subsetsCount)
+    {
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        cList<SectionMemoryInterface::GeneralSection> sections;
+        sections.append(SectionMemoryInterface::GeneralSection(
+                SECTION_START,
+                SECTION_START + size,
+                0,
+                SectionMemoryInterface::SECTION_FLAG_EXECUTABLE |
+                SectionMemoryInterface::SECTION_FLAG_READ));
+        SectionMemoryInterfacePtr memoryInterface(new SectionMemoryInterface(
+                IMAGE_BASE, IMAGE_BASE, SECTION_START + size, sections));
+        BasicInputPtr stream(new cMemoryAccesserStream(context,
+                                                       getNumeric(image),
+                                                       getNumeric(image) + size));
+
+        FlowMapper mapper(stream, memoryInterface);
+        FlowMapper::addresses entryPoints;
+        entryPoints.append(ENTRY_POINT);
+        TESTS_ASSERT_EQUAL(mapper.mapAll(entryPoints), subsetsCount);
+        cList<FlowMapper::CodeSubset> listMap;
+        mapper.getMapList(listMap);
+        TESTS_ASSERT_EQUAL(isSubsetStart(listMap, extra), isExtraWalked);
+
+        // A switch edge into each walked case
+        const ControlFlowGraph& graph = mapper.getGraph();
+        uint switchEdges = 0;
+        for (uint block = 0; block < graph.getBlocksCount(); block++)
+            for (uint i = 0; i < graph.getSuccessorsCount(block); i++)
+                if (ControlFlowGraph::EDGE_SWITCH == graph.getSuccessor(block, i).m_kind)
+                    switchEdges++;
+        TESTS_ASSERT_EQUAL(switchEdges, cases);
+
+        // The jump references the table, and each walked case
+        uint count;
+        uint first = mapper.getXrefIndex().findFrom(jump, count);
+        TESTS_ASSERT_EQUAL(count, cases + 1);
+        uint tables = 0;
+        for (uint i = 0; i < count; i++)
+            if (XrefIndex::XREF_SWITCH_TABLE == mapper.getXrefIndex().getXref(first + i).m_kind)
+                tables++;
+        TESTS_ASSERT_EQUAL(tables, 1U);
+
+        // The parallel mapper reads the same table
+        ParallelFlowMapper parallelMapper(stream, memoryInterface, 2);
+        parallelMapper.addEntryPoint(ENTRY_POINT);
+        TESTS_ASSERT_EQUAL(parallelMapper.map(), subsetsCount);
+        cList<FlowMapper::CodeSubset> parallelMap;
+        parallelMapper.getMapList(parallelMap);
+        TESTS_ASSERT_EQUAL(isSubsetStart(parallelMap, extra), isExtraWalked);
+    }
+
+    virtual void test()
+    {
+        // The table has an entry past the bound check, which is valid code
+        static const uint8 gBounded[] = {
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1010: cmp eax, 2 / ja 101C / jmp dword ptr [eax*4 + 401028]
+            0x83, 0xF8, 0x02,
+            0x77, 0x07,
+            0xFF, 0x24, 0x85, 0x28, 0x10, 0x40, 0x00,
+            // 101C: ret (The default)
+            0xC3,
+            // 101D, 101F, 1021: nop / ret (The cases)
+            0x90, 0xC3, 0x90, 0xC3, 0x90, 0xC3,
+            // 1023: nop / ret (Reached only through the entry past the bound)
+            0x90, 0xC3,
+            0xCC, 0xCC, 0xCC,
+            // 1028: The table, and a value which isn't code
+            0x1D, 0x10, 0x40, 0x00,
+            0x1F, 0x10, 0x40, 0x00,
+            0x21, 0x10, 0x40, 0x00,
+            0x23, 0x10, 0x40, 0x00,
+            0x78, 0x56, 0x34, 0x12 };
+
+        // Without a bound check the table is read until an entry isn't code
+        static const uint8 gUnbounded[] = {
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1010: jmp dword ptr [eax*4 + 401020]
+            0xFF, 0x24, 0x85, 0x20, 0x10, 0x40, 0x00,
+            // 1017, 1019, 101B, 101D: nop / ret (The cases)
+            0x90, 0xC3, 0x90, 0xC3, 0x90, 0xC3, 0x90, 0xC3,
+            0xCC,
+            // 1020: The table, and a value which isn't code
+            0x17, 0x10, 0x40, 0x00,
+            0x19, 0x10, 0x40, 0x00,
+            0x1B, 0x10, 0x40, 0x00,
+            0x1D, 0x10, 0x40, 0x00,
+            0x78, 0x56, 0x34, 0x12 };
+
+        // The entry, the default, three cases and the unknown jump target
+        testSwitch(gBounded, sizeof(gBounded), 0x1015, 3, 0x1023, false, 6);
+        // The entry, four cases and the unknown jump target
+        testSwitch(gUnbounded, sizeof(gUnbounded), 0x1010, 4, 0x101D, true, 6);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestSwitchTable g_globalTestSwitchTable;
@@ -0,0 +1,129 @@
+/*
+ * testSymbolTable.cpp
+ *
+ * Tests loading a symbols file and translating addresses into names
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/string.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/SymbolTable.h"
+
+class TestObjectTestSymbolTable : public cTestObject {
+public:
+    /*
+     * Loads the symbols file 'text' into 'symbols'.
+     *
+     * isThrown - Will be set to true if the file was rejected
+     *
+     * Return the number of symbols read
+     */
+    uint loadText(SymbolTable& symbols, const char* text, bool& isThrown)
+    {
+        uint length = 0;
+        while (text[length] != '\0')
+            length++;
+
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        cMemoryAccesserStream stream(context,
+                                     getNumeric(text),
+                                     getNumeric(text) + length);
+        uint count = 0;
+        isThrown = false;
+        XSTL_TRY
+        {
+            count = symbols.load(stream);
+        }
+        XSTL_CATCH_ALL
+        {
+            isThrown = true;
+        }
+        return count;
+    }
+
+    /*
+     * Checks that 'name' is 'expected'
+     */
+    void testName(const char* name, const char* expected)
+    {
+        TESTS_ASSERT_EQUAL(name != NULL, true);
+        if (name != NULL)
+            TESTS_ASSERT_EQUAL(cString(name) == cString(expected), true);
+    }
+
+    virtual void test()
+    {
+        // Comments, empty lines, the address forms, and a second symbol at
+        // the same address
+        SymbolTable symbols;
+        bool isThrown;
+        TESTS_ASSERT_EQUAL(loadText(symbols,
+                                    "# A comment\n"
+                                    "\n"
+                                    "  0x401000 _main\r\n"
+                                    "401100h\t_foo\n"
+                                    "; Another comment\n"
+                                    "00401100 _fooAlias\n"
+                                    "401200  _bar@8  \n",
+                                    isThrown), 4U);
+        TESTS_ASSERT_EQUAL(isThrown, false);
+        TESTS_ASSERT_EQUAL(symbols.getCount(), 3U);
+        TESTS_ASSERT_EQUAL(symbols.getAddress(1), (ProcessorAddress::uintAddress)0x401100);
+        testName(symbols.getName(1), "_foo");
+        testName(symbols.getName(2), "_bar@8");
+
+        // A malformed line rejects the whole file, the table is unchanged
+        static const char* gMalformed[] = {
+            // No name
+            "401300 _ok\n401400\n",
+            // No address
+            "401300 _ok\nzz _baz\n",
+            // No space between the address and the name
+            "401300 _ok\n401400h_baz\n",
+            // An address which is too long
+            "401300 _ok\n12345678901234567 _baz\n" };
+        for (uint i = 0; i < (sizeof(gMalformed) / sizeof(gMalformed[0])); i++)
+        {
+            loadText(symbols, gMalformed[i], isThrown);
+            TESTS_ASSERT_EQUAL(isThrown, true);
+            TESTS_ASSERT_EQUAL(symbols.getCount(), 3U);
+            TESTS_ASSERT_EQUAL(symbols.find(0x401300) == NULL, true);
+        }
+
+        // Exact lookups
+        testName(symbols.find(0x401000), "_main");
+        testName(symbols.find(0x401100), "_foo");
+        TESTS_ASSERT_EQUAL(symbols.find(0x401101) == NULL, true);
+
+        // The nearest preceding symbol
+        ProcessorAddress::uintAddress address = 0;
+        testName(symbols.findNearest(0x401150, address), "_foo");
+        TESTS_ASSERT_EQUAL(address, (ProcessorAddress::uintAddress)0x401100);
+        testName(symbols.findNearest(0x401000, address), "_main");
+        TESTS_ASSERT_EQUAL(address, (ProcessorAddress::uintAddress)0x401000);
+        testName(symbols.findNearest(0x500000, address), "_bar@8");
+        TESTS_ASSERT_EQUAL(address, (ProcessorAddress::uintAddress)0x401200);
+        TESTS_ASSERT_EQUAL(symbols.findNearest(0x400FFF, address) == NULL, true);
+
+        // Rendering names with offsets
+        cString output;
+        TESTS_ASSERT_EQUAL(symbols.render(0x401000, 0, output), true);
+        TESTS_ASSERT_EQUAL(output == cString("_main"), true);
+        TESTS_ASSERT_EQUAL(symbols.render(0x401110, 0x100, output), true);
+        TESTS_ASSERT_EQUAL(output == cString("_foo+10h"), true);
+        TESTS_ASSERT_EQUAL(symbols.render(0x401300, 0x10, output), false);
+        TESTS_ASSERT_EQUAL(output == cString("_foo+10h"), true);
+        TESTS_ASSERT_EQUAL(symbols.render(0x400000, 0x1000, output), false);
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestSymbolTable g_globalTestSymbolTable;
@@ -0,0 +1,183 @@
+/*
+ * testXrefIndex.cpp
+ *
+ * Tests building an XrefIndex from walked records, and the references which
+ * FlowMapper records
+ *
+ * Author: Elad Raz <e@eladraz.com>
+ */
+#include "xStl/types.h"
+#include "xStl/data/list.h"
+#include "xStl/os/threadUnsafeMemoryAccesser.h"
+#include "xStl/except/trace.h"
+#include "xStl/except/assert.h"
+#include "xStl/stream/memoryAccesserStream.h"
+#include "xStl/../../tests/tests.h"
+#include "dismount/SectionMemoryInterface.h"
+#include "dismount/FlowMapper.h"
+#include "dismount/XrefIndex.h"
+
+class TestObjectTestXrefIndex : public cTestObject {
+public:
+    // The layout of the test image
+    enum {
+        IMAGE_BASE = 0x400000,
+        SECTION_START = 0x1000,
+        CODE_SIZE = 0x30,
+        DATA_START = 0x2000
+    };
+
+    /*
+     * Checks that 'xref' is from 'source' to 'target', of kind 'kind'
+     */
+    void testXref(const XrefIndex::Xref& xref,
+                  addressNumericValue source,
+                  addressNumericValue target,
+                  uint kind)
+    {
+        TESTS_ASSERT_EQUAL(xref.m_source, source);
+        TESTS_ASSERT_EQUAL(xref.m_target, target);
+        TESTS_ASSERT_EQUAL(xref.m_kind, kind);
+    }
+
+    /*
+     * Builds an index from records
+     */
+    void testRecords()
+    {
+        XrefIndex::Records records;
+        records.add(0x1008, 0x2000, XrefIndex::XREF_CALL);
+        records.add(0x1000, 0x2000, XrefIndex::XREF_CALL);
+        records.add(0x1000, 0x1800, XrefIndex::XREF_JUMP);
+        records.add(0x1008, 0x2000, XrefIndex::XREF_CALL);
+        records.add(0x1004, 0x2000, XrefIndex::XREF_THUNK);
+        TESTS_ASSERT_EQUAL(records.getCount(), 5U);
+
+        // The duplicated reference is stored once, sorted by the source
+        XrefIndex xrefs;
+        xrefs.build(records);
+        TESTS_ASSERT_EQUAL(xrefs.getXrefsCount(), 4U);
+        testXref(xrefs.getXref(0), 0x1000, 0x1800, XrefIndex::XREF_JUMP);
+        testXref(xrefs.getXref(1), 0x1000, 0x2000, XrefIndex::XREF_CALL);
+        testXref(xrefs.getXref(2), 0x1004, 0x2000, XrefIndex::XREF_THUNK);
+        testXref(xrefs.getXref(3), 0x1008, 0x2000, XrefIndex::XREF_CALL);
+
+        uint count;
+        TESTS_ASSERT_EQUAL(xrefs.findFrom(0x1000, count), 0U);
+        TESTS_ASSERT_EQUAL(count, 2U);
+        TESTS_ASSERT_EQUAL(xrefs.findFrom(0x1008, count), 3U);
+        TESTS_ASSERT_EQUAL(count, 1U);
+        TESTS_ASSERT_EQUAL(xrefs.findFrom(0x1002, count),
+                           (uint)XrefIndex::NOT_FOUND);
+        TESTS_ASSERT_EQUAL(count, 0U);
+        TESTS_ASSERT_EQUAL(xrefs.findFrom(0x2000, count),
+                           (uint)XrefIndex::NOT_FOUND);
+
+        // The references to a target are sorted by the source
+        TESTS_ASSERT_EQUAL(xrefs.getTargetsCount(), 2U);
+        TESTS_ASSERT_EQUAL(xrefs.getTarget(0), (addressNumericValue)0x1800);
+        TESTS_ASSERT_EQUAL(xrefs.getTarget(1), (addressNumericValue)0x2000);
+        uint first = xrefs.findTo(0x2000, count);
+        TESTS_ASSERT_EQUAL(first, 1U);
+        TESTS_ASSERT_EQUAL(count, 3U);
+        TESTS_ASSERT_EQUAL(xrefs.getTargetFirstXref(1), first);
+        TESTS_ASSERT_EQUAL(xrefs.getTargetXrefsCount(1), count);
+        TESTS_ASSERT_EQUAL(xrefs.getXrefTo(first).m_source, (addressNumericValue)0x1000);
+        TESTS_ASSERT_EQUAL(xrefs.getXrefTo(first + 1).m_source, (addressNumericValue)0x1004);
+        TESTS_ASSERT_EQUAL(xrefs.getXrefTo(first + 2).m_source, (addressNumericValue)0x1008);
+        TESTS_ASSERT_EQUAL(xrefs.findTo(0x1FFF, count),
+                           (uint)XrefIndex::NOT_FOUND);
+        TESTS_ASSERT_EQUAL(count, 0U);
+
+        // Copying, moving and truncating records
+        XrefIndex::Records other;
+        other.append(records, 2, 3);
+        TESTS_ASSERT_EQUAL(other.getCount(), 3U);
+        other.moveDown(1, 2, 0);
+        other.truncate(2);
+        TESTS_ASSERT_EQUAL(other.getCount(), 2U);
+        testXref(other.get(0), 0x1008, 0x2000, XrefIndex::XREF_CALL);
+        testXref(other.get(1), 0x1004, 0x2000, XrefIndex::XREF_THUNK);
+
+        // Building again drops the previous index
+        xrefs.build(other);
+        TESTS_ASSERT_EQUAL(xrefs.getXrefsCount(), 2U);
+        TESTS_ASSERT_EQUAL(xrefs.getTargetsCount(), 1U);
+        TESTS_ASSERT_EQUAL(xrefs.findFrom(0x1000, count),
+                           (uint)XrefIndex::NOT_FOUND);
+    }
+
+    /*
+     * Checks the references which FlowMapper records while walking
+     */
+    void testMapper()
+    {
+        static const uint8 gImage[] = {
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 1010: call 1020 / je 101D / call dword ptr [402000] / ret
+            0xE8, 0x0B, 0x00, 0x00, 0x00,
+            0x74, 0x06,
+            0xFF, 0x15, 0x00, 0x20, 0x40, 0x00,
+            0xC3,
+            0xCC, 0xCC,
+            // 1020: jmp 1024
+            0xEB, 0x02,
+            0xCC, 0xCC,
+            // 1024: call 1010 / ret
+            0xE8, 0xE7, 0xFF, 0xFF, 0xFF, 0xC3,
+            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+            // 2000: The pointer of the indirect call
+            0x00, 0x00, 0x00, 0x00 };
+
+        cVirtualMemoryAccesserPtr context(new cThreadUnsafeMemoryAccesser());
+        cList<SectionMemoryInterface::GeneralSection> sections;
+        sections.append(SectionMemoryInterface::GeneralSection(
+                SECTION_START,
+                SECTION_START + CODE_SIZE,
+                0,
+                SectionMemoryInterface::SECTION_FLAG_EXECUTABLE |
+                SectionMemoryInterface::SECTION_FLAG_READ));
+        sections.append(SectionMemoryInterface::GeneralSection(
+                DATA_START,
+                DATA_START + sizeof(uint32),
+                CODE_SIZE,
+                SectionMemoryInterface::SECTION_FLAG_READ));
+        SectionMemoryInterfacePtr memoryInterface(new SectionMemoryInterface(
+                IMAGE_BASE, IMAGE_BASE, DATA_START + sizeof(uint32), sections));
+        BasicInputPtr stream(new cMemoryAccesserStream(context,
+                                                       getNumeric(gImage),
+                                                       getNumeric(gImage) + sizeof(gImage)));
+
+        FlowMapper mapper(stream, memoryInterface);
+        FlowMapper::addresses entryPoints;
+        entryPoints.append(0x1010);
+        mapper.mapAll(entryPoints);
+
+        // The reference into visited code is recorded too
+        const XrefIndex& xrefs = mapper.getXrefIndex();
+        TESTS_ASSERT_EQUAL(xrefs.getXrefsCount(), 5U);
+        testXref(xrefs.getXref(0), 0x1010, 0x1020, XrefIndex::XREF_CALL);
+        testXref(xrefs.getXref(1), 0x1015, 0x101D, XrefIndex::XREF_JUMP);
+        testXref(xrefs.getXref(2), 0x1017, DATA_START, XrefIndex::XREF_THUNK);
+        testXref(xrefs.getXref(3), 0x1020, 0x1024, XrefIndex::XREF_JUMP);
+        testXref(xrefs.getXref(4), 0x1024, 0x1010, XrefIndex::XREF_CALL);
+
+        uint count;
+        uint first = xrefs.findTo(0x1010, count);
+        TESTS_ASSERT_EQUAL(count, 1U);
+        TESTS_ASSERT_EQUAL(xrefs.getXrefTo(first).m_source, (addressNumericValue)0x1024);
+    }
+
+    virtual void test()
+    {
+        testRecords();
+        testMapper();
+    }
+
+    // Return the name of the module
+    virtual cString getName() { return __FILE__; }
+};
+
+// Instance test object
+TestObjectTestXrefIndex g_globalTestXrefIndex;